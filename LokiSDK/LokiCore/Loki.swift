@@ -429,6 +429,9 @@ public class Loki: NSObject {
 
 		var delay = 100
 		IoTHubDeviceClient_SetOption(self.iotHubClientHandle, OPTION_DO_WORK_FREQUENCY_IN_MS, &delay)
+		// Wake the worker as soon as a location is queued instead of waiting for the next tick
+		var wakeOnDemand = true
+		IoTHubDeviceClient_SetOption(self.iotHubClientHandle, OPTION_DO_WORK_WAKE_ON_DEMAND, &wakeOnDemand)
 		
 		// Mangle my self pointer in order to pass it as an UnsafeMutableRawPointer
 		let that = UnsafeMutableRawPointer(Unmanaged.passUnretained(self).toOpaque())
@@ -500,7 +503,8 @@ public class Loki: NSObject {
 			let messageHandle: IOTHUB_MESSAGE_HANDLE = IoTHubMessage_CreateFromByteArray(jsonString, jsonString.utf8.count)
 			if messageHandle != OpaquePointer.init(bitPattern: 0) {
 				let that = UnsafeMutableRawPointer(Unmanaged.passUnretained(self).toOpaque())
-				let result = IoTHubDeviceClient_SendEventAsync(iotHubClientHandle, messageHandle, mySendConfirmationCallback, that)
+				// The client takes the message over on success; on failure it is still ours to destroy.
+				let result = IoTHubDeviceClient_SendEventAsync_Move(iotHubClientHandle, messageHandle, mySendConfirmationCallback, that)
 				var responseString: String? = nil
 				if let resultStr = IOTHUB_CLIENT_RESULTStrings(result) {
 					responseString = String(cString: UnsafePointer<CChar>(resultStr))
@@ -510,6 +514,7 @@ public class Loki: NSObject {
 					os_log("Loki: location updates send using device to cloud")
 					success = true
 				} else {
+					IoTHubMessage_Destroy(messageHandle)
 					dc.updateSendStatus(locationId: locationId, status: .mqttFailed, error: responseString)
 					os_log("Loki: unable to send location updates using device to cloud")
 				}
@@ -0,0 +1,68 @@
+//
+//  CodecBenchmarkTests.swift
+//  LokiSDKTests
+//
+//  Encode/decode throughput of the uMQTT and uAMQP codecs. Each test sweeps the payload sizes and prints one
+//  JSON line per size, so runs can be diffed across SDK versions, then measures a 4 KB payload with XCTest
+//  metrics. The Pods build does not define GB_DEBUG_ALLOC, so gballoc cannot count allocations and
+//  XCTMemoryMetric reports the memory cost instead.
+//
+
+import XCTest
+
+final class CodecBenchmarkTests: XCTestCase {
+
+    /// Payload sizes swept by each benchmark, 64 B to 256 KB.
+    private static let payloadSizes = [64, 256, 1024, 4096, 16384, 65536, 262144]
+
+    /// Payload bytes processed per sweep point, bounding the run time of the large payloads.
+    private static let bytesPerPoint = 16 << 20
+
+    private static let measuredPayloadSize = 4096
+    private static let measuredIterations = 10_000
+
+    private func sweep(_ operation: CODEC_BENCHMARK_OPERATION) {
+        let name = String(cString: codec_benchmark_operation_name(operation))
+        for payloadSize in CodecBenchmarkTests.payloadSizes {
+            let iterations = min(max(CodecBenchmarkTests.bytesPerPoint / payloadSize, 64), 100_000)
+            var result = CODEC_BENCHMARK_RESULT()
+            XCTAssertEqual(codec_benchmark_run(operation, payloadSize, iterations, &result), 0, "\(name) failed for \(payloadSize) bytes")
+            print("{\"operation\":\"\(name)\",\"payload_bytes\":\(result.payload_size),\"encoded_bytes\":\(result.encoded_size),"
+                  + "\"iterations\":\(result.iterations),\"ns_per_op\":\(String(format: "%.1f", result.ns_per_op)),"
+                  + "\"mb_per_s\":\(String(format: "%.1f", result.mb_per_s))}")
+        }
+    }
+
+    private func benchmark(_ operation: CODEC_BENCHMARK_OPERATION) {
+        sweep(operation)
+        measure(metrics: [XCTClockMetric(), XCTCPUMetric(), XCTMemoryMetric()]) {
+            var result = CODEC_BENCHMARK_RESULT()
+            XCTAssertEqual(codec_benchmark_run(operation, CodecBenchmarkTests.measuredPayloadSize, CodecBenchmarkTests.measuredIterations, &result), 0)
+        }
+    }
+
+    func testMqttCodecPublish() {
+        benchmark(CODEC_BENCHMARK_MQTT_PUBLISH_ENCODE)
+    }
+
+    func testMqttCodecBytesReceived() {
+        benchmark(CODEC_BENCHMARK_MQTT_PUBLISH_DECODE)
+    }
+
+    func testAmqpValueEncode() {
+        benchmark(CODEC_BENCHMARK_AMQP_VALUE_ENCODE)
+    }
+
+    func testAmqpValueDecodeBytes() {
+        benchmark(CODEC_BENCHMARK_AMQP_VALUE_DECODE)
+    }
+
+    func testFrameCodecEncodeFrame() {
+        benchmark(CODEC_BENCHMARK_AMQP_FRAME_ENCODE)
+    }
+
+    func testFrameCodecReceiveBytes() {
+        benchmark(CODEC_BENCHMARK_AMQP_FRAME_DECODE)
+    }
+
+}
@@ -0,0 +1,9 @@
+//
+//  LokiSDKTests-Bridging-Header.h
+//  LokiSDKTests
+//
+//  Use this file to import the test target's C harnesses that you would like to expose to Swift.
+//
+
+#include "codec_benchmark.h"
+#include "mqtt_loopback_broker.h"
@@ -0,0 +1,241 @@
+//
+//  MqttLoopbackBrokerTests.swift
+//  LokiSDKTests
+//
+//  Drives the device client over the real MQTT transport against the in-process loopback broker: telemetry
+//  throughput, delayed and dropped PUBACKs, reconnects, device twin and direct methods.
+//
+
+import XCTest
+import AzureIoTHubClient
+
+/// What the client reported back, shared with the C callbacks through their context pointer.
+private final class ClientEvents {
+    var confirmed = 0
+    var failed = 0
+    var authenticated = 0
+    var unauthenticated = 0
+    var twinUpdates = 0
+    var methodCalls = 0
+    var reportedStatus: Int32 = 0
+}
+
+final class MqttLoopbackBrokerTests: XCTestCase {
+
+    private static let connectionString = "HostName=loopback.azure-devices.net;DeviceId=loki-loopback;SharedAccessKey=AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA="
+
+    /// One location fix, the shape of the telemetry LokiSDK sends.
+    private static let locationFix = "{\"deviceId\":\"loki-loopback\",\"timestamp\":\"2023-09-22T10:00:00.000Z\","
+        + "\"latitude\":-33.868820,\"longitude\":151.209296,\"altitude\":58.0,\"horizontalAccuracy\":4.8}"
+
+    /// Messages sent per measured iteration.
+    private static let messagesPerIteration = 1000
+
+    private var broker: MQTT_LOOPBACK_BROKER_HANDLE!
+    private var client: IOTHUB_DEVICE_CLIENT_LL_HANDLE!
+    private let events = ClientEvents()
+
+    private var context: UnsafeMutableRawPointer {
+        return Unmanaged.passUnretained(events).toOpaque()
+    }
+
+    private var stats: MQTT_LOOPBACK_BROKER_STATS {
+        var stats = MQTT_LOOPBACK_BROKER_STATS()
+        mqtt_loopback_broker_get_stats(broker, &stats)
+        return stats
+    }
+
+    override func setUpWithError() throws {
+        XCTAssertEqual(IoTHub_Init(), 0)
+        broker = try XCTUnwrap(mqtt_loopback_broker_create())
+        client = try XCTUnwrap(IoTHubDeviceClient_LL_CreateFromConnectionString(MqttLoopbackBrokerTests.connectionString, MqttLoopback_Protocol))
+
+        // Reconnect as soon as the broker drops the connection rather than after the default backoff
+        XCTAssertEqual(IoTHubDeviceClient_LL_SetRetryPolicy(client, IOTHUB_CLIENT_RETRY_IMMEDIATE, 0), IOTHUB_CLIENT_OK)
+
+        let connectionStatusCallback: IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK = { status, reason, userContext in
+            let events = Unmanaged<ClientEvents>.fromOpaque(userContext!).takeUnretainedValue()
+            if status == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED {
+                events.authenticated += 1
+            } else {
+                events.unauthenticated += 1
+            }
+        }
+        XCTAssertEqual(IoTHubDeviceClient_LL_SetConnectionStatusCallback(client, connectionStatusCallback, context), IOTHUB_CLIENT_OK)
+    }
+
+    override func tearDownWithError() throws {
+        if let client = client {
+            IoTHubDeviceClient_LL_Destroy(client)
+        }
+        if let broker = broker {
+            mqtt_loopback_broker_destroy(broker)
+        }
+        IoTHub_Deinit()
+    }
+
+    /// Runs the client's DoWork until @p done holds, giving up after @p timeout seconds.
+    @discardableResult
+    private func pump(timeout: TimeInterval = 10, until done: () -> Bool) -> Bool {
+        let deadline = Date(timeIntervalSinceNow: timeout)
+        while !done() && Date() < deadline {
+            IoTHubDeviceClient_LL_DoWork(client)
+            usleep(1000)
+        }
+        return done()
+    }
+
+    private func sendTelemetry(_ count: Int, contentType: String? = nil) {
+        let confirmationCallback: IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK = { result, userContext in
+            let events = Unmanaged<ClientEvents>.fromOpaque(userContext!).takeUnretainedValue()
+            if result == IOTHUB_CLIENT_CONFIRMATION_OK {
+                events.confirmed += 1
+            } else {
+                events.failed += 1
+            }
+        }
+
+        for _ in 0..<count {
+            let message = IoTHubMessage_CreateFromString(MqttLoopbackBrokerTests.locationFix)
+            XCTAssertNotNil(message)
+            if let contentType = contentType {
+                XCTAssertEqual(IoTHubMessage_SetContentTypeSystemProperty(message, contentType), IOTHUB_MESSAGE_OK)
+            }
+            XCTAssertEqual(IoTHubDeviceClient_LL_SendEventAsync(client, message, confirmationCallback, context), IOTHUB_CLIENT_OK)
+            IoTHubMessage_Destroy(message)
+        }
+    }
+
+    private func setFaults(_ faults: MQTT_LOOPBACK_BROKER_FAULTS?) {
+        if var faults = faults {
+            mqtt_loopback_broker_set_faults(broker, &faults)
+        } else {
+            mqtt_loopback_broker_set_faults(broker, nil)
+        }
+    }
+
+    func testTelemetryThroughput() {
+        measure(metrics: [XCTClockMetric(), XCTCPUMetric(), XCTMemoryMetric()]) {
+            let expected = events.confirmed + MqttLoopbackBrokerTests.messagesPerIteration
+            sendTelemetry(MqttLoopbackBrokerTests.messagesPerIteration)
+            XCTAssertTrue(pump { events.confirmed == expected })
+        }
+        XCTAssertEqual(events.failed, 0)
+        XCTAssertEqual(stats.connects, 1)
+        XCTAssertEqual(stats.telemetry_duplicates, 0)
+    }
+
+    private func setTelemetryLinger(milliseconds: Int) {
+        var linger = milliseconds
+        XCTAssertEqual(IoTHubDeviceClient_LL_SetOption(client, OPTION_TELEMETRY_LINGER_MS, &linger), IOTHUB_CLIENT_OK)
+    }
+
+    func testTelemetryWithoutContentTypeIsNotCoalesced() {
+        setTelemetryLinger(milliseconds: 100)
+        sendTelemetry(10)
+
+        XCTAssertTrue(pump { events.confirmed == 10 })
+        let stats = self.stats
+        XCTAssertEqual(stats.telemetry_publishes, 10)
+        XCTAssertEqual(stats.telemetry_payload_bytes, 10 * MqttLoopbackBrokerTests.locationFix.utf8.count)
+        XCTAssertEqual(stats.telemetry_with_content_type, 0)
+    }
+
+    func testJsonTelemetryIsCoalesced() {
+        setTelemetryLinger(milliseconds: 100)
+        sendTelemetry(10, contentType: "application/json")
+
+        XCTAssertTrue(pump { events.confirmed == 10 })
+        let stats = self.stats
+        XCTAssertEqual(stats.telemetry_publishes, 1)
+        // The brackets and the nine commas of the JSON array
+        XCTAssertEqual(stats.telemetry_payload_bytes, 10 * MqttLoopbackBrokerTests.locationFix.utf8.count + 11)
+        XCTAssertEqual(stats.telemetry_with_content_type, 1)
+    }
+
+    func testDelayedPubacks() {
+        setFaults(MQTT_LOOPBACK_BROKER_FAULTS(puback_delay_ms: 50, puback_drop_every: 0, disconnect_after_publishes: 0))
+        let start = Date()
+        sendTelemetry(100)
+
+        XCTAssertTrue(pump { events.confirmed == 100 })
+        XCTAssertGreaterThanOrEqual(Date().timeIntervalSince(start), 0.05)
+        XCTAssertEqual(events.failed, 0)
+        XCTAssertEqual(stats.pubacks_sent, 100)
+        XCTAssertEqual(stats.telemetry_duplicates, 0)
+    }
+
+    func testDroppedPubacksAreRepublishedOnReconnect() {
+        // Without a reconnect the transport only resends after a minute, so the drops come with a disconnect
+        setFaults(MQTT_LOOPBACK_BROKER_FAULTS(puback_delay_ms: 0, puback_drop_every: 2, disconnect_after_publishes: 100))
+        sendTelemetry(100)
+        XCTAssertTrue(pump { stats.disconnects_injected == 1 })
+        setFaults(nil)
+
+        XCTAssertTrue(pump { events.confirmed == 100 })
+        let stats = self.stats
+        XCTAssertEqual(events.failed, 0)
+        XCTAssertEqual(stats.connects, 2)
+        XCTAssertGreaterThan(stats.pubacks_dropped, 0)
+        XCTAssertGreaterThanOrEqual(stats.telemetry_duplicates, stats.pubacks_dropped)
+    }
+
+    func testReconnectAfterDisconnect() {
+        setFaults(MQTT_LOOPBACK_BROKER_FAULTS(puback_delay_ms: 0, puback_drop_every: 0, disconnect_after_publishes: 10))
+        sendTelemetry(50)
+
+        XCTAssertTrue(pump { events.confirmed == 50 })
+        XCTAssertEqual(events.failed, 0)
+        XCTAssertEqual(events.authenticated, 2)
+        XCTAssertEqual(events.unauthenticated, 1)
+        XCTAssertEqual(stats.connects, 2)
+        XCTAssertEqual(stats.disconnects_injected, 1)
+    }
+
+    func testDeviceTwin() {
+        let twinCallback: IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK = { updateState, payload, size, userContext in
+            let events = Unmanaged<ClientEvents>.fromOpaque(userContext!).takeUnretainedValue()
+            events.twinUpdates += 1
+        }
+        XCTAssertEqual(IoTHubDeviceClient_LL_SetDeviceTwinCallback(client, twinCallback, context), IOTHUB_CLIENT_OK)
+
+        // The full twin is requested first, desired property updates are only subscribed to once it arrived
+        XCTAssertTrue(pump { events.twinUpdates == 1 })
+        XCTAssertEqual(stats.twin_gets, 1)
+        XCTAssertTrue(pump { stats.subscribes == 2 })
+
+        XCTAssertEqual(mqtt_loopback_broker_update_desired(broker, "{\"reportingInterval\":30,\"$version\":2}"), 0)
+        XCTAssertTrue(pump { events.twinUpdates == 2 })
+
+        let reportedCallback: IOTHUB_CLIENT_REPORTED_STATE_CALLBACK = { statusCode, userContext in
+            let events = Unmanaged<ClientEvents>.fromOpaque(userContext!).takeUnretainedValue()
+            events.reportedStatus = statusCode
+        }
+        let reported = Array("{\"batteryLevel\":0.81}".utf8)
+        XCTAssertEqual(IoTHubDeviceClient_LL_SendReportedState(client, reported, reported.count, reportedCallback, context), IOTHUB_CLIENT_OK)
+        XCTAssertTrue(pump { events.reportedStatus != 0 })
+        XCTAssertEqual(events.reportedStatus, 204)
+        XCTAssertEqual(stats.twin_reported_patches, 1)
+    }
+
+    func testDeviceMethod() {
+        let methodCallback: IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC = { methodName, payload, payloadSize, response, responseSize, userContext in
+            let events = Unmanaged<ClientEvents>.fromOpaque(userContext!).takeUnretainedValue()
+            events.methodCalls += 1
+
+            // The client frees the response
+            let body = strdup("{\"rebooting\":true}")!
+            response!.pointee = UnsafeMutableRawPointer(body).assumingMemoryBound(to: UInt8.self)
+            responseSize!.pointee = strlen(body)
+            return String(cString: methodName!) == "reboot" ? 200 : 404
+        }
+        XCTAssertEqual(IoTHubDeviceClient_LL_SetDeviceMethodCallback(client, methodCallback, context), IOTHUB_CLIENT_OK)
+        XCTAssertTrue(pump { stats.subscribes > 0 })
+
+        XCTAssertEqual(mqtt_loopback_broker_invoke_method(broker, "reboot", "{\"delay\":0}"), 0)
+        XCTAssertTrue(pump { stats.method_responses == 1 })
+        XCTAssertEqual(events.methodCalls, 1)
+        XCTAssertEqual(stats.last_method_status, 200)
+    }
+
+}
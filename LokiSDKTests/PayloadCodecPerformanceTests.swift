@@ -0,0 +1,82 @@
+//
+//  PayloadCodecPerformanceTests.swift
+//  LokiSDKTests
+//
+//  Compression ratio and CPU cost of the built-in telemetry payload codecs (OPTION_PAYLOAD_CODEC).
+//
+
+import XCTest
+import AzureIoTHubClient
+
+final class PayloadCodecPerformanceTests: XCTestCase {
+
+    /// Messages encoded per measured iteration.
+    private static let messagesPerIteration = 1000
+
+    /// Twenty location fixes batched into one JSON array, the shape of the telemetry LokiSDK sends.
+    private static let locationBatch: [UInt8] = {
+        var fixes: [String] = []
+        for i in 0..<20 {
+            fixes.append(String(format: "{\"deviceId\":\"loki-device-0001\",\"timestamp\":\"2023-09-22T10:%02ld:%02ld.000Z\","
+                                + "\"latitude\":%.6f,\"longitude\":%.6f,\"altitude\":%.1f,\"horizontalAccuracy\":%.1f,"
+                                + "\"speed\":%.2f,\"course\":%.1f,\"batteryLevel\":%.2f}",
+                                i / 6, (i * 10) % 60,
+                                -33.868820 + Double(i) * 0.000137, 151.209296 + Double(i) * 0.000211,
+                                58.0 + Double(i) * 0.3, 4.8 + Double(i % 3), 1.35 + Double(i) * 0.07,
+                                87.5 + Double(i), 0.81 - Double(i) * 0.001))
+        }
+        return Array(("[" + fixes.joined(separator: ",") + "]").utf8)
+    }()
+
+    /// Encodes @p payload with @p codec, returning the encoded size or nil when the codec refused it.
+    private func encode(_ codec: UnsafePointer<IOTHUB_CLIENT_PAYLOAD_CODEC>, _ payload: [UInt8], into destination: inout [UInt8]) -> Int? {
+        var encodedSize = destination.count
+        let result = payload.withUnsafeBufferPointer { source in
+            destination.withUnsafeMutableBufferPointer { target in
+                codec.pointee.encode!(source.baseAddress, source.count, target.baseAddress, &encodedSize)
+            }
+        }
+        return result == 0 ? encodedSize : nil
+    }
+
+    private func compressionRatio(_ codec: UnsafePointer<IOTHUB_CLIENT_PAYLOAD_CODEC>) throws -> Double {
+        let payload = PayloadCodecPerformanceTests.locationBatch
+        var destination = [UInt8](repeating: 0, count: payload.count)
+        let encodedSize = try XCTUnwrap(encode(codec, payload, into: &destination))
+        let ratio = Double(payload.count) / Double(encodedSize)
+        print("{\"codec\":\"\(String(cString: codec.pointee.contentEncoding))\",\"size\":\(payload.count),\"encoded\":\(encodedSize),\"ratio\":\(String(format: "%.2f", ratio))}")
+        return ratio
+    }
+
+    private func measureEncoding(_ codec: UnsafePointer<IOTHUB_CLIENT_PAYLOAD_CODEC>) {
+        let payload = PayloadCodecPerformanceTests.locationBatch
+        var destination = [UInt8](repeating: 0, count: payload.count)
+        measure(metrics: [XCTClockMetric(), XCTCPUMetric()]) {
+            for _ in 0..<PayloadCodecPerformanceTests.messagesPerIteration {
+                XCTAssertNotNil(encode(codec, payload, into: &destination))
+            }
+        }
+    }
+
+    func testDeflateCompressionRatio() throws {
+        XCTAssertGreaterThan(try compressionRatio(IoTHubClient_PayloadCodec_Deflate()), 3.0)
+    }
+
+    func testLZ4CompressionRatio() throws {
+        XCTAssertGreaterThan(try compressionRatio(IoTHubClient_PayloadCodec_LZ4()), 3.0)
+    }
+
+    func testDeflateCompressesBetterThanLZ4() throws {
+        XCTAssertGreaterThanOrEqual(try compressionRatio(IoTHubClient_PayloadCodec_Deflate()),
+                                    try compressionRatio(IoTHubClient_PayloadCodec_LZ4()))
+    }
+
+    func testDeflateEncodePerformance() {
+        measureEncoding(IoTHubClient_PayloadCodec_Deflate())
+    }
+
+    func testLZ4EncodePerformance() {
+        measureEncoding(IoTHubClient_PayloadCodec_LZ4())
+    }
+
+}
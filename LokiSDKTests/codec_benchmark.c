@@ -0,0 +1,509 @@
+//
+//  codec_benchmark.c
+//  LokiSDKTests
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "azure_macro_utils/macro_utils.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_umqtt_c/mqtt_codec.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/frame_codec.h"
+
+#include "codec_benchmark.h"
+
+#define BENCHMARK_TOPIC             "devices/loki-benchmark/messages/events/"
+#define BENCHMARK_CHANNEL_BYTES     { 0x00, 0x00 }
+#define NANOSECONDS_PER_SECOND      1000000000ULL
+
+typedef struct ENCODED_BYTES_TAG
+{
+    unsigned char* bytes;
+    size_t size;
+    size_t capacity;
+} ENCODED_BYTES;
+
+static uint64_t get_time_ns(void)
+{
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NANOSECONDS_PER_SECOND + (uint64_t)now.tv_nsec;
+}
+
+static int append_encoded_bytes(void* context, const unsigned char* bytes, size_t length)
+{
+    int result;
+    ENCODED_BYTES* encoded = (ENCODED_BYTES*)context;
+
+    if (encoded->size + length > encoded->capacity)
+    {
+        size_t capacity = (encoded->size + length) * 2;
+        unsigned char* bytes_realloc = (unsigned char*)realloc(encoded->bytes, capacity);
+        if (bytes_realloc == NULL)
+        {
+            LogError("Cannot grow the encoded bytes to %lu bytes", (unsigned long)capacity);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            encoded->bytes = bytes_realloc;
+            encoded->capacity = capacity;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (result == 0)
+    {
+        (void)memcpy(encoded->bytes + encoded->size, bytes, length);
+        encoded->size += length;
+    }
+
+    return result;
+}
+
+static void on_frame_bytes_encoded(void* context, const unsigned char* bytes, size_t length, bool encode_complete)
+{
+    (void)encode_complete;
+    (void)append_encoded_bytes(context, bytes, length);
+}
+
+static void on_mqtt_packet_decoded(void* context, CONTROL_PACKET_TYPE packet, int flags, const uint8_t* packetData, size_t packetLength)
+{
+    (void)flags;
+    (void)packetData;
+    (void)packetLength;
+    if (packet == PUBLISH_TYPE)
+    {
+        (*(size_t*)context)++;
+    }
+}
+
+static void on_amqp_value_decoded(void* context, AMQP_VALUE decoded_value)
+{
+    (void)decoded_value;
+    (*(size_t*)context)++;
+}
+
+static void on_amqp_frame_decoded(void* context, const unsigned char* type_specific, uint32_t type_specific_size, const unsigned char* frame_body, uint32_t frame_body_size)
+{
+    (void)type_specific;
+    (void)type_specific_size;
+    (void)frame_body;
+    (void)frame_body_size;
+    (*(size_t*)context)++;
+}
+
+static void on_frame_codec_error(void* context)
+{
+    (void)context;
+    LogError("Frame codec error");
+}
+
+static FRAME_CODEC_HANDLE create_frame_codec(size_t payload_size)
+{
+    FRAME_CODEC_HANDLE result;
+
+    if ((result = frame_codec_create(on_frame_codec_error, NULL)) == NULL)
+    {
+        LogError("frame_codec_create failed");
+    }
+    // The 8 byte header and the 2 channel bytes padded to a 4 byte boundary
+    else if (frame_codec_set_max_frame_size(result, (uint32_t)payload_size + 12) != 0)
+    {
+        LogError("frame_codec_set_max_frame_size failed");
+        frame_codec_destroy(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static int benchmark_mqtt_publish_encode(const unsigned char* payload, size_t payload_size, CODEC_BENCHMARK_RESULT* result)
+{
+    int status = 0;
+    uint64_t start = get_time_ns();
+    size_t i;
+
+    for (i = 0; i < result->iterations; i++)
+    {
+        BUFFER_HANDLE packet = mqtt_codec_publish(DELIVER_AT_LEAST_ONCE, false, false, (uint16_t)(i % UINT16_MAX + 1), BENCHMARK_TOPIC, payload, payload_size, NULL);
+        if (packet == NULL)
+        {
+            LogError("mqtt_codec_publish failed");
+            status = MU_FAILURE;
+            break;
+        }
+
+        result->encoded_size = BUFFER_length(packet);
+        BUFFER_delete(packet);
+    }
+
+    result->elapsed_ns = get_time_ns() - start;
+    return status;
+}
+
+static int benchmark_mqtt_publish_decode(const unsigned char* payload, size_t payload_size, CODEC_BENCHMARK_RESULT* result)
+{
+    int status;
+    size_t decoded = 0;
+    BUFFER_HANDLE packet;
+    MQTTCODEC_HANDLE codec;
+
+    if ((packet = mqtt_codec_publish(DELIVER_AT_LEAST_ONCE, false, false, 1, BENCHMARK_TOPIC, payload, payload_size, NULL)) == NULL)
+    {
+        LogError("mqtt_codec_publish failed");
+        status = MU_FAILURE;
+    }
+    else
+    {
+        if ((codec = mqtt_codec_create_with_packet_data(on_mqtt_packet_decoded, &decoded)) == NULL)
+        {
+            LogError("mqtt_codec_create_with_packet_data failed");
+            status = MU_FAILURE;
+        }
+        else
+        {
+            const unsigned char* bytes = BUFFER_u_char(packet);
+            size_t size = BUFFER_length(packet);
+            uint64_t start = get_time_ns();
+            size_t i;
+
+            status = 0;
+            for (i = 0; i < result->iterations; i++)
+            {
+                if (mqtt_codec_bytesReceived(codec, bytes, size) != 0)
+                {
+                    LogError("mqtt_codec_bytesReceived failed");
+                    status = MU_FAILURE;
+                    break;
+                }
+            }
+
+            result->elapsed_ns = get_time_ns() - start;
+            result->encoded_size = size;
+            if (status == 0 && decoded != result->iterations)
+            {
+                LogError("Decoded %lu of %lu packets", (unsigned long)decoded, (unsigned long)result->iterations);
+                status = MU_FAILURE;
+            }
+
+            mqtt_codec_destroy(codec);
+        }
+
+        BUFFER_delete(packet);
+    }
+
+    return status;
+}
+
+static int benchmark_amqp_value_encode(const unsigned char* payload, size_t payload_size, CODEC_BENCHMARK_RESULT* result)
+{
+    int status;
+    amqp_binary binary = { payload, (uint32_t)payload_size };
+    AMQP_VALUE value;
+
+    if ((value = amqpvalue_create_binary(binary)) == NULL)
+    {
+        LogError("amqpvalue_create_binary failed");
+        status = MU_FAILURE;
+    }
+    else
+    {
+        ENCODED_BYTES encoded = { NULL, 0, 0 };
+        uint64_t start = get_time_ns();
+        size_t i;
+
+        status = 0;
+        for (i = 0; i < result->iterations; i++)
+        {
+            encoded.size = 0;
+            if (amqpvalue_encode(value, append_encoded_bytes, &encoded) != 0)
+            {
+                LogError("amqpvalue_encode failed");
+                status = MU_FAILURE;
+                break;
+            }
+        }
+
+        result->elapsed_ns = get_time_ns() - start;
+        result->encoded_size = encoded.size;
+
+        free(encoded.bytes);
+        amqpvalue_destroy(value);
+    }
+
+    return status;
+}
+
+static int benchmark_amqp_value_decode(const unsigned char* payload, size_t payload_size, CODEC_BENCHMARK_RESULT* result)
+{
+    int status;
+    amqp_binary binary = { payload, (uint32_t)payload_size };
+    ENCODED_BYTES encoded = { NULL, 0, 0 };
+    AMQP_VALUE value;
+
+    if ((value = amqpvalue_create_binary(binary)) == NULL)
+    {
+        LogError("amqpvalue_create_binary failed");
+        status = MU_FAILURE;
+    }
+    else
+    {
+        if (amqpvalue_encode(value, append_encoded_bytes, &encoded) != 0)
+        {
+            LogError("amqpvalue_encode failed");
+            status = MU_FAILURE;
+        }
+        else
+        {
+            size_t decoded = 0;
+            AMQPVALUE_DECODER_HANDLE decoder;
+
+            if ((decoder = amqpvalue_decoder_create(on_amqp_value_decoded, &decoded)) == NULL)
+            {
+                LogError("amqpvalue_decoder_create failed");
+                status = MU_FAILURE;
+            }
+            else
+            {
+                uint64_t start = get_time_ns();
+                size_t i;
+
+                status = 0;
+                for (i = 0; i < result->iterations; i++)
+                {
+                    if (amqpvalue_decode_bytes(decoder, encoded.bytes, encoded.size) != 0)
+                    {
+                        LogError("amqpvalue_decode_bytes failed");
+                        status = MU_FAILURE;
+                        break;
+                    }
+                }
+
+                result->elapsed_ns = get_time_ns() - start;
+                result->encoded_size = encoded.size;
+                if (status == 0 && decoded != result->iterations)
+                {
+                    LogError("Decoded %lu of %lu values", (unsigned long)decoded, (unsigned long)result->iterations);
+                    status = MU_FAILURE;
+                }
+
+                amqpvalue_decoder_destroy(decoder);
+            }
+        }
+
+        free(encoded.bytes);
+        amqpvalue_destroy(value);
+    }
+
+    return status;
+}
+
+static int benchmark_amqp_frame_encode(const unsigned char* payload, size_t payload_size, CODEC_BENCHMARK_RESULT* result)
+{
+    int status;
+    FRAME_CODEC_HANDLE frame_codec;
+
+    if ((frame_codec = create_frame_codec(payload_size)) == NULL)
+    {
+        status = MU_FAILURE;
+    }
+    else
+    {
+        const unsigned char channel_bytes[] = BENCHMARK_CHANNEL_BYTES;
+        PAYLOAD frame_payload = { payload, payload_size };
+        ENCODED_BYTES encoded = { NULL, 0, 0 };
+        uint64_t start = get_time_ns();
+        size_t i;
+
+        status = 0;
+        for (i = 0; i < result->iterations; i++)
+        {
+            encoded.size = 0;
+            if (frame_codec_encode_frame(frame_codec, FRAME_TYPE_AMQP, &frame_payload, 1, channel_bytes, sizeof(channel_bytes), on_frame_bytes_encoded, &encoded) != 0)
+            {
+                LogError("frame_codec_encode_frame failed");
+                status = MU_FAILURE;
+                break;
+            }
+        }
+
+        result->elapsed_ns = get_time_ns() - start;
+        result->encoded_size = encoded.size;
+
+        free(encoded.bytes);
+        frame_codec_destroy(frame_codec);
+    }
+
+    return status;
+}
+
+static int benchmark_amqp_frame_decode(const unsigned char* payload, size_t payload_size, CODEC_BENCHMARK_RESULT* result)
+{
+    int status;
+    FRAME_CODEC_HANDLE frame_codec;
+
+    if ((frame_codec = create_frame_codec(payload_size)) == NULL)
+    {
+        status = MU_FAILURE;
+    }
+    else
+    {
+        const unsigned char channel_bytes[] = BENCHMARK_CHANNEL_BYTES;
+        PAYLOAD frame_payload = { payload, payload_size };
+        ENCODED_BYTES encoded = { NULL, 0, 0 };
+        size_t decoded = 0;
+
+        if (frame_codec_encode_frame(frame_codec, FRAME_TYPE_AMQP, &frame_payload, 1, channel_bytes, sizeof(channel_bytes), on_frame_bytes_encoded, &encoded) != 0 ||
+            encoded.bytes == NULL)
+        {
+            LogError("frame_codec_encode_frame failed");
+            status = MU_FAILURE;
+        }
+        else if (frame_codec_subscribe(frame_codec, FRAME_TYPE_AMQP, on_amqp_frame_decoded, &decoded) != 0)
+        {
+            LogError("frame_codec_subscribe failed");
+            status = MU_FAILURE;
+        }
+        else
+        {
+            uint64_t start = get_time_ns();
+            size_t i;
+
+            status = 0;
+            for (i = 0; i < result->iterations; i++)
+            {
+                if (frame_codec_receive_bytes(frame_codec, encoded.bytes, encoded.size) != 0)
+                {
+                    LogError("frame_codec_receive_bytes failed");
+                    status = MU_FAILURE;
+                    break;
+                }
+            }
+
+            result->elapsed_ns = get_time_ns() - start;
+            result->encoded_size = encoded.size;
+            if (status == 0 && decoded != result->iterations)
+            {
+                LogError("Decoded %lu of %lu frames", (unsigned long)decoded, (unsigned long)result->iterations);
+                status = MU_FAILURE;
+            }
+
+            (void)frame_codec_unsubscribe(frame_codec, FRAME_TYPE_AMQP);
+        }
+
+        free(encoded.bytes);
+        frame_codec_destroy(frame_codec);
+    }
+
+    return status;
+}
+
+const char* codec_benchmark_operation_name(CODEC_BENCHMARK_OPERATION operation)
+{
+    const char* result;
+
+    switch (operation)
+    {
+        case CODEC_BENCHMARK_MQTT_PUBLISH_ENCODE:
+            result = "mqtt_codec_publish";
+            break;
+        case CODEC_BENCHMARK_MQTT_PUBLISH_DECODE:
+            result = "mqtt_codec_bytesReceived";
+            break;
+        case CODEC_BENCHMARK_AMQP_VALUE_ENCODE:
+            result = "amqpvalue_encode";
+            break;
+        case CODEC_BENCHMARK_AMQP_VALUE_DECODE:
+            result = "amqpvalue_decode_bytes";
+            break;
+        case CODEC_BENCHMARK_AMQP_FRAME_ENCODE:
+            result = "frame_codec_encode_frame";
+            break;
+        case CODEC_BENCHMARK_AMQP_FRAME_DECODE:
+            result = "frame_codec_receive_bytes";
+            break;
+        default:
+            result = "unknown";
+            break;
+    }
+
+    return result;
+}
+
+int codec_benchmark_run(CODEC_BENCHMARK_OPERATION operation, size_t payload_size, size_t iterations, CODEC_BENCHMARK_RESULT* result)
+{
+    int status;
+    unsigned char* payload;
+
+    if (payload_size == 0 || payload_size > UINT32_MAX - 12 || iterations == 0 || result == NULL)
+    {
+        LogError("Invalid argument: payload_size=%lu, iterations=%lu, result=%p", (unsigned long)payload_size, (unsigned long)iterations, result);
+        status = MU_FAILURE;
+    }
+    else if ((payload = (unsigned char*)malloc(payload_size)) == NULL)
+    {
+        LogError("Cannot allocate a %lu byte payload", (unsigned long)payload_size);
+        status = MU_FAILURE;
+    }
+    else
+    {
+        size_t i;
+
+        // Printable bytes standing in for the JSON telemetry the codecs carry
+        for (i = 0; i < payload_size; i++)
+        {
+            payload[i] = (unsigned char)(' ' + (i * 7) % 95);
+        }
+
+        (void)memset(result, 0, sizeof(*result));
+        result->payload_size = payload_size;
+        result->iterations = iterations;
+
+        switch (operation)
+        {
+            case CODEC_BENCHMARK_MQTT_PUBLISH_ENCODE:
+                status = benchmark_mqtt_publish_encode(payload, payload_size, result);
+                break;
+            case CODEC_BENCHMARK_MQTT_PUBLISH_DECODE:
+                status = benchmark_mqtt_publish_decode(payload, payload_size, result);
+                break;
+            case CODEC_BENCHMARK_AMQP_VALUE_ENCODE:
+                status = benchmark_amqp_value_encode(payload, payload_size, result);
+                break;
+            case CODEC_BENCHMARK_AMQP_VALUE_DECODE:
+                status = benchmark_amqp_value_decode(payload, payload_size, result);
+                break;
+            case CODEC_BENCHMARK_AMQP_FRAME_ENCODE:
+                status = benchmark_amqp_frame_encode(payload, payload_size, result);
+                break;
+            case CODEC_BENCHMARK_AMQP_FRAME_DECODE:
+                status = benchmark_amqp_frame_decode(payload, payload_size, result);
+                break;
+            default:
+                LogError("Unknown operation %d", (int)operation);
+                status = MU_FAILURE;
+                break;
+        }
+
+        if (status == 0)
+        {
+            result->ns_per_op = (double)result->elapsed_ns / (double)iterations;
+            result->mb_per_s = result->elapsed_ns == 0 ? 0.0 :
+                ((double)payload_size * (double)iterations * 1000.0) / (double)result->elapsed_ns;
+        }
+
+        free(payload);
+    }
+
+    return status;
+}
@@ -0,0 +1,62 @@
+//
+//  codec_benchmark.h
+//  LokiSDKTests
+//
+
+/** @file   codec_benchmark.h
+*    @brief  Encode/decode throughput of the uMQTT and uAMQP codecs, driven by CodecBenchmarkTests.
+*/
+
+#ifndef CODEC_BENCHMARK_H
+#define CODEC_BENCHMARK_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+typedef enum CODEC_BENCHMARK_OPERATION_TAG
+{
+    CODEC_BENCHMARK_MQTT_PUBLISH_ENCODE,
+    CODEC_BENCHMARK_MQTT_PUBLISH_DECODE,
+    CODEC_BENCHMARK_AMQP_VALUE_ENCODE,
+    CODEC_BENCHMARK_AMQP_VALUE_DECODE,
+    CODEC_BENCHMARK_AMQP_FRAME_ENCODE,
+    CODEC_BENCHMARK_AMQP_FRAME_DECODE
+} CODEC_BENCHMARK_OPERATION;
+
+typedef struct CODEC_BENCHMARK_RESULT_TAG
+{
+    /** @brief Size of the payload carried by each encoded packet, value or frame. */
+    size_t payload_size;
+    /** @brief Size of each packet, value or frame on the wire. */
+    size_t encoded_size;
+    size_t iterations;
+    uint64_t elapsed_ns;
+    double ns_per_op;
+    /** @brief Payload bytes processed per second, in MB (10^6 bytes). */
+    double mb_per_s;
+} CODEC_BENCHMARK_RESULT;
+
+/**
+* @brief    Returns the name of the codec function @p operation measures, e.g. "mqtt_codec_publish".
+*/
+extern const char* codec_benchmark_operation_name(CODEC_BENCHMARK_OPERATION operation);
+
+/**
+* @brief    Runs @p operation @p iterations times on a payload of @p payload_size bytes. Decode operations
+*           time only the decoding of an input encoded beforehand.
+*
+* @return   0 upon success, non-zero if any encode or decode failed.
+*/
+extern int codec_benchmark_run(CODEC_BENCHMARK_OPERATION operation, size_t payload_size, size_t iterations, CODEC_BENCHMARK_RESULT* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CODEC_BENCHMARK_H */
@@ -0,0 +1,877 @@
+//
+//  mqtt_loopback_broker.c
+//  LokiSDKTests
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include "azure_macro_utils/macro_utils.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/optionhandler.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_umqtt_c/mqtt_codec.h"
+#include "iothubtransportmqtt.h"
+#include "internal/iothub_transport_ll_private.h"
+#include "internal/iothubtransport_mqtt_common.h"
+
+#include "mqtt_loopback_broker.h"
+
+#define PUBLISH_FLAG_DUP            0x08
+#define PUBLISH_QOS_MASK            0x06
+#define PUBLISH_QOS_SHIFT           1
+#define MAX_SUBACK_TOPICS           125     // Keeps the SUBACK remaining length in a single byte
+#define MAX_TOPIC_LENGTH            256
+
+#define SUBSCRIPTION_METHODS        0x01
+#define SUBSCRIPTION_DESIRED        0x02
+
+static const char TELEMETRY_TOPIC_PREFIX[] = "devices/";
+static const char TELEMETRY_TOPIC_EVENTS[] = "/messages/events/";
+static const char TELEMETRY_CONTENT_TYPE_PROPERTY[] = "%24.ct=";     // $.ct, the transport URL encodes the $
+static const char TWIN_GET_TOPIC_PREFIX[] = "$iothub/twin/GET/";
+static const char TWIN_REPORTED_TOPIC_PREFIX[] = "$iothub/twin/PATCH/properties/reported/";
+static const char METHOD_RESPONSE_TOPIC_PREFIX[] = "$iothub/methods/res/";
+static const char METHODS_SUBSCRIPTION[] = "$iothub/methods/POST/";
+static const char DESIRED_SUBSCRIPTION[] = "$iothub/twin/PATCH/properties/desired/";
+static const char REQUEST_ID_PROPERTY[] = "$rid=";
+static const char DEFAULT_DESIRED_PROPERTIES[] = "{\"$version\":1}";
+
+typedef enum LOOPBACK_IO_STATE_TAG
+{
+    LOOPBACK_IO_STATE_CLOSED,
+    LOOPBACK_IO_STATE_OPENING,
+    LOOPBACK_IO_STATE_OPEN,
+    LOOPBACK_IO_STATE_ERROR
+} LOOPBACK_IO_STATE;
+
+// A packet the broker sends to the client once due_ms is reached.
+typedef struct OUTBOUND_PACKET_TAG
+{
+    DLIST_ENTRY entry;
+    tickcounter_ms_t due_ms;
+    BUFFER_HANDLE packet;
+    bool is_puback;
+} OUTBOUND_PACKET;
+
+typedef struct MQTT_LOOPBACK_BROKER_INSTANCE_TAG MQTT_LOOPBACK_BROKER_INSTANCE;
+
+// The memory-pipe xio, the client's end of its connection to the broker.
+typedef struct LOOPBACK_IO_INSTANCE_TAG
+{
+    MQTT_LOOPBACK_BROKER_INSTANCE* broker;  // NULL while the IO is not connected to the broker
+    LOOPBACK_IO_STATE state;
+    ON_IO_OPEN_COMPLETE on_io_open_complete;
+    void* on_io_open_complete_context;
+    ON_BYTES_RECEIVED on_bytes_received;
+    void* on_bytes_received_context;
+    ON_IO_ERROR on_io_error;
+    void* on_io_error_context;
+    MQTTCODEC_HANDLE codec;                 // Frames the packets the client sends
+    DLIST_ENTRY outbound;                   // OUTBOUND_PACKETs, in the order they were queued
+    int subscriptions;
+    bool disconnect_pending;
+} LOOPBACK_IO_INSTANCE;
+
+struct MQTT_LOOPBACK_BROKER_INSTANCE_TAG
+{
+    TICK_COUNTER_HANDLE tick_counter;
+    LOOPBACK_IO_INSTANCE* connection;       // The open connection, NULL if there is none
+    MQTT_LOOPBACK_BROKER_FAULTS faults;
+    size_t publishes_since_faults;
+    MQTT_LOOPBACK_BROKER_STATS stats;
+    char* desired_json;
+    uint32_t desired_version;
+    uint32_t reported_version;
+    uint32_t next_method_request_id;
+};
+
+// The transport's MQTT_GET_IO_TRANSPORT has no context, so the IOs it creates connect to the one existing broker.
+static MQTT_LOOPBACK_BROKER_INSTANCE* active_broker = NULL;
+
+static void on_client_packet(void* context, CONTROL_PACKET_TYPE packet, int flags, const uint8_t* packetData, size_t packetLength);
+
+static int queue_packet(LOOPBACK_IO_INSTANCE* loopback_io, BUFFER_HANDLE packet, uint32_t delay_ms, bool is_puback)
+{
+    int result;
+    OUTBOUND_PACKET* outbound_packet;
+    tickcounter_ms_t now_ms;
+
+    if (packet == NULL)
+    {
+        LogError("Cannot encode the broker packet");
+        result = MU_FAILURE;
+    }
+    else if (tickcounter_get_current_ms(loopback_io->broker->tick_counter, &now_ms) != 0)
+    {
+        LogError("tickcounter_get_current_ms failed");
+        BUFFER_delete(packet);
+        result = MU_FAILURE;
+    }
+    else if ((outbound_packet = (OUTBOUND_PACKET*)malloc(sizeof(OUTBOUND_PACKET))) == NULL)
+    {
+        LogError("Cannot allocate the broker packet");
+        BUFFER_delete(packet);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        outbound_packet->due_ms = now_ms + delay_ms;
+        outbound_packet->packet = packet;
+        outbound_packet->is_puback = is_puback;
+        DList_InsertTailList(&loopback_io->outbound, &outbound_packet->entry);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int queue_bytes(LOOPBACK_IO_INSTANCE* loopback_io, const unsigned char* bytes, size_t size)
+{
+    return queue_packet(loopback_io, BUFFER_create(bytes, size), 0, false);
+}
+
+// Broker to client PUBLISHes are sent at most once, as IoT Hub does for twin and method topics.
+static int queue_publish(LOOPBACK_IO_INSTANCE* loopback_io, const char* topic, const char* payload)
+{
+    return queue_packet(loopback_io, mqtt_codec_publish(DELIVER_AT_MOST_ONCE, false, false, 0, topic, (const uint8_t*)payload, strlen(payload), NULL), 0, false);
+}
+
+static void clear_outbound(LOOPBACK_IO_INSTANCE* loopback_io)
+{
+    while (!DList_IsListEmpty(&loopback_io->outbound))
+    {
+        OUTBOUND_PACKET* outbound_packet = containingRecord(DList_RemoveHeadList(&loopback_io->outbound), OUTBOUND_PACKET, entry);
+        BUFFER_delete(outbound_packet->packet);
+        free(outbound_packet);
+    }
+}
+
+static void detach_connection(LOOPBACK_IO_INSTANCE* loopback_io)
+{
+    if (loopback_io->broker != NULL && loopback_io->broker->connection == loopback_io)
+    {
+        loopback_io->broker->connection = NULL;
+    }
+    loopback_io->broker = NULL;
+    clear_outbound(loopback_io);
+}
+
+static int get_subscription(const uint8_t* topic, size_t topic_length)
+{
+    int result;
+
+    if (topic_length >= sizeof(METHODS_SUBSCRIPTION) - 1 && memcmp(topic, METHODS_SUBSCRIPTION, sizeof(METHODS_SUBSCRIPTION) - 1) == 0)
+    {
+        result = SUBSCRIPTION_METHODS;
+    }
+    else if (topic_length >= sizeof(DESIRED_SUBSCRIPTION) - 1 && memcmp(topic, DESIRED_SUBSCRIPTION, sizeof(DESIRED_SUBSCRIPTION) - 1) == 0)
+    {
+        result = SUBSCRIPTION_DESIRED;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static bool read_uint16(const uint8_t** iterator, const uint8_t* end, uint16_t* value)
+{
+    bool result;
+
+    if (end - *iterator < 2)
+    {
+        result = false;
+    }
+    else
+    {
+        *value = (uint16_t)(((*iterator)[0] << 8) | (*iterator)[1]);
+        *iterator += 2;
+        result = true;
+    }
+
+    return result;
+}
+
+static void process_subscribe(LOOPBACK_IO_INSTANCE* loopback_io, const uint8_t* packetData, size_t packetLength)
+{
+    const uint8_t* iterator = packetData;
+    const uint8_t* end = packetData + packetLength;
+    uint16_t packet_id;
+    unsigned char suback[4 + MAX_SUBACK_TOPICS];
+    size_t topic_count = 0;
+    uint16_t topic_length;
+
+    if (!read_uint16(&iterator, end, &packet_id))
+    {
+        LogError("Malformed SUBSCRIBE");
+    }
+    else
+    {
+        while (iterator < end && topic_count < MAX_SUBACK_TOPICS && read_uint16(&iterator, end, &topic_length) && end - iterator > topic_length)
+        {
+            loopback_io->subscriptions |= get_subscription(iterator, topic_length);
+            iterator += topic_length;
+            // Granted QoS: IoT Hub does not support QoS 2
+            suback[4 + topic_count] = (unsigned char)((*iterator > DELIVER_AT_LEAST_ONCE) ? DELIVER_AT_LEAST_ONCE : *iterator);
+            iterator++;
+            topic_count++;
+        }
+
+        suback[0] = SUBACK_TYPE;
+        suback[1] = (unsigned char)(2 + topic_count);
+        suback[2] = (unsigned char)(packet_id >> 8);
+        suback[3] = (unsigned char)(packet_id & 0xFF);
+        loopback_io->broker->stats.subscribes++;
+        (void)queue_bytes(loopback_io, suback, 4 + topic_count);
+    }
+}
+
+static void process_unsubscribe(LOOPBACK_IO_INSTANCE* loopback_io, const uint8_t* packetData, size_t packetLength)
+{
+    const uint8_t* iterator = packetData;
+    const uint8_t* end = packetData + packetLength;
+    uint16_t packet_id;
+    uint16_t topic_length;
+
+    if (!read_uint16(&iterator, end, &packet_id))
+    {
+        LogError("Malformed UNSUBSCRIBE");
+    }
+    else
+    {
+        unsigned char unsuback[] = { UNSUBACK_TYPE, 0x02, (unsigned char)(packet_id >> 8), (unsigned char)(packet_id & 0xFF) };
+
+        while (read_uint16(&iterator, end, &topic_length) && end - iterator >= topic_length)
+        {
+            loopback_io->subscriptions &= ~get_subscription(iterator, topic_length);
+            iterator += topic_length;
+        }
+
+        (void)queue_bytes(loopback_io, unsuback, sizeof(unsuback));
+    }
+}
+
+// Copies the request id of @p topic, the value of its $rid property, into @p request_id.
+static bool get_request_id(const char* topic, char* request_id, size_t request_id_size)
+{
+    bool result;
+    const char* value = strstr(topic, REQUEST_ID_PROPERTY);
+
+    if (value == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        size_t length;
+
+        value += sizeof(REQUEST_ID_PROPERTY) - 1;
+        length = strcspn(value, "&");
+        if (length == 0 || length >= request_id_size)
+        {
+            result = false;
+        }
+        else
+        {
+            (void)memcpy(request_id, value, length);
+            request_id[length] = '\0';
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+static void process_telemetry(LOOPBACK_IO_INSTANCE* loopback_io, const char* topic, int qos, bool is_duplicate, uint16_t packet_id, size_t payload_size)
+{
+    MQTT_LOOPBACK_BROKER_INSTANCE* broker = loopback_io->broker;
+
+    broker->stats.telemetry_publishes++;
+    broker->stats.telemetry_payload_bytes += payload_size;
+    if (strstr(topic, TELEMETRY_CONTENT_TYPE_PROPERTY) != NULL)
+    {
+        broker->stats.telemetry_with_content_type++;
+    }
+    if (is_duplicate)
+    {
+        broker->stats.telemetry_duplicates++;
+    }
+    broker->publishes_since_faults++;
+
+    if (broker->faults.disconnect_after_publishes != 0 && broker->publishes_since_faults == broker->faults.disconnect_after_publishes)
+    {
+        broker->faults.disconnect_after_publishes = 0;
+        broker->stats.disconnects_injected++;
+        loopback_io->disconnect_pending = true;
+    }
+    else if (qos != DELIVER_AT_MOST_ONCE)
+    {
+        if (broker->faults.puback_drop_every != 0 && broker->publishes_since_faults % broker->faults.puback_drop_every == 0)
+        {
+            broker->stats.pubacks_dropped++;
+        }
+        else
+        {
+            (void)queue_packet(loopback_io, mqtt_codec_publishAck(packet_id), broker->faults.puback_delay_ms, true);
+        }
+    }
+}
+
+static void process_twin_get(LOOPBACK_IO_INSTANCE* loopback_io, const char* topic)
+{
+    MQTT_LOOPBACK_BROKER_INSTANCE* broker = loopback_io->broker;
+    char request_id[32];
+    char response_topic[MAX_TOPIC_LENGTH];
+    char* twin;
+
+    broker->stats.twin_gets++;
+    if (!get_request_id(topic, request_id, sizeof(request_id)))
+    {
+        LogError("Twin GET without a request id: %s", topic);
+    }
+    else if ((twin = (char*)malloc(strlen(broker->desired_json) + 64)) == NULL)
+    {
+        LogError("Cannot allocate the twin");
+    }
+    else
+    {
+        (void)sprintf(twin, "{\"desired\":%s,\"reported\":{\"$version\":%" PRIu32 "}}", broker->desired_json, broker->reported_version);
+        (void)snprintf(response_topic, sizeof(response_topic), "$iothub/twin/res/200/?$rid=%s", request_id);
+        (void)queue_publish(loopback_io, response_topic, twin);
+        free(twin);
+    }
+}
+
+static void process_twin_reported(LOOPBACK_IO_INSTANCE* loopback_io, const char* topic)
+{
+    MQTT_LOOPBACK_BROKER_INSTANCE* broker = loopback_io->broker;
+    char request_id[32];
+    char response_topic[MAX_TOPIC_LENGTH];
+
+    broker->stats.twin_reported_patches++;
+    if (!get_request_id(topic, request_id, sizeof(request_id)))
+    {
+        LogError("Reported properties PATCH without a request id: %s", topic);
+    }
+    else
+    {
+        broker->reported_version++;
+        (void)snprintf(response_topic, sizeof(response_topic), "$iothub/twin/res/204/?$rid=%s&$version=%" PRIu32, request_id, broker->reported_version);
+        (void)queue_publish(loopback_io, response_topic, "");
+    }
+}
+
+static void process_publish(LOOPBACK_IO_INSTANCE* loopback_io, int flags, const uint8_t* packetData, size_t packetLength)
+{
+    const uint8_t* iterator = packetData;
+    const uint8_t* end = packetData + packetLength;
+    int qos = (flags & PUBLISH_QOS_MASK) >> PUBLISH_QOS_SHIFT;
+    uint16_t topic_length;
+    uint16_t packet_id = 0;
+    char topic[MAX_TOPIC_LENGTH];
+
+    if (!read_uint16(&iterator, end, &topic_length) || topic_length >= sizeof(topic) || end - iterator < topic_length)
+    {
+        LogError("Malformed PUBLISH");
+    }
+    else
+    {
+        (void)memcpy(topic, iterator, topic_length);
+        topic[topic_length] = '\0';
+        iterator += topic_length;
+
+        if (qos != DELIVER_AT_MOST_ONCE && !read_uint16(&iterator, end, &packet_id))
+        {
+            LogError("PUBLISH without a packet id");
+        }
+        else if (strncmp(topic, TELEMETRY_TOPIC_PREFIX, sizeof(TELEMETRY_TOPIC_PREFIX) - 1) == 0 && strstr(topic, TELEMETRY_TOPIC_EVENTS) != NULL)
+        {
+            process_telemetry(loopback_io, topic, qos, (flags & PUBLISH_FLAG_DUP) != 0, packet_id, (size_t)(end - iterator));
+        }
+        else
+        {
+            if (strncmp(topic, TWIN_GET_TOPIC_PREFIX, sizeof(TWIN_GET_TOPIC_PREFIX) - 1) == 0)
+            {
+                process_twin_get(loopback_io, topic);
+            }
+            else if (strncmp(topic, TWIN_REPORTED_TOPIC_PREFIX, sizeof(TWIN_REPORTED_TOPIC_PREFIX) - 1) == 0)
+            {
+                process_twin_reported(loopback_io, topic);
+            }
+            else if (strncmp(topic, METHOD_RESPONSE_TOPIC_PREFIX, sizeof(METHOD_RESPONSE_TOPIC_PREFIX) - 1) == 0)
+            {
+                loopback_io->broker->stats.method_responses++;
+                loopback_io->broker->stats.last_method_status = atoi(topic + sizeof(METHOD_RESPONSE_TOPIC_PREFIX) - 1);
+            }
+            else
+            {
+                LogError("PUBLISH to an unexpected topic: %s", topic);
+            }
+
+            if (qos != DELIVER_AT_MOST_ONCE)
+            {
+                (void)queue_packet(loopback_io, mqtt_codec_publishAck(packet_id), 0, false);
+            }
+        }
+    }
+}
+
+static void on_client_packet(void* context, CONTROL_PACKET_TYPE packet, int flags, const uint8_t* packetData, size_t packetLength)
+{
+    LOOPBACK_IO_INSTANCE* loopback_io = (LOOPBACK_IO_INSTANCE*)context;
+
+    // Whatever follows the packet that triggered an injected disconnect is lost with the connection
+    if (loopback_io->broker != NULL && !loopback_io->disconnect_pending)
+    {
+        switch (packet)
+        {
+            case CONNECT_TYPE:
+            {
+                const unsigned char connack[] = { CONNACK_TYPE, 0x02, 0x00, CONNECTION_ACCEPTED };
+                loopback_io->broker->stats.connects++;
+                loopback_io->subscriptions = 0;
+                (void)queue_bytes(loopback_io, connack, sizeof(connack));
+                break;
+            }
+            case SUBSCRIBE_TYPE:
+                process_subscribe(loopback_io, packetData, packetLength);
+                break;
+            case UNSUBSCRIBE_TYPE:
+                process_unsubscribe(loopback_io, packetData, packetLength);
+                break;
+            case PUBLISH_TYPE:
+                process_publish(loopback_io, flags, packetData, packetLength);
+                break;
+            case PINGREQ_TYPE:
+            {
+                const unsigned char pingresp[] = { PINGRESP_TYPE, 0x00 };
+                loopback_io->broker->stats.pings++;
+                (void)queue_bytes(loopback_io, pingresp, sizeof(pingresp));
+                break;
+            }
+            case PUBACK_TYPE:
+            case DISCONNECT_TYPE:
+                break;
+            default:
+                LogError("Unexpected packet 0x%x from the client", (unsigned int)packet);
+                break;
+        }
+    }
+}
+
+static CONCRETE_IO_HANDLE loopback_io_create(void* io_create_parameters)
+{
+    LOOPBACK_IO_INSTANCE* result;
+    (void)io_create_parameters;
+
+    if ((result = (LOOPBACK_IO_INSTANCE*)calloc(1, sizeof(LOOPBACK_IO_INSTANCE))) == NULL)
+    {
+        LogError("Cannot allocate the loopback IO");
+    }
+    else if ((result->codec = mqtt_codec_create_with_packet_data(on_client_packet, result)) == NULL)
+    {
+        LogError("mqtt_codec_create_with_packet_data failed");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->state = LOOPBACK_IO_STATE_CLOSED;
+        DList_InitializeListHead(&result->outbound);
+    }
+
+    return result;
+}
+
+static void loopback_io_destroy(CONCRETE_IO_HANDLE concrete_io)
+{
+    if (concrete_io != NULL)
+    {
+        LOOPBACK_IO_INSTANCE* loopback_io = (LOOPBACK_IO_INSTANCE*)concrete_io;
+        detach_connection(loopback_io);
+        mqtt_codec_destroy(loopback_io->codec);
+        free(loopback_io);
+    }
+}
+
+static int loopback_io_open(CONCRETE_IO_HANDLE concrete_io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+    int result;
+    LOOPBACK_IO_INSTANCE* loopback_io = (LOOPBACK_IO_INSTANCE*)concrete_io;
+
+    if (loopback_io == NULL || on_io_open_complete == NULL || on_bytes_received == NULL || on_io_error == NULL)
+    {
+        LogError("Invalid argument: concrete_io=%p", concrete_io);
+        result = MU_FAILURE;
+    }
+    else if (loopback_io->state != LOOPBACK_IO_STATE_CLOSED)
+    {
+        LogError("The loopback IO is already open");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        loopback_io->on_io_open_complete = on_io_open_complete;
+        loopback_io->on_io_open_complete_context = on_io_open_complete_context;
+        loopback_io->on_bytes_received = on_bytes_received;
+        loopback_io->on_bytes_received_context = on_bytes_received_context;
+        loopback_io->on_io_error = on_io_error;
+        loopback_io->on_io_error_context = on_io_error_context;
+        loopback_io->disconnect_pending = false;
+        mqtt_codec_reset(loopback_io->codec);
+
+        // Completed by the next dowork, as a network IO would
+        loopback_io->state = LOOPBACK_IO_STATE_OPENING;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int loopback_io_close(CONCRETE_IO_HANDLE concrete_io, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+    int result;
+    LOOPBACK_IO_INSTANCE* loopback_io = (LOOPBACK_IO_INSTANCE*)concrete_io;
+
+    if (loopback_io == NULL)
+    {
+        LogError("Invalid argument: concrete_io=NULL");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        detach_connection(loopback_io);
+        loopback_io->state = LOOPBACK_IO_STATE_CLOSED;
+        if (on_io_close_complete != NULL)
+        {
+            on_io_close_complete(callback_context);
+        }
+        result = 0;
+    }
+
+    return result;
+}
+
+static int loopback_io_send(CONCRETE_IO_HANDLE concrete_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    LOOPBACK_IO_INSTANCE* loopback_io = (LOOPBACK_IO_INSTANCE*)concrete_io;
+
+    if (loopback_io == NULL || buffer == NULL || size == 0)
+    {
+        LogError("Invalid argument: concrete_io=%p, buffer=%p, size=%lu", concrete_io, buffer, (unsigned long)size);
+        result = MU_FAILURE;
+    }
+    else if (loopback_io->state != LOOPBACK_IO_STATE_OPEN || loopback_io->broker == NULL)
+    {
+        LogError("The loopback IO is not connected");
+        result = MU_FAILURE;
+    }
+    else if (mqtt_codec_bytesReceived(loopback_io->codec, (const unsigned char*)buffer, size) != 0)
+    {
+        LogError("The broker cannot parse the packets the client sent");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (on_send_complete != NULL)
+        {
+            on_send_complete(callback_context, IO_SEND_OK);
+        }
+        result = 0;
+    }
+
+    return result;
+}
+
+static void loopback_io_dowork(CONCRETE_IO_HANDLE concrete_io)
+{
+    LOOPBACK_IO_INSTANCE* loopback_io = (LOOPBACK_IO_INSTANCE*)concrete_io;
+
+    if (loopback_io != NULL)
+    {
+        if (loopback_io->state == LOOPBACK_IO_STATE_OPENING)
+        {
+            MQTT_LOOPBACK_BROKER_INSTANCE* broker = active_broker;
+            if (broker == NULL)
+            {
+                loopback_io->state = LOOPBACK_IO_STATE_ERROR;
+                loopback_io->on_io_open_complete(loopback_io->on_io_open_complete_context, IO_OPEN_ERROR);
+            }
+            else
+            {
+                // A new connection takes over from the previous one, as IoT Hub does for a device id
+                if (broker->connection != NULL)
+                {
+                    broker->connection->disconnect_pending = true;
+                }
+                loopback_io->broker = broker;
+                broker->connection = loopback_io;
+                loopback_io->state = LOOPBACK_IO_STATE_OPEN;
+                loopback_io->on_io_open_complete(loopback_io->on_io_open_complete_context, IO_OPEN_OK);
+            }
+        }
+        else if (loopback_io->state == LOOPBACK_IO_STATE_OPEN)
+        {
+            if (loopback_io->disconnect_pending || loopback_io->broker == NULL)
+            {
+                detach_connection(loopback_io);
+                loopback_io->state = LOOPBACK_IO_STATE_ERROR;
+                loopback_io->on_io_error(loopback_io->on_io_error_context);
+            }
+            else
+            {
+                tickcounter_ms_t now_ms;
+                if (tickcounter_get_current_ms(loopback_io->broker->tick_counter, &now_ms) == 0)
+                {
+                    // Delivering a packet can make the client send more, so the list is walked from the head again
+                    // after each packet; delayed PUBACKs do not hold back the packets queued after them.
+                    PDLIST_ENTRY current = loopback_io->outbound.Flink;
+                    while (current != &loopback_io->outbound && loopback_io->broker != NULL && !loopback_io->disconnect_pending)
+                    {
+                        OUTBOUND_PACKET* outbound_packet = containingRecord(current, OUTBOUND_PACKET, entry);
+                        if (outbound_packet->due_ms > now_ms)
+                        {
+                            current = current->Flink;
+                        }
+                        else
+                        {
+                            (void)DList_RemoveEntryList(current);
+                            if (outbound_packet->is_puback)
+                            {
+                                loopback_io->broker->stats.pubacks_sent++;
+                            }
+                            loopback_io->on_bytes_received(loopback_io->on_bytes_received_context, BUFFER_u_char(outbound_packet->packet), BUFFER_length(outbound_packet->packet));
+                            BUFFER_delete(outbound_packet->packet);
+                            free(outbound_packet);
+                            current = loopback_io->outbound.Flink;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static int loopback_io_setoption(CONCRETE_IO_HANDLE concrete_io, const char* optionName, const void* value)
+{
+    // The TLS and socket options the transport sets have no meaning for a memory pipe
+    (void)concrete_io;
+    (void)optionName;
+    (void)value;
+    return 0;
+}
+
+static void* loopback_io_clone_option(const char* name, const void* value)
+{
+    (void)name;
+    (void)value;
+    return NULL;
+}
+
+static void loopback_io_destroy_option(const char* name, const void* value)
+{
+    (void)name;
+    (void)value;
+}
+
+static OPTIONHANDLER_HANDLE loopback_io_retrieveoptions(CONCRETE_IO_HANDLE concrete_io)
+{
+    (void)concrete_io;
+    return OptionHandler_Create(loopback_io_clone_option, loopback_io_destroy_option, loopback_io_setoption);
+}
+
+static const IO_INTERFACE_DESCRIPTION loopback_io_interface_description =
+{
+    loopback_io_retrieveoptions,
+    loopback_io_create,
+    loopback_io_destroy,
+    loopback_io_open,
+    loopback_io_close,
+    loopback_io_send,
+    loopback_io_dowork,
+    loopback_io_setoption,
+    NULL,
+    NULL
+};
+
+static XIO_HANDLE getLoopbackIoTransport(const char* fully_qualified_name, const MQTT_TRANSPORT_PROXY_OPTIONS* mqtt_transport_proxy_options)
+{
+    (void)fully_qualified_name;
+    (void)mqtt_transport_proxy_options;
+    return xio_create(&loopback_io_interface_description, NULL);
+}
+
+static TRANSPORT_LL_HANDLE MqttLoopback_Create(const IOTHUBTRANSPORT_CONFIG* config, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
+{
+    return IoTHubTransport_MQTT_Common_Create(config, getLoopbackIoTransport, cb_info, ctx);
+}
+
+MQTT_LOOPBACK_BROKER_HANDLE mqtt_loopback_broker_create(void)
+{
+    MQTT_LOOPBACK_BROKER_INSTANCE* result;
+
+    if (active_broker != NULL)
+    {
+        LogError("A loopback broker already exists");
+        result = NULL;
+    }
+    else if ((result = (MQTT_LOOPBACK_BROKER_INSTANCE*)calloc(1, sizeof(MQTT_LOOPBACK_BROKER_INSTANCE))) == NULL)
+    {
+        LogError("Cannot allocate the loopback broker");
+    }
+    else if ((result->tick_counter = tickcounter_create()) == NULL)
+    {
+        LogError("tickcounter_create failed");
+        free(result);
+        result = NULL;
+    }
+    else if (mallocAndStrcpy_s(&result->desired_json, DEFAULT_DESIRED_PROPERTIES) != 0)
+    {
+        LogError("Cannot allocate the desired properties");
+        tickcounter_destroy(result->tick_counter);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->desired_version = 1;
+        result->reported_version = 1;
+        result->next_method_request_id = 1;
+        active_broker = result;
+    }
+
+    return result;
+}
+
+void mqtt_loopback_broker_destroy(MQTT_LOOPBACK_BROKER_HANDLE broker)
+{
+    if (broker != NULL)
+    {
+        if (broker->connection != NULL)
+        {
+            // The client's next dowork reports the connection failed
+            LOOPBACK_IO_INSTANCE* connection = broker->connection;
+            detach_connection(connection);
+        }
+        if (active_broker == broker)
+        {
+            active_broker = NULL;
+        }
+        tickcounter_destroy(broker->tick_counter);
+        free(broker->desired_json);
+        free(broker);
+    }
+}
+
+void mqtt_loopback_broker_set_faults(MQTT_LOOPBACK_BROKER_HANDLE broker, const MQTT_LOOPBACK_BROKER_FAULTS* faults)
+{
+    if (broker == NULL)
+    {
+        LogError("Invalid argument: broker=NULL");
+    }
+    else
+    {
+        if (faults == NULL)
+        {
+            (void)memset(&broker->faults, 0, sizeof(broker->faults));
+        }
+        else
+        {
+            broker->faults = *faults;
+        }
+        broker->publishes_since_faults = 0;
+    }
+}
+
+void mqtt_loopback_broker_get_stats(MQTT_LOOPBACK_BROKER_HANDLE broker, MQTT_LOOPBACK_BROKER_STATS* stats)
+{
+    if (broker == NULL || stats == NULL)
+    {
+        LogError("Invalid argument: broker=%p, stats=%p", broker, stats);
+    }
+    else
+    {
+        *stats = broker->stats;
+    }
+}
+
+int mqtt_loopback_broker_update_desired(MQTT_LOOPBACK_BROKER_HANDLE broker, const char* desired_json)
+{
+    int result;
+    char* desired_copy;
+
+    if (broker == NULL || desired_json == NULL)
+    {
+        LogError("Invalid argument: broker=%p, desired_json=%p", broker, desired_json);
+        result = MU_FAILURE;
+    }
+    else if (mallocAndStrcpy_s(&desired_copy, desired_json) != 0)
+    {
+        LogError("Cannot allocate the desired properties");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        free(broker->desired_json);
+        broker->desired_json = desired_copy;
+        broker->desired_version++;
+
+        if (broker->connection != NULL && (broker->connection->subscriptions & SUBSCRIPTION_DESIRED) != 0)
+        {
+            char topic[MAX_TOPIC_LENGTH];
+            (void)snprintf(topic, sizeof(topic), "%s?$version=%" PRIu32, DESIRED_SUBSCRIPTION, broker->desired_version);
+            result = queue_publish(broker->connection, topic, desired_json);
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int mqtt_loopback_broker_invoke_method(MQTT_LOOPBACK_BROKER_HANDLE broker, const char* method_name, const char* payload)
+{
+    int result;
+
+    if (broker == NULL || method_name == NULL || payload == NULL)
+    {
+        LogError("Invalid argument: broker=%p, method_name=%p, payload=%p", broker, method_name, payload);
+        result = MU_FAILURE;
+    }
+    else if (broker->connection == NULL || (broker->connection->subscriptions & SUBSCRIPTION_METHODS) == 0)
+    {
+        LogError("No client subscribed to methods is connected");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        char topic[MAX_TOPIC_LENGTH];
+        (void)snprintf(topic, sizeof(topic), "%s%s/?$rid=%" PRIx32, METHODS_SUBSCRIPTION, method_name, broker->next_method_request_id++);
+        result = queue_publish(broker->connection, topic, payload);
+    }
+
+    return result;
+}
+
+static TRANSPORT_PROVIDER loopback_protocol;
+
+const TRANSPORT_PROVIDER* MqttLoopback_Protocol(void)
+{
+    // The MQTT transport with only its IO swapped for the memory pipe
+    loopback_protocol = *MQTT_Protocol();
+    loopback_protocol.IoTHubTransport_Create = MqttLoopback_Create;
+    return &loopback_protocol;
+}
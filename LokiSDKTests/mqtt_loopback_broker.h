@@ -0,0 +1,111 @@
+//
+//  mqtt_loopback_broker.h
+//  LokiSDKTests
+//
+//  An in-process stand-in for the IoT Hub MQTT endpoint, reached through a memory-pipe xio. It frames the client's
+//  packets with uMQTT's mqtt_codec and answers the IoT Hub topics the MQTT transport uses:
+//  - devices/{id}/messages/events/ telemetry, PUBACK'd subject to the injected faults
+//  - $iothub/twin/GET and $iothub/twin/PATCH/properties/reported requests
+//  - $iothub/methods/res responses to the methods invoked with mqtt_loopback_broker_invoke_method
+//
+//  The broker runs on the thread calling the client's DoWork: bytes the client sends are processed during the send,
+//  and the broker's packets are delivered by the xio's dowork once due.
+//
+
+#ifndef MQTT_LOOPBACK_BROKER_H
+#define MQTT_LOOPBACK_BROKER_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+// TRANSPORT_PROVIDER of iothub_transport_ll.h, declared here so that Swift sees the type the AzureIoTHubClient module does
+struct TRANSPORT_PROVIDER_TAG;
+
+typedef struct MQTT_LOOPBACK_BROKER_INSTANCE_TAG* MQTT_LOOPBACK_BROKER_HANDLE;
+
+typedef struct MQTT_LOOPBACK_BROKER_FAULTS_TAG
+{
+    /** @brief Time each telemetry PUBACK is held back, in milliseconds. */
+    uint32_t puback_delay_ms;
+    /** @brief Drop the PUBACK of every nth telemetry PUBLISH, 0 to acknowledge them all. */
+    size_t puback_drop_every;
+    /** @brief Close the connection once, right after the nth telemetry PUBLISH from now, 0 never. The PUBACKs
+                not delivered yet are lost with the connection. */
+    size_t disconnect_after_publishes;
+} MQTT_LOOPBACK_BROKER_FAULTS;
+
+typedef struct MQTT_LOOPBACK_BROKER_STATS_TAG
+{
+    size_t connects;
+    size_t subscribes;
+    size_t pings;
+    /** @brief Telemetry PUBLISH packets received, including the ones sent again. */
+    size_t telemetry_publishes;
+    /** @brief Telemetry PUBLISH packets received with the DUP flag set. */
+    size_t telemetry_duplicates;
+    size_t telemetry_payload_bytes;
+    /** @brief Telemetry PUBLISH packets whose topic sets a content type ($.ct). */
+    size_t telemetry_with_content_type;
+    size_t pubacks_sent;
+    size_t pubacks_dropped;
+    size_t disconnects_injected;
+    size_t twin_gets;
+    size_t twin_reported_patches;
+    size_t method_responses;
+    /** @brief Status the device returned for the last method invoked. */
+    int last_method_status;
+} MQTT_LOOPBACK_BROKER_STATS;
+
+/**
+* @brief    Creates the broker the transport returned by MqttLoopback_Protocol connects to. Only one broker can
+*           exist at a time.
+*
+* @return   A handle to the broker, NULL if another broker exists or on error.
+*/
+extern MQTT_LOOPBACK_BROKER_HANDLE mqtt_loopback_broker_create(void);
+
+/**
+* @brief    Destroys the broker. The client connected to it sees its connection fail.
+*/
+extern void mqtt_loopback_broker_destroy(MQTT_LOOPBACK_BROKER_HANDLE broker);
+
+/**
+* @brief    Sets the faults injected from now on, NULL to clear them.
+*/
+extern void mqtt_loopback_broker_set_faults(MQTT_LOOPBACK_BROKER_HANDLE broker, const MQTT_LOOPBACK_BROKER_FAULTS* faults);
+
+extern void mqtt_loopback_broker_get_stats(MQTT_LOOPBACK_BROKER_HANDLE broker, MQTT_LOOPBACK_BROKER_STATS* stats);
+
+/**
+* @brief    Sets the desired properties, a JSON object that should include "$version", and sends them to a client
+*           subscribed to desired property updates.
+*
+* @return   0 upon success, non-zero otherwise.
+*/
+extern int mqtt_loopback_broker_update_desired(MQTT_LOOPBACK_BROKER_HANDLE broker, const char* desired_json);
+
+/**
+* @brief    Invokes the method @p method_name on the connected client with the JSON @p payload. The status the client
+*           responds with is reported in MQTT_LOOPBACK_BROKER_STATS.
+*
+* @return   0 upon success, non-zero if no client subscribed to methods is connected or on error.
+*/
+extern int mqtt_loopback_broker_invoke_method(MQTT_LOOPBACK_BROKER_HANDLE broker, const char* method_name, const char* payload);
+
+/**
+* @brief    MQTT transport connecting to the broker instead of IoT Hub, to pass to IoTHubDeviceClient_LL_Create and
+*           the other client creation functions. The host name in the connection string is ignored.
+*/
+extern const struct TRANSPORT_PROVIDER_TAG* MqttLoopback_Protocol(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MQTT_LOOPBACK_BROKER_H */
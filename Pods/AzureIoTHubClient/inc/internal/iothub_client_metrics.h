@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_METRICS_H
+#define IOTHUB_CLIENT_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/tickcounter.h"
+#include "umock_c/umock_c_prod.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Counters owned by an LL client and fed by the client and its transport. Every update is a relaxed atomic add,
+   so they can be bumped from any thread without a lock; a snapshot is not a consistent cut across counters. */
+typedef struct IOTHUB_CLIENT_METRICS_COUNTERS_TAG* IOTHUB_CLIENT_METRICS_HANDLE;
+
+#define IOTHUB_CLIENT_METRICS_COUNTER_VALUES    \
+    IOTHUB_CLIENT_METRICS_WAITING_TO_SEND,      \
+    IOTHUB_CLIENT_METRICS_WAITING_FOR_ACK,      \
+    IOTHUB_CLIENT_METRICS_BYTES_SENT,           \
+    IOTHUB_CLIENT_METRICS_BYTES_RECEIVED,       \
+    IOTHUB_CLIENT_METRICS_RECONNECTS
+
+MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_METRICS_COUNTER, IOTHUB_CLIENT_METRICS_COUNTER_VALUES);
+
+#define IOTHUB_CLIENT_METRICS_HISTOGRAM_VALUES      \
+    IOTHUB_CLIENT_METRICS_TELEMETRY_ACK_LATENCY,    \
+    IOTHUB_CLIENT_METRICS_DISPOSITION_LATENCY,      \
+    IOTHUB_CLIENT_METRICS_DO_WORK_DURATION
+
+MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_METRICS_HISTOGRAM, IOTHUB_CLIENT_METRICS_HISTOGRAM_VALUES);
+
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_METRICS_HANDLE, iothub_client_metrics_create);
+MOCKABLE_FUNCTION(, void, iothub_client_metrics_destroy, IOTHUB_CLIENT_METRICS_HANDLE, metrics);
+
+/* All updates do nothing when metrics is NULL, so callers need not check whether metrics are wired up. */
+MOCKABLE_FUNCTION(, void, iothub_client_metrics_add, IOTHUB_CLIENT_METRICS_HANDLE, metrics, IOTHUB_CLIENT_METRICS_COUNTER, counter, uint64_t, value);
+MOCKABLE_FUNCTION(, void, iothub_client_metrics_subtract, IOTHUB_CLIENT_METRICS_HANDLE, metrics, IOTHUB_CLIENT_METRICS_COUNTER, counter, uint64_t, value);
+MOCKABLE_FUNCTION(, void, iothub_client_metrics_record, IOTHUB_CLIENT_METRICS_HANDLE, metrics, IOTHUB_CLIENT_METRICS_HISTOGRAM, histogram, tickcounter_ms_t, value_ms);
+
+/* ON_XIO_BYTES_TRANSFERRED for an XIO_BYTE_COUNTER whose context is an IOTHUB_CLIENT_METRICS_HANDLE */
+MOCKABLE_FUNCTION(, void, iothub_client_metrics_on_bytes_transferred, void*, context, size_t, bytes_sent, size_t, bytes_received);
+
+/* WAITING_TO_SEND goes up when the LL client queues a message in waitingToSend and down when the client or the transport
+   takes one out, so reading it never walks the list. */
+MOCKABLE_FUNCTION(, void, iothub_client_metrics_get, IOTHUB_CLIENT_METRICS_HANDLE, metrics, IOTHUB_CLIENT_METRICS*, snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_METRICS_H
@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_payload_codec_private.h
+*    @brief  For internal use of the Azure IoT C SDK only.
+*/
+
+#ifndef IOTHUB_CLIENT_PAYLOAD_CODEC_PRIVATE_H
+#define IOTHUB_CLIENT_PAYLOAD_CODEC_PRIVATE_H
+
+#include "umock_c/umock_c_prod.h"
+
+#include "iothub_message.h"
+#include "iothub_client_payload_codec.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+/** @brief payload codec related setting */
+typedef struct IOTHUB_PAYLOAD_CODEC_SETTING_DATA_TAG
+{
+    const IOTHUB_CLIENT_PAYLOAD_CODEC* codec;
+    size_t minPayloadSize;
+} IOTHUB_PAYLOAD_CODEC_SETTING_DATA;
+
+/**
+    * @brief    Encodes the payload of message with codecSetting->codec if:
+    *           a. a codec is set and the message has no content encoding yet and
+    *           b. the payload is at least codecSetting->minPayloadSize bytes and
+    *           c. the encoded payload is smaller than the payload
+    *
+    * @param    codecSetting     Pointer to an @c IOTHUB_PAYLOAD_CODEC_SETTING_DATA structure
+    *
+    * @param    messageHandle    message handle
+    *
+    * @return    0 upon success, including when the message is left as is, non-zero on failure, in which case the
+    *            message is left unchanged
+    */
+MOCKABLE_FUNCTION(, int, IoTHubClient_PayloadCodec_EncodeIfNecessary, IOTHUB_PAYLOAD_CODEC_SETTING_DATA*, codecSetting, IOTHUB_MESSAGE_HANDLE, messageHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_PAYLOAD_CODEC_PRIVATE_H */
@@ -9,6 +9,7 @@
 #include "azure_c_shared_utility/constbuffer.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/timer_wheel.h"
 #include "umock_c/umock_c_prod.h"
 
 #include "iothub_message.h"
@@ -50,6 +51,8 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     DLIST_ENTRY entry;
     tickcounter_ms_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
     tickcounter_ms_t message_timeout_value;
+    TIMER_WHEEL_ENTRY timeout_entry; /* scheduled only while the message is in waitingToSend; a transport taking it out of that list cancels it */
+    uint64_t journal_record_id; /* 0 unless the message is kept in the telemetry journal, see OPTION_TELEMETRY_JOURNAL_DIRECTORY */
 }IOTHUB_MESSAGE_LIST;
 
 typedef struct IOTHUB_DEVICE_TWIN_TAG
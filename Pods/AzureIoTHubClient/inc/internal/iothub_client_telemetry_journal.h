@@ -0,0 +1,46 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_TELEMETRY_JOURNAL_H
+#define IOTHUB_CLIENT_TELEMETRY_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "umock_c/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Append-only journal of the telemetry an LL client has queued, kept in memory-mapped segment files of a directory so
+   that it survives the process. Records get increasing ids starting at 1. A record is handed out once, either when it
+   is appended or later by iothub_client_telemetry_journal_load_next, in id order; it is replayed by the next journal
+   created on the directory until it is acknowledged. Segments are deleted once all their records are acknowledged.
+   Appends and acknowledgements reach storage at iothub_client_telemetry_journal_sync, which waits for them with
+   msync(MS_SYNC), and when the journal is destroyed; until then a power loss can lose them, a process crash cannot. */
+typedef struct TELEMETRY_JOURNAL_TAG* TELEMETRY_JOURNAL_HANDLE;
+
+/* Opens the journal in directory, which must exist, picking up the unacknowledged records of earlier journals. */
+MOCKABLE_FUNCTION(, TELEMETRY_JOURNAL_HANDLE, iothub_client_telemetry_journal_create, const char*, directory);
+/* Unmaps the segments; the unacknowledged records stay on disk. */
+MOCKABLE_FUNCTION(, void, iothub_client_telemetry_journal_destroy, TELEMETRY_JOURNAL_HANDLE, journal);
+
+/* Appends message. When hand_out is true and every earlier record has been handed out, the record is handed out right
+   away and *handed_out is set to true; otherwise it waits for iothub_client_telemetry_journal_load_next. */
+MOCKABLE_FUNCTION(, int, iothub_client_telemetry_journal_append, TELEMETRY_JOURNAL_HANDLE, journal, IOTHUB_MESSAGE_HANDLE, message, bool, hand_out, uint64_t*, record_id, bool*, handed_out);
+/* Hands out the oldest record not handed out yet as a new message, NULL when there is none. */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, iothub_client_telemetry_journal_load_next, TELEMETRY_JOURNAL_HANDLE, journal, uint64_t*, record_id);
+/* True when every record appended so far has been handed out, or dropped by load_next because it could not be read. */
+MOCKABLE_FUNCTION(, bool, iothub_client_telemetry_journal_is_caught_up, TELEMETRY_JOURNAL_HANDLE, journal);
+MOCKABLE_FUNCTION(, int, iothub_client_telemetry_journal_acknowledge, TELEMETRY_JOURNAL_HANDLE, journal, uint64_t, record_id);
+/* Waits until the records appended and acknowledged so far are on storage. */
+MOCKABLE_FUNCTION(, int, iothub_client_telemetry_journal_sync, TELEMETRY_JOURNAL_HANDLE, journal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_TELEMETRY_JOURNAL_H
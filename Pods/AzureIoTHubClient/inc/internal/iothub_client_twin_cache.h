@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_TWIN_CACHE_H
+#define IOTHUB_CLIENT_TWIN_CACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "umock_c/umock_c_prod.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Copy of the twin document kept by an LL client: full documents replace it, desired properties patches are merged into
+   its "desired" section in place (JSON merge-patch) when their $version follows the cached one. */
+typedef struct TWIN_CACHE_TAG* TWIN_CACHE_HANDLE;
+
+MOCKABLE_FUNCTION(, TWIN_CACHE_HANDLE, iothub_client_twin_cache_create);
+MOCKABLE_FUNCTION(, void, iothub_client_twin_cache_destroy, TWIN_CACHE_HANDLE, twin_cache);
+
+/* Applies a DEVICE_TWIN_UPDATE_COMPLETE document or a DEVICE_TWIN_UPDATE_PARTIAL patch. *refresh_needed is set when the
+   cache cannot follow the patches any more (no document yet, or a $version gap) and needs a full document; patches
+   older than the cached document are ignored. */
+MOCKABLE_FUNCTION(, int, iothub_client_twin_cache_update, TWIN_CACHE_HANDLE, twin_cache, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payload, size_t, size, bool*, refresh_needed);
+
+/* Serializes the cached document, NULL when there is none; the result is freed with iothub_client_twin_cache_free_document. */
+MOCKABLE_FUNCTION(, char*, iothub_client_twin_cache_get_document, TWIN_CACHE_HANDLE, twin_cache);
+MOCKABLE_FUNCTION(, void, iothub_client_twin_cache_free_document, char*, document);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_TWIN_CACHE_H
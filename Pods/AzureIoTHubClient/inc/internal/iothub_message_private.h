@@ -10,6 +10,7 @@
 
 #include "azure_macro_utils/macro_utils.h"
 #include "umock_c/umock_c_prod.h"
+#include "azure_c_shared_utility/buffer_.h"
 #include "iothub_message.h"
 
 #ifdef __cplusplus
@@ -25,6 +26,12 @@ typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG* MESSAGE_DISPOSITION_CONTEXT_HAND
 
 typedef void(*MESSAGE_DISPOSITION_CONTEXT_DESTROY_FUNCTION)(MESSAGE_DISPOSITION_CONTEXT_HANDLE dispositionContext);
 
+struct MESSAGE_PROPERTIES_SOURCE_TAG;
+typedef struct MESSAGE_PROPERTIES_SOURCE_TAG* MESSAGE_PROPERTIES_SOURCE_HANDLE;
+
+typedef int(*MESSAGE_PROPERTIES_DECODE_FUNCTION)(MESSAGE_PROPERTIES_SOURCE_HANDLE propertiesSource, IOTHUB_MESSAGE_HANDLE iotHubMessageHandle);
+typedef void(*MESSAGE_PROPERTIES_SOURCE_DESTROY_FUNCTION)(MESSAGE_PROPERTIES_SOURCE_HANDLE propertiesSource);
+
 /**
 * @brief   Sets the context for the transport layer to send a DISPOSITION or ACK for a cloud-to-device message.
 *
@@ -46,6 +53,31 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetDispositionContext,
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetDispositionContext, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, MESSAGE_DISPOSITION_CONTEXT_HANDLE*, dispositionContext);
 
+/**
+* @brief   Defers setting the application and system properties of a received message until they are first read or written,
+*          e.g. with IoTHubMessage_Properties or IoTHubMessage_GetMessageId, or the message is cloned.
+*
+* @param   iotHubMessageHandle                The message whose properties are decoded later.
+* @param   propertiesSource                   The transport's encoded properties, e.g. a copy of the MQTT topic.
+* @param   propertiesDecodeFunction           A function defined by the transport setting the properties of the message from propertiesSource.
+* @param   propertiesSourceDestroyFunction    A function defined by the transport for destroying propertiesSource once decoded or with the message.
+*
+* @return  An #IOTHUB_MESSAGE_RESULT with the result of the operation.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetPropertiesSource, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, MESSAGE_PROPERTIES_SOURCE_HANDLE, propertiesSource, MESSAGE_PROPERTIES_DECODE_FUNCTION, propertiesDecodeFunction, MESSAGE_PROPERTIES_SOURCE_DESTROY_FUNCTION, propertiesSourceDestroyFunction);
+
+/**
+* @brief   Replaces the body of a message with its encoded form, which becomes a byte array message, and sets the
+*          content encoding system property. Either both are changed or, on failure, neither is.
+*
+* @param   iotHubMessageHandle                The message whose body is replaced.
+* @param   byteArray                          The encoded body. The message takes ownership of it on success.
+* @param   contentEncoding                    The content encoding of @p byteArray.
+*
+* @return  An #IOTHUB_MESSAGE_RESULT with the result of the operation.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetEncodedByteArray, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, BUFFER_HANDLE, byteArray, const char*, contentEncoding);
+
 #ifdef __cplusplus
 }
 #endif
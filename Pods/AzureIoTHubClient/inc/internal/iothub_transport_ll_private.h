@@ -13,6 +13,7 @@ typedef union IOTHUB_IDENTITY_INFO_TAG IOTHUB_IDENTITY_INFO;
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/platform.h"
 #include "internal/iothub_client_authorization.h"
+#include "internal/iothub_client_metrics.h"
 #include "iothub_message.h"
 
 #include "iothub_client_ll.h"
@@ -31,6 +32,7 @@ extern "C"
     typedef void (*pfTransport_Twin_RetrievePropertyComplete_Callback)(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* ctx);
     typedef int (*pfTransport_DeviceMethod_Complete_Callback)(const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id, void* ctx);
     typedef const char* (*pfTransport_GetOption_Model_Id_Callback)(void* ctx);
+    typedef IOTHUB_CLIENT_METRICS_HANDLE (*pfTransport_GetMetrics_Callback)(void* ctx);
 
     /** @brief    This struct captures device configuration. */
     typedef struct IOTHUB_DEVICE_CONFIG_TAG
@@ -61,6 +63,7 @@ extern "C"
         pfTransport_Twin_RetrievePropertyComplete_Callback twin_retrieve_prop_complete_cb;
         pfTransport_DeviceMethod_Complete_Callback method_complete_cb;
         pfTransport_GetOption_Model_Id_Callback get_model_id_cb;
+        pfTransport_GetMetrics_Callback get_metrics_cb;
     } TRANSPORT_CALLBACKS_INFO;
 
     typedef STRING_HANDLE (*pfIoTHubTransport_GetHostname)(TRANSPORT_LL_HANDLE handle);
@@ -86,6 +89,7 @@ extern "C"
     typedef void(*pfIoTHubTransport_Unsubscribe_InputQueue)(IOTHUB_DEVICE_HANDLE handle);
     typedef int(*pfIoTHubTransport_SetCallbackContext)(TRANSPORT_LL_HANDLE handle, void* ctx);
     typedef int(*pfIoTHubTransport_GetSupportedPlatformInfo)(TRANSPORT_LL_HANDLE handle, PLATFORM_INFO_OPTION* info);
+    typedef int(*pfIoTHubTransport_GetPollInfo)(TRANSPORT_LL_HANDLE handle, bool has_pending_items, IOTHUB_CLIENT_POLL_INFO* poll_info);
 
 #define TRANSPORT_PROVIDER_FIELDS                                                   \
 pfIotHubTransport_SendMessageDisposition IoTHubTransport_SendMessageDisposition;    \
@@ -110,7 +114,8 @@ pfIoTHubTransport_Subscribe_InputQueue IoTHubTransport_Subscribe_InputQueue;
 pfIoTHubTransport_Unsubscribe_InputQueue IoTHubTransport_Unsubscribe_InputQueue;    \
 pfIoTHubTransport_SetCallbackContext IoTHubTransport_SetCallbackContext;            \
 pfIoTHubTransport_GetTwinAsync IoTHubTransport_GetTwinAsync;                        \
-pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo     /*there's an intentional missing ; on this line*/
+pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo;  \
+pfIoTHubTransport_GetPollInfo IoTHubTransport_GetPollInfo     /*optional, may be NULL. there's an intentional missing ; on this line*/
 
     struct TRANSPORT_PROVIDER_TAG
     {
@@ -16,8 +16,11 @@
 #include "iothub_message.h"
 
 #ifdef __cplusplus
+#include <cstdint>
 extern "C"
 {
+#else
+#include <stdint.h>
 #endif
 
 #define IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES \
@@ -83,10 +86,12 @@ extern "C"
 
 #define IOTHUB_CLIENT_STATUS_VALUES       \
     IOTHUB_CLIENT_SEND_STATUS_IDLE,       \
-    IOTHUB_CLIENT_SEND_STATUS_BUSY
+    IOTHUB_CLIENT_SEND_STATUS_BUSY,       \
+    IOTHUB_CLIENT_SEND_STATUS_BACKPRESSURE
 
     /** @brief Enumeration returned by the GetSendStatus family of APIs (e.g. IoTHubDeviceClient_LL_GetSendStatus())
-    *           to indicate the current sending status of the IoT Hub client.
+    *           to indicate the current sending status of the IoT Hub client. @c IOTHUB_CLIENT_SEND_STATUS_BACKPRESSURE
+    *           means messages are queued behind a full OPTION_MAX_INFLIGHT_MESSAGES window: producers should slow down.
     */
     MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_STATUS_VALUES);
 
@@ -140,6 +145,56 @@ extern "C"
     */
     MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
 
+#define IOTHUB_CLIENT_BATCH_CONFIRMATION_VALUES      \
+    IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE,      \
+    IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE     \
+
+    /** @brief Enumeration selecting how the messages of a SendEventBatchAsync call are confirmed:
+    *          once for the whole batch (IOTHUB_CLIENT_CONFIRMATION_OK only if every message succeeded,
+    *          otherwise the first failure) or once per message.
+    */
+    MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_BATCH_CONFIRMATION, IOTHUB_CLIENT_BATCH_CONFIRMATION_VALUES);
+
+#define IOTHUB_CLIENT_HISTOGRAM_BUCKET_COUNT 16
+
+    /** @brief Distribution of durations in milliseconds. buckets[0] counts values below 1 ms and buckets[i] values in
+    *          [2^(i-1), 2^i) ms; the last bucket also counts everything above that.
+    */
+    typedef struct IOTHUB_CLIENT_HISTOGRAM_TAG
+    {
+        uint64_t count;
+        uint64_t sum_ms;
+        uint64_t buckets[IOTHUB_CLIENT_HISTOGRAM_BUCKET_COUNT];
+    } IOTHUB_CLIENT_HISTOGRAM;
+
+    /** @brief Snapshot filled by the GetMetrics APIs (e.g. IoTHubDeviceClient_GetMetrics()). Everything but the two
+    *          queue depths accumulates from the creation of the client. Transports that do not report a value leave it 0.
+    */
+    typedef struct IOTHUB_CLIENT_METRICS_TAG
+    {
+        size_t waiting_to_send;                      /* messages accepted by SendEventAsync, not yet taken by the transport */
+        uint64_t waiting_for_ack;                    /* telemetry published, not yet acknowledged */
+        uint64_t bytes_sent;                         /* bytes handed to the transport's xio */
+        uint64_t bytes_received;                     /* bytes delivered by the transport's xio */
+        uint64_t reconnects;                         /* connections established after the first one */
+        IOTHUB_CLIENT_HISTOGRAM telemetry_ack_latency; /* last publish of a telemetry message to its PUBACK */
+        IOTHUB_CLIENT_HISTOGRAM disposition_latency; /* arrival of a cloud-to-device message to its disposition */
+        IOTHUB_CLIENT_HISTOGRAM do_work_duration;    /* DoWork calls on the LL client */
+    } IOTHUB_CLIENT_METRICS;
+
+#define IOTHUB_CLIENT_POLL_NO_TIMEOUT UINT64_MAX
+
+    /** @brief Filled by the GetPollInfo APIs (e.g. IoTHubDeviceClient_LL_GetPollInfo()) for applications that run
+    *          LL clients from their own event loop: DoWork is due when fd is readable, when want_write is set and fd
+    *          is writable, or when timeout_ms has elapsed, whichever comes first.
+    */
+    typedef struct IOTHUB_CLIENT_POLL_INFO_TAG
+    {
+        int fd;                 /* socket of the connection, -1 while there is none or the transport cannot expose it */
+        bool want_write;        /* output is queued and waits for fd to become writable */
+        uint64_t timeout_ms;    /* 0 when DoWork has work right away, IOTHUB_CLIENT_POLL_NO_TIMEOUT when nothing is timed */
+    } IOTHUB_CLIENT_POLL_INFO;
+
 #define IOTHUB_CLIENT_CONNECTION_STATUS_VALUES             \
     IOTHUB_CLIENT_CONNECTION_AUTHENTICATED,                \
     IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED               \
@@ -103,8 +103,104 @@ extern "C"
     //diagnostic sampling percentage value, [0-100]
     static STATIC_VAR_UNUSED const char* OPTION_DIAGNOSTIC_SAMPLING_PERCENTAGE = "diag_sampling_percentage";
 
+    /*
+    * @brief Codec compressing the payload of telemetry messages at least OPTION_PAYLOAD_CODEC_MIN_SIZE bytes long when they are
+    *        queued, setting their content encoding system property. Messages that already have a content encoding, or that the
+    *        codec does not make smaller, are sent as is. Value is a const IOTHUB_CLIENT_PAYLOAD_CODEC*, e.g.
+    *        IoTHubClient_PayloadCodec_Deflate() (see iothub_client_payload_codec.h), that must outlive the client; a codec with
+    *        a NULL encode function turns compression off, which is the default.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_PAYLOAD_CODEC = "payload_codec";
+
+    /*
+    * @brief Smallest payload OPTION_PAYLOAD_CODEC compresses, in bytes. Value is a pointer to a size_t; the default is 256.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_PAYLOAD_CODEC_MIN_SIZE = "payload_codec_min_size";
+
+    /*
+    * @brief Existing directory where telemetry sent with IoTHubClient_LL_SendEventAsync is journaled in memory-mapped files
+    *        until the hub confirms it, so that messages not yet sent when the process stops are sent by the next client
+    *        given the same directory (without confirmation callback). The journal is synced to storage with msync(MS_SYNC)
+    *        once per DoWork, before the transport publishes, and when the client is destroyed: a power loss can lose the
+    *        messages queued, or replay the messages confirmed, since the last DoWork. Value is a const char*; the option can be set once,
+    *        before sending telemetry. SendEventBatchAsync fails while the journal is enabled,
+    *        as a batch could not be journaled all-or-nothing; send journaled messages one by one.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TELEMETRY_JOURNAL_DIRECTORY = "telemetry_journal_directory";
+
+    /*
+    * @brief Number of journaled messages kept in memory for the transport at most; the others are read back from the
+    *        journal as these are confirmed. Value is a pointer to a size_t greater than 0; the default is 16.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TELEMETRY_JOURNAL_WINDOW = "telemetry_journal_window";
+
+    /*
+    * @brief Keeps a copy of the twin document, read with the GetCachedTwin APIs (e.g. IoTHubDeviceClient_LL_GetCachedTwin())
+    *        without a round-trip to the hub. Desired properties patches are merged into it as they arrive; when one is
+    *        missed (a $version gap) the client gets the full twin again and also passes it to the twin callback as
+    *        DEVICE_TWIN_UPDATE_COMPLETE. Value is a pointer to a bool; the default is false. Enabling it subscribes to the twin,
+    *        and the subscription stays while the cache is enabled even if the twin callback is cleared.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_CACHE = "twin_cache";
+
     static STATIC_VAR_UNUSED const char* OPTION_DO_WORK_FREQUENCY_IN_MS = "do_work_freq_ms";
 
+    /*
+    * @brief Makes the convenience layer worker thread block until work is submitted (e.g. SendEventAsync, SendReportedState)
+    *        instead of sleeping a fixed interval between calls to DoWork. The OPTION_DO_WORK_FREQUENCY_IN_MS value becomes the
+    *        maximum time the thread stays idle, which bounds how late incoming data and timers are serviced.
+    *        Value is a pointer to a bool. Not applicable to clients created with a shared transport handle.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_DO_WORK_WAKE_ON_DEMAND = "do_work_wake_on_demand";
+
+    /*
+    * @brief Number of threads the convenience layer uses to run user callbacks (confirmations, methods, twin, messages...),
+    *        so that slow application code does not hold up network I/O. Callbacks of the same type always run on the
+    *        same thread, in the order they were raised. Value is a pointer to a size_t; 0 (the default) runs callbacks
+    *        on the worker thread. Can only be set once per client.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_CALLBACK_DISPATCH_THREAD_COUNT = "callback_dispatch_thread_count";
+
+    /*
+    * @brief Capacity of a lock-free submission ring for IoTHubClient(Core)_SendEventAsync. With it, the calling thread only
+    *        clones the message and enqueues it; the worker thread hands queued messages to the LL layer at the start of its
+    *        next DoWork, so producers never wait for network processing. When the ring is full, sends fall back to the
+    *        locked path. Value is a pointer to a size_t (rounded up to a power of two); 0, the default, disables it.
+    *        Must be set before the first send and can only be set once per client.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_SEND_QUEUE_RING_SIZE = "send_queue_ring_size";
+
+    /*
+    * @brief Maximum number of telemetry messages published and not yet acknowledged. Further messages wait in the client's
+    *        queue until acks arrive, and the GetSendStatus APIs report IOTHUB_CLIENT_SEND_STATUS_BACKPRESSURE meanwhile.
+    *        Value is a pointer to a size_t; 0, the default, leaves the window unbounded. MQTT transports only.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_MAX_INFLIGHT_MESSAGES = "max_inflight_messages";
+
+    /*
+    * @brief Publishes telemetry at QoS 0: no PUBACK is awaited and nothing is resent, so a message can be lost. Confirmation
+    *        callbacks report IOTHUB_CLIENT_CONFIRMATION_OK as soon as the message is handed to the network layer.
+    *        Value is a pointer to a bool; false (QoS 1) by default. Applies to messages sent after it is set. MQTT transports only.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TELEMETRY_AT_MOST_ONCE = "telemetry_at_most_once";
+
+    /*
+    * @brief Time telemetry may wait to be coalesced with the messages sent after it. Consecutive queued messages with content
+    *        type application/json and the same properties (and no message id, creation time or diagnostics) are published as
+    *        one message whose payload is the JSON array of their payloads; its PUBACK confirms them all. Messages without a
+    *        content type or with another one are published as they are. Queued messages
+    *        are published once the oldest has waited this long or OPTION_TELEMETRY_BATCH_MAX_BYTES is reached.
+    *        Value is a pointer to a size_t; 0, the default, disables coalescing. Not applied with OPTION_TELEMETRY_AT_MOST_ONCE.
+    *        MQTT transports only.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TELEMETRY_LINGER_MS = "telemetry_linger_ms";
+
+    /*
+    * @brief Maximum payload size of a coalesced telemetry message, see OPTION_TELEMETRY_LINGER_MS. Value is a pointer to a size_t;
+    *        the default is 16384 bytes.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TELEMETRY_BATCH_MAX_BYTES = "telemetry_batch_max_bytes";
+
 // Minimum percentage (in the 0 to 1 range) of multiplexed registered devices that must be failing for a transport-wide reconnection to be triggered.
 // A value of zero results in a single registered device to be able to cause a general transport reconnection 
 // (thus causing all other multiplexed registered devices to be also reconnected, meaning an agressive reconnection strategy).
@@ -0,0 +1,60 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_payload_codec.h
+*    @brief  Codecs the client can compress telemetry payloads with before sending them, see
+*            OPTION_PAYLOAD_CODEC.
+*/
+
+#ifndef IOTHUB_CLIENT_PAYLOAD_CODEC_H
+#define IOTHUB_CLIENT_PAYLOAD_CODEC_H
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+/**
+* @brief    Encodes @p source into @p destination.
+*
+* @param    source             The payload to encode.
+* @param    sourceSize         The size of @p source.
+* @param    destination        The buffer receiving the encoded payload.
+* @param    destinationSize    The size of @p destination on input, the size of the encoded payload on output.
+*
+* @return   0 upon success, non-zero if the encoded payload does not fit in @p destination or on error. The
+*           message is then sent unencoded.
+*/
+typedef int(*IOTHUB_CLIENT_PAYLOAD_ENCODE_FUNCTION)(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t* destinationSize);
+
+/** @brief A payload codec, set with OPTION_PAYLOAD_CODEC. */
+typedef struct IOTHUB_CLIENT_PAYLOAD_CODEC_TAG
+{
+    /** @brief Content encoding system property set on the messages the codec encodes. */
+    const char* contentEncoding;
+    /** @brief Encoding function; NULL disables payload encoding. */
+    IOTHUB_CLIENT_PAYLOAD_ENCODE_FUNCTION encode;
+} IOTHUB_CLIENT_PAYLOAD_CODEC;
+
+/**
+* @brief    Returns the built-in deflate codec. Payloads are encoded in the zlib format (RFC 1950) with
+*           content encoding "deflate", as for HTTP.
+*/
+MOCKABLE_FUNCTION(, const IOTHUB_CLIENT_PAYLOAD_CODEC*, IoTHubClient_PayloadCodec_Deflate);
+
+/**
+* @brief    Returns the built-in LZ4 codec, faster than deflate at a lower compression ratio. Payloads are
+*           encoded as an LZ4 block preceded by the decoded size as a 4-byte little-endian integer, with
+*           content encoding "lz4".
+*/
+MOCKABLE_FUNCTION(, const IOTHUB_CLIENT_PAYLOAD_CODEC*, IoTHubClient_PayloadCodec_LZ4);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_PAYLOAD_CODEC_H */
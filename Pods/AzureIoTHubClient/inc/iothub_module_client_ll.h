@@ -110,6 +110,41 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Same as IoTHubModuleClient_LL_SendEventAsync(), except that the client takes ownership of @p eventMessageHandle
+    *           instead of copying it, which saves a copy of the payload and properties per message.
+    *
+    * @param    iotHubModuleClientHandle   The handle created by a call to the create function.
+    * @param    eventMessageHandle         The handle to an IoT Hub message. On success the client owns and eventually destroys it,
+    *                                      so the caller must not use or destroy it any more. On failure it still belongs to the caller.
+    * @param    eventConfirmationCallback  As for IoTHubModuleClient_LL_SendEventAsync().
+    * @param    userContextCallback        As for IoTHubModuleClient_LL_SendEventAsync().
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventAsync_Move, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Asynchronous call to send the @p eventMessageCount messages in @p eventMessageHandles, in order.
+    *           The batch is queued as a whole: either every message is queued or none is.
+    *
+    * @param    iotHubModuleClientHandle   The handle created by a call to the create function.
+    * @param    eventMessageHandles        The messages to send. None of them can be @c NULL.
+    * @param    eventMessageCount          The number of entries in @p eventMessageHandles. Must be greater than 0.
+    * @param    confirmationMode           IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE invokes @p eventConfirmationCallback once,
+    *                                      after every message completed, with IOTHUB_CLIENT_CONFIRMATION_OK or the first failure.
+    *                                      IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE invokes it once per message.
+    * @param    eventConfirmationCallback  The callback receiving the confirmation(s). Can be @c NULL.
+    * @param    userContextCallback        User specified context that will be provided to every invocation of the callback.
+    *
+    * @warning: Do not call IoTHubModuleClient_LL_Destroy() or IoTHubModuleClient_LL_DoWork() from inside your application's callback.
+    *
+    * @remarks
+    *           As with IoTHubModuleClient_LL_SendEventAsync, the messages are copied and can be destroyed right after the call returns.
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventBatchAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION, confirmationMode, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief    This function returns the current sending status for IoTHubModuleClient.
     *
@@ -124,6 +159,38 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetSendStatus, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief    Takes a snapshot of the client's counters: queue depths, PUBACK and disposition latency
+    *           histograms, bytes on the wire, reconnects and IoTHubModuleClient_LL_DoWork() duration.
+    *
+    * @param    iotHubModuleClientHandle  The handle created by a call to the create function.
+    * @param    metrics                   The snapshot is written at the address pointed at by this parameter.
+    *
+    * @remark    Counters are updated with relaxed atomics, so the snapshot is not a consistent cut across them.
+    *            Reading them takes no lock: the call may be called from any thread, also while IoTHubModuleClient_LL_DoWork() runs.
+    *            Only the MQTT transports feed the transport-level counters.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetMetrics, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_METRICS*, metrics);
+
+    /**
+    * @brief    Tells an application that drives the client from its own event loop (epoll, kqueue, select)
+    *           what to wait for before the next call to IoTHubModuleClient_LL_DoWork().
+    *
+    * @param    iotHubModuleClientHandle  The handle created by a call to the create function.
+    * @param    pollInfo                  The socket, whether to wait for it to become writable and the time until
+    *                                     the next timer (connect timeout, keep alive, SAS token renewal,
+    *                                     message and twin timeouts) are written at this address.
+    *
+    * @remark    Call it after every IoTHubModuleClient_LL_DoWork() or API call, as each one can change the answer.
+    *            Only the MQTT transports expose their socket; the others report fd -1 and a short timeout,
+    *            as do the MQTT transports while reconnecting.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetPollInfo, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_POLL_INFO*, pollInfo);
+
     /**
     * @brief    Sets up the message callback to be invoked when Edge issues a
     *             message to the module. This is a blocking call.
@@ -280,6 +347,22 @@ extern "C"
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetTwinAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Provides the twin document kept by the client when OPTION_TWIN_CACHE is set, with the desired properties
+    *           patches received since the last full document merged in, without a round-trip to the hub.
+    *
+    * @param    iotHubModuleClientHandle  The handle created by a call to the create function.
+    * @param    deviceTwinCallback        Invoked with the document as DEVICE_TWIN_UPDATE_COMPLETE before this function returns.
+    * @param    userContextCallback       User specified context that will be provided to the
+    *                                     callback. This can be @c NULL.
+    *
+    * @warning: Do not call IoTHubModuleClient_LL_Destroy() or IoTHubModuleClient_LL_DoWork() from inside your application's callback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success, IOTHUB_CLIENT_ERROR when the cache is disabled or has no document yet, e.g.
+    *            while a missed patch is being recovered from.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetCachedTwin, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
+
      /**
      * @brief    This API sets callback for async cloud to module method call.
      *
@@ -33,6 +33,19 @@ MOCKABLE_FUNCTION(, TRANSPORT_HANDLE, IoTHubTransport_Create, IOTHUB_CLIENT_TRAN
 MOCKABLE_FUNCTION(, void, IoTHubTransport_Destroy, TRANSPORT_HANDLE, transportHandle);
 MOCKABLE_FUNCTION(, TRANSPORT_LL_HANDLE, IoTHubTransport_GetLLTransport, TRANSPORT_HANDLE, transportHandle);
 
+/**
+* @brief    Sets the number of threads that run the clients multiplexed over @p transportHandle. Each
+*           thread owns its own lower layer transport, that is its own connection to the IoT Hub, and its
+*           own lock; every new client is placed on the thread with the fewest clients. The lower layer
+*           DoWork, the network I/O and the per-client work of different threads therefore run in
+*           parallel. Transport options set through a client apply to the connection of its thread only.
+*           Call it after IoTHubTransport_Create and before the first client is created on the
+*           transport. The default is 1.
+*
+* @return   0 on success, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, IoTHubTransport_SetWorkerThreadCount, TRANSPORT_HANDLE, transportHandle, size_t, workerThreadCount);
+
 #ifdef __cplusplus
 }
 #endif
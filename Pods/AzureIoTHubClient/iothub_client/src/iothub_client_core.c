@@ -7,6 +7,7 @@
 
 #include <signal.h>
 #include <stddef.h>
+#include <stdatomic.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothub_client_core.h"
@@ -16,8 +17,10 @@
 #include "internal/iothubtransport.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/mpsc_ring.h"
 #include "azure_c_shared_utility/vector.h"
 #include "iothub_client_options.h"
 #include "azure_c_shared_utility/tickcounter.h"
@@ -31,6 +34,7 @@
 static const int DEFAULT_COMMAND_RESPONSE_STATUS_CODE = 500;
 
 struct IOTHUB_QUEUE_CONTEXT_TAG;
+struct CALLBACK_DISPATCHER_TAG;
 
 typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
 {
@@ -54,6 +58,16 @@ typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
     struct IOTHUB_QUEUE_CONTEXT_TAG* method_user_context;
     tickcounter_ms_t do_work_freq_ms;
     tickcounter_ms_t currentMessageTimeout;
+    COND_HANDLE WorkCondition; /*signaled when new work is submitted, only used if do_work_on_demand is set*/
+    LOCK_HANDLE WorkLock; /*guards work_pending and WorkCondition only, never held across DoWork, so signaling the worker does not wait for I/O*/
+    bool do_work_on_demand;
+    bool work_pending;
+    struct CALLBACK_DISPATCHER_TAG* callback_dispatchers; /*threads running user callbacks, NULL when they run on the worker thread*/
+    size_t callback_dispatcher_count;
+    MPSC_RING_HANDLE send_queue; /*QUEUED_EVENT_INFO submitted without taking LockHandle, drained by the worker*/
+    atomic_bool send_queue_signaled; /*set by the producer that wakes the worker, cleared when the worker drains send_queue*/
+    atomic_size_t send_queue_count; /*QUEUED_EVENT_INFO in send_queue, never below the true count, for IoTHubClientCore_GetMetrics*/
+    atomic_bool worker_started; /*ThreadHandle is set, so callers that do not take LockHandle need not take it to start the worker*/
 } IOTHUB_CLIENT_CORE_INSTANCE;
 
 typedef enum HTTPWORKER_THREAD_TYPE_TAG
@@ -112,6 +126,7 @@ typedef struct HTTPWORKER_THREAD_INFO_TAG
 
 MU_DEFINE_ENUM_WITHOUT_INVALID(USER_CALLBACK_TYPE, USER_CALLBACK_TYPE_VALUES)
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(USER_CALLBACK_TYPE, USER_CALLBACK_TYPE_VALUES)
+#define USER_CALLBACK_TYPE_COUNT MU_COUNT_ARG(USER_CALLBACK_TYPE_VALUES)
 
 typedef struct DEVICE_TWIN_CALLBACK_INFO_TAG
 {
@@ -169,6 +184,16 @@ typedef struct USER_CALLBACK_INFO_TAG
     } iothub_callback;
 } USER_CALLBACK_INFO;
 
+typedef struct CALLBACK_DISPATCHER_TAG
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance;
+    THREAD_HANDLE threadHandle;
+    LOCK_HANDLE lockHandle;
+    COND_HANDLE condHandle;
+    VECTOR_HANDLE pending_callbacks; /*USER_CALLBACK_INFO queued for this thread*/
+    sig_atomic_t stopThread;
+} CALLBACK_DISPATCHER;
+
 typedef struct IOTHUB_QUEUE_CONTEXT_TAG
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientHandle;
@@ -180,6 +205,19 @@ typedef struct IOTHUB_QUEUE_CONTEXT_TAG
     } callbackFunction;
 } IOTHUB_QUEUE_CONTEXT;
 
+/*IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE batches share one context; it is freed with the last confirmation*/
+typedef struct IOTHUB_BATCH_QUEUE_CONTEXT_TAG
+{
+    IOTHUB_QUEUE_CONTEXT queue_context;
+    size_t pending_confirmations;
+} IOTHUB_BATCH_QUEUE_CONTEXT;
+
+typedef struct QUEUED_EVENT_INFO_TAG
+{
+    IOTHUB_MESSAGE_HANDLE message_handle; /*clone owned by the queue*/
+    IOTHUB_QUEUE_CONTEXT* queue_context; /*NULL if no confirmation callback was given*/
+} QUEUED_EVENT_INFO;
+
 typedef struct IOTHUB_QUEUE_CONSOLIDATED_CONTEXT_TAG
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientHandle;
@@ -489,6 +527,27 @@ static void iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT r
     }
 }
 
+static void iothub_ll_event_batch_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    IOTHUB_BATCH_QUEUE_CONTEXT* batch_context = (IOTHUB_BATCH_QUEUE_CONTEXT*)userContextCallback;
+    if (batch_context != NULL)
+    {
+        USER_CALLBACK_INFO queue_cb_info;
+        queue_cb_info.type = CALLBACK_TYPE_EVENT_CONFIRM;
+        queue_cb_info.userContextCallback = batch_context->queue_context.userContextCallback;
+        queue_cb_info.iothub_callback.event_confirm_cb_info.confirm_result = result;
+        queue_cb_info.iothub_callback.event_confirm_cb_info.eventConfirmationCallback = batch_context->queue_context.callbackFunction.eventConfirmationCallback;
+        if (VECTOR_push_back(batch_context->queue_context.iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        {
+            LogError("event confirm callback vector push failed.");
+        }
+        if (--batch_context->pending_confirmations == 0)
+        {
+            free(batch_context);
+        }
+    }
+}
+
 static void iothub_ll_reported_state_callback(int status_code, void* userContextCallback)
 {
     IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)userContextCallback;
@@ -864,6 +923,321 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
     VECTOR_destroy(call_backs);
 }
 
+static int CallbackDispatch_Thread(void* threadArgument)
+{
+    CALLBACK_DISPATCHER* dispatcher = (CALLBACK_DISPATCHER*)threadArgument;
+
+    while (1)
+    {
+        VECTOR_HANDLE call_backs = NULL;
+        bool stop = false;
+
+        if (Lock(dispatcher->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking callback dispatcher");
+            (void)ThreadAPI_Sleep(DO_WORK_FREQ_DEFAULT);
+        }
+        else
+        {
+            while (VECTOR_size(dispatcher->pending_callbacks) == 0 && !dispatcher->stopThread)
+            {
+                if (Condition_Wait(dispatcher->condHandle, dispatcher->lockHandle, 0) != COND_OK)
+                {
+                    LogError("Condition_Wait failed");
+                    break;
+                }
+            }
+
+            if (VECTOR_size(dispatcher->pending_callbacks) != 0)
+            {
+                if ((call_backs = VECTOR_move(dispatcher->pending_callbacks)) == NULL)
+                {
+                    LogError("VECTOR_move failed");
+                }
+            }
+            else
+            {
+                /*queue is drained, only now honor the stop request so no callback is lost on destroy*/
+                stop = (dispatcher->stopThread != 0);
+            }
+            (void)Unlock(dispatcher->lockHandle);
+        }
+
+        if (call_backs != NULL)
+        {
+            dispatch_user_callbacks(dispatcher->iotHubClientInstance, call_backs);
+        }
+        else if (stop)
+        {
+            break;
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static void destroy_callback_dispatchers(CALLBACK_DISPATCHER* dispatchers, size_t count)
+{
+    size_t index;
+
+    for (index = 0; index < count; index++)
+    {
+        if (dispatchers[index].threadHandle != NULL)
+        {
+            int res;
+
+            if (Lock(dispatchers[index].lockHandle) != LOCK_OK)
+            {
+                LogError("unable to Lock - will still attempt to end the dispatcher thread");
+                dispatchers[index].stopThread = 1;
+                (void)Condition_Post(dispatchers[index].condHandle);
+            }
+            else
+            {
+                dispatchers[index].stopThread = 1;
+                (void)Condition_Post(dispatchers[index].condHandle);
+                (void)Unlock(dispatchers[index].lockHandle);
+            }
+
+            if (ThreadAPI_Join(dispatchers[index].threadHandle, &res) != THREADAPI_OK)
+            {
+                LogError("ThreadAPI_Join failed");
+            }
+        }
+
+        if (dispatchers[index].pending_callbacks != NULL)
+        {
+            VECTOR_destroy(dispatchers[index].pending_callbacks);
+        }
+        if (dispatchers[index].condHandle != NULL)
+        {
+            Condition_Deinit(dispatchers[index].condHandle);
+        }
+        if (dispatchers[index].lockHandle != NULL)
+        {
+            Lock_Deinit(dispatchers[index].lockHandle);
+        }
+    }
+    free(dispatchers);
+}
+
+static CALLBACK_DISPATCHER* create_callback_dispatchers(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, size_t count)
+{
+    CALLBACK_DISPATCHER* result = (CALLBACK_DISPATCHER*)calloc(count, sizeof(CALLBACK_DISPATCHER));
+
+    if (result == NULL)
+    {
+        LogError("failure allocating callback dispatchers");
+    }
+    else
+    {
+        size_t index;
+        for (index = 0; index < count; index++)
+        {
+            result[index].iotHubClientInstance = iotHubClientInstance;
+            if ((result[index].lockHandle = Lock_Init()) == NULL ||
+                (result[index].condHandle = Condition_Init()) == NULL ||
+                (result[index].pending_callbacks = VECTOR_create(sizeof(USER_CALLBACK_INFO))) == NULL)
+            {
+                LogError("failure creating callback dispatcher %lu", (unsigned long)index);
+                break;
+            }
+            else if (ThreadAPI_Create(&result[index].threadHandle, CallbackDispatch_Thread, &result[index]) != THREADAPI_OK)
+            {
+                LogError("ThreadAPI_Create failed for callback dispatcher %lu", (unsigned long)index);
+                result[index].threadHandle = NULL;
+                break;
+            }
+        }
+
+        if (index != count)
+        {
+            destroy_callback_dispatchers(result, count);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*hands the callbacks to the dispatcher threads, or runs them on the calling thread if there are none.
+Each callback type maps to a single dispatcher so callbacks of a type keep their order.*/
+static void queue_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, CALLBACK_DISPATCHER* dispatchers, size_t dispatcher_count, VECTOR_HANDLE call_backs)
+{
+    if (dispatchers == NULL || VECTOR_size(call_backs) == 0)
+    {
+        dispatch_user_callbacks(iotHubClientInstance, call_backs);
+    }
+    else
+    {
+        VECTOR_HANDLE not_queued = NULL;
+        size_t callbacks_length = VECTOR_size(call_backs);
+        size_t index;
+
+        for (index = 0; index < callbacks_length; index++)
+        {
+            USER_CALLBACK_INFO* queued_cb = (USER_CALLBACK_INFO*)VECTOR_element(call_backs, index);
+            CALLBACK_DISPATCHER* dispatcher = &dispatchers[(size_t)queued_cb->type % dispatcher_count];
+            bool queued = false;
+
+            if (Lock(dispatcher->lockHandle) != LOCK_OK)
+            {
+                LogError("failed locking callback dispatcher");
+            }
+            else
+            {
+                if (VECTOR_push_back(dispatcher->pending_callbacks, queued_cb, 1) != 0)
+                {
+                    LogError("callback dispatcher vector push failed.");
+                }
+                else
+                {
+                    queued = true;
+                    (void)Condition_Post(dispatcher->condHandle);
+                }
+                (void)Unlock(dispatcher->lockHandle);
+            }
+
+            /*a callback that cannot be queued still runs, just on this thread*/
+            if (!queued &&
+                ((not_queued != NULL) || ((not_queued = VECTOR_create(sizeof(USER_CALLBACK_INFO))) != NULL)) &&
+                (VECTOR_push_back(not_queued, queued_cb, 1) != 0))
+            {
+                LogError("unable to save callback of type %s", MU_ENUM_TO_STRING(USER_CALLBACK_TYPE, queued_cb->type));
+            }
+        }
+
+        VECTOR_destroy(call_backs);
+        if (not_queued != NULL)
+        {
+            dispatch_user_callbacks(iotHubClientInstance, not_queued);
+        }
+    }
+}
+
+/*can be called with or without LockHandle held*/
+static void signalWorkerThread(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->WorkCondition == NULL)
+    {
+        /*the worker sleeps a fixed do_work_freq_ms, nothing to wake*/
+    }
+    else if (Lock(iotHubClientInstance->WorkLock) != LOCK_OK)
+    {
+        LogError("unable to Lock - the work is picked up on the worker's next timeout");
+    }
+    else
+    {
+        /*posted under WorkLock, so it cannot fall between the worker's work_pending check and its wait*/
+        iotHubClientInstance->work_pending = true;
+        if (Condition_Post(iotHubClientInstance->WorkCondition) != COND_OK)
+        {
+            LogError("unable to signal worker thread");
+        }
+        (void)Unlock(iotHubClientInstance->WorkLock);
+    }
+}
+
+/*must be called with LockHandle held, by the single consumer of send_queue*/
+static void drainSendQueue(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->send_queue != NULL)
+    {
+        QUEUED_EVENT_INFO* queued_event;
+
+        /*cleared before popping: anything pushed after this point signals the worker again*/
+        atomic_store(&iotHubClientInstance->send_queue_signaled, false);
+        while ((queued_event = (QUEUED_EVENT_INFO*)mpsc_ring_pop(iotHubClientInstance->send_queue)) != NULL)
+        {
+            (void)atomic_fetch_sub_explicit(&iotHubClientInstance->send_queue_count, 1, memory_order_relaxed);
+            /*the queued message is already a private copy (or was handed over), so the LL layer can take it as is*/
+            IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendEventAsync_Move(iotHubClientInstance->IoTHubClientLLHandle, queued_event->message_handle,
+                (queued_event->queue_context == NULL) ? NULL : iothub_ll_event_confirm_callback, queued_event->queue_context);
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                LogError("IoTHubClientCore_LL_SendEventAsync_Move failed for queued message");
+                if (queued_event->queue_context != NULL)
+                {
+                    iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, queued_event->queue_context);
+                }
+                IoTHubMessage_Destroy(queued_event->message_handle);
+            }
+            free(queued_event);
+        }
+    }
+}
+
+/*hands the message (or a clone of it, unless takeOwnership is set) to the worker without taking LockHandle. Returns false if the ring is full,
+in which case the caller still owns eventMessageHandle.*/
+static bool tryQueueEvent(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE eventMessageHandle, bool takeOwnership, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, IOTHUB_CLIENT_RESULT* result)
+{
+    bool queued = false;
+    QUEUED_EVENT_INFO* queued_event = (QUEUED_EVENT_INFO*)malloc(sizeof(QUEUED_EVENT_INFO));
+
+    if (queued_event == NULL)
+    {
+        LogError("Failed allocating QUEUED_EVENT_INFO");
+        *result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((queued_event->message_handle = (takeOwnership ? eventMessageHandle : IoTHubMessage_Clone(eventMessageHandle))) == NULL)
+    {
+        LogError("IoTHubMessage_Clone failed");
+        free(queued_event);
+        *result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        if (eventConfirmationCallback == NULL)
+        {
+            queued_event->queue_context = NULL;
+        }
+        else if ((queued_event->queue_context = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT))) != NULL)
+        {
+            queued_event->queue_context->iotHubClientHandle = iotHubClientInstance;
+            queued_event->queue_context->userContextCallback = userContextCallback;
+            queued_event->queue_context->callbackFunction.eventConfirmationCallback = eventConfirmationCallback;
+        }
+
+        if (eventConfirmationCallback != NULL && queued_event->queue_context == NULL)
+        {
+            LogError("Failed allocating QUEUE_CONTEXT");
+            *result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            /*counted before the push, so that the worker popping it first cannot take send_queue_count below zero*/
+            (void)atomic_fetch_add_explicit(&iotHubClientInstance->send_queue_count, 1, memory_order_relaxed);
+            if (mpsc_ring_push(iotHubClientInstance->send_queue, queued_event) == 0)
+            {
+                queued = true;
+                *result = IOTHUB_CLIENT_OK;
+            }
+            else
+            {
+                (void)atomic_fetch_sub_explicit(&iotHubClientInstance->send_queue_count, 1, memory_order_relaxed);
+            }
+        }
+
+        if (!queued)
+        {
+            free(queued_event->queue_context);
+            if (!takeOwnership)
+            {
+                IoTHubMessage_Destroy(queued_event->message_handle);
+            }
+            free(queued_event);
+        }
+        else if (iotHubClientInstance->WorkCondition != NULL && !atomic_exchange(&iotHubClientInstance->send_queue_signaled, true))
+        {
+            /*only the first producer since the last drain wakes the worker, the rest find the flag already set. The wake takes
+            WorkLock, not LockHandle, so it does not wait for the DoWork the worker may be running*/
+            signalWorkerThread(iotHubClientInstance);
+        }
+    }
+
+    return queued;
+}
+
 static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
@@ -871,7 +1245,10 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
     garbageCollectorImpl(iotHubClientInstance);
     if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
     {
+        drainSendQueue(iotHubClientInstance);
         VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+        CALLBACK_DISPATCHER* dispatchers = iotHubClientInstance->callback_dispatchers;
+        size_t dispatcher_count = iotHubClientInstance->callback_dispatcher_count;
         (void)Unlock(iotHubClientInstance->LockHandle);
 
         if (call_backs == NULL)
@@ -880,7 +1257,7 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
         }
         else
         {
-            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+            queue_user_callbacks(iotHubClientInstance, dispatchers, dispatcher_count, call_backs);
         }
     }
     else
@@ -889,10 +1266,36 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
     }
 }
 
+/*blocks until new work is signaled or sleeptime_in_ms elapses. Stopping the thread signals it too*/
+static void waitForWork(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, unsigned int sleeptime_in_ms)
+{
+    if (Lock(iotHubClientInstance->WorkLock) != LOCK_OK)
+    {
+        LogError("unable to Lock - sleeping instead");
+        (void)ThreadAPI_Sleep(sleeptime_in_ms);
+    }
+    else
+    {
+        /*messages submitted without a signal (e.g. the signaling producer failed to lock) are not left waiting a whole timeout*/
+        if (!iotHubClientInstance->work_pending &&
+            ((iotHubClientInstance->send_queue == NULL) || (atomic_load_explicit(&iotHubClientInstance->send_queue_count, memory_order_relaxed) == 0)))
+        {
+            COND_RESULT wait_result = Condition_Wait(iotHubClientInstance->WorkCondition, iotHubClientInstance->WorkLock, (int)sleeptime_in_ms);
+            if (wait_result != COND_OK && wait_result != COND_TIMEOUT)
+            {
+                LogError("Condition_Wait failed");
+            }
+        }
+        iotHubClientInstance->work_pending = false;
+        (void)Unlock(iotHubClientInstance->WorkLock);
+    }
+}
+
 static int ScheduleWork_Thread(void* threadArgument)
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)threadArgument;
     unsigned int sleeptime_in_ms = DO_WORK_FREQ_DEFAULT;
+    bool wait_for_work = false;
 
     srand((unsigned int)get_time(NULL));
 
@@ -907,11 +1310,15 @@ static int ScheduleWork_Thread(void* threadArgument)
             }
             else
             {
+                drainSendQueue(iotHubClientInstance);
                 IoTHubClientCore_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
 
                 garbageCollectorImpl(iotHubClientInstance);
                 VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+                CALLBACK_DISPATCHER* dispatchers = iotHubClientInstance->callback_dispatchers;
+                size_t dispatcher_count = iotHubClientInstance->callback_dispatcher_count;
                 sleeptime_in_ms = (unsigned int)iotHubClientInstance->do_work_freq_ms; // Update the sleepval within the locked thread.
+                wait_for_work = iotHubClientInstance->do_work_on_demand;
                 (void)Unlock(iotHubClientInstance->LockHandle);
                 if (call_backs == NULL)
                 {
@@ -919,7 +1326,7 @@ static int ScheduleWork_Thread(void* threadArgument)
                 }
                 else
                 {
-                    dispatch_user_callbacks(iotHubClientInstance, call_backs);
+                    queue_user_callbacks(iotHubClientInstance, dispatchers, dispatcher_count, call_backs);
                 }
 
 
@@ -929,7 +1336,15 @@ static int ScheduleWork_Thread(void* threadArgument)
         {
             /*no code, shall retry*/
         }
-        (void)ThreadAPI_Sleep(sleeptime_in_ms);
+
+        if (wait_for_work)
+        {
+            waitForWork(iotHubClientInstance, sleeptime_in_ms);
+        }
+        else
+        {
+            (void)ThreadAPI_Sleep(sleeptime_in_ms);
+        }
     }
 
     ThreadAPI_Exit(0);
@@ -941,23 +1356,38 @@ static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_CORE_INSTANC
     IOTHUB_CLIENT_RESULT result;
     if (iotHubClientInstance->TransportHandle == NULL)
     {
-        if (iotHubClientInstance->ThreadHandle == NULL)
+        if (atomic_load(&iotHubClientInstance->worker_started))
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*producers submitting without LockHandle can get here concurrently, only one of them may create the thread*/
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
-            iotHubClientInstance->StopThread = 0;
-            if (ThreadAPI_Create(&iotHubClientInstance->ThreadHandle, ScheduleWork_Thread, iotHubClientInstance) != THREADAPI_OK)
+            LogError("unable to Lock");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            if (iotHubClientInstance->ThreadHandle != NULL)
             {
-                LogError("ThreadAPI_Create failed");
-                iotHubClientInstance->ThreadHandle = NULL;
-                result = IOTHUB_CLIENT_ERROR;
+                result = IOTHUB_CLIENT_OK;
             }
             else
             {
-                result = IOTHUB_CLIENT_OK;
+                iotHubClientInstance->StopThread = 0;
+                if (ThreadAPI_Create(&iotHubClientInstance->ThreadHandle, ScheduleWork_Thread, iotHubClientInstance) != THREADAPI_OK)
+                {
+                    LogError("ThreadAPI_Create failed");
+                    iotHubClientInstance->ThreadHandle = NULL;
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    atomic_store(&iotHubClientInstance->worker_started, true);
+                    result = IOTHUB_CLIENT_OK;
+                }
             }
-        }
-        else
-        {
-            result = IOTHUB_CLIENT_OK;
+            (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
     else
@@ -1003,43 +1433,35 @@ static IOTHUB_CLIENT_CORE_INSTANCE* create_iothub_instance(CREATE_HUB_INSTANCE_T
                 {
                     if (transportHandle != NULL)
                     {
-                        result->LockHandle = IoTHubTransport_GetLock(transportHandle);
-                        if (result->LockHandle == NULL)
+                        IOTHUB_CLIENT_DEVICE_CONFIG deviceConfig;
+                        deviceConfig.deviceId = config->deviceId;
+                        deviceConfig.deviceKey = config->deviceKey;
+                        deviceConfig.protocol = config->protocol;
+                        deviceConfig.deviceSasToken = config->deviceSasToken;
+
+                        /*the client registers on, and locks, the lower layer of the transport worker it is bound to*/
+                        if (IoTHubTransport_BindClient(transportHandle, result, &result->LockHandle, &deviceConfig.transportHandle) != IOTHUB_CLIENT_OK)
                         {
-                            LogError("unable to IoTHubTransport_GetLock");
+                            LogError("unable to IoTHubTransport_BindClient");
+                            result->LockHandle = NULL;
                             result->IoTHubClientLLHandle = NULL;
                         }
                         else
                         {
-                            IOTHUB_CLIENT_DEVICE_CONFIG deviceConfig;
-                            deviceConfig.deviceId = config->deviceId;
-                            deviceConfig.deviceKey = config->deviceKey;
-                            deviceConfig.protocol = config->protocol;
-                            deviceConfig.deviceSasToken = config->deviceSasToken;
-
-                            deviceConfig.transportHandle = IoTHubTransport_GetLLTransport(transportHandle);
-                            if (deviceConfig.transportHandle == NULL)
+                            if (Lock(result->LockHandle) != LOCK_OK)
                             {
-                                LogError("unable to IoTHubTransport_GetLLTransport");
+                                LogError("unable to Lock");
                                 result->IoTHubClientLLHandle = NULL;
                             }
                             else
                             {
-                                if (Lock(result->LockHandle) != LOCK_OK)
+                                result->IoTHubClientLLHandle = IoTHubClientCore_LL_CreateWithTransport(&deviceConfig);
+                                result->created_with_transport_handle = 1;
+                                if (Unlock(result->LockHandle) != LOCK_OK)
                                 {
-                                    LogError("unable to Lock");
+                                    LogError("unable to Unlock");
                                     result->IoTHubClientLLHandle = NULL;
                                 }
-                                else
-                                {
-                                    result->IoTHubClientLLHandle = IoTHubClientCore_LL_CreateWithTransport(&deviceConfig);
-                                    result->created_with_transport_handle = 1;
-                                    if (Unlock(result->LockHandle) != LOCK_OK)
-                                    {
-                                        LogError("unable to Unlock");
-                                        result->IoTHubClientLLHandle = NULL;
-                                    }
-                                }
                             }
                         }
                     }
@@ -1111,6 +1533,14 @@ static IOTHUB_CLIENT_CORE_INSTANCE* create_iothub_instance(CREATE_HUB_INSTANCE_T
                     {
                         Lock_Deinit(result->LockHandle);
                     }
+                    else if ((transportHandle != NULL) && (result->LockHandle != NULL))
+                    {
+                        /*releases the transport worker the client was bound to*/
+                        if (IoTHubTransport_SignalEndWorkerThread(transportHandle, result))
+                        {
+                            IoTHubTransport_JoinWorkerThread(transportHandle, result);
+                        }
+                    }
                     singlylinkedlist_destroy(result->httpWorkerThreadInfoList);
                     LogError("Failure creating iothub handle");
                     VECTOR_destroy(result->saved_user_callback_list);
@@ -1120,6 +1550,7 @@ static IOTHUB_CLIENT_CORE_INSTANCE* create_iothub_instance(CREATE_HUB_INSTANCE_T
                 else
                 {
                     result->ThreadHandle = NULL;
+                    atomic_init(&result->worker_started, false);
                     result->desired_state_callback = NULL;
                     result->devicetwin_user_context = NULL;
                     result->connection_status_callback = NULL;
@@ -1246,6 +1677,7 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
         if (iotHubClientInstance->ThreadHandle != NULL)
         {
             iotHubClientInstance->StopThread = 1;
+            signalWorkerThread(iotHubClientInstance);
             joinClientThread = true;
         }
         else
@@ -1272,6 +1704,14 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
             IoTHubTransport_JoinWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
         }
 
+        /*the dispatcher threads drain what they were handed before exiting, while the LL handle is still alive*/
+        if (iotHubClientInstance->callback_dispatchers != NULL)
+        {
+            destroy_callback_dispatchers(iotHubClientInstance->callback_dispatchers, iotHubClientInstance->callback_dispatcher_count);
+            iotHubClientInstance->callback_dispatchers = NULL;
+            iotHubClientInstance->callback_dispatcher_count = 0;
+        }
+
         if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
             LogError("unable to Lock - - will still proceed to try to end the thread without locking");
@@ -1300,6 +1740,8 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
             singlylinkedlist_destroy(iotHubClientInstance->httpWorkerThreadInfoList);
         }
 
+        /*queued messages reach the LL layer so they are reported through its destroy path like any other pending message*/
+        drainSendQueue(iotHubClientInstance);
         IoTHubClientCore_LL_Destroy(iotHubClientInstance->IoTHubClientLLHandle);
 
         if (Unlock(iotHubClientInstance->LockHandle) != LOCK_OK)
@@ -1358,6 +1800,15 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
         {
             Lock_Deinit(iotHubClientInstance->LockHandle);
         }
+        if (iotHubClientInstance->WorkCondition != NULL)
+        {
+            Condition_Deinit(iotHubClientInstance->WorkCondition);
+            Lock_Deinit(iotHubClientInstance->WorkLock);
+        }
+        if (iotHubClientInstance->send_queue != NULL)
+        {
+            mpsc_ring_destroy(iotHubClientInstance->send_queue);
+        }
         if (iotHubClientInstance->devicetwin_user_context != NULL)
         {
             free(iotHubClientInstance->devicetwin_user_context);
@@ -1378,7 +1829,7 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
     }
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static IOTHUB_CLIENT_RESULT sendEventAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, bool takeOwnership, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -1396,6 +1847,15 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
             result = IOTHUB_CLIENT_ERROR;
             LogError("Could not start worker thread");
         }
+        else if (eventMessageHandle != NULL && iotHubClientInstance->send_queue != NULL && iotHubClientInstance->created_with_transport_handle == 0 &&
+            tryQueueEvent(iotHubClientInstance, eventMessageHandle, takeOwnership, eventConfirmationCallback, userContextCallback, &result))
+        {
+            /*queued without locking, the worker submits it on its next pass*/
+        }
+        else if (result != IOTHUB_CLIENT_OK)
+        {
+            LogError("Could not queue message");
+        }
         else
         {
             if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
@@ -1405,9 +1865,12 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
             }
             else
             {
+                /*messages already in the ring were submitted first and must reach the LL client ahead of this one*/
+                drainSendQueue(iotHubClientInstance);
+
                 if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
                 {
-                    result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+                    result = (takeOwnership ? IoTHubClientCore_LL_SendEventAsync_Move : IoTHubClientCore_LL_SendEventAsync)(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
                 }
                 else
                 {
@@ -1422,7 +1885,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
                         queue_context->iotHubClientHandle = iotHubClientInstance;
                         queue_context->userContextCallback = userContextCallback;
                         queue_context->callbackFunction.eventConfirmationCallback = eventConfirmationCallback;
-                        result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
+                        result = (takeOwnership ? IoTHubClientCore_LL_SendEventAsync_Move : IoTHubClientCore_LL_SendEventAsync)(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
                         if (result != IOTHUB_CLIENT_OK)
                         {
                             LogError("IoTHubClientCore_LL_SendEventAsync failed");
@@ -1431,6 +1894,11 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
                     }
                 }
 
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signalWorkerThread(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1439,6 +1907,93 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return sendEventAsync(iotHubClientHandle, eventMessageHandle, false, eventConfirmationCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync_Move(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return sendEventAsync(iotHubClientHandle, eventMessageHandle, true, eventConfirmationCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventBatchAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION confirmationMode, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not start worker thread");
+        }
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*messages still in send_queue were submitted earlier and go first*/
+            drainSendQueue(iotHubClientInstance);
+
+            if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
+            {
+                result = IoTHubClientCore_LL_SendEventBatchAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, confirmationMode, eventConfirmationCallback, userContextCallback);
+            }
+            else
+            {
+                /*the aggregate confirmation arrives once, so a plain queue context does; per message confirmations share a counted one*/
+                size_t context_size = (confirmationMode == IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE) ? sizeof(IOTHUB_BATCH_QUEUE_CONTEXT) : sizeof(IOTHUB_QUEUE_CONTEXT);
+                IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)malloc(context_size);
+                if (queue_context == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Failed allocating QUEUE_CONTEXT");
+                }
+                else
+                {
+                    queue_context->iotHubClientHandle = iotHubClientInstance;
+                    queue_context->userContextCallback = userContextCallback;
+                    queue_context->callbackFunction.eventConfirmationCallback = eventConfirmationCallback;
+                    if (confirmationMode == IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE)
+                    {
+                        ((IOTHUB_BATCH_QUEUE_CONTEXT*)queue_context)->pending_confirmations = eventMessageCount;
+                        result = IoTHubClientCore_LL_SendEventBatchAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, confirmationMode, iothub_ll_event_batch_confirm_callback, queue_context);
+                    }
+                    else
+                    {
+                        result = IoTHubClientCore_LL_SendEventBatchAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, confirmationMode, iothub_ll_event_confirm_callback, queue_context);
+                    }
+
+                    if (result != IOTHUB_CLIENT_OK)
+                    {
+                        LogError("IoTHubClientCore_LL_SendEventBatchAsync failed");
+                        free(queue_context);
+                    }
+                }
+            }
+
+            if (result == IOTHUB_CLIENT_OK)
+            {
+                signalWorkerThread(iotHubClientInstance);
+            }
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_GetSendStatus(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1468,6 +2023,31 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_GetSendStatus(IOTHUB_CLIENT_CORE_HANDLE io
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_GetMetrics(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_METRICS* metrics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || metrics == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("Invalid argument (iotHubClientHandle=%p, metrics=%p)", iotHubClientHandle, metrics);
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        /*no LockHandle: the LL counters are relaxed atomics, so the snapshot never waits for the worker's DoWork*/
+        result = IoTHubClientCore_LL_GetMetrics(iotHubClientInstance->IoTHubClientLLHandle, metrics);
+        if (result == IOTHUB_CLIENT_OK && iotHubClientInstance->send_queue != NULL)
+        {
+            /*messages still in the submission ring count as waiting to send*/
+            metrics->waiting_to_send += atomic_load_explicit(&iotHubClientInstance->send_queue_count, memory_order_relaxed);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_SetMessageCallback(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1758,6 +2338,86 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetOption(IOTHUB_CLIENT_CORE_HANDLE iotHub
                     LogError("Invalid value: OPTION_DO_WORK_FREQUENCY_IN_MS cannot exceed %d ms. If you wish to reduce the frequency further, consider using the LL layer.", DO_WORK_MAXIMUM_ALLOWED_FREQUENCY);
                 }
             }
+            else if (strcmp(OPTION_DO_WORK_WAKE_ON_DEMAND, optionName) == 0)
+            {
+                if (iotHubClientInstance->TransportHandle != NULL)
+                {
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("Invalid option: OPTION_DO_WORK_WAKE_ON_DEMAND is not supported when sharing a transport handle.");
+                }
+                else if (*(bool*)value && iotHubClientInstance->WorkCondition == NULL && (iotHubClientInstance->WorkLock = Lock_Init()) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Lock_Init failed");
+                }
+                else if (*(bool*)value && iotHubClientInstance->WorkCondition == NULL && (iotHubClientInstance->WorkCondition = Condition_Init()) == NULL)
+                {
+                    Lock_Deinit(iotHubClientInstance->WorkLock);
+                    iotHubClientInstance->WorkLock = NULL;
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Condition_Init failed");
+                }
+                else
+                {
+                    iotHubClientInstance->do_work_on_demand = *(bool*)value;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else if (strcmp(OPTION_CALLBACK_DISPATCH_THREAD_COUNT, optionName) == 0)
+            {
+                size_t thread_count = *(size_t*)value;
+                if (thread_count > USER_CALLBACK_TYPE_COUNT)
+                {
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("Invalid value: OPTION_CALLBACK_DISPATCH_THREAD_COUNT cannot exceed %d, the number of callback types.", USER_CALLBACK_TYPE_COUNT);
+                }
+                else if (iotHubClientInstance->callback_dispatchers != NULL)
+                {
+                    result = (thread_count == iotHubClientInstance->callback_dispatcher_count) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_INVALID_ARG;
+                    if (result != IOTHUB_CLIENT_OK)
+                    {
+                        LogError("Invalid value: OPTION_CALLBACK_DISPATCH_THREAD_COUNT can only be set once.");
+                    }
+                }
+                else if (thread_count == 0)
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+                else if ((iotHubClientInstance->callback_dispatchers = create_callback_dispatchers(iotHubClientInstance, thread_count)) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("failure creating callback dispatch threads");
+                }
+                else
+                {
+                    iotHubClientInstance->callback_dispatcher_count = thread_count;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else if (strcmp(OPTION_SEND_QUEUE_RING_SIZE, optionName) == 0)
+            {
+                size_t ring_size = *(size_t*)value;
+                if (iotHubClientInstance->send_queue != NULL || iotHubClientInstance->created_with_transport_handle != 0)
+                {
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("Invalid option: OPTION_SEND_QUEUE_RING_SIZE can only be set once and not with a shared transport handle.");
+                }
+                else if (ring_size == 0)
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+                else if ((iotHubClientInstance->send_queue = mpsc_ring_create(ring_size)) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("mpsc_ring_create failed");
+                }
+                else
+                {
+                    atomic_init(&iotHubClientInstance->send_queue_signaled, false);
+                    atomic_init(&iotHubClientInstance->send_queue_count, 0);
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
             else if (strcmp(OPTION_MESSAGE_TIMEOUT, optionName) == 0)
             {
                 iotHubClientInstance->currentMessageTimeout = * (tickcounter_ms_t *)value;
@@ -1913,6 +2573,11 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendReportedState(IOTHUB_CLIENT_CORE_HANDL
                     }
                 }
 
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signalWorkerThread(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1920,6 +2585,72 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendReportedState(IOTHUB_CLIENT_CORE_HANDL
     return result;
 }
 
+typedef struct CACHED_TWIN_COPY_TAG
+{
+    unsigned char* document;
+    size_t size;
+} CACHED_TWIN_COPY;
+
+/*copies the cached twin, which is passed to the application once the lock is released*/
+static void copy_cached_twin(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+    CACHED_TWIN_COPY* copy = (CACHED_TWIN_COPY*)userContextCallback;
+    (void)update_state;
+
+    if ((copy->document = (unsigned char*)malloc(size)) == NULL)
+    {
+        LogError("Failed copying the cached twin");
+    }
+    else
+    {
+        (void)memcpy(copy->document, payLoad, size);
+        copy->size = size;
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_GetCachedTwin(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || deviceTwinCallback == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("Invalid argument (iotHubClientHandle=%p, deviceTwinCallback=%p)", iotHubClientHandle, deviceTwinCallback);
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+        CACHED_TWIN_COPY copy = { NULL, 0 };
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            result = IoTHubClientCore_LL_GetCachedTwin(iotHubClientInstance->IoTHubClientLLHandle, copy_cached_twin, &copy);
+            (void)Unlock(iotHubClientInstance->LockHandle);
+
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                LogError("IoTHubClientCore_LL_GetCachedTwin failed");
+            }
+            else if (copy.document == NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                deviceTwinCallback(DEVICE_TWIN_UPDATE_COMPLETE, copy.document, copy.size, userContextCallback);
+                free(copy.document);
+            }
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_GetTwinAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1968,6 +2699,10 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_GetTwinAsync(IOTHUB_CLIENT_CORE_HANDLE iot
                         LogError("IoTHubClientCore_LL_GetTwinAsync failed");
                         free(queueContext);
                     }
+                    else
+                    {
+                        signalWorkerThread(iotHubClientInstance);
+                    }
 
                     (void)Unlock(iotHubClientInstance->LockHandle);
                 }
@@ -2213,6 +2948,10 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_DeviceMethodResponse(IOTHUB_CLIENT_CORE_HA
             {
                 LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
             }
+            else
+            {
+                signalWorkerThread(iotHubClientInstance);
+            }
             (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
@@ -2687,6 +3426,10 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendMessageDisposition(IOTHUB_CLIENT_CORE_
             else
             {
                 result = IoTHubClientCore_LL_SendMessageDisposition(iotHubClientInstance->IoTHubClientLLHandle, message, disposition);
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signalWorkerThread(iotHubClientInstance);
+                }
 
                 (void)Unlock(iotHubClientInstance->LockHandle);
 
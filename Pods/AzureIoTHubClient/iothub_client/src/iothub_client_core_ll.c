@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <errno.h>
 
@@ -12,6 +13,7 @@
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/timer_wheel.h"
 #include "azure_c_shared_utility/constbuffer.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
@@ -25,6 +27,10 @@
 #include "internal/iothub_client_authorization.h"
 #include "internal/iothub_client_private.h"
 #include "internal/iothub_client_diagnostic.h"
+#include "internal/iothub_client_payload_codec_private.h"
+#include "internal/iothub_client_metrics.h"
+#include "internal/iothub_client_telemetry_journal.h"
+#include "internal/iothub_client_twin_cache.h"
 #include "internal/iothubtransport.h"
 
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -40,6 +46,10 @@
 #define LOG_ERROR_RESULT LogError("result = %s", MU_ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
 #define INDEFINITE_TIME ((time_t)(-1))
 #define ERROR_CODE_BECAUSE_DESTROY 0
+#define MESSAGE_TIMEOUT_RESOLUTION_MS 1
+#define POLL_INTERVAL_WITHOUT_TRANSPORT_SUPPORT_MS 100
+#define DEFAULT_PAYLOAD_CODEC_MIN_SIZE 256
+#define DEFAULT_TELEMETRY_JOURNAL_WINDOW 16
 
 
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUB_CLIENT_FILE_UPLOAD_RESULT, IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES);
@@ -102,8 +112,26 @@ typedef struct GET_TWIN_CONTEXT_TAG
 {
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK callback;
     void* context;
+    struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* handleData;
 } GET_TWIN_CONTEXT;
 
+/*shared by all messages of a batch confirmed with IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE*/
+typedef struct IOTHUB_EVENT_BATCH_TAG
+{
+    size_t pending_confirmations;
+    IOTHUB_CLIENT_CONFIRMATION_RESULT result; /*first failure, or IOTHUB_CLIENT_CONFIRMATION_OK*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    void* userContextCallback;
+} IOTHUB_EVENT_BATCH;
+
+/*confirmation callback of a journaled message that is not in memory yet*/
+typedef struct IOTHUB_JOURNAL_CALLBACK_TAG
+{
+    uint64_t record_id;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+} IOTHUB_JOURNAL_CALLBACK;
+
 typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
 {
     DLIST_ENTRY waitingToSend;
@@ -119,6 +147,8 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
     void* conStatusUserContextCallback;
     time_t lastMessageReceiveTime;
     TICK_COUNTER_HANDLE tickCounter; /*shared tickcounter used to track message timeouts in waitingToSend list*/
+    TIMER_WHEEL_HANDLE messageTimeouts; /*deadlines of the messages in waitingToSend, created with the first message that has a timeout*/
+    IOTHUB_CLIENT_METRICS_HANDLE metrics; /*counters shared with the transport, see IoTHubClientCore_LL_GetMetrics*/
     tickcounter_ms_t currentMessageTimeout;
     uint64_t current_device_twin_timeout;
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback;
@@ -136,8 +166,16 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
     STRING_HANDLE product_info;
     IOTHUB_DIAGNOSTIC_SETTING_DATA diagnostic_setting;
+    IOTHUB_PAYLOAD_CODEC_SETTING_DATA payload_codec_setting;
     SINGLYLINKEDLIST_HANDLE event_callbacks;  // List of IOTHUB_EVENT_CALLBACK's
     STRING_HANDLE model_id;
+    TELEMETRY_JOURNAL_HANDLE telemetry_journal; /*NULL unless OPTION_TELEMETRY_JOURNAL_DIRECTORY is set*/
+    size_t telemetry_journal_window; /*journaled messages kept in memory at most*/
+    size_t telemetry_journal_in_memory;
+    SINGLYLINKEDLIST_HANDLE journal_callbacks; /*IOTHUB_JOURNAL_CALLBACK's of the journaled messages still on disk only, oldest first*/
+    TWIN_CACHE_HANDLE twin_cache; /*NULL unless OPTION_TWIN_CACHE is set*/
+    bool twin_cache_refresh_needed; /*the cache missed a patch, DoWork requests the full twin*/
+    bool twin_cache_refresh_pending;
 }IOTHUB_CLIENT_CORE_LL_HANDLE_DATA;
 
 static const char HOSTNAME_TOKEN[] = "HostName";
@@ -303,6 +341,7 @@ static void setTransportProtocol(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData,
     handleData->IoTHubTransport_Unsubscribe_InputQueue = protocol->IoTHubTransport_Unsubscribe_InputQueue;
     handleData->IoTHubTransport_SetCallbackContext = protocol->IoTHubTransport_SetCallbackContext;
     handleData->IoTHubTransport_GetSupportedPlatformInfo = protocol->IoTHubTransport_GetSupportedPlatformInfo;
+    handleData->IoTHubTransport_GetPollInfo = protocol->IoTHubTransport_GetPollInfo;
 }
 
 static bool is_event_equal(IOTHUB_EVENT_CALLBACK *event_callback, const char *input_name)
@@ -494,6 +533,27 @@ static STRING_HANDLE make_product_info(const char* product, PLATFORM_INFO_OPTION
     return result;
 }
 
+/*confirms and frees an event, acknowledging its journal record unless the client is being destroyed, so that the
+message is replayed by the next client using the journal*/
+static void complete_event_entry(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    if (messageList->journal_record_id != 0)
+    {
+        handleData->telemetry_journal_in_memory--;
+        if (result != IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY &&
+            iothub_client_telemetry_journal_acknowledge(handleData->telemetry_journal, messageList->journal_record_id) != 0)
+        {
+            LogError("unable to acknowledge telemetry journal record %" PRIu64, messageList->journal_record_id);
+        }
+    }
+    if (messageList->callback != NULL)
+    {
+        messageList->callback(result, messageList->context);
+    }
+    IoTHubMessage_Destroy(messageList->messageHandle);
+    free(messageList);
+}
+
 static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* ctx)
 {
     if (
@@ -510,12 +570,50 @@ static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIE
         while ((oldest = DList_RemoveHeadList(completed)) != completed)
         {
             IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
-            if (messageList->callback != NULL)
-            {
-                messageList->callback(result, messageList->context);
-            }
-            IoTHubMessage_Destroy(messageList->messageHandle);
-            free(messageList);
+            timer_wheel_cancel(&messageList->timeout_entry);
+            complete_event_entry((IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx, messageList, result);
+        }
+    }
+}
+
+static void update_twin_cache(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size)
+{
+    bool refresh_needed;
+
+    if (handleData->twin_cache == NULL || payLoad == NULL)
+    {
+        /*no cache, or a failed twin request*/
+    }
+    else
+    {
+        if (iothub_client_twin_cache_update(handleData->twin_cache, update_state, payLoad, size, &refresh_needed) != 0)
+        {
+            LogError("unable to update the twin cache");
+        }
+        if (refresh_needed)
+        {
+            handleData->twin_cache_refresh_needed = true;
+        }
+    }
+}
+
+/*full twin requested by DoWork after the twin cache missed a patch; the application, which missed it too, gets the document*/
+static void on_twin_cache_refreshed(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)userContextCallback;
+
+    handleData->twin_cache_refresh_pending = false;
+    if (payLoad == NULL)
+    {
+        LogError("unable to get the twin for the twin cache, retrying");
+        handleData->twin_cache_refresh_needed = true;
+    }
+    else
+    {
+        update_twin_cache(handleData, update_state, payLoad, size);
+        if (handleData->deviceTwinCallback != NULL && handleData->complete_twin_update_encountered)
+        {
+            handleData->deviceTwinCallback(DEVICE_TWIN_UPDATE_COMPLETE, payLoad, size, handleData->deviceTwinContextCallback);
         }
     }
 }
@@ -529,6 +627,7 @@ static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STAT
     else
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        update_twin_cache(handleData, update_state, payLoad, size);
         if (handleData->deviceTwinCallback)
         {
             if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
@@ -625,6 +724,22 @@ static const char* IoTHubClientCore_LL_GetModelId(void* ctx)
     return result;
 }
 
+static IOTHUB_CLIENT_METRICS_HANDLE IoTHubClientCore_LL_GetMetricsHandle(void* ctx)
+{
+    IOTHUB_CLIENT_METRICS_HANDLE result;
+    if (ctx == NULL)
+    {
+        result = NULL;
+        LogError("invalid argument ctx %p", ctx);
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* iothub_data = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        result = iothub_data->metrics;
+    }
+    return result;
+}
+
 static bool IoTHubClientCore_LL_MessageCallbackFromInput(IOTHUB_MESSAGE_HANDLE messageHandle, void* ctx)
 {
     bool result;
@@ -912,6 +1027,7 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
             transport_cb.msg_cb = IoTHubClientCore_LL_MessageCallback;
             transport_cb.method_complete_cb = IoTHubClientCore_LL_DeviceMethodComplete;
             transport_cb.get_model_id_cb = IoTHubClientCore_LL_GetModelId;
+            transport_cb.get_metrics_cb = IoTHubClientCore_LL_GetMetricsHandle;
 
             if (client_config != NULL)
             {
@@ -1055,6 +1171,20 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
                     free(result);
                     result = NULL;
                 }
+                else if ((result->metrics = iothub_client_metrics_create()) == NULL)
+                {
+                    LogError("unable to create the client metrics");
+                    if (!result->isSharedTransport)
+                    {
+                        result->IoTHubTransport_Destroy(result->transportHandle);
+                    }
+                    tickcounter_destroy(result->tickCounter);
+                    destroy_blob_upload_module(result);
+                    destroy_module_method_module(result);
+                    IoTHubClient_Auth_Destroy(result->authorization_module);
+                    free(result);
+                    result = NULL;
+                }
                 // Add extended info to product info if required
                 else if (result->IoTHubTransport_GetSupportedPlatformInfo(result->transportHandle, &supportedPlatformInfo) != 0)
                 {
@@ -1064,6 +1194,7 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
                         result->IoTHubTransport_Destroy(result->transportHandle);
                     }
                     tickcounter_destroy(result->tickCounter);
+                    iothub_client_metrics_destroy(result->metrics);
                     destroy_blob_upload_module(result);
                     destroy_module_method_module(result);
                     IoTHubClient_Auth_Destroy(result->authorization_module);
@@ -1078,6 +1209,7 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
                         result->IoTHubTransport_Destroy(result->transportHandle);
                     }
                     tickcounter_destroy(result->tickCounter);
+                    iothub_client_metrics_destroy(result->metrics);
                     destroy_blob_upload_module(result);
                     destroy_module_method_module(result);
                     IoTHubClient_Auth_Destroy(result->authorization_module);
@@ -1112,6 +1244,7 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
                         destroy_blob_upload_module(result);
                         destroy_module_method_module(result);
                         tickcounter_destroy(result->tickCounter);
+                        iothub_client_metrics_destroy(result->metrics);
                         STRING_delete(result->product_info);
                         free(result);
                         result = NULL;
@@ -1123,6 +1256,9 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
 
                         result->diagnostic_setting.currentMessageNumber = 0;
                         result->diagnostic_setting.diagSamplingPercentage = 0;
+                        result->payload_codec_setting.codec = NULL;
+                        result->payload_codec_setting.minPayloadSize = DEFAULT_PAYLOAD_CODEC_MIN_SIZE;
+                        result->telemetry_journal_window = DEFAULT_TELEMETRY_JOURNAL_WINDOW;
                         if (IoTHubClientCore_LL_SetRetryPolicy(result, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 0) != IOTHUB_CLIENT_OK)
                         {
                             LogError("Setting default retry policy in transport failed");
@@ -1135,6 +1271,7 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
                             destroy_blob_upload_module(result);
                             destroy_module_method_module(result);
                             tickcounter_destroy(result->tickCounter);
+                            iothub_client_metrics_destroy(result->metrics);
                             STRING_delete(result->product_info);
                             free(result);
                             result = NULL;
@@ -1206,6 +1343,7 @@ static void on_get_device_twin_completed(DEVICE_TWIN_UPDATE_STATE update_state,
     else
     {
         GET_TWIN_CONTEXT* getTwinCtx = (GET_TWIN_CONTEXT*)userContextCallback;
+        update_twin_cache(getTwinCtx->handleData, update_state, payLoad, size);
         getTwinCtx->callback(update_state, payLoad, size, getTwinCtx->context);
         free(getTwinCtx);
     }
@@ -1756,13 +1894,26 @@ void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle
         while ((unsend = DList_RemoveHeadList(&(handleData->waitingToSend))) != &(handleData->waitingToSend))
         {
             IOTHUB_MESSAGE_LIST* temp = containingRecord(unsend, IOTHUB_MESSAGE_LIST, entry);
-            if (temp->callback != NULL)
+            timer_wheel_cancel(&temp->timeout_entry);
+            iothub_client_metrics_subtract(handleData->metrics, IOTHUB_CLIENT_METRICS_WAITING_TO_SEND, 1);
+            complete_event_entry(handleData, temp, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+        }
+
+        if (handleData->journal_callbacks != NULL)
+        {
+            /*the messages stay in the journal, to be sent by the next client using it*/
+            LIST_ITEM_HANDLE item;
+            while ((item = singlylinkedlist_get_head_item(handleData->journal_callbacks)) != NULL)
             {
-                temp->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, temp->context);
+                IOTHUB_JOURNAL_CALLBACK* journal_callback = (IOTHUB_JOURNAL_CALLBACK*)singlylinkedlist_item_get_value(item);
+                journal_callback->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, journal_callback->context);
+                free(journal_callback);
+                (void)singlylinkedlist_remove(handleData->journal_callbacks, item);
             }
-            IoTHubMessage_Destroy(temp->messageHandle);
-            free(temp);
+            singlylinkedlist_destroy(handleData->journal_callbacks);
         }
+        iothub_client_telemetry_journal_destroy(handleData->telemetry_journal);
+        iothub_client_twin_cache_destroy(handleData->twin_cache);
 
         while ((unsend = DList_RemoveHeadList(&(handleData->iot_msg_queue))) != &(handleData->iot_msg_queue))
         {
@@ -1796,7 +1947,9 @@ void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle
         delete_event_callback_list(handleData);
 
         IoTHubClient_Auth_Destroy(handleData->authorization_module);
+        timer_wheel_destroy(handleData->messageTimeouts);
         tickcounter_destroy(handleData->tickCounter);
+        iothub_client_metrics_destroy(handleData->metrics);
 #ifndef DONT_USE_UPLOADTOBLOB
         IoTHubClient_LL_UploadToBlob_Destroy(handleData->uploadToBlobHandle);
 #endif
@@ -1813,6 +1966,7 @@ void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle
 static int attach_ms_timesOutAfter(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST *newEntry)
 {
     int result;
+    timer_wheel_entry_init(&newEntry->timeout_entry);
     if (handleData->currentMessageTimeout == 0)
     {
         newEntry->ms_timesOutAfter = 0; /*do not timeout*/
@@ -1826,6 +1980,12 @@ static int attach_ms_timesOutAfter(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData
             result = MU_FAILURE;
             LogError("unable to get the current relative tickcount");
         }
+        else if (handleData->messageTimeouts == NULL &&
+            (handleData->messageTimeouts = timer_wheel_create(MESSAGE_TIMEOUT_RESOLUTION_MS, newEntry->ms_timesOutAfter)) == NULL)
+        {
+            result = MU_FAILURE;
+            LogError("unable to create the message timeout wheel");
+        }
         else
         {
             newEntry->message_timeout_value = handleData->currentMessageTimeout;
@@ -1835,7 +1995,237 @@ static int attach_ms_timesOutAfter(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+/*allocates the waitingToSend entry for a clone of eventMessageHandle, or for eventMessageHandle itself if takeOwnership is set
+(in which case it is left to the caller on failure); the entry is not linked anywhere yet*/
+static IOTHUB_MESSAGE_LIST* create_event_entry(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, bool takeOwnership, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_MESSAGE_LIST *newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
+    if (newEntry == NULL)
+    {
+        LogError("unable to allocate IOTHUB_MESSAGE_LIST");
+    }
+    else if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+    {
+        LogError("unable to attach the message timeout");
+        free(newEntry);
+        newEntry = NULL;
+    }
+    else if ((newEntry->messageHandle = (takeOwnership ? eventMessageHandle : IoTHubMessage_Clone(eventMessageHandle))) == NULL)
+    {
+        LogError("unable to clone the message");
+        free(newEntry);
+        newEntry = NULL;
+    }
+    else if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, newEntry->messageHandle) != 0)
+    {
+        LogError("unable to add diagnostic data to the message");
+        if (!takeOwnership)
+        {
+            IoTHubMessage_Destroy(newEntry->messageHandle);
+        }
+        free(newEntry);
+        newEntry = NULL;
+    }
+    else if (IoTHubClient_PayloadCodec_EncodeIfNecessary(&handleData->payload_codec_setting, newEntry->messageHandle) != 0)
+    {
+        LogError("unable to encode the message payload");
+        if (!takeOwnership)
+        {
+            IoTHubMessage_Destroy(newEntry->messageHandle);
+        }
+        free(newEntry);
+        newEntry = NULL;
+    }
+    else
+    {
+        newEntry->callback = eventConfirmationCallback;
+        newEntry->context = userContextCallback;
+        newEntry->journal_record_id = 0;
+    }
+    return newEntry;
+}
+
+/*to be called once newEntry is in waitingToSend: counts it in IOTHUB_CLIENT_METRICS_WAITING_TO_SEND, which whoever takes it
+out again (the client or the transport) decrements, and arms its timeout*/
+static void event_entry_queued(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry)
+{
+    iothub_client_metrics_add(handleData->metrics, IOTHUB_CLIENT_METRICS_WAITING_TO_SEND, 1);
+    if (newEntry->ms_timesOutAfter != 0)
+    {
+        /*the message times out once more than message_timeout_value ms have elapsed*/
+        (void)timer_wheel_schedule(handleData->messageTimeouts, &newEntry->timeout_entry, newEntry->ms_timesOutAfter + newEntry->message_timeout_value + 1);
+    }
+}
+
+/*appends newEntry to the telemetry journal; it is queued right away while fewer than telemetry_journal_window journaled
+messages are in memory, otherwise it is freed and its message reloaded by load_journaled_events once there is room*/
+static IOTHUB_CLIENT_RESULT journal_event_entry(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    uint64_t record_id;
+    bool handed_out;
+
+    if (iothub_client_telemetry_journal_append(handleData->telemetry_journal, newEntry->messageHandle,
+        handleData->telemetry_journal_in_memory < handleData->telemetry_journal_window, &record_id, &handed_out) != 0)
+    {
+        LogError("unable to append the message to the telemetry journal");
+        if (!takeOwnership)
+        {
+            IoTHubMessage_Destroy(newEntry->messageHandle);
+        }
+        free(newEntry);
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if (handed_out)
+    {
+        newEntry->journal_record_id = record_id;
+        DList_InsertTailList(&(handleData->waitingToSend), &(newEntry->entry));
+        event_entry_queued(handleData, newEntry);
+        handleData->telemetry_journal_in_memory++;
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        /*the journal has the message now; only the confirmation callback waits in memory*/
+        IOTHUB_JOURNAL_CALLBACK* journal_callback = NULL;
+        if (newEntry->callback == NULL)
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if ((handleData->journal_callbacks == NULL) && ((handleData->journal_callbacks = singlylinkedlist_create()) == NULL))
+        {
+            LogError("unable to create the journal callback list");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((journal_callback = (IOTHUB_JOURNAL_CALLBACK*)malloc(sizeof(IOTHUB_JOURNAL_CALLBACK))) == NULL)
+        {
+            LogError("unable to allocate IOTHUB_JOURNAL_CALLBACK");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            journal_callback->record_id = record_id;
+            journal_callback->callback = newEntry->callback;
+            journal_callback->context = newEntry->context;
+            if (singlylinkedlist_add(handleData->journal_callbacks, journal_callback) == NULL)
+            {
+                LogError("unable to add the journal callback");
+                free(journal_callback);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            /*the caller is told the send failed, so the record must not be sent either*/
+            (void)iothub_client_telemetry_journal_acknowledge(handleData->telemetry_journal, record_id);
+            if (!takeOwnership)
+            {
+                IoTHubMessage_Destroy(newEntry->messageHandle);
+            }
+        }
+        else
+        {
+            IoTHubMessage_Destroy(newEntry->messageHandle);
+        }
+        free(newEntry);
+    }
+    return result;
+}
+
+/*fails the callbacks of records older than record_id: the journal has passed them without handing them out, because
+they could not be read back, so nothing else would ever remove them from journal_callbacks*/
+static void fail_dropped_journal_callbacks(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, uint64_t record_id)
+{
+    LIST_ITEM_HANDLE head;
+
+    while ((handleData->journal_callbacks != NULL) && ((head = singlylinkedlist_get_head_item(handleData->journal_callbacks)) != NULL))
+    {
+        IOTHUB_JOURNAL_CALLBACK* journal_callback = (IOTHUB_JOURNAL_CALLBACK*)singlylinkedlist_item_get_value(head);
+        if (journal_callback->record_id >= record_id)
+        {
+            break;
+        }
+        (void)singlylinkedlist_remove(handleData->journal_callbacks, head);
+        journal_callback->callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, journal_callback->context);
+        free(journal_callback);
+    }
+}
+
+/*moves journaled messages back into waitingToSend, oldest first, while there is room in the telemetry journal window*/
+static void load_journaled_events(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    while (handleData->telemetry_journal_in_memory < handleData->telemetry_journal_window)
+    {
+        uint64_t record_id;
+        IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback = NULL;
+        void* context = NULL;
+        IOTHUB_MESSAGE_LIST* newEntry;
+        IOTHUB_MESSAGE_HANDLE messageHandle = iothub_client_telemetry_journal_load_next(handleData->telemetry_journal, &record_id);
+        if (messageHandle == NULL)
+        {
+            if (iothub_client_telemetry_journal_is_caught_up(handleData->telemetry_journal))
+            {
+                /*every record has been handed out, so any callback left belongs to a dropped record*/
+                fail_dropped_journal_callbacks(handleData, UINT64_MAX);
+            }
+            break;
+        }
+
+        fail_dropped_journal_callbacks(handleData, record_id);
+
+        /*records replayed from an earlier client have no callback*/
+        if (handleData->journal_callbacks != NULL)
+        {
+            LIST_ITEM_HANDLE head = singlylinkedlist_get_head_item(handleData->journal_callbacks);
+            IOTHUB_JOURNAL_CALLBACK* journal_callback = (head == NULL) ? NULL : (IOTHUB_JOURNAL_CALLBACK*)singlylinkedlist_item_get_value(head);
+            if ((journal_callback != NULL) && (journal_callback->record_id == record_id))
+            {
+                callback = journal_callback->callback;
+                context = journal_callback->context;
+                free(journal_callback);
+                (void)singlylinkedlist_remove(handleData->journal_callbacks, head);
+            }
+        }
+
+        if ((newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST))) == NULL)
+        {
+            LogError("unable to allocate IOTHUB_MESSAGE_LIST");
+        }
+        else if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+        {
+            LogError("unable to attach the message timeout");
+            free(newEntry);
+            newEntry = NULL;
+        }
+
+        if (newEntry == NULL)
+        {
+            LogError("dropping telemetry journal record %" PRIu64, record_id);
+            IoTHubMessage_Destroy(messageHandle);
+            (void)iothub_client_telemetry_journal_acknowledge(handleData->telemetry_journal, record_id);
+            if (callback != NULL)
+            {
+                callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, context);
+            }
+            break;
+        }
+
+        newEntry->messageHandle = messageHandle;
+        newEntry->callback = callback;
+        newEntry->context = context;
+        newEntry->journal_record_id = record_id;
+        DList_InsertTailList(&(handleData->waitingToSend), &(newEntry->entry));
+        event_entry_queued(handleData, newEntry);
+        handleData->telemetry_journal_in_memory++;
+    }
+}
+
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, bool takeOwnership, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
     if (
@@ -1849,44 +2239,150 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HA
     }
     else
     {
-        IOTHUB_MESSAGE_LIST *newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        IOTHUB_MESSAGE_LIST *newEntry = create_event_entry(handleData, eventMessageHandle, takeOwnership, eventConfirmationCallback, userContextCallback);
         if (newEntry == NULL)
         {
             result = IOTHUB_CLIENT_ERROR;
             LOG_ERROR_RESULT;
         }
+        else if (handleData->telemetry_journal != NULL)
+        {
+            result = journal_event_entry(handleData, newEntry, takeOwnership);
+        }
+        else
+        {
+            DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
+            event_entry_queued(handleData, newEntry);
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, false, eventConfirmationCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync_Move(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, true, eventConfirmationCallback, userContextCallback);
+}
+
+/*confirms every message of an IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE batch; the last one reports to the application*/
+static void on_batch_event_confirmed(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    IOTHUB_EVENT_BATCH* batch = (IOTHUB_EVENT_BATCH*)userContextCallback;
+
+    if (result != IOTHUB_CLIENT_CONFIRMATION_OK && batch->result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        batch->result = result;
+    }
+
+    if (--batch->pending_confirmations == 0)
+    {
+        batch->eventConfirmationCallback(batch->result, batch->userContextCallback);
+        free(batch);
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventBatchAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_BATCH_CONFIRMATION confirmationMode, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    size_t index = 0;
+
+    if ((iotHubClientHandle != NULL) && (eventMessageHandles != NULL))
+    {
+        while ((index < eventMessageCount) && (eventMessageHandles[index] != NULL))
+        {
+            index++;
+        }
+    }
+
+    if (
+        (iotHubClientHandle == NULL) ||
+        (eventMessageHandles == NULL) ||
+        (eventMessageCount == 0) ||
+        (index != eventMessageCount) ||
+        ((confirmationMode != IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE) && (confirmationMode != IOTHUB_CLIENT_BATCH_CONFIRMATION_PER_MESSAGE)) ||
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
+        )
+    {
+        LogError("Invalid argument (iotHubClientHandle=%p, eventMessageHandles=%p, eventMessageCount=%lu, NULL message at %lu)",
+            iotHubClientHandle, eventMessageHandles, (unsigned long)eventMessageCount, (unsigned long)index);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        IOTHUB_EVENT_BATCH* batch = NULL;
+        IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK entryCallback = eventConfirmationCallback;
+        void* entryContext = userContextCallback;
+
+        if (handleData->telemetry_journal != NULL)
+        {
+            /*records already appended cannot be taken back, so a batch failing part way could not leave waitingToSend and the journal untouched*/
+            LogError("batches cannot be sent while the telemetry journal is enabled");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((confirmationMode == IOTHUB_CLIENT_BATCH_CONFIRMATION_AGGREGATE) && (eventConfirmationCallback != NULL) &&
+            ((batch = (IOTHUB_EVENT_BATCH*)malloc(sizeof(IOTHUB_EVENT_BATCH))) == NULL))
+        {
+            LogError("unable to allocate IOTHUB_EVENT_BATCH");
+            result = IOTHUB_CLIENT_ERROR;
+        }
         else
         {
-            IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+            DLIST_ENTRY batchEntries;
+            PDLIST_ENTRY link;
 
-            if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+            if (batch != NULL)
             {
-                result = IOTHUB_CLIENT_ERROR;
-                LOG_ERROR_RESULT;
-                free(newEntry);
+                batch->pending_confirmations = eventMessageCount;
+                batch->result = IOTHUB_CLIENT_CONFIRMATION_OK;
+                batch->eventConfirmationCallback = eventConfirmationCallback;
+                batch->userContextCallback = userContextCallback;
+                entryCallback = on_batch_event_confirmed;
+                entryContext = batch;
             }
-            else
+
+            /*the whole batch is built aside first, so that a failure leaves waitingToSend untouched*/
+            DList_InitializeListHead(&batchEntries);
+            for (index = 0; index < eventMessageCount; index++)
             {
-                if ((newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+                IOTHUB_MESSAGE_LIST* newEntry = create_event_entry(handleData, eventMessageHandles[index], false, entryCallback, entryContext);
+                if (newEntry == NULL)
                 {
-                    result = IOTHUB_CLIENT_ERROR;
-                    free(newEntry);
-                    LOG_ERROR_RESULT;
+                    break;
                 }
-                else if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, newEntry->messageHandle) != 0)
+                DList_InsertTailList(&batchEntries, &(newEntry->entry));
+            }
+
+            if (index != eventMessageCount)
+            {
+                LogError("unable to queue message %lu of %lu", (unsigned long)index, (unsigned long)eventMessageCount);
+                while ((link = DList_RemoveHeadList(&batchEntries)) != &batchEntries)
                 {
-                    result = IOTHUB_CLIENT_ERROR;
-                    IoTHubMessage_Destroy(newEntry->messageHandle);
-                    free(newEntry);
-                    LOG_ERROR_RESULT;
+                    IOTHUB_MESSAGE_LIST* entry = containingRecord(link, IOTHUB_MESSAGE_LIST, entry);
+                    IoTHubMessage_Destroy(entry->messageHandle);
+                    free(entry);
                 }
-                else
+                free(batch);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*splice: detach the local head and hang the remaining ring at the tail of waitingToSend*/
+                link = batchEntries.Flink;
+                (void)DList_RemoveEntryList(&batchEntries);
+                DList_AppendTailList(&(iotHubClientHandle->waitingToSend), link);
+
+                for (index = 0; index < eventMessageCount; index++, link = link->Flink)
                 {
-                    newEntry->callback = eventConfirmationCallback;
-                    newEntry->context = userContextCallback;
-                    DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
-                    result = IOTHUB_CLIENT_OK;
+                    event_entry_queued(handleData, containingRecord(link, IOTHUB_MESSAGE_LIST, entry));
                 }
+                result = IOTHUB_CLIENT_OK;
             }
         }
     }
@@ -2042,36 +2538,33 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendMessageDisposition(IOTHUB_CLIENT_CO
     return result;
 }
 
+static void on_message_timeout(void* context, TIMER_WHEEL_ENTRY* timeout_entry)
+{
+    IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(timeout_entry, IOTHUB_MESSAGE_LIST, timeout_entry);
+
+    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)context;
+
+    /*only messages in waitingToSend have their timeout armed*/
+    DList_RemoveEntryList(&fullEntry->entry);
+    iothub_client_metrics_subtract(handleData->metrics, IOTHUB_CLIENT_METRICS_WAITING_TO_SEND, 1);
+    complete_event_entry(handleData, fullEntry, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+}
+
 static void DoTimeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
 {
     tickcounter_ms_t nowTick;
-    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    if (handleData->messageTimeouts == NULL)
+    {
+        /*no message was ever sent with a timeout*/
+    }
+    else if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
     {
         LogError("unable to get the current ms, timeouts will not be processed");
     }
     else
     {
-        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
-        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
-        {
-            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
-            if ((fullEntry->ms_timesOutAfter != 0) && ((nowTick - fullEntry->ms_timesOutAfter) > fullEntry->message_timeout_value))
-            {
-                PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
-                DList_RemoveEntryList(currentItemInWaitingToSend);
-                if (fullEntry->callback != NULL)
-                {
-                    fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
-                }
-                IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
-                free(fullEntry);
-                currentItemInWaitingToSend = theNext;
-            }
-            else
-            {
-                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
-            }
-        }
+        /*only the messages whose deadline has passed are visited, however long waitingToSend is*/
+        (void)timer_wheel_advance(handleData->messageTimeouts, nowTick, on_message_timeout, handleData);
     }
 }
 
@@ -2080,7 +2573,32 @@ void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
     if (iotHubClientHandle != NULL)
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        tickcounter_ms_t start_ms;
+        tickcounter_ms_t end_ms;
+        int start_result = tickcounter_get_current_ms(handleData->tickCounter, &start_ms);
+
         DoTimeouts(handleData);
+        if (handleData->telemetry_journal != NULL)
+        {
+            load_journaled_events(handleData);
+            /*group commit: what was journaled since the last DoWork reaches storage before the transport publishes it*/
+            if (iothub_client_telemetry_journal_sync(handleData->telemetry_journal) != 0)
+            {
+                LogError("unable to sync the telemetry journal");
+            }
+        }
+        if (handleData->twin_cache_refresh_needed && !handleData->twin_cache_refresh_pending && handleData->twin_cache != NULL)
+        {
+            if (handleData->IoTHubTransport_GetTwinAsync(handleData->deviceHandle, on_twin_cache_refreshed, handleData) != IOTHUB_CLIENT_OK)
+            {
+                LogError("unable to request the twin for the twin cache");
+            }
+            else
+            {
+                handleData->twin_cache_refresh_needed = false;
+                handleData->twin_cache_refresh_pending = true;
+            }
+        }
 
         DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
         while (client_item != &(handleData->iot_msg_queue)) /*while we are not at the end of the list*/
@@ -2113,6 +2631,11 @@ void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
         }
 
         handleData->IoTHubTransport_DoWork(handleData->transportHandle);
+
+        if (start_result == 0 && tickcounter_get_current_ms(handleData->tickCounter, &end_ms) == 0)
+        {
+            iothub_client_metrics_record(handleData->metrics, IOTHUB_CLIENT_METRICS_DO_WORK_DURATION, end_ms - start_ms);
+        }
     }
 }
 
@@ -2135,6 +2658,119 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetSendStatus(IOTHUB_CLIENT_CORE_LL_HAN
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetMetrics(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_METRICS* metrics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || metrics == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+
+        /*only relaxed atomic loads, so this may run on any thread, concurrently with DoWork*/
+        iothub_client_metrics_get(handleData->metrics, metrics);
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetCachedTwin(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || deviceTwinCallback == NULL)
+    {
+        LogError("Invalid argument iothubClientHandle=%p, deviceTwinCallback=%p", iotHubClientHandle, deviceTwinCallback);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (iotHubClientHandle->twin_cache == NULL)
+    {
+        LogError("the twin cache is not enabled, see OPTION_TWIN_CACHE");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        char* document = iothub_client_twin_cache_get_document(iotHubClientHandle->twin_cache);
+        if (document == NULL)
+        {
+            LogError("no twin document cached yet");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            deviceTwinCallback(DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)document, strlen(document), userContextCallback);
+            iothub_client_twin_cache_free_document(document);
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetPollInfo(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POLL_INFO* pollInfo)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || pollInfo == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+
+        if (handleData->IoTHubTransport_GetPollInfo == NULL)
+        {
+            /*the transport cannot tell when it has work, so DoWork is polled*/
+            pollInfo->fd = -1;
+            pollInfo->want_write = false;
+            pollInfo->timeout_ms = POLL_INTERVAL_WITHOUT_TRANSPORT_SUPPORT_MS;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (handleData->IoTHubTransport_GetPollInfo(handleData->transportHandle, !DList_IsListEmpty(&handleData->iot_msg_queue), pollInfo) != 0)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Failure getting the poll info from the transport");
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+
+        if (result == IOTHUB_CLIENT_OK && handleData->messageTimeouts != NULL)
+        {
+            tickcounter_ms_t nowTick;
+            tickcounter_ms_t deadline;
+
+            if (timer_wheel_get_next_deadline(handleData->messageTimeouts, &deadline) != 0)
+            {
+                /*no message waits with a timeout*/
+            }
+            else if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+            {
+                LogError("unable to get the current ms, polling for message timeouts");
+                pollInfo->timeout_ms = 0;
+            }
+            else if (deadline <= nowTick)
+            {
+                pollInfo->timeout_ms = 0;
+            }
+            else if ((uint64_t)(deadline - nowTick) < pollInfo->timeout_ms)
+            {
+                pollInfo->timeout_ms = deadline - nowTick;
+            }
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetConnectionStatusCallback(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatusCallback, void * userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2299,6 +2935,82 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
                 result = IOTHUB_CLIENT_OK;
             }
         }
+        else if (strcmp(optionName, OPTION_PAYLOAD_CODEC) == 0)
+        {
+            handleData->payload_codec_setting.codec = (const IOTHUB_CLIENT_PAYLOAD_CODEC*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_PAYLOAD_CODEC_MIN_SIZE) == 0)
+        {
+            handleData->payload_codec_setting.minPayloadSize = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_TELEMETRY_JOURNAL_DIRECTORY) == 0)
+        {
+            if (handleData->telemetry_journal != NULL)
+            {
+                LogError("the telemetry journal is already set");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if ((handleData->telemetry_journal = iothub_client_telemetry_journal_create((const char*)value)) == NULL)
+            {
+                LogError("unable to create the telemetry journal in %s", (const char*)value);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_TWIN_CACHE) == 0)
+        {
+            if (!*(const bool*)value)
+            {
+                if (handleData->twin_cache != NULL && handleData->deviceTwinCallback == NULL)
+                {
+                    /*the subscription was only kept for the cache*/
+                    handleData->IoTHubTransport_Unsubscribe_DeviceTwin(handleData->transportHandle);
+                }
+                iothub_client_twin_cache_destroy(handleData->twin_cache);
+                handleData->twin_cache = NULL;
+                handleData->twin_cache_refresh_needed = false;
+                result = IOTHUB_CLIENT_OK;
+            }
+            else if (handleData->twin_cache != NULL)
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+            else if ((handleData->twin_cache = iothub_client_twin_cache_create()) == NULL)
+            {
+                LogError("unable to create the twin cache");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) != 0)
+            {
+                /*subscribing gets the full twin the cache starts from*/
+                LogError("unable to subscribe to the twin for the twin cache");
+                iothub_client_twin_cache_destroy(handleData->twin_cache);
+                handleData->twin_cache = NULL;
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_TELEMETRY_JOURNAL_WINDOW) == 0)
+        {
+            if (*(const size_t*)value == 0)
+            {
+                LogError("the telemetry journal window cannot be 0");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->telemetry_journal_window = *(const size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else if ((strcmp(optionName, OPTION_BLOB_UPLOAD_TIMEOUT_SECS) == 0) || 
                  (strcmp(optionName, OPTION_CURL_VERBOSE) == 0) || 
                  (strcmp(optionName, OPTION_NETWORK_INTERFACE_UPLOAD_TO_BLOB) == 0) ||
@@ -2382,7 +3094,11 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_COR
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
         if (deviceTwinCallback == NULL)
         {
-            handleData->IoTHubTransport_Unsubscribe_DeviceTwin(handleData->transportHandle);
+            /*the twin cache keeps receiving desired properties patches through the same subscription*/
+            if (handleData->twin_cache == NULL)
+            {
+                handleData->IoTHubTransport_Unsubscribe_DeviceTwin(handleData->transportHandle);
+            }
             handleData->deviceTwinCallback = NULL;
             result = IOTHUB_CLIENT_OK;
         }
@@ -2470,6 +3186,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetTwinAsync(IOTHUB_CLIENT_CORE_LL_HAND
 
                 getTwinCtx->callback = deviceTwinCallback;
                 getTwinCtx->context = userContextCallback;
+                getTwinCtx->handleData = handleData;
 
                 if (handleData->IoTHubTransport_GetTwinAsync(handleData->deviceHandle, on_get_device_twin_completed, getTwinCtx) != IOTHUB_CLIENT_OK)
                 {
@@ -2998,6 +3715,7 @@ int IoTHubClientCore_LL_GetTransportCallbacks(TRANSPORT_CALLBACKS_INFO* transpor
         transport_cb->msg_cb = IoTHubClientCore_LL_MessageCallback;
         transport_cb->method_complete_cb = IoTHubClientCore_LL_DeviceMethodComplete;
         transport_cb->get_model_id_cb = IoTHubClientCore_LL_GetModelId;
+        transport_cb->get_metrics_cb = IoTHubClientCore_LL_GetMetricsHandle;
         result = 0;
     }
     return result;
@@ -0,0 +1,154 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "internal/iothub_client_metrics.h"
+
+#define COUNTER_COUNT   MU_COUNT_ARG(IOTHUB_CLIENT_METRICS_COUNTER_VALUES)
+#define HISTOGRAM_COUNT MU_COUNT_ARG(IOTHUB_CLIENT_METRICS_HISTOGRAM_VALUES)
+
+typedef struct METRICS_HISTOGRAM_TAG
+{
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum_ms;
+    atomic_uint_fast64_t buckets[IOTHUB_CLIENT_HISTOGRAM_BUCKET_COUNT];
+} METRICS_HISTOGRAM;
+
+typedef struct IOTHUB_CLIENT_METRICS_COUNTERS_TAG
+{
+    atomic_uint_fast64_t counters[COUNTER_COUNT];
+    METRICS_HISTOGRAM histograms[HISTOGRAM_COUNT];
+} IOTHUB_CLIENT_METRICS_COUNTERS;
+
+static size_t bucket_index(tickcounter_ms_t value_ms)
+{
+    size_t result = 0;
+
+    while (value_ms != 0 && result < IOTHUB_CLIENT_HISTOGRAM_BUCKET_COUNT - 1)
+    {
+        value_ms >>= 1;
+        result++;
+    }
+
+    return result;
+}
+
+static uint64_t load(atomic_uint_fast64_t* value)
+{
+    return (uint64_t)atomic_load_explicit(value, memory_order_relaxed);
+}
+
+IOTHUB_CLIENT_METRICS_HANDLE iothub_client_metrics_create(void)
+{
+    IOTHUB_CLIENT_METRICS_COUNTERS* result = (IOTHUB_CLIENT_METRICS_COUNTERS*)malloc(sizeof(IOTHUB_CLIENT_METRICS_COUNTERS));
+
+    if (result == NULL)
+    {
+        LogError("Failed allocating IOTHUB_CLIENT_METRICS_COUNTERS");
+    }
+    else
+    {
+        size_t index;
+        size_t bucket;
+
+        for (index = 0; index < COUNTER_COUNT; index++)
+        {
+            atomic_init(&result->counters[index], 0);
+        }
+        for (index = 0; index < HISTOGRAM_COUNT; index++)
+        {
+            atomic_init(&result->histograms[index].count, 0);
+            atomic_init(&result->histograms[index].sum_ms, 0);
+            for (bucket = 0; bucket < IOTHUB_CLIENT_HISTOGRAM_BUCKET_COUNT; bucket++)
+            {
+                atomic_init(&result->histograms[index].buckets[bucket], 0);
+            }
+        }
+    }
+
+    return result;
+}
+
+void iothub_client_metrics_destroy(IOTHUB_CLIENT_METRICS_HANDLE metrics)
+{
+    free(metrics);
+}
+
+void iothub_client_metrics_add(IOTHUB_CLIENT_METRICS_HANDLE metrics, IOTHUB_CLIENT_METRICS_COUNTER counter, uint64_t value)
+{
+    if (metrics != NULL)
+    {
+        (void)atomic_fetch_add_explicit(&metrics->counters[counter], value, memory_order_relaxed);
+    }
+}
+
+void iothub_client_metrics_subtract(IOTHUB_CLIENT_METRICS_HANDLE metrics, IOTHUB_CLIENT_METRICS_COUNTER counter, uint64_t value)
+{
+    if (metrics != NULL)
+    {
+        (void)atomic_fetch_sub_explicit(&metrics->counters[counter], value, memory_order_relaxed);
+    }
+}
+
+void iothub_client_metrics_record(IOTHUB_CLIENT_METRICS_HANDLE metrics, IOTHUB_CLIENT_METRICS_HISTOGRAM histogram, tickcounter_ms_t value_ms)
+{
+    if (metrics != NULL)
+    {
+        METRICS_HISTOGRAM* target = &metrics->histograms[histogram];
+        (void)atomic_fetch_add_explicit(&target->count, 1, memory_order_relaxed);
+        (void)atomic_fetch_add_explicit(&target->sum_ms, value_ms, memory_order_relaxed);
+        (void)atomic_fetch_add_explicit(&target->buckets[bucket_index(value_ms)], 1, memory_order_relaxed);
+    }
+}
+
+void iothub_client_metrics_on_bytes_transferred(void* context, size_t bytes_sent, size_t bytes_received)
+{
+    IOTHUB_CLIENT_METRICS_HANDLE metrics = (IOTHUB_CLIENT_METRICS_HANDLE)context;
+
+    if (bytes_sent != 0)
+    {
+        iothub_client_metrics_add(metrics, IOTHUB_CLIENT_METRICS_BYTES_SENT, bytes_sent);
+    }
+    if (bytes_received != 0)
+    {
+        iothub_client_metrics_add(metrics, IOTHUB_CLIENT_METRICS_BYTES_RECEIVED, bytes_received);
+    }
+}
+
+void iothub_client_metrics_get(IOTHUB_CLIENT_METRICS_HANDLE metrics, IOTHUB_CLIENT_METRICS* snapshot)
+{
+    if (metrics == NULL || snapshot == NULL)
+    {
+        LogError("Invalid argument (metrics=%p, snapshot=%p)", metrics, snapshot);
+    }
+    else
+    {
+        IOTHUB_CLIENT_HISTOGRAM* targets[HISTOGRAM_COUNT];
+        size_t index;
+        size_t bucket;
+
+        snapshot->waiting_to_send = (size_t)load(&metrics->counters[IOTHUB_CLIENT_METRICS_WAITING_TO_SEND]);
+        snapshot->waiting_for_ack = load(&metrics->counters[IOTHUB_CLIENT_METRICS_WAITING_FOR_ACK]);
+        snapshot->bytes_sent = load(&metrics->counters[IOTHUB_CLIENT_METRICS_BYTES_SENT]);
+        snapshot->bytes_received = load(&metrics->counters[IOTHUB_CLIENT_METRICS_BYTES_RECEIVED]);
+        snapshot->reconnects = load(&metrics->counters[IOTHUB_CLIENT_METRICS_RECONNECTS]);
+
+        targets[IOTHUB_CLIENT_METRICS_TELEMETRY_ACK_LATENCY] = &snapshot->telemetry_ack_latency;
+        targets[IOTHUB_CLIENT_METRICS_DISPOSITION_LATENCY] = &snapshot->disposition_latency;
+        targets[IOTHUB_CLIENT_METRICS_DO_WORK_DURATION] = &snapshot->do_work_duration;
+
+        for (index = 0; index < HISTOGRAM_COUNT; index++)
+        {
+            targets[index]->count = load(&metrics->histograms[index].count);
+            targets[index]->sum_ms = load(&metrics->histograms[index].sum_ms);
+            for (bucket = 0; bucket < IOTHUB_CLIENT_HISTOGRAM_BUCKET_COUNT; bucket++)
+            {
+                targets[index]->buckets[bucket] = load(&metrics->histograms[index].buckets[bucket]);
+            }
+        }
+    }
+}
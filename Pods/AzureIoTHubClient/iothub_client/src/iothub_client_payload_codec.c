@@ -0,0 +1,502 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/buffer_.h"
+
+#include "iothub_client_payload_codec.h"
+#include "internal/iothub_client_payload_codec_private.h"
+#include "internal/iothub_message_private.h"
+
+#define MATCH_HASH_BITS         12
+#define MATCH_HASH_SIZE         (1 << MATCH_HASH_BITS)
+
+#define ZLIB_HEADER_CMF         0x78    // deflate with a 32K window
+#define ZLIB_HEADER_FLG         0x01    // no dictionary, FCHECK making the header a multiple of 31
+#define ZLIB_TRAILER_LENGTH     4       // Adler-32 of the uncompressed data
+#define ADLER32_MODULUS         65521
+#define ADLER32_MAX_RUN         5552    // Bytes that can be summed before the sums overflow 32 bits
+
+#define DEFLATE_WINDOW_SIZE     32768
+#define DEFLATE_MIN_MATCH       3
+#define DEFLATE_MAX_MATCH       258
+#define DEFLATE_END_OF_BLOCK    256
+#define DEFLATE_LENGTH_CODES    29
+#define DEFLATE_DISTANCE_CODES  30
+
+#define LZ4_SIZE_PREFIX_LENGTH  4
+#define LZ4_MIN_MATCH           4
+#define LZ4_MAX_OFFSET          65535
+#define LZ4_LAST_LITERALS       5       // The block format requires the last 5 bytes to be literals ...
+#define LZ4_MATCH_FIND_LIMIT    12      // ... and the last match to start at least 12 bytes before the end
+#define LZ4_RUN_MASK            15
+
+static const uint16_t DEFLATE_LENGTH_BASE[DEFLATE_LENGTH_CODES] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t DEFLATE_LENGTH_EXTRA_BITS[DEFLATE_LENGTH_CODES] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t DEFLATE_DISTANCE_BASE[DEFLATE_DISTANCE_CODES] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t DEFLATE_DISTANCE_EXTRA_BITS[DEFLATE_DISTANCE_CODES] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+typedef struct BIT_WRITER_TAG
+{
+    unsigned char* destination;
+    size_t capacity;
+    size_t position;
+    uint32_t bits;
+    unsigned int bitCount;
+    bool overflow;
+} BIT_WRITER;
+
+static uint32_t read_uint32(const unsigned char* source)
+{
+    uint32_t result;
+    (void)memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+// Multiplicative hash of a 4 byte sequence; deflate, which matches from 3 bytes, passes 3 bytes only
+static uint32_t hash_sequence(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - MATCH_HASH_BITS);
+}
+
+static uint32_t hash_deflate_sequence(const unsigned char* source)
+{
+    return hash_sequence((uint32_t)source[0] | ((uint32_t)source[1] << 8) | ((uint32_t)source[2] << 16));
+}
+
+static void write_bits(BIT_WRITER* writer, uint32_t value, unsigned int count)
+{
+    writer->bits |= value << writer->bitCount;
+    writer->bitCount += count;
+    while (writer->bitCount >= 8)
+    {
+        if (writer->position == writer->capacity)
+        {
+            writer->overflow = true;
+        }
+        else
+        {
+            writer->destination[writer->position++] = (unsigned char)writer->bits;
+        }
+        writer->bits >>= 8;
+        writer->bitCount -= 8;
+    }
+}
+
+// Huffman codes are packed starting from their most significant bit, unlike every other deflate field
+static void write_huffman_code(BIT_WRITER* writer, uint32_t code, unsigned int length)
+{
+    uint32_t reversed = 0;
+    unsigned int index;
+    for (index = 0; index < length; index++)
+    {
+        reversed = (reversed << 1) | ((code >> index) & 1);
+    }
+    write_bits(writer, reversed, length);
+}
+
+// Writes a literal/length symbol with the fixed Huffman code of RFC 1951 3.2.6
+static void write_fixed_symbol(BIT_WRITER* writer, unsigned int symbol)
+{
+    if (symbol < 144)
+    {
+        write_huffman_code(writer, 0x30 + symbol, 8);
+    }
+    else if (symbol < 256)
+    {
+        write_huffman_code(writer, 0x190 + symbol - 144, 9);
+    }
+    else if (symbol < 280)
+    {
+        write_huffman_code(writer, symbol - 256, 7);
+    }
+    else
+    {
+        write_huffman_code(writer, 0xC0 + symbol - 280, 8);
+    }
+}
+
+static void write_deflate_match(BIT_WRITER* writer, size_t length, size_t distance)
+{
+    unsigned int code = DEFLATE_LENGTH_CODES - 1;
+    while (DEFLATE_LENGTH_BASE[code] > length)
+    {
+        code--;
+    }
+    write_fixed_symbol(writer, DEFLATE_END_OF_BLOCK + 1 + code);
+    write_bits(writer, (uint32_t)(length - DEFLATE_LENGTH_BASE[code]), DEFLATE_LENGTH_EXTRA_BITS[code]);
+
+    code = DEFLATE_DISTANCE_CODES - 1;
+    while (DEFLATE_DISTANCE_BASE[code] > distance)
+    {
+        code--;
+    }
+    // Distance codes are all 5 bits long with the fixed Huffman codes
+    write_huffman_code(writer, code, 5);
+    write_bits(writer, (uint32_t)(distance - DEFLATE_DISTANCE_BASE[code]), DEFLATE_DISTANCE_EXTRA_BITS[code]);
+}
+
+static uint32_t adler32(const unsigned char* source, size_t sourceSize)
+{
+    uint32_t a = 1;
+    uint32_t b = 0;
+
+    while (sourceSize > 0)
+    {
+        size_t run = (sourceSize < ADLER32_MAX_RUN) ? sourceSize : ADLER32_MAX_RUN;
+        sourceSize -= run;
+        while (run-- > 0)
+        {
+            a += *source++;
+            b += a;
+        }
+        a %= ADLER32_MODULUS;
+        b %= ADLER32_MODULUS;
+    }
+
+    return (b << 16) | a;
+}
+
+// Greedy LZ77 over a single hash chain entry per bucket, coded as one fixed-Huffman block.  Telemetry payloads are too
+// small for dynamic Huffman tables to pay for themselves.
+static int deflate_encode(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t* destinationSize)
+{
+    int result;
+    uint32_t* lastPositions;
+
+    if (*destinationSize < 2 + ZLIB_TRAILER_LENGTH || sourceSize >= UINT32_MAX)
+    {
+        result = MU_FAILURE;
+    }
+    else if ((lastPositions = (uint32_t*)calloc(MATCH_HASH_SIZE, sizeof(uint32_t))) == NULL)
+    {
+        LogError("Failed allocating the deflate match table");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        BIT_WRITER writer;
+        size_t position = 0;
+
+        writer.destination = destination;
+        writer.capacity = *destinationSize - ZLIB_TRAILER_LENGTH;
+        writer.position = 0;
+        writer.bits = 0;
+        writer.bitCount = 0;
+        writer.overflow = false;
+
+        write_bits(&writer, ZLIB_HEADER_CMF, 8);
+        write_bits(&writer, ZLIB_HEADER_FLG, 8);
+        // BFINAL, then BTYPE 01 (fixed Huffman codes)
+        write_bits(&writer, 1, 1);
+        write_bits(&writer, 1, 2);
+
+        while (position < sourceSize && !writer.overflow)
+        {
+            size_t matchLength = 0;
+            size_t matchPosition = 0;
+
+            if (position + DEFLATE_MIN_MATCH <= sourceSize)
+            {
+                uint32_t hash = hash_deflate_sequence(source + position);
+                // Positions are stored plus one, 0 marking an empty bucket
+                size_t candidate = lastPositions[hash];
+                lastPositions[hash] = (uint32_t)(position + 1);
+
+                if (candidate != 0 && position - (candidate - 1) <= DEFLATE_WINDOW_SIZE)
+                {
+                    size_t maxLength = (sourceSize - position < DEFLATE_MAX_MATCH) ? sourceSize - position : DEFLATE_MAX_MATCH;
+                    matchPosition = candidate - 1;
+                    while (matchLength < maxLength && source[matchPosition + matchLength] == source[position + matchLength])
+                    {
+                        matchLength++;
+                    }
+                }
+            }
+
+            if (matchLength >= DEFLATE_MIN_MATCH)
+            {
+                size_t index;
+                write_deflate_match(&writer, matchLength, position - matchPosition);
+                for (index = 1; index < matchLength && position + index + DEFLATE_MIN_MATCH <= sourceSize; index++)
+                {
+                    lastPositions[hash_deflate_sequence(source + position + index)] = (uint32_t)(position + index + 1);
+                }
+                position += matchLength;
+            }
+            else
+            {
+                write_fixed_symbol(&writer, source[position]);
+                position++;
+            }
+        }
+
+        write_fixed_symbol(&writer, DEFLATE_END_OF_BLOCK);
+        if (writer.bitCount > 0)
+        {
+            write_bits(&writer, 0, 8 - writer.bitCount);
+        }
+
+        if (writer.overflow)
+        {
+            result = MU_FAILURE;
+        }
+        else
+        {
+            uint32_t checksum = adler32(source, sourceSize);
+            destination[writer.position++] = (unsigned char)(checksum >> 24);
+            destination[writer.position++] = (unsigned char)(checksum >> 16);
+            destination[writer.position++] = (unsigned char)(checksum >> 8);
+            destination[writer.position++] = (unsigned char)checksum;
+            *destinationSize = writer.position;
+            result = 0;
+        }
+
+        free(lastPositions);
+    }
+
+    return result;
+}
+
+static void write_lz4_length(unsigned char* destination, size_t* position, size_t length)
+{
+    while (length >= 255)
+    {
+        destination[(*position)++] = 255;
+        length -= 255;
+    }
+    destination[(*position)++] = (unsigned char)length;
+}
+
+// Writes one LZ4 sequence: the literals since the previous match, then the match unless matchLength is 0 (last sequence)
+static bool write_lz4_sequence(unsigned char* destination, size_t capacity, size_t* position, const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    bool result;
+    // token, literal length, literals, offset and match length, at their largest
+    size_t required = 1 + (literalLength / 255 + 1) + literalLength + 2 + (matchLength / 255 + 1);
+
+    if (capacity - *position < required)
+    {
+        result = false;
+    }
+    else
+    {
+        unsigned char* token = destination + (*position)++;
+
+        *token = (unsigned char)(((literalLength < LZ4_RUN_MASK) ? literalLength : LZ4_RUN_MASK) << 4);
+        if (literalLength >= LZ4_RUN_MASK)
+        {
+            write_lz4_length(destination, position, literalLength - LZ4_RUN_MASK);
+        }
+        (void)memcpy(destination + *position, literals, literalLength);
+        *position += literalLength;
+
+        if (matchLength != 0)
+        {
+            size_t encodedLength = matchLength - LZ4_MIN_MATCH;
+            destination[(*position)++] = (unsigned char)offset;
+            destination[(*position)++] = (unsigned char)(offset >> 8);
+            *token |= (unsigned char)((encodedLength < LZ4_RUN_MASK) ? encodedLength : LZ4_RUN_MASK);
+            if (encodedLength >= LZ4_RUN_MASK)
+            {
+                write_lz4_length(destination, position, encodedLength - LZ4_RUN_MASK);
+            }
+        }
+
+        result = true;
+    }
+
+    return result;
+}
+
+static int lz4_encode(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t* destinationSize)
+{
+    int result;
+    uint32_t* lastPositions;
+
+    if (*destinationSize < LZ4_SIZE_PREFIX_LENGTH || sourceSize >= UINT32_MAX)
+    {
+        result = MU_FAILURE;
+    }
+    else if ((lastPositions = (uint32_t*)calloc(MATCH_HASH_SIZE, sizeof(uint32_t))) == NULL)
+    {
+        LogError("Failed allocating the LZ4 match table");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t matchFindLimit = (sourceSize > LZ4_MATCH_FIND_LIMIT) ? sourceSize - LZ4_MATCH_FIND_LIMIT : 0;
+        size_t position = 0;
+        size_t anchor = 0;
+        size_t written = LZ4_SIZE_PREFIX_LENGTH;
+        bool fits = true;
+
+        destination[0] = (unsigned char)sourceSize;
+        destination[1] = (unsigned char)(sourceSize >> 8);
+        destination[2] = (unsigned char)(sourceSize >> 16);
+        destination[3] = (unsigned char)(sourceSize >> 24);
+
+        while (position < matchFindLimit && fits)
+        {
+            uint32_t sequence = read_uint32(source + position);
+            uint32_t hash = hash_sequence(sequence);
+            // Positions are stored plus one, 0 marking an empty bucket
+            size_t candidate = lastPositions[hash];
+            lastPositions[hash] = (uint32_t)(position + 1);
+
+            if (candidate != 0 && position - (candidate - 1) <= LZ4_MAX_OFFSET && read_uint32(source + candidate - 1) == sequence)
+            {
+                size_t matchPosition = candidate - 1;
+                size_t maxLength = sourceSize - LZ4_LAST_LITERALS - position;
+                size_t matchLength = LZ4_MIN_MATCH;
+                while (matchLength < maxLength && source[matchPosition + matchLength] == source[position + matchLength])
+                {
+                    matchLength++;
+                }
+
+                fits = write_lz4_sequence(destination, *destinationSize, &written, source + anchor, position - anchor, position - matchPosition, matchLength);
+                position += matchLength;
+                anchor = position;
+            }
+            else
+            {
+                position++;
+            }
+        }
+
+        if (!fits || !write_lz4_sequence(destination, *destinationSize, &written, source + anchor, sourceSize - anchor, 0, 0))
+        {
+            result = MU_FAILURE;
+        }
+        else
+        {
+            *destinationSize = written;
+            result = 0;
+        }
+
+        free(lastPositions);
+    }
+
+    return result;
+}
+
+static const IOTHUB_CLIENT_PAYLOAD_CODEC DEFLATE_CODEC = { "deflate", deflate_encode };
+static const IOTHUB_CLIENT_PAYLOAD_CODEC LZ4_CODEC = { "lz4", lz4_encode };
+
+const IOTHUB_CLIENT_PAYLOAD_CODEC* IoTHubClient_PayloadCodec_Deflate(void)
+{
+    return &DEFLATE_CODEC;
+}
+
+const IOTHUB_CLIENT_PAYLOAD_CODEC* IoTHubClient_PayloadCodec_LZ4(void)
+{
+    return &LZ4_CODEC;
+}
+
+static int get_message_payload(IOTHUB_MESSAGE_HANDLE messageHandle, const unsigned char** payload, size_t* payloadSize)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(messageHandle);
+
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        result = (IoTHubMessage_GetByteArray(messageHandle, payload, payloadSize) == IOTHUB_MESSAGE_OK) ? 0 : MU_FAILURE;
+    }
+    else if (contentType == IOTHUBMESSAGE_STRING && (*payload = (const unsigned char*)IoTHubMessage_GetString(messageHandle)) != NULL)
+    {
+        *payloadSize = strlen((const char*)*payload);
+        result = 0;
+    }
+    else
+    {
+        result = MU_FAILURE;
+    }
+
+    return result;
+}
+
+int IoTHubClient_PayloadCodec_EncodeIfNecessary(IOTHUB_PAYLOAD_CODEC_SETTING_DATA* codecSetting, IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    int result;
+    const unsigned char* payload;
+    size_t payloadSize;
+
+    if (codecSetting == NULL || messageHandle == NULL)
+    {
+        LogError("Invalid argument (codecSetting=%p, messageHandle=%p)", codecSetting, messageHandle);
+        result = MU_FAILURE;
+    }
+    else if (codecSetting->codec == NULL || codecSetting->codec->encode == NULL ||
+        IoTHubMessage_GetContentEncodingSystemProperty(messageHandle) != NULL)
+    {
+        result = 0;
+    }
+    else if (get_message_payload(messageHandle, &payload, &payloadSize) != 0)
+    {
+        LogError("Failed getting the message payload");
+        result = MU_FAILURE;
+    }
+    else if (payloadSize <= 1 || payloadSize < codecSetting->minPayloadSize)
+    {
+        result = 0;
+    }
+    else
+    {
+        // Only an encoded payload smaller than the payload is worth sending
+        size_t capacity = payloadSize - 1;
+        size_t encodedSize = capacity;
+        BUFFER_HANDLE encoded = BUFFER_create_with_size(capacity);
+
+        if (encoded == NULL)
+        {
+            LogError("Failed allocating %lu bytes for the encoded payload", (unsigned long)capacity);
+            result = MU_FAILURE;
+        }
+        else if (codecSetting->codec->encode(payload, payloadSize, BUFFER_u_char(encoded), &encodedSize) != 0)
+        {
+            // Does not compress; sent as is
+            BUFFER_delete(encoded);
+            result = 0;
+        }
+        else if (encodedSize < capacity && BUFFER_shrink(encoded, capacity - encodedSize, true) != 0)
+        {
+            LogError("Failed trimming the encoded payload");
+            BUFFER_delete(encoded);
+            result = MU_FAILURE;
+        }
+        else if (IoTHubMessage_SetEncodedByteArray(messageHandle, encoded, codecSetting->codec->contentEncoding) != IOTHUB_MESSAGE_OK)
+        {
+            // The message is left unchanged
+            LogError("Failed replacing the message payload with its %s encoding", codecSetting->codec->contentEncoding);
+            BUFFER_delete(encoded);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
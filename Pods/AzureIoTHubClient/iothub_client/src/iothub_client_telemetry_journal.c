@@ -0,0 +1,1033 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/map.h"
+#include "internal/iothub_client_telemetry_journal.h"
+
+#define JOURNAL_SEGMENT_SIZE            (1024 * 1024)
+#define JOURNAL_SEGMENT_MAGIC           0x4A544F49 /* "IOTJ" */
+#define JOURNAL_SEGMENT_VERSION         1
+#define JOURNAL_RECORD_MAGIC            0x4443524A /* "JRCD" */
+#define JOURNAL_RECORD_ALIGNMENT        8
+#define JOURNAL_NULL_STRING             UINT32_MAX
+
+#define JOURNAL_SEGMENT_NAME_PREFIX     "telemetry-"
+#define JOURNAL_SEGMENT_NAME_SUFFIX     ".journal"
+#define JOURNAL_SEGMENT_NAME_LENGTH     (sizeof(JOURNAL_SEGMENT_NAME_PREFIX) - 1 + 16 + sizeof(JOURNAL_SEGMENT_NAME_SUFFIX) - 1)
+
+#define ALIGN_RECORD_SIZE(size)         (((size) + JOURNAL_RECORD_ALIGNMENT - 1) & ~((size_t)JOURNAL_RECORD_ALIGNMENT - 1))
+
+typedef struct JOURNAL_SEGMENT_HEADER_TAG
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t first_record_id;
+} JOURNAL_SEGMENT_HEADER;
+
+typedef struct JOURNAL_RECORD_HEADER_TAG
+{
+    uint32_t magic;         /* stored last: a record torn by a crash has none and ends the segment */
+    uint32_t acknowledged;  /* set in place */
+    uint64_t record_id;
+    uint32_t length;        /* of the serialized message following the header */
+    uint32_t reserved;
+} JOURNAL_RECORD_HEADER;
+
+typedef struct JOURNAL_SEGMENT_TAG
+{
+    DLIST_ENTRY entry;
+    char* path;
+    uint64_t first_record_id;
+    uint8_t* base;              /* NULL while the segment is not mapped */
+    size_t size;
+    size_t end;                 /* offset following the last record */
+    size_t unacknowledged;
+    size_t acknowledge_hint;    /* offset of the record following the last one acknowledged */
+    size_t dirty_begin;         /* bytes changed since they were last synced, none when dirty_end is 0 */
+    size_t dirty_end;
+} JOURNAL_SEGMENT;
+
+typedef struct TELEMETRY_JOURNAL_TAG
+{
+    char* directory;
+    DLIST_ENTRY segments;               /* oldest first, records are appended to the last one */
+    JOURNAL_SEGMENT* load_segment;      /* holds the next record to hand out, NULL while there is no segment */
+    size_t load_offset;
+    uint64_t next_record_id;
+    size_t page_size;
+} TELEMETRY_JOURNAL;
+
+/*serialization of a message; a NULL destination only measures it*/
+typedef struct JOURNAL_WRITER_TAG
+{
+    uint8_t* destination;
+    size_t size;
+    bool failed;
+} JOURNAL_WRITER;
+
+typedef struct JOURNAL_READER_TAG
+{
+    const uint8_t* source;
+    size_t size;
+    size_t position;
+    bool failed;
+} JOURNAL_READER;
+
+typedef const char*(*MESSAGE_STRING_GETTER)(IOTHUB_MESSAGE_HANDLE message);
+typedef IOTHUB_MESSAGE_RESULT(*MESSAGE_STRING_SETTER)(IOTHUB_MESSAGE_HANDLE message, const char* value);
+
+typedef struct MESSAGE_STRING_FIELD_TAG
+{
+    MESSAGE_STRING_GETTER get;
+    MESSAGE_STRING_SETTER set;
+} MESSAGE_STRING_FIELD;
+
+static const MESSAGE_STRING_FIELD MESSAGE_STRING_FIELDS[] =
+{
+    { IoTHubMessage_GetMessageId, IoTHubMessage_SetMessageId },
+    { IoTHubMessage_GetCorrelationId, IoTHubMessage_SetCorrelationId },
+    { IoTHubMessage_GetContentTypeSystemProperty, IoTHubMessage_SetContentTypeSystemProperty },
+    { IoTHubMessage_GetContentEncodingSystemProperty, IoTHubMessage_SetContentEncodingSystemProperty },
+    { IoTHubMessage_GetOutputName, IoTHubMessage_SetOutputName },
+    { IoTHubMessage_GetComponentName, IoTHubMessage_SetComponentName },
+    { IoTHubMessage_GetMessageCreationTimeUtcSystemProperty, IoTHubMessage_SetMessageCreationTimeUtcSystemProperty },
+    { IoTHubMessage_GetMessageUserIdSystemProperty, IoTHubMessage_SetMessageUserIdSystemProperty }
+};
+
+static void write_bytes(JOURNAL_WRITER* writer, const void* bytes, size_t length)
+{
+    if (writer->destination != NULL && length > 0)
+    {
+        (void)memcpy(writer->destination + writer->size, bytes, length);
+    }
+    writer->size += length;
+}
+
+static void write_uint32(JOURNAL_WRITER* writer, uint32_t value)
+{
+    write_bytes(writer, &value, sizeof(value));
+}
+
+static void write_length_prefixed(JOURNAL_WRITER* writer, const void* bytes, size_t length)
+{
+    if (length >= JOURNAL_NULL_STRING)
+    {
+        writer->failed = true;
+    }
+    else
+    {
+        write_uint32(writer, (uint32_t)length);
+        write_bytes(writer, bytes, length);
+    }
+}
+
+static void write_string(JOURNAL_WRITER* writer, const char* value)
+{
+    if (value == NULL)
+    {
+        write_uint32(writer, JOURNAL_NULL_STRING);
+    }
+    else
+    {
+        write_length_prefixed(writer, value, strlen(value));
+    }
+}
+
+static void serialize_message(JOURNAL_WRITER* writer, IOTHUB_MESSAGE_HANDLE message)
+{
+    IOTHUBMESSAGE_CONTENT_TYPE content_type = IoTHubMessage_GetContentType(message);
+    const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnostic_data;
+    const char*const* keys;
+    const char*const* values;
+    size_t count;
+    size_t i;
+
+    write_uint32(writer, (uint32_t)content_type);
+    if (content_type == IOTHUBMESSAGE_STRING)
+    {
+        const char* payload = IoTHubMessage_GetString(message);
+        if (payload == NULL)
+        {
+            writer->failed = true;
+        }
+        else
+        {
+            /*with its terminator, so that the message can be created from the mapped record*/
+            write_length_prefixed(writer, payload, strlen(payload) + 1);
+        }
+    }
+    else
+    {
+        const unsigned char* payload;
+        size_t size;
+        if (IoTHubMessage_GetByteArray(message, &payload, &size) != IOTHUB_MESSAGE_OK)
+        {
+            writer->failed = true;
+        }
+        else
+        {
+            write_length_prefixed(writer, payload, size);
+        }
+    }
+
+    for (i = 0; i < sizeof(MESSAGE_STRING_FIELDS) / sizeof(MESSAGE_STRING_FIELDS[0]); i++)
+    {
+        write_string(writer, MESSAGE_STRING_FIELDS[i].get(message));
+    }
+
+    diagnostic_data = IoTHubMessage_GetDiagnosticPropertyData(message);
+    write_string(writer, (diagnostic_data != NULL) ? diagnostic_data->diagnosticId : NULL);
+    write_string(writer, (diagnostic_data != NULL) ? diagnostic_data->diagnosticCreationTimeUtc : NULL);
+    write_uint32(writer, IoTHubMessage_IsSecurityMessage(message) ? 1 : 0);
+
+    if (Map_GetInternals(IoTHubMessage_Properties(message), &keys, &values, &count) != MAP_OK || count >= JOURNAL_NULL_STRING)
+    {
+        writer->failed = true;
+    }
+    else
+    {
+        write_uint32(writer, (uint32_t)count);
+        for (i = 0; i < count; i++)
+        {
+            write_string(writer, keys[i]);
+            write_string(writer, values[i]);
+        }
+    }
+}
+
+static uint32_t read_uint32(JOURNAL_READER* reader)
+{
+    uint32_t result = 0;
+    if (reader->size - reader->position < sizeof(result))
+    {
+        reader->failed = true;
+    }
+    else
+    {
+        (void)memcpy(&result, reader->source + reader->position, sizeof(result));
+        reader->position += sizeof(result);
+    }
+    return result;
+}
+
+/*returns the bytes that follow their length in the record, NULL when reading a NULL string or failing*/
+static const uint8_t* read_length_prefixed(JOURNAL_READER* reader, size_t* length)
+{
+    const uint8_t* result = NULL;
+    uint32_t value = read_uint32(reader);
+    *length = 0;
+    if (reader->failed || value == JOURNAL_NULL_STRING)
+    {
+        /*nothing to read*/
+    }
+    else if (reader->size - reader->position < value)
+    {
+        reader->failed = true;
+    }
+    else
+    {
+        result = reader->source + reader->position;
+        reader->position += value;
+        *length = value;
+    }
+    return result;
+}
+
+static char* read_string(JOURNAL_READER* reader)
+{
+    char* result = NULL;
+    size_t length;
+    const uint8_t* bytes = read_length_prefixed(reader, &length);
+    if (bytes != NULL)
+    {
+        if ((result = (char*)malloc(length + 1)) == NULL)
+        {
+            reader->failed = true;
+        }
+        else
+        {
+            (void)memcpy(result, bytes, length);
+            result[length] = '\0';
+        }
+    }
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE deserialize_message(const uint8_t* source, size_t size)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    JOURNAL_READER reader = { source, size, 0, false };
+    uint32_t content_type = read_uint32(&reader);
+    size_t length;
+    const uint8_t* payload = read_length_prefixed(&reader, &length);
+
+    if (reader.failed)
+    {
+        result = NULL;
+    }
+    else if (content_type == IOTHUBMESSAGE_STRING)
+    {
+        result = (payload != NULL && length > 0 && payload[length - 1] == '\0') ? IoTHubMessage_CreateFromString((const char*)payload) : NULL;
+    }
+    else
+    {
+        result = IoTHubMessage_CreateFromByteArray(payload, length);
+    }
+
+    if (result != NULL)
+    {
+        IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA diagnostic_data;
+        uint32_t count;
+        size_t i;
+
+        for (i = 0; i < sizeof(MESSAGE_STRING_FIELDS) / sizeof(MESSAGE_STRING_FIELDS[0]) && !reader.failed; i++)
+        {
+            char* value = read_string(&reader);
+            if (value != NULL)
+            {
+                if (MESSAGE_STRING_FIELDS[i].set(result, value) != IOTHUB_MESSAGE_OK)
+                {
+                    reader.failed = true;
+                }
+                free(value);
+            }
+        }
+
+        diagnostic_data.diagnosticId = read_string(&reader);
+        diagnostic_data.diagnosticCreationTimeUtc = read_string(&reader);
+        if (diagnostic_data.diagnosticId != NULL && diagnostic_data.diagnosticCreationTimeUtc != NULL &&
+            IoTHubMessage_SetDiagnosticPropertyData(result, &diagnostic_data) != IOTHUB_MESSAGE_OK)
+        {
+            reader.failed = true;
+        }
+        free(diagnostic_data.diagnosticId);
+        free(diagnostic_data.diagnosticCreationTimeUtc);
+
+        if (read_uint32(&reader) != 0 && IoTHubMessage_SetAsSecurityMessage(result) != IOTHUB_MESSAGE_OK)
+        {
+            reader.failed = true;
+        }
+
+        count = read_uint32(&reader);
+        for (i = 0; i < count && !reader.failed; i++)
+        {
+            char* key = read_string(&reader);
+            char* value = read_string(&reader);
+            if (key == NULL || value == NULL || IoTHubMessage_SetProperty(result, key, value) != IOTHUB_MESSAGE_OK)
+            {
+                reader.failed = true;
+            }
+            free(key);
+            free(value);
+        }
+
+        if (reader.failed)
+        {
+            IoTHubMessage_Destroy(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+static char* make_segment_path(const char* directory, uint64_t first_record_id)
+{
+    size_t length = strlen(directory) + 1 + JOURNAL_SEGMENT_NAME_LENGTH + 1;
+    char* result = (char*)malloc(length);
+    if (result == NULL)
+    {
+        LogError("unable to allocate the journal segment path");
+    }
+    else
+    {
+        (void)snprintf(result, length, "%s/" JOURNAL_SEGMENT_NAME_PREFIX "%016" PRIx64 JOURNAL_SEGMENT_NAME_SUFFIX, directory, first_record_id);
+    }
+    return result;
+}
+
+static JOURNAL_SEGMENT* get_write_segment(TELEMETRY_JOURNAL* journal)
+{
+    return DList_IsListEmpty(&journal->segments) ? NULL : containingRecord(journal->segments.Blink, JOURNAL_SEGMENT, entry);
+}
+
+static JOURNAL_RECORD_HEADER* get_record(JOURNAL_SEGMENT* segment, size_t offset)
+{
+    return (JOURNAL_RECORD_HEADER*)(segment->base + offset);
+}
+
+/*records the bytes changed since the segment was last synced*/
+static void mark_dirty(JOURNAL_SEGMENT* segment, size_t offset, size_t length)
+{
+    if (segment->dirty_end == 0)
+    {
+        segment->dirty_begin = offset;
+        segment->dirty_end = offset + length;
+    }
+    else
+    {
+        if (offset < segment->dirty_begin)
+        {
+            segment->dirty_begin = offset;
+        }
+        if (offset + length > segment->dirty_end)
+        {
+            segment->dirty_end = offset + length;
+        }
+    }
+}
+
+/*writes the changed bytes back to the file and waits until they are on storage, the journal's durability point*/
+static int sync_segment(TELEMETRY_JOURNAL* journal, JOURNAL_SEGMENT* segment)
+{
+    int result;
+    if (segment->dirty_end == 0 || segment->base == NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t first_page = segment->dirty_begin & ~(journal->page_size - 1);
+        if (msync(segment->base + first_page, segment->dirty_end - first_page, MS_SYNC) != 0)
+        {
+            LogError("unable to sync journal segment %s", segment->path);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            segment->dirty_begin = 0;
+            segment->dirty_end = 0;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*a new segment file only survives a power loss once the directory entry naming it does*/
+static void sync_directory(TELEMETRY_JOURNAL* journal)
+{
+    int fd = open(journal->directory, O_RDONLY);
+    if (fd < 0 || fsync(fd) != 0)
+    {
+        LogError("unable to sync the telemetry journal directory %s", journal->directory);
+    }
+    if (fd >= 0)
+    {
+        (void)close(fd);
+    }
+}
+
+static int map_segment(JOURNAL_SEGMENT* segment)
+{
+    int result;
+    if (segment->base != NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        int fd = open(segment->path, O_RDWR);
+        if (fd < 0)
+        {
+            LogError("unable to open journal segment %s", segment->path);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            void* base = mmap(NULL, segment->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED)
+            {
+                LogError("unable to map journal segment %s", segment->path);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                segment->base = (uint8_t*)base;
+                result = 0;
+            }
+            (void)close(fd);
+        }
+    }
+    return result;
+}
+
+static void unmap_segment(JOURNAL_SEGMENT* segment)
+{
+    if (segment->base != NULL)
+    {
+        (void)munmap(segment->base, segment->size);
+        segment->base = NULL;
+        segment->dirty_begin = 0;
+        segment->dirty_end = 0;
+    }
+}
+
+static void destroy_segment(JOURNAL_SEGMENT* segment)
+{
+    unmap_segment(segment);
+    free(segment->path);
+    free(segment);
+}
+
+static void delete_segment(JOURNAL_SEGMENT* segment)
+{
+    (void)DList_RemoveEntryList(&segment->entry);
+    if (unlink(segment->path) != 0)
+    {
+        LogError("unable to delete journal segment %s", segment->path);
+    }
+    destroy_segment(segment);
+}
+
+/*only the segments appended to and read from stay mapped; the others are deleted once all their records are acknowledged*/
+static void release_segment(TELEMETRY_JOURNAL* journal, JOURNAL_SEGMENT* segment)
+{
+    if (segment != get_write_segment(journal) && segment != journal->load_segment)
+    {
+        /*the acknowledgements are synced before the segment is deleted too: should the unlink be lost, the records
+        are not replayed*/
+        (void)sync_segment(journal, segment);
+        if (segment->unacknowledged == 0)
+        {
+            delete_segment(segment);
+        }
+        else
+        {
+            unmap_segment(segment);
+        }
+    }
+}
+
+static bool is_caught_up(TELEMETRY_JOURNAL* journal)
+{
+    JOURNAL_SEGMENT* write_segment = get_write_segment(journal);
+    return (journal->load_segment == NULL) ||
+        (journal->load_segment == write_segment && journal->load_offset >= write_segment->end);
+}
+
+static JOURNAL_SEGMENT* create_segment(TELEMETRY_JOURNAL* journal, size_t record_size)
+{
+    JOURNAL_SEGMENT* result = (JOURNAL_SEGMENT*)malloc(sizeof(JOURNAL_SEGMENT));
+    if (result == NULL)
+    {
+        LogError("unable to allocate JOURNAL_SEGMENT");
+    }
+    else
+    {
+        memset(result, 0, sizeof(JOURNAL_SEGMENT));
+        result->first_record_id = journal->next_record_id;
+        result->size = (record_size > JOURNAL_SEGMENT_SIZE - sizeof(JOURNAL_SEGMENT_HEADER)) ? sizeof(JOURNAL_SEGMENT_HEADER) + record_size : JOURNAL_SEGMENT_SIZE;
+        result->end = sizeof(JOURNAL_SEGMENT_HEADER);
+        result->acknowledge_hint = result->end;
+
+        if ((result->path = make_segment_path(journal->directory, result->first_record_id)) == NULL)
+        {
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            int fd = open(result->path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+            if (fd < 0)
+            {
+                LogError("unable to create journal segment %s", result->path);
+                destroy_segment(result);
+                result = NULL;
+            }
+            else
+            {
+                bool created = (ftruncate(fd, (off_t)result->size) == 0);
+                (void)close(fd);
+
+                if (!created || map_segment(result) != 0)
+                {
+                    LogError("unable to size journal segment %s", result->path);
+                    (void)unlink(result->path);
+                    destroy_segment(result);
+                    result = NULL;
+                }
+                else
+                {
+                    JOURNAL_SEGMENT_HEADER* header = (JOURNAL_SEGMENT_HEADER*)result->base;
+                    header->version = JOURNAL_SEGMENT_VERSION;
+                    header->first_record_id = result->first_record_id;
+                    header->magic = JOURNAL_SEGMENT_MAGIC;
+                    mark_dirty(result, 0, sizeof(JOURNAL_SEGMENT_HEADER));
+                    sync_directory(journal);
+                    DList_InsertTailList(&journal->segments, &result->entry);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+/*maps an existing segment file and counts its records; a segment that is not one is left alone*/
+static JOURNAL_SEGMENT* open_segment(TELEMETRY_JOURNAL* journal, uint64_t first_record_id)
+{
+    JOURNAL_SEGMENT* result = (JOURNAL_SEGMENT*)malloc(sizeof(JOURNAL_SEGMENT));
+    if (result == NULL)
+    {
+        LogError("unable to allocate JOURNAL_SEGMENT");
+    }
+    else
+    {
+        struct stat file_status;
+        memset(result, 0, sizeof(JOURNAL_SEGMENT));
+        result->first_record_id = first_record_id;
+
+        if ((result->path = make_segment_path(journal->directory, first_record_id)) == NULL)
+        {
+            free(result);
+            result = NULL;
+        }
+        else if (stat(result->path, &file_status) != 0 || (size_t)file_status.st_size < sizeof(JOURNAL_SEGMENT_HEADER))
+        {
+            LogError("ignoring journal segment %s", result->path);
+            destroy_segment(result);
+            result = NULL;
+        }
+        else
+        {
+            JOURNAL_SEGMENT_HEADER* header;
+            result->size = (size_t)file_status.st_size;
+
+            if (map_segment(result) != 0)
+            {
+                destroy_segment(result);
+                result = NULL;
+            }
+            else if ((header = (JOURNAL_SEGMENT_HEADER*)result->base)->magic != JOURNAL_SEGMENT_MAGIC ||
+                header->version != JOURNAL_SEGMENT_VERSION ||
+                header->first_record_id != first_record_id)
+            {
+                LogError("ignoring journal segment %s", result->path);
+                destroy_segment(result);
+                result = NULL;
+            }
+            else
+            {
+                size_t offset = sizeof(JOURNAL_SEGMENT_HEADER);
+                while (result->size - offset >= sizeof(JOURNAL_RECORD_HEADER))
+                {
+                    JOURNAL_RECORD_HEADER* record = get_record(result, offset);
+                    if (record->magic != JOURNAL_RECORD_MAGIC ||
+                        record->length > result->size - offset - sizeof(JOURNAL_RECORD_HEADER))
+                    {
+                        break;
+                    }
+
+                    if (!record->acknowledged)
+                    {
+                        result->unacknowledged++;
+                    }
+                    if (record->record_id >= journal->next_record_id)
+                    {
+                        journal->next_record_id = record->record_id + 1;
+                    }
+                    offset += ALIGN_RECORD_SIZE(sizeof(JOURNAL_RECORD_HEADER) + record->length);
+                    if (offset > result->size)
+                    {
+                        offset = result->size;
+                    }
+                }
+                result->end = offset;
+                result->acknowledge_hint = sizeof(JOURNAL_SEGMENT_HEADER);
+            }
+        }
+    }
+    return result;
+}
+
+static void insert_segment_in_order(TELEMETRY_JOURNAL* journal, JOURNAL_SEGMENT* segment)
+{
+    PDLIST_ENTRY next = journal->segments.Flink;
+    while (next != &journal->segments && containingRecord(next, JOURNAL_SEGMENT, entry)->first_record_id < segment->first_record_id)
+    {
+        next = next->Flink;
+    }
+    /*inserting at the tail of the list headed by next puts segment right before it*/
+    DList_InsertTailList(next, &segment->entry);
+}
+
+static int open_segments(TELEMETRY_JOURNAL* journal)
+{
+    int result;
+    DIR* directory = opendir(journal->directory);
+    if (directory == NULL)
+    {
+        LogError("unable to open the telemetry journal directory %s", journal->directory);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        struct dirent* directory_entry;
+        PDLIST_ENTRY current;
+
+        while ((directory_entry = readdir(directory)) != NULL)
+        {
+            const char* name = directory_entry->d_name;
+            uint64_t first_record_id;
+            JOURNAL_SEGMENT* segment;
+
+            if (strlen(name) == JOURNAL_SEGMENT_NAME_LENGTH &&
+                strncmp(name, JOURNAL_SEGMENT_NAME_PREFIX, sizeof(JOURNAL_SEGMENT_NAME_PREFIX) - 1) == 0 &&
+                strcmp(name + JOURNAL_SEGMENT_NAME_LENGTH - (sizeof(JOURNAL_SEGMENT_NAME_SUFFIX) - 1), JOURNAL_SEGMENT_NAME_SUFFIX) == 0 &&
+                sscanf(name + sizeof(JOURNAL_SEGMENT_NAME_PREFIX) - 1, "%16" SCNx64, &first_record_id) == 1 &&
+                (segment = open_segment(journal, first_record_id)) != NULL)
+            {
+                insert_segment_in_order(journal, segment);
+            }
+        }
+        (void)closedir(directory);
+
+        journal->load_segment = DList_IsListEmpty(&journal->segments) ? NULL : containingRecord(journal->segments.Flink, JOURNAL_SEGMENT, entry);
+        journal->load_offset = sizeof(JOURNAL_SEGMENT_HEADER);
+
+        current = journal->segments.Flink;
+        while (current != &journal->segments)
+        {
+            JOURNAL_SEGMENT* segment = containingRecord(current, JOURNAL_SEGMENT, entry);
+            current = current->Flink;
+            if (segment == journal->load_segment && segment->unacknowledged == 0 && segment != get_write_segment(journal))
+            {
+                journal->load_segment = containingRecord(current, JOURNAL_SEGMENT, entry);
+            }
+            release_segment(journal, segment);
+        }
+        result = 0;
+    }
+    return result;
+}
+
+TELEMETRY_JOURNAL_HANDLE iothub_client_telemetry_journal_create(const char* directory)
+{
+    TELEMETRY_JOURNAL* result;
+    if (directory == NULL)
+    {
+        LogError("Invalid argument - directory is NULL");
+        result = NULL;
+    }
+    else if ((result = (TELEMETRY_JOURNAL*)malloc(sizeof(TELEMETRY_JOURNAL))) == NULL)
+    {
+        LogError("unable to allocate TELEMETRY_JOURNAL");
+    }
+    else
+    {
+        long page_size = sysconf(_SC_PAGESIZE);
+        memset(result, 0, sizeof(TELEMETRY_JOURNAL));
+        DList_InitializeListHead(&result->segments);
+        result->next_record_id = 1;
+        result->page_size = (page_size > 0) ? (size_t)page_size : 4096;
+
+        if (mallocAndStrcpy_s(&result->directory, directory) != 0)
+        {
+            LogError("unable to copy the telemetry journal directory");
+            free(result);
+            result = NULL;
+        }
+        else if (open_segments(result) != 0)
+        {
+            iothub_client_telemetry_journal_destroy(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+void iothub_client_telemetry_journal_destroy(TELEMETRY_JOURNAL_HANDLE journal)
+{
+    if (journal != NULL)
+    {
+        PDLIST_ENTRY current;
+        while ((current = DList_RemoveHeadList(&journal->segments)) != &journal->segments)
+        {
+            JOURNAL_SEGMENT* segment = containingRecord(current, JOURNAL_SEGMENT, entry);
+            (void)sync_segment(journal, segment);
+            destroy_segment(segment);
+        }
+        free(journal->directory);
+        free(journal);
+    }
+}
+
+static int append_record(TELEMETRY_JOURNAL* journal, IOTHUB_MESSAGE_HANDLE message, size_t length, bool hand_out, uint64_t* record_id, bool* handed_out)
+{
+    int result;
+    size_t record_size = ALIGN_RECORD_SIZE(sizeof(JOURNAL_RECORD_HEADER) + length);
+    bool caught_up = is_caught_up(journal);
+    JOURNAL_SEGMENT* segment = get_write_segment(journal);
+
+    if (segment == NULL || segment->size - segment->end < record_size || map_segment(segment) != 0)
+    {
+        JOURNAL_SEGMENT* previous = segment;
+        if (previous != NULL && previous->end == sizeof(JOURNAL_SEGMENT_HEADER))
+        {
+            /*an empty segment would have the name of the one replacing it*/
+            if (journal->load_segment == previous)
+            {
+                journal->load_segment = NULL;
+            }
+            delete_segment(previous);
+            previous = NULL;
+        }
+
+        if ((segment = create_segment(journal, record_size)) != NULL)
+        {
+            if (caught_up)
+            {
+                journal->load_segment = segment;
+                journal->load_offset = segment->end;
+            }
+            if (previous != NULL)
+            {
+                release_segment(journal, previous);
+            }
+        }
+    }
+
+    if (segment == NULL)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        JOURNAL_RECORD_HEADER* record = get_record(segment, segment->end);
+        JOURNAL_WRITER writer = { (uint8_t*)(record + 1), 0, false };
+        uintptr_t first_page = (uintptr_t)record & ~((uintptr_t)journal->page_size - 1);
+
+        serialize_message(&writer, message);
+        record->acknowledged = 0;
+        record->record_id = journal->next_record_id;
+        record->length = (uint32_t)writer.size;
+        record->reserved = 0;
+        atomic_thread_fence(memory_order_release);
+        record->magic = JOURNAL_RECORD_MAGIC;
+        /*start writing the record back now, so that the next iothub_client_telemetry_journal_sync has less to wait for*/
+        (void)msync((void*)first_page, (uintptr_t)record + record_size - first_page, MS_ASYNC);
+        mark_dirty(segment, segment->end, record_size);
+
+        segment->end += record_size;
+        segment->unacknowledged++;
+        *record_id = journal->next_record_id++;
+
+        if (hand_out && caught_up)
+        {
+            journal->load_segment = segment;
+            journal->load_offset = segment->end;
+            *handed_out = true;
+        }
+        else
+        {
+            *handed_out = false;
+        }
+        result = 0;
+    }
+    return result;
+}
+
+int iothub_client_telemetry_journal_append(TELEMETRY_JOURNAL_HANDLE journal, IOTHUB_MESSAGE_HANDLE message, bool hand_out, uint64_t* record_id, bool* handed_out)
+{
+    int result;
+
+    if (journal == NULL || message == NULL || record_id == NULL || handed_out == NULL)
+    {
+        LogError("Invalid argument - journal=%p, message=%p, record_id=%p, handed_out=%p", journal, message, record_id, handed_out);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        JOURNAL_WRITER measure = { NULL, 0, false };
+        serialize_message(&measure, message);
+
+        if (measure.failed || measure.size > UINT32_MAX)
+        {
+            LogError("unable to serialize the message for the telemetry journal");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = append_record(journal, message, measure.size, hand_out, record_id, handed_out);
+        }
+    }
+    return result;
+}
+
+static int acknowledge_record(TELEMETRY_JOURNAL* journal, JOURNAL_SEGMENT* segment, size_t offset)
+{
+    JOURNAL_RECORD_HEADER* record = get_record(segment, offset);
+    if (!record->acknowledged)
+    {
+        record->acknowledged = 1;
+        mark_dirty(segment, offset, sizeof(JOURNAL_RECORD_HEADER));
+        segment->unacknowledged--;
+    }
+    segment->acknowledge_hint = offset + ALIGN_RECORD_SIZE(sizeof(JOURNAL_RECORD_HEADER) + record->length);
+    release_segment(journal, segment);
+    return 0;
+}
+
+IOTHUB_MESSAGE_HANDLE iothub_client_telemetry_journal_load_next(TELEMETRY_JOURNAL_HANDLE journal, uint64_t* record_id)
+{
+    IOTHUB_MESSAGE_HANDLE result = NULL;
+
+    if (journal == NULL || record_id == NULL)
+    {
+        LogError("Invalid argument - journal=%p, record_id=%p", journal, record_id);
+    }
+    else
+    {
+        while (result == NULL && journal->load_segment != NULL)
+        {
+            JOURNAL_SEGMENT* segment = journal->load_segment;
+
+            if (journal->load_offset >= segment->end)
+            {
+                if (segment == get_write_segment(journal))
+                {
+                    /*caught up*/
+                    break;
+                }
+                journal->load_segment = containingRecord(segment->entry.Flink, JOURNAL_SEGMENT, entry);
+                journal->load_offset = sizeof(JOURNAL_SEGMENT_HEADER);
+                release_segment(journal, segment);
+            }
+            else if (map_segment(segment) != 0)
+            {
+                break;
+            }
+            else
+            {
+                size_t offset = journal->load_offset;
+                JOURNAL_RECORD_HEADER* record = get_record(segment, offset);
+                journal->load_offset += ALIGN_RECORD_SIZE(sizeof(JOURNAL_RECORD_HEADER) + record->length);
+
+                if (!record->acknowledged)
+                {
+                    if ((result = deserialize_message((const uint8_t*)(record + 1), record->length)) == NULL)
+                    {
+                        LogError("dropping unreadable telemetry journal record %" PRIu64, record->record_id);
+                        (void)acknowledge_record(journal, segment, offset);
+                    }
+                    else
+                    {
+                        *record_id = record->record_id;
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+bool iothub_client_telemetry_journal_is_caught_up(TELEMETRY_JOURNAL_HANDLE journal)
+{
+    bool result;
+
+    if (journal == NULL)
+    {
+        LogError("Invalid argument - journal=NULL");
+        result = false;
+    }
+    else
+    {
+        result = is_caught_up(journal);
+    }
+    return result;
+}
+
+int iothub_client_telemetry_journal_acknowledge(TELEMETRY_JOURNAL_HANDLE journal, uint64_t record_id)
+{
+    int result;
+
+    if (journal == NULL || record_id == 0)
+    {
+        LogError("Invalid argument - journal=%p, record_id=%" PRIu64, journal, record_id);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        JOURNAL_SEGMENT* segment = NULL;
+        PDLIST_ENTRY current;
+
+        for (current = journal->segments.Flink; current != &journal->segments; current = current->Flink)
+        {
+            JOURNAL_SEGMENT* candidate = containingRecord(current, JOURNAL_SEGMENT, entry);
+            if (candidate->first_record_id > record_id)
+            {
+                break;
+            }
+            segment = candidate;
+        }
+
+        if (segment == NULL || map_segment(segment) != 0)
+        {
+            LogError("telemetry journal record %" PRIu64 " not found", record_id);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            size_t offset = segment->acknowledge_hint;
+            if (offset >= segment->end || get_record(segment, offset)->record_id != record_id)
+            {
+                offset = sizeof(JOURNAL_SEGMENT_HEADER);
+                while (offset < segment->end && get_record(segment, offset)->record_id != record_id)
+                {
+                    offset += ALIGN_RECORD_SIZE(sizeof(JOURNAL_RECORD_HEADER) + get_record(segment, offset)->length);
+                }
+            }
+
+            if (offset >= segment->end)
+            {
+                LogError("telemetry journal record %" PRIu64 " not found", record_id);
+                release_segment(journal, segment);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                result = acknowledge_record(journal, segment, offset);
+            }
+        }
+    }
+    return result;
+}
+
+int iothub_client_telemetry_journal_sync(TELEMETRY_JOURNAL_HANDLE journal)
+{
+    int result;
+
+    if (journal == NULL)
+    {
+        LogError("Invalid argument - journal=NULL");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        PDLIST_ENTRY current;
+
+        /*only the segments appended to and read from stay mapped, the others were synced when they were released*/
+        result = 0;
+        for (current = journal->segments.Flink; current != &journal->segments; current = current->Flink)
+        {
+            if (sync_segment(journal, containingRecord(current, JOURNAL_SEGMENT, entry)) != 0)
+            {
+                result = MU_FAILURE;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,244 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+#include "internal/iothub_client_twin_cache.h"
+
+static const char* TWIN_DESIRED = "desired";
+static const char* TWIN_VERSION = "$version";
+
+typedef struct TWIN_CACHE_TAG
+{
+    JSON_Value* document; /*NULL until the first full document*/
+    double version;       /*$version of the desired properties in document*/
+} TWIN_CACHE;
+
+static JSON_Value* parse_payload(const unsigned char* payload, size_t size)
+{
+    JSON_Value* result;
+    char* json = (char*)malloc(size + 1);
+
+    if (json == NULL)
+    {
+        LogError("Failed allocating the twin payload copy");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(json, payload, size);
+        json[size] = '\0';
+        if ((result = json_parse_string(json)) == NULL)
+        {
+            LogError("Failed parsing the twin payload");
+        }
+        free(json);
+    }
+
+    return result;
+}
+
+// merge_patch applies patch to target as in RFC 7386: null removes a member, objects are merged recursively and any
+// other value replaces the member.
+static int merge_patch(JSON_Object* target, const JSON_Object* patch)
+{
+    int result = 0;
+    size_t count = json_object_get_count(patch);
+    size_t index;
+
+    for (index = 0; index < count && result == 0; index++)
+    {
+        const char* name = json_object_get_name(patch, index);
+        JSON_Value* value = json_object_get_value_at(patch, index);
+
+        if (json_value_get_type(value) == JSONNull)
+        {
+            (void)json_object_remove(target, name);
+        }
+        else if (json_value_get_type(value) == JSONObject)
+        {
+            JSON_Object* member = json_object_get_object(target, name);
+
+            if (member == NULL &&
+                (json_object_set_value(target, name, json_value_init_object()) != JSONSuccess ||
+                 (member = json_object_get_object(target, name)) == NULL))
+            {
+                LogError("Failed adding twin member %s", name);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                result = merge_patch(member, json_value_get_object(value));
+            }
+        }
+        else
+        {
+            JSON_Value* copy = json_value_deep_copy(value);
+
+            if (copy == NULL || json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("Failed setting twin member %s", name);
+                json_value_free(copy);
+                result = MU_FAILURE;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int replace_document(TWIN_CACHE* twin_cache, JSON_Value* document)
+{
+    int result;
+    JSON_Object* desired = json_object_get_object(json_value_get_object(document), TWIN_DESIRED);
+
+    if (desired == NULL || json_object_get_value(desired, TWIN_VERSION) == NULL)
+    {
+        LogError("The twin document has no desired properties $version");
+        json_value_free(document);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        json_value_free(twin_cache->document);
+        twin_cache->document = document;
+        twin_cache->version = json_object_get_number(desired, TWIN_VERSION);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int apply_patch(TWIN_CACHE* twin_cache, JSON_Value* patch, bool* refresh_needed)
+{
+    int result;
+    JSON_Object* patch_object = json_value_get_object(patch);
+    double version;
+
+    if (patch_object == NULL || json_object_get_value(patch_object, TWIN_VERSION) == NULL)
+    {
+        LogError("The desired properties patch has no $version");
+        result = MU_FAILURE;
+    }
+    else if (twin_cache->document == NULL)
+    {
+        *refresh_needed = true;
+        result = 0;
+    }
+    else if ((version = json_object_get_number(patch_object, TWIN_VERSION)) <= twin_cache->version)
+    {
+        // Already part of the cached document, e.g. a patch received while a full document was requested.
+        result = 0;
+    }
+    else if (version != twin_cache->version + 1)
+    {
+        LogInfo("Twin desired properties $version gap (%.0f after %.0f), the cached document is stale", version, twin_cache->version);
+        json_value_free(twin_cache->document);
+        twin_cache->document = NULL;
+        *refresh_needed = true;
+        result = 0;
+    }
+    else if (merge_patch(json_object_get_object(json_value_get_object(twin_cache->document), TWIN_DESIRED), patch_object) != 0)
+    {
+        // The document is partly patched, only a full one can fix it.
+        json_value_free(twin_cache->document);
+        twin_cache->document = NULL;
+        *refresh_needed = true;
+        result = MU_FAILURE;
+    }
+    else
+    {
+        twin_cache->version = version;
+        result = 0;
+    }
+
+    json_value_free(patch);
+    return result;
+}
+
+TWIN_CACHE_HANDLE iothub_client_twin_cache_create(void)
+{
+    TWIN_CACHE* result = (TWIN_CACHE*)malloc(sizeof(TWIN_CACHE));
+
+    if (result == NULL)
+    {
+        LogError("Failed allocating TWIN_CACHE");
+    }
+    else
+    {
+        result->document = NULL;
+        result->version = 0;
+    }
+
+    return result;
+}
+
+void iothub_client_twin_cache_destroy(TWIN_CACHE_HANDLE twin_cache)
+{
+    if (twin_cache != NULL)
+    {
+        json_value_free(twin_cache->document);
+        free(twin_cache);
+    }
+}
+
+int iothub_client_twin_cache_update(TWIN_CACHE_HANDLE twin_cache, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payload, size_t size, bool* refresh_needed)
+{
+    int result;
+    JSON_Value* value;
+
+    if (twin_cache == NULL || payload == NULL || refresh_needed == NULL)
+    {
+        LogError("Invalid argument (twin_cache=%p, payload=%p, refresh_needed=%p)", twin_cache, payload, refresh_needed);
+        result = MU_FAILURE;
+    }
+    else if ((value = parse_payload(payload, size)) == NULL)
+    {
+        *refresh_needed = false;
+        result = MU_FAILURE;
+    }
+    else
+    {
+        *refresh_needed = false;
+        if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
+        {
+            result = replace_document(twin_cache, value);
+        }
+        else
+        {
+            result = apply_patch(twin_cache, value, refresh_needed);
+        }
+    }
+
+    return result;
+}
+
+char* iothub_client_twin_cache_get_document(TWIN_CACHE_HANDLE twin_cache)
+{
+    char* result;
+
+    if (twin_cache == NULL)
+    {
+        LogError("Invalid argument (twin_cache=NULL)");
+        result = NULL;
+    }
+    else if (twin_cache->document == NULL)
+    {
+        result = NULL;
+    }
+    else if ((result = json_serialize_to_string(twin_cache->document)) == NULL)
+    {
+        LogError("Failed serializing the cached twin");
+    }
+
+    return result;
+}
+
+void iothub_client_twin_cache_free_document(char* document)
+{
+    json_free_serialized_string(document);
+}
@@ -39,6 +39,9 @@ typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
     MESSAGE_DISPOSITION_CONTEXT_HANDLE dispositionContext;
     MESSAGE_DISPOSITION_CONTEXT_DESTROY_FUNCTION dispositionContextDestroyFunction;
     char* componentName;
+    MESSAGE_PROPERTIES_SOURCE_HANDLE propertiesSource;
+    MESSAGE_PROPERTIES_DECODE_FUNCTION propertiesDecodeFunction;
+    MESSAGE_PROPERTIES_SOURCE_DESTROY_FUNCTION propertiesSourceDestroyFunction;
 }IOTHUB_MESSAGE_HANDLE_DATA;
 
 static bool ContainsValidUsAscii(const char* asciiValue)
@@ -83,6 +86,24 @@ static void DestroyDiagnosticPropertyData(IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DAT
     free(diagnosticHandle);
 }
 
+// decode_properties_if_needed runs the decode deferred with IoTHubMessage_SetPropertiesSource, once, before the properties
+// it sets are first read or written.
+static void decode_properties_if_needed(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    if (handleData->propertiesSource != NULL)
+    {
+        MESSAGE_PROPERTIES_SOURCE_HANDLE propertiesSource = handleData->propertiesSource;
+
+        // Cleared first, as the decode function sets the properties through the IoTHubMessage_Set* functions.
+        handleData->propertiesSource = NULL;
+        if (handleData->propertiesDecodeFunction(propertiesSource, handleData) != 0)
+        {
+            LogError("Failed decoding the message properties, the message only has those decoded before the failure");
+        }
+        handleData->propertiesSourceDestroyFunction(propertiesSource);
+    }
+}
+
 static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
 {
     if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
@@ -114,6 +135,11 @@ static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
         handleData->dispositionContextDestroyFunction(handleData->dispositionContext);
     }
 
+    if (handleData->propertiesSource != NULL)
+    {
+        handleData->propertiesSourceDestroyFunction(handleData->propertiesSource);
+    }
+
     free(handleData->componentName);
     free(handleData);
 }
@@ -335,6 +361,8 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
     }
     else
     {
+        /*the clone gets the decoded properties rather than a second deferred decode*/
+        decode_properties_if_needed(iotHubMessageHandle);
         result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
         if (result == NULL)
         {
@@ -532,6 +560,7 @@ MAP_HANDLE IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
         result = handleData->properties;
     }
     return result;
@@ -547,7 +576,9 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetProperty(IOTHUB_MESSAGE_HANDLE msg_handle
     }
     else
     {
-        MAP_RESULT map_result = Map_AddOrUpdate(msg_handle->properties, key, value);
+        MAP_RESULT map_result;
+        decode_properties_if_needed(msg_handle);
+        map_result = Map_AddOrUpdate(msg_handle->properties, key, value);
         if (map_result == MAP_FILTER_REJECT)
         {
             LogError("Failure validating property as ASCII");
@@ -577,6 +608,7 @@ const char* IoTHubMessage_GetProperty(IOTHUB_MESSAGE_HANDLE msg_handle, const ch
     else
     {
         bool key_exists = false;
+        decode_properties_if_needed(msg_handle);
         // The return value is not necessary, just check the key_exist variable
         if ((Map_ContainsKey(msg_handle->properties, key, &key_exists) == MAP_OK) && key_exists)
         {
@@ -601,6 +633,7 @@ const char* IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHa
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
         result = handleData->correlationId;
     }
     return result;
@@ -617,6 +650,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHu
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
         if (handleData->correlationId != NULL)
         {
             free(handleData->correlationId);
@@ -646,6 +680,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMes
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
         if (handleData->messageId != NULL)
         {
             free(handleData->messageId);
@@ -675,6 +710,7 @@ const char* IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
         result = handleData->messageId;
     }
     return result;
@@ -692,6 +728,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
 
         if (handleData->userDefinedContentType != NULL)
         {
@@ -725,6 +762,7 @@ const char* IoTHubMessage_GetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE iot
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
 
         result = (const char*)handleData->userDefinedContentType;
     }
@@ -743,6 +781,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESS
     }
     else
     {
+        decode_properties_if_needed(iotHubMessageHandle);
         if (set_content_encoding(iotHubMessageHandle, contentEncoding) != 0)
         {
             LogError("Failed saving a copy of contentEncoding");
@@ -768,6 +807,7 @@ const char* IoTHubMessage_GetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
 
         result = (const char*)handleData->contentEncoding;
     }
@@ -786,6 +826,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetMessageCreationTimeUtcSystemProperty(IOTH
     }
     else
     {
+        decode_properties_if_needed(iotHubMessageHandle);
         if (set_message_creation_time(iotHubMessageHandle, creationTimeUtc) != 0)
         {
             LogError("Failed saving a copy of creationTimeUtc");
@@ -811,6 +852,7 @@ const char* IoTHubMessage_GetMessageCreationTimeUtcSystemProperty(IOTHUB_MESSAGE
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
         result = (const char*)handleData->creationTimeUtc;
     }
 
@@ -828,6 +870,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetMessageUserIdSystemProperty(IOTHUB_MESSAG
     }
     else
     {
+        decode_properties_if_needed(iotHubMessageHandle);
         if (set_message_user_id(iotHubMessageHandle, userId) != 0)
         {
             LogError("Failed saving a copy of userId");
@@ -853,6 +896,7 @@ const char* IoTHubMessage_GetMessageUserIdSystemProperty(IOTHUB_MESSAGE_HANDLE i
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
         result = (const char*)handleData->userId;
     }
 
@@ -1019,6 +1063,7 @@ const char* IoTHubMessage_GetConnectionModuleId(IOTHUB_MESSAGE_HANDLE iotHubMess
     }
     else
     {
+        decode_properties_if_needed(iotHubMessageHandle);
         result = iotHubMessageHandle->connectionModuleId;
     }
     return result;
@@ -1036,6 +1081,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetConnectionModuleId(IOTHUB_MESSAGE_HANDLE
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
 
         if (handleData->connectionModuleId != NULL)
         {
@@ -1069,6 +1115,7 @@ const char* IoTHubMessage_GetConnectionDeviceId(IOTHUB_MESSAGE_HANDLE iotHubMess
     }
     else
     {
+        decode_properties_if_needed(iotHubMessageHandle);
         result = iotHubMessageHandle->connectionDeviceId;
     }
     return result;
@@ -1086,6 +1133,7 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetConnectionDeviceId(IOTHUB_MESSAGE_HANDLE
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
+        decode_properties_if_needed(iotHubMessageHandle);
 
         if (handleData->connectionDeviceId != NULL)
         {
@@ -1238,3 +1286,69 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_GetDispositionContext(IOTHUB_MESSAGE_HANDLE
 
     return result;
 }
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetPropertiesSource(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, MESSAGE_PROPERTIES_SOURCE_HANDLE propertiesSource, MESSAGE_PROPERTIES_DECODE_FUNCTION propertiesDecodeFunction, MESSAGE_PROPERTIES_SOURCE_DESTROY_FUNCTION propertiesSourceDestroyFunction)
+{
+    IOTHUB_MESSAGE_RESULT result;
+
+    if (iotHubMessageHandle == NULL || propertiesSource == NULL || propertiesDecodeFunction == NULL || propertiesSourceDestroyFunction == NULL)
+    {
+        LogError("Invalid argument (iotHubMessageHandle=%p, propertiesSource=%p, propertiesDecodeFunction=%p, propertiesSourceDestroyFunction=%p)",
+            iotHubMessageHandle, propertiesSource, propertiesDecodeFunction, propertiesSourceDestroyFunction);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else if (iotHubMessageHandle->propertiesSource != NULL)
+    {
+        LogError("The message already has a properties source");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
+    else
+    {
+        iotHubMessageHandle->propertiesSource = propertiesSource;
+        iotHubMessageHandle->propertiesDecodeFunction = propertiesDecodeFunction;
+        iotHubMessageHandle->propertiesSourceDestroyFunction = propertiesSourceDestroyFunction;
+        result = IOTHUB_MESSAGE_OK;
+    }
+
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetEncodedByteArray(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, BUFFER_HANDLE byteArray, const char* contentEncoding)
+{
+    IOTHUB_MESSAGE_RESULT result;
+
+    if (iotHubMessageHandle == NULL || byteArray == NULL || contentEncoding == NULL)
+    {
+        LogError("Invalid argument (iotHubMessageHandle=%p, byteArray=%p, contentEncoding=%p)",
+            iotHubMessageHandle, byteArray, contentEncoding);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        decode_properties_if_needed(iotHubMessageHandle);
+
+        // Setting the content encoding is the only step that can fail, so it goes first and leaves the body as it was
+        if (set_content_encoding(iotHubMessageHandle, contentEncoding) != 0)
+        {
+            LogError("Failed saving a copy of contentEncoding");
+            result = IOTHUB_MESSAGE_ERROR;
+        }
+        else
+        {
+            if (iotHubMessageHandle->contentType == IOTHUBMESSAGE_BYTEARRAY)
+            {
+                BUFFER_delete(iotHubMessageHandle->value.byteArray);
+            }
+            else if (iotHubMessageHandle->contentType == IOTHUBMESSAGE_STRING)
+            {
+                STRING_delete(iotHubMessageHandle->value.string);
+            }
+
+            iotHubMessageHandle->contentType = IOTHUBMESSAGE_BYTEARRAY;
+            iotHubMessageHandle->value.byteArray = byteArray;
+            result = IOTHUB_MESSAGE_OK;
+        }
+    }
+
+    return result;
+}
@@ -19,39 +19,156 @@
 #include "iothub_transport_ll.h"
 #include "iothub_client_core.h"
 
-typedef struct TRANSPORT_HANDLE_DATA_TAG
+#define TRANSPORT_WORKER_THREAD_COUNT_DEFAULT 1
+#define TRANSPORT_WORKER_THREAD_COUNT_MAX 64
+
+struct TRANSPORT_HANDLE_DATA_TAG;
+
+typedef struct TRANSPORT_SHARD_CLIENT_TAG
+{
+    IOTHUB_CLIENT_CORE_HANDLE clientHandle;
+    bool running; /* set by IoTHubTransport_StartWorkerThread; a client still being created is bound but not run */
+} TRANSPORT_SHARD_CLIENT;
+
+/* Each shard owns a lower layer transport instance - its own connection - with the lock that serializes
+   it and the thread that drives it. A client is bound to a shard when it is created: it registers on the
+   shard's lower layer and takes the shard lock as its own, so the lower layer DoWork, the network I/O and
+   the send queue drain of one shard never wait for another shard. */
+typedef struct TRANSPORT_WORKER_SHARD_TAG
 {
+    struct TRANSPORT_HANDLE_DATA_TAG* transportData;
     TRANSPORT_LL_HANDLE transportLLHandle;
-    THREAD_HANDLE workerThreadHandle;
     LOCK_HANDLE lockHandle;
+    THREAD_HANDLE workerThreadHandle;
     sig_atomic_t stopThread;
-    TRANSPORT_PROVIDER_FIELDS;
     VECTOR_HANDLE clients;
     LOCK_HANDLE clientsLockHandle;
+} TRANSPORT_WORKER_SHARD;
+
+typedef struct TRANSPORT_HANDLE_DATA_TAG
+{
+    TRANSPORT_PROVIDER_FIELDS;
+    IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;
+    char* iotHubName;
+    char* iotHubSuffix;
+    TRANSPORT_WORKER_SHARD* shards;
+    size_t shardCount;
     IOTHUB_CLIENT_MULTIPLEXED_DO_WORK clientDoWork;
 } TRANSPORT_HANDLE_DATA;
 
-/* Used for Unit test */
-const size_t IoTHubTransport_ThreadTerminationOffset = offsetof(TRANSPORT_HANDLE_DATA, stopThread);
+static void destroy_shards(TRANSPORT_HANDLE_DATA* transportData, TRANSPORT_WORKER_SHARD* shards, size_t shardCount)
+{
+    size_t index;
+    for (index = 0; index < shardCount; index++)
+    {
+        if (shards[index].transportLLHandle != NULL)
+        {
+            (transportData->IoTHubTransport_Destroy)(shards[index].transportLLHandle);
+        }
+        if (shards[index].lockHandle != NULL)
+        {
+            Lock_Deinit(shards[index].lockHandle);
+        }
+        if (shards[index].clients != NULL)
+        {
+            VECTOR_destroy(shards[index].clients);
+        }
+        if (shards[index].clientsLockHandle != NULL)
+        {
+            Lock_Deinit(shards[index].clientsLockHandle);
+        }
+    }
+    free(shards);
+}
 
-TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
+static TRANSPORT_LL_HANDLE create_lower_layer(TRANSPORT_HANDLE_DATA* transportData)
 {
-    TRANSPORT_HANDLE_DATA *result;
+    TRANSPORT_LL_HANDLE result;
     TRANSPORT_CALLBACKS_INFO transport_cb;
 
-    if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL)
+    if (IoTHubClientCore_LL_GetTransportCallbacks(&transport_cb) != 0)
     {
-        LogError("Invalid NULL argument, protocol [%p], name [%p], suffix [%p].", protocol, iotHubName, iotHubSuffix);
+        LogError("Failure getting transport callbacks");
         result = NULL;
     }
-    else if (IoTHubClientCore_LL_GetTransportCallbacks(&transport_cb) != 0)
+    else
     {
-        LogError("Failure getting transport callbacks");
+        IOTHUB_CLIENT_CONFIG upperConfig;
+        upperConfig.deviceId = NULL;
+        upperConfig.deviceKey = NULL;
+        upperConfig.iotHubName = transportData->iotHubName;
+        upperConfig.iotHubSuffix = transportData->iotHubSuffix;
+        upperConfig.protocol = transportData->protocol;
+        upperConfig.protocolGatewayHostName = NULL;
+
+        IOTHUBTRANSPORT_CONFIG transportLLConfig;
+        memset(&transportLLConfig, 0, sizeof(IOTHUBTRANSPORT_CONFIG));
+        transportLLConfig.upperConfig = &upperConfig;
+        transportLLConfig.waitingToSend = NULL;
+
+        result = transportData->IoTHubTransport_Create(&transportLLConfig, &transport_cb, NULL);
+    }
+    return result;
+}
+
+static TRANSPORT_WORKER_SHARD* create_shards(TRANSPORT_HANDLE_DATA* transportData, size_t shardCount)
+{
+    TRANSPORT_WORKER_SHARD* result = (TRANSPORT_WORKER_SHARD*)calloc(shardCount, sizeof(TRANSPORT_WORKER_SHARD));
+    if (result == NULL)
+    {
+        LogError("worker shards not allocated.");
+    }
+    else
+    {
+        size_t index;
+        for (index = 0; index < shardCount; index++)
+        {
+            result[index].transportData = transportData;
+            result[index].stopThread = 1;
+            result[index].workerThreadHandle = NULL; /* create thread when work needs to be done */
+            if ((result[index].transportLLHandle = create_lower_layer(transportData)) == NULL)
+            {
+                LogError("Lower Layer transport not created.");
+                break;
+            }
+            else if ((result[index].lockHandle = Lock_Init()) == NULL)
+            {
+                LogError("transport Lock not created.");
+                break;
+            }
+            else if ((result[index].clientsLockHandle = Lock_Init()) == NULL)
+            {
+                LogError("clients Lock not created.");
+                break;
+            }
+            else if ((result[index].clients = VECTOR_create(sizeof(TRANSPORT_SHARD_CLIENT))) == NULL)
+            {
+                LogError("clients list not created.");
+                break;
+            }
+        }
+
+        if (index != shardCount)
+        {
+            destroy_shards(transportData, result, shardCount);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
+{
+    TRANSPORT_HANDLE_DATA *result;
+
+    if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL)
+    {
+        LogError("Invalid NULL argument, protocol [%p], name [%p], suffix [%p].", protocol, iotHubName, iotHubSuffix);
         result = NULL;
     }
     else
     {
-        result = (TRANSPORT_HANDLE_DATA*)malloc(sizeof(TRANSPORT_HANDLE_DATA));
+        result = (TRANSPORT_HANDLE_DATA*)calloc(1, sizeof(TRANSPORT_HANDLE_DATA));
         if (result == NULL)
         {
             LogError("Transport handle was not allocated.");
@@ -59,74 +176,41 @@ TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoco
         else
         {
             TRANSPORT_PROVIDER * transportProtocol = (TRANSPORT_PROVIDER*)(protocol());
-            IOTHUB_CLIENT_CONFIG upperConfig;
-            upperConfig.deviceId = NULL;
-            upperConfig.deviceKey = NULL;
-            upperConfig.iotHubName = iotHubName;
-            upperConfig.iotHubSuffix = iotHubSuffix;
-            upperConfig.protocol = protocol;
-            upperConfig.protocolGatewayHostName = NULL;
-
-            IOTHUBTRANSPORT_CONFIG transportLLConfig;
-            memset(&transportLLConfig, 0, sizeof(IOTHUBTRANSPORT_CONFIG));
-            transportLLConfig.upperConfig = &upperConfig;
-            transportLLConfig.waitingToSend = NULL;
-
-            result->transportLLHandle = transportProtocol->IoTHubTransport_Create(&transportLLConfig, &transport_cb, NULL);
-            if (result->transportLLHandle == NULL)
+            result->protocol = protocol;
+            result->clientDoWork = NULL;
+            result->IoTHubTransport_GetHostname = transportProtocol->IoTHubTransport_GetHostname;
+            result->IoTHubTransport_SetOption = transportProtocol->IoTHubTransport_SetOption;
+            result->IoTHubTransport_Create = transportProtocol->IoTHubTransport_Create;
+            result->IoTHubTransport_Destroy = transportProtocol->IoTHubTransport_Destroy;
+            result->IoTHubTransport_Register = transportProtocol->IoTHubTransport_Register;
+            result->IoTHubTransport_Unregister = transportProtocol->IoTHubTransport_Unregister;
+            result->IoTHubTransport_Subscribe = transportProtocol->IoTHubTransport_Subscribe;
+            result->IoTHubTransport_Unsubscribe = transportProtocol->IoTHubTransport_Unsubscribe;
+            result->IoTHubTransport_DoWork = transportProtocol->IoTHubTransport_DoWork;
+            result->IoTHubTransport_SetRetryPolicy = transportProtocol->IoTHubTransport_SetRetryPolicy;
+            result->IoTHubTransport_GetSendStatus = transportProtocol->IoTHubTransport_GetSendStatus;
+
+            /* kept to create the lower layer of shards added by IoTHubTransport_SetWorkerThreadCount */
+            if (mallocAndStrcpy_s(&result->iotHubName, iotHubName) != 0 ||
+                mallocAndStrcpy_s(&result->iotHubSuffix, iotHubSuffix) != 0)
             {
-                LogError("Lower Layer transport not created.");
+                LogError("Failed copying the IoT Hub name.");
+                free(result->iotHubName);
+                free(result->iotHubSuffix);
+                free(result);
+                result = NULL;
+            }
+            else if ((result->shards = create_shards(result, TRANSPORT_WORKER_THREAD_COUNT_DEFAULT)) == NULL)
+            {
+                LogError("worker shards not created.");
+                free(result->iotHubName);
+                free(result->iotHubSuffix);
                 free(result);
                 result = NULL;
             }
             else
             {
-                result->lockHandle = Lock_Init();
-                if (result->lockHandle == NULL)
-                {
-                    LogError("transport Lock not created.");
-                    transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
-                    free(result);
-                    result = NULL;
-                }
-                else if ((result->clientsLockHandle = Lock_Init()) == NULL)
-                {
-                    LogError("clients Lock not created.");
-                    Lock_Deinit(result->lockHandle);
-                    transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    result->clients = VECTOR_create(sizeof(IOTHUB_CLIENT_CORE_HANDLE));
-                    if (result->clients == NULL)
-                    {
-                        LogError("clients list not created.");
-                        Lock_Deinit(result->clientsLockHandle);
-                        Lock_Deinit(result->lockHandle);
-                        transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
-                        free(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        result->stopThread = 1;
-                        result->clientDoWork = NULL;
-                        result->workerThreadHandle = NULL; /* create thread when work needs to be done */
-                        result->IoTHubTransport_GetHostname = transportProtocol->IoTHubTransport_GetHostname;
-                        result->IoTHubTransport_SetOption = transportProtocol->IoTHubTransport_SetOption;
-                        result->IoTHubTransport_Create = transportProtocol->IoTHubTransport_Create;
-                        result->IoTHubTransport_Destroy = transportProtocol->IoTHubTransport_Destroy;
-                        result->IoTHubTransport_Register = transportProtocol->IoTHubTransport_Register;
-                        result->IoTHubTransport_Unregister = transportProtocol->IoTHubTransport_Unregister;
-                        result->IoTHubTransport_Subscribe = transportProtocol->IoTHubTransport_Subscribe;
-                        result->IoTHubTransport_Unsubscribe = transportProtocol->IoTHubTransport_Unsubscribe;
-                        result->IoTHubTransport_DoWork = transportProtocol->IoTHubTransport_DoWork;
-                        result->IoTHubTransport_SetRetryPolicy = transportProtocol->IoTHubTransport_SetRetryPolicy;
-                        result->IoTHubTransport_GetSendStatus = transportProtocol->IoTHubTransport_GetSendStatus;
-                    }
-                }
+                result->shardCount = TRANSPORT_WORKER_THREAD_COUNT_DEFAULT;
             }
         }
     }
@@ -134,9 +218,9 @@ TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoco
     return result;
 }
 
-static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
+static void multiplexed_client_do_work(TRANSPORT_WORKER_SHARD* shard)
 {
-    if (Lock(transportData->clientsLockHandle) != LOCK_OK)
+    if (Lock(shard->clientsLockHandle) != LOCK_OK)
     {
         LogError("failed to lock for multiplexed_client_do_work");
     }
@@ -145,18 +229,18 @@ static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
         size_t numberOfClients;
         size_t iterator;
 
-        numberOfClients = VECTOR_size(transportData->clients);
+        numberOfClients = VECTOR_size(shard->clients);
         for (iterator = 0; iterator < numberOfClients; iterator++)
         {
-            IOTHUB_CLIENT_CORE_HANDLE* clientHandle = (IOTHUB_CLIENT_CORE_HANDLE*)VECTOR_element(transportData->clients, iterator);
+            TRANSPORT_SHARD_CLIENT* client = (TRANSPORT_SHARD_CLIENT*)VECTOR_element(shard->clients, iterator);
 
-            if (clientHandle != NULL)
+            if (client != NULL && client->running)
             {
-                transportData->clientDoWork(*clientHandle);
+                shard->transportData->clientDoWork(client->clientHandle);
             }
         }
 
-        if (Unlock(transportData->clientsLockHandle) != LOCK_OK)
+        if (Unlock(shard->clientsLockHandle) != LOCK_OK)
         {
             LogError("failed to unlock on multiplexed_client_do_work");
         }
@@ -165,26 +249,26 @@ static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
 
 static int transport_worker_thread(void* threadArgument)
 {
-    TRANSPORT_HANDLE_DATA* transportData = (TRANSPORT_HANDLE_DATA*)threadArgument;
+    TRANSPORT_WORKER_SHARD* shard = (TRANSPORT_WORKER_SHARD*)threadArgument;
 
     while (1)
     {
-        if (Lock(transportData->lockHandle) == LOCK_OK)
+        if (Lock(shard->lockHandle) == LOCK_OK)
         {
-            if (transportData->stopThread)
+            if (shard->stopThread)
             {
-                (void)Unlock(transportData->lockHandle);
+                (void)Unlock(shard->lockHandle);
                 break;
             }
             else
             {
-                (transportData->IoTHubTransport_DoWork)(transportData->transportLLHandle);
+                (shard->transportData->IoTHubTransport_DoWork)(shard->transportLLHandle);
 
-                (void)Unlock(transportData->lockHandle);
+                (void)Unlock(shard->lockHandle);
             }
         }
 
-        multiplexed_client_do_work(transportData);
+        multiplexed_client_do_work(shard);
 
         ThreadAPI_Sleep(1);
     }
@@ -196,133 +280,220 @@ static int transport_worker_thread(void* threadArgument)
 static bool find_by_handle(const void* element, const void* value)
 {
     /* data stored at element is device handle */
-    const IOTHUB_CLIENT_CORE_HANDLE * guess = (const IOTHUB_CLIENT_CORE_HANDLE *)element;
+    const TRANSPORT_SHARD_CLIENT * guess = (const TRANSPORT_SHARD_CLIENT *)element;
     const IOTHUB_CLIENT_CORE_HANDLE match = (const IOTHUB_CLIENT_CORE_HANDLE)value;
-    return (*guess == match);
+    return (guess->clientHandle == match);
 }
 
-static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * transportData, IOTHUB_CLIENT_CORE_HANDLE clientHandle)
+static void set_shard_stop(TRANSPORT_WORKER_SHARD* shard, sig_atomic_t stopThread)
 {
-    IOTHUB_CLIENT_RESULT result;
-    if (transportData->workerThreadHandle == NULL)
+    if (Lock(shard->lockHandle) != LOCK_OK)
     {
-        transportData->stopThread = 0;
-        if (ThreadAPI_Create(&transportData->workerThreadHandle, transport_worker_thread, transportData) != THREADAPI_OK)
-        {
-            transportData->workerThreadHandle = NULL;
-        }
+        // Need to setup a critical error function here to inform the user that an critical error
+        // has occurred.
+        LogError("Unable to lock - will still attempt to end thread without thread safety");
+        shard->stopThread = stopThread;
     }
-    if (transportData->workerThreadHandle != NULL)
+    else
     {
-        if (Lock(transportData->clientsLockHandle) != LOCK_OK)
-        {
-            LogError("failed to lock for start_worker_if_needed");
-            result = IOTHUB_CLIENT_ERROR;
-        }
-        else
+        shard->stopThread = stopThread;
+        (void)Unlock(shard->lockHandle);
+    }
+}
+
+static void stop_worker_thread(TRANSPORT_HANDLE_DATA* transportData)
+{
+    size_t index;
+
+    for (index = 0; index < transportData->shardCount; index++)
+    {
+        set_shard_stop(&transportData->shards[index], 1);
+    }
+}
+
+static void wait_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
+{
+    size_t index;
+
+    for (index = 0; index < transportData->shardCount; index++)
+    {
+        if (transportData->shards[index].workerThreadHandle != NULL)
         {
-            bool addToList = ((VECTOR_size(transportData->clients) == 0) || (VECTOR_find_if(transportData->clients, find_by_handle, clientHandle) == NULL));
-            if (addToList)
+            int res;
+            if (ThreadAPI_Join(transportData->shards[index].workerThreadHandle, &res) != THREADAPI_OK)
             {
-                if (VECTOR_push_back(transportData->clients, &clientHandle, 1) != 0)
-                {
-                    LogError("Failed adding device to list (VECTOR_push_back failed)");
-                    result = IOTHUB_CLIENT_ERROR;
-                }
-                else
-                {
-                    result = IOTHUB_CLIENT_OK;
-                }
+                LogError("ThreadAPI_Join failed on shard %lu", (unsigned long)index);
             }
             else
             {
-                result = IOTHUB_CLIENT_OK;
+                transportData->shards[index].workerThreadHandle = NULL;
             }
+        }
+    }
+}
 
-            if (Unlock(transportData->clientsLockHandle) != LOCK_OK)
+/* returns the shard the client is bound to, or NULL. Each shard lock is taken in turn. */
+static TRANSPORT_WORKER_SHARD* find_client_shard(TRANSPORT_HANDLE_DATA* transportData, IOTHUB_CLIENT_CORE_HANDLE clientHandle)
+{
+    TRANSPORT_WORKER_SHARD* result = NULL;
+    size_t index;
+
+    for (index = 0; index < transportData->shardCount && result == NULL; index++)
+    {
+        if (Lock(transportData->shards[index].clientsLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock shard %lu", (unsigned long)index);
+        }
+        else
+        {
+            if (VECTOR_find_if(transportData->shards[index].clients, find_by_handle, clientHandle) != NULL)
             {
-                LogError("failed to unlock on start_worker_if_needed");
+                result = &transportData->shards[index];
             }
+            (void)Unlock(transportData->shards[index].clientsLockHandle);
         }
     }
-    else
+    return result;
+}
+
+/* the shard with the fewest clients receives new clients so the connections stay balanced */
+static TRANSPORT_WORKER_SHARD* select_shard(TRANSPORT_HANDLE_DATA* transportData)
+{
+    TRANSPORT_WORKER_SHARD* result = &transportData->shards[0];
+    size_t smallest = (size_t)-1;
+    size_t index;
+
+    for (index = 0; index < transportData->shardCount; index++)
     {
-        result = IOTHUB_CLIENT_ERROR;
+        if (Lock(transportData->shards[index].clientsLockHandle) == LOCK_OK)
+        {
+            size_t size = VECTOR_size(transportData->shards[index].clients);
+            (void)Unlock(transportData->shards[index].clientsLockHandle);
+            if (size < smallest)
+            {
+                smallest = size;
+                result = &transportData->shards[index];
+            }
+        }
     }
     return result;
 }
 
-static void stop_worker_thread(TRANSPORT_HANDLE_DATA* transportData)
+static IOTHUB_CLIENT_RESULT set_client_running(TRANSPORT_WORKER_SHARD* shard, IOTHUB_CLIENT_CORE_HANDLE clientHandle, bool running)
 {
-    if (Lock(transportData->lockHandle) != LOCK_OK)
+    IOTHUB_CLIENT_RESULT result;
+
+    if (Lock(shard->clientsLockHandle) != LOCK_OK)
     {
-        // Need to setup a critical error function here to inform the user that an critical error
-        // has occurred.
-        LogError("Unable to lock - will still attempt to end thread without thread safety");
-        transportData->stopThread = 1;
+        LogError("failed to lock for set_client_running");
+        result = IOTHUB_CLIENT_ERROR;
     }
     else
     {
-        transportData->stopThread = 1;
-        (void)Unlock(transportData->lockHandle);
-    }
+        TRANSPORT_SHARD_CLIENT* client = (TRANSPORT_SHARD_CLIENT*)VECTOR_find_if(shard->clients, find_by_handle, clientHandle);
+        if (client == NULL)
+        {
+            LogError("client is no longer bound to the transport");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            client->running = running;
+            result = IOTHUB_CLIENT_OK;
+        }
 
+        if (Unlock(shard->clientsLockHandle) != LOCK_OK)
+        {
+            LogError("failed to unlock on set_client_running");
+        }
+    }
+    return result;
 }
 
-static void wait_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
+static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * transportData, IOTHUB_CLIENT_CORE_HANDLE clientHandle)
 {
-    if (transportData->workerThreadHandle != NULL)
+    IOTHUB_CLIENT_RESULT result;
+    TRANSPORT_WORKER_SHARD* shard = find_client_shard(transportData, clientHandle);
+
+    if (shard == NULL)
+    {
+        LogError("client was not created on this transport");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
     {
-        int res;
-        if (ThreadAPI_Join(transportData->workerThreadHandle, &res) != THREADAPI_OK)
+        if (shard->workerThreadHandle == NULL)
+        {
+            set_shard_stop(shard, 0);
+            if (ThreadAPI_Create(&shard->workerThreadHandle, transport_worker_thread, shard) != THREADAPI_OK)
+            {
+                LogError("Unable to create transport worker thread");
+                shard->workerThreadHandle = NULL;
+                set_shard_stop(shard, 1);
+            }
+        }
+
+        if (shard->workerThreadHandle != NULL)
         {
-            LogError("ThreadAPI_Join failed");
+            result = set_client_running(shard, clientHandle, true);
         }
         else
         {
-            transportData->workerThreadHandle = NULL;
+            result = IOTHUB_CLIENT_ERROR;
         }
     }
+    return result;
 }
 
 static bool signal_end_worker_thread(TRANSPORT_HANDLE_DATA * transportData, IOTHUB_CLIENT_CORE_HANDLE clientHandle)
 {
-    bool okToJoin;
+    bool okToJoin = false;
+    bool threadsRunning = false;
+    size_t runningClients = 0;
+    size_t index;
 
-    if (Lock(transportData->clientsLockHandle) != LOCK_OK)
-    {
-        LogError("failed to lock for signal_end_worker_thread");
-        okToJoin = false;
-    }
-    else
+    for (index = 0; index < transportData->shardCount; index++)
     {
-        void* element = VECTOR_find_if(transportData->clients, find_by_handle, clientHandle);
-        if (element != NULL)
+        TRANSPORT_WORKER_SHARD* shard = &transportData->shards[index];
+
+        if (Lock(shard->clientsLockHandle) != LOCK_OK)
         {
-            VECTOR_erase(transportData->clients, element, 1);
+            LogError("failed to lock shard %lu, assuming it still has clients", (unsigned long)index);
+            runningClients++;
         }
-        if (transportData->workerThreadHandle != NULL)
+        else
         {
-            if (VECTOR_size(transportData->clients) == 0)
+            size_t numberOfClients;
+            size_t iterator;
+            void* element = VECTOR_find_if(shard->clients, find_by_handle, clientHandle);
+            if (element != NULL)
             {
-                stop_worker_thread(transportData);
-                okToJoin = true;
+                VECTOR_erase(shard->clients, element, 1);
             }
-            else
+
+            numberOfClients = VECTOR_size(shard->clients);
+            for (iterator = 0; iterator < numberOfClients; iterator++)
             {
-                okToJoin = false;
+                if (((TRANSPORT_SHARD_CLIENT*)VECTOR_element(shard->clients, iterator))->running)
+                {
+                    runningClients++;
+                }
             }
-        }
-        else
-        {
-            okToJoin = false;
+            (void)Unlock(shard->clientsLockHandle);
         }
 
-        if (Unlock(transportData->clientsLockHandle) != LOCK_OK)
+        if (shard->workerThreadHandle != NULL)
         {
-            LogError("failed to unlock on signal_end_worker_thread");
+            threadsRunning = true;
         }
     }
+
+    if (threadsRunning && runningClients == 0)
+    {
+        stop_worker_thread(transportData);
+        okToJoin = true;
+    }
+
     return okToJoin;
 }
 
@@ -333,14 +504,121 @@ void IoTHubTransport_Destroy(TRANSPORT_HANDLE transportHandle)
         TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
         stop_worker_thread(transportData);
         wait_worker_thread(transportData);
-        Lock_Deinit(transportData->lockHandle);
-        (transportData->IoTHubTransport_Destroy)(transportData->transportLLHandle);
-        VECTOR_destroy(transportData->clients);
-        Lock_Deinit(transportData->clientsLockHandle);
+        destroy_shards(transportData, transportData->shards, transportData->shardCount);
+        free(transportData->iotHubName);
+        free(transportData->iotHubSuffix);
         free(transportHandle);
     }
 }
 
+int IoTHubTransport_SetWorkerThreadCount(TRANSPORT_HANDLE transportHandle, size_t workerThreadCount)
+{
+    int result;
+
+    if (transportHandle == NULL || workerThreadCount == 0 || workerThreadCount > TRANSPORT_WORKER_THREAD_COUNT_MAX)
+    {
+        LogError("Invalid argument, transportHandle [%p], workerThreadCount [%lu] (maximum %d).", transportHandle, (unsigned long)workerThreadCount, TRANSPORT_WORKER_THREAD_COUNT_MAX);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+        size_t boundClients = 0;
+        size_t index;
+
+        for (index = 0; index < transportData->shardCount; index++)
+        {
+            if (Lock(transportData->shards[index].clientsLockHandle) != LOCK_OK)
+            {
+                LogError("failed to lock shard %lu, assuming it has clients", (unsigned long)index);
+                boundClients++;
+            }
+            else
+            {
+                boundClients += VECTOR_size(transportData->shards[index].clients);
+                (void)Unlock(transportData->shards[index].clientsLockHandle);
+            }
+        }
+
+        if (boundClients != 0)
+        {
+            LogError("Worker thread count cannot be changed once clients are created on the transport");
+            result = MU_FAILURE;
+        }
+        else if (workerThreadCount == transportData->shardCount)
+        {
+            result = 0;
+        }
+        else
+        {
+            /* no client is registered on the lower layers and no thread runs without clients, so the shards can simply be replaced */
+            TRANSPORT_WORKER_SHARD* shards;
+
+            stop_worker_thread(transportData);
+            wait_worker_thread(transportData);
+            if ((shards = create_shards(transportData, workerThreadCount)) == NULL)
+            {
+                LogError("Failed creating %lu worker shards", (unsigned long)workerThreadCount);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                destroy_shards(transportData, transportData->shards, transportData->shardCount);
+                transportData->shards = shards;
+                transportData->shardCount = workerThreadCount;
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubTransport_BindClient(TRANSPORT_HANDLE transportHandle, IOTHUB_CLIENT_CORE_HANDLE clientHandle, LOCK_HANDLE* lockHandle, TRANSPORT_LL_HANDLE* transportLLHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (transportHandle == NULL || clientHandle == NULL || lockHandle == NULL || transportLLHandle == NULL)
+    {
+        LogError("Invalid argument, transportHandle [%p], clientHandle [%p], lockHandle [%p], transportLLHandle [%p].", transportHandle, clientHandle, lockHandle, transportLLHandle);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+        TRANSPORT_WORKER_SHARD* shard = select_shard(transportData);
+
+        if (Lock(shard->clientsLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for IoTHubTransport_BindClient");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            TRANSPORT_SHARD_CLIENT client;
+            client.clientHandle = clientHandle;
+            client.running = false;
+
+            if (VECTOR_push_back(shard->clients, &client, 1) != 0)
+            {
+                LogError("Failed adding device to list (VECTOR_push_back failed)");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                *lockHandle = shard->lockHandle;
+                *transportLLHandle = shard->transportLLHandle;
+                result = IOTHUB_CLIENT_OK;
+            }
+
+            if (Unlock(shard->clientsLockHandle) != LOCK_OK)
+            {
+                LogError("failed to unlock on IoTHubTransport_BindClient");
+            }
+        }
+    }
+    return result;
+}
+
 LOCK_HANDLE IoTHubTransport_GetLock(TRANSPORT_HANDLE transportHandle)
 {
     LOCK_HANDLE lock;
@@ -351,7 +629,7 @@ LOCK_HANDLE IoTHubTransport_GetLock(TRANSPORT_HANDLE transportHandle)
     else
     {
         TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
-        lock = transportData->lockHandle;
+        lock = transportData->shards[0].lockHandle;
     }
     return lock;
 }
@@ -366,7 +644,7 @@ TRANSPORT_LL_HANDLE IoTHubTransport_GetLLTransport(TRANSPORT_HANDLE transportHan
     else
     {
         TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
-        llTransport = transportData->transportLLHandle;
+        llTransport = transportData->shards[0].transportLLHandle;
     }
     return llTransport;
 }
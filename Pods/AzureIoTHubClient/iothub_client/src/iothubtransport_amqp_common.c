@@ -12,6 +12,7 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/timer_wheel.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/strings.h"
@@ -134,6 +135,7 @@ typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
     AMQP_DEVICE_HANDLE device_handle;                                   // Logic unit that performs authentication, messaging, etc.
     AMQP_TRANSPORT_INSTANCE* transport_instance;                        // Saved reference to the transport the device is registered on.
     PDLIST_ENTRY waiting_to_send;                                       // List of events waiting to be sent to the iot hub (i.e., haven't been processed by the transport yet).
+    IOTHUB_CLIENT_METRICS_HANDLE metrics;                               // The client's counters; IOTHUB_CLIENT_METRICS_WAITING_TO_SEND drops as events leave waiting_to_send.
     DEVICE_STATE device_state;                                          // Current state of the device_handle instance.
     size_t number_of_previous_failures;                                 // Number of times the device has failed in sequence; this value is reset to 0 if device succeeds to authenticate, send and/or recv messages.
     size_t number_of_send_event_complete_failures;                      // Number of times on_event_send_complete was called in row with an error.
@@ -897,6 +899,9 @@ static IOTHUB_MESSAGE_LIST* get_next_event_to_send(AMQP_TRANSPORT_DEVICE_INSTANC
         PDLIST_ENTRY list_entry = registered_device->waiting_to_send->Flink;
         message = containingRecord(list_entry, IOTHUB_MESSAGE_LIST, entry);
         (void)DList_RemoveEntryList(list_entry);
+        // From here on the messenger's own timeouts apply, not the client's.
+        timer_wheel_cancel(&message->timeout_entry);
+        iothub_client_metrics_subtract(registered_device->metrics, IOTHUB_CLIENT_METRICS_WAITING_TO_SEND, 1);
     }
     else
     {
@@ -2053,6 +2058,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                 amqp_device_instance->is_quota_exceeded = false;  
                 amqp_device_instance->transport_ctx = transport_instance->transport_ctx;
                 amqp_device_instance->transport_callbacks = transport_instance->transport_callbacks;
+                amqp_device_instance->metrics = (transport_instance->transport_callbacks.get_metrics_cb == NULL) ? NULL : transport_instance->transport_callbacks.get_metrics_cb(transport_instance->transport_ctx);
 
                 if ((amqp_device_instance->device_id = STRING_construct(device->deviceId)) == NULL)
                 {
@@ -14,6 +14,7 @@
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/sastoken.h"
 #include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/timer_wheel.h"
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/string_tokenizer.h"
@@ -22,6 +23,7 @@
 
 #include "internal/iothub_client_private.h"
 #include "internal/iothub_client_retry_control.h"
+#include "internal/iothub_client_metrics.h"
 #include "internal/iothub_transport_ll_private.h"
 #include "internal/iothubtransport_mqtt_common.h"
 #include "internal/iothubtransport.h"
@@ -59,6 +61,18 @@
 
 #define ON_DEMAND_GET_TWIN_REQUEST_TIMEOUT_SECS    60
 #define TWIN_REPORT_UPDATE_TIMEOUT_SECS           (60*5)
+#define TIMEOUT_RESOLUTION_MS                     100
+#define POLL_INTERVAL_WITHOUT_EVENTS_MS           100 // reconnect backoff and IOs without a descriptor are polled
+
+// Telemetry waiting for its PUBACK is indexed by packet id in pages of 256 slots, allocated only while in use
+#define TELEMETRY_INFLIGHT_PAGE_BITS              8
+#define TELEMETRY_INFLIGHT_PAGE_SIZE              (1 << TELEMETRY_INFLIGHT_PAGE_BITS)
+#define TELEMETRY_INFLIGHT_PAGE_COUNT             ((USHRT_MAX + 1) >> TELEMETRY_INFLIGHT_PAGE_BITS)
+
+// Telemetry topics of the last few property sets are kept, so messages that repeat one skip building and encoding it
+#define TELEMETRY_TOPIC_CACHE_SIZE                8
+#define TELEMETRY_TOPIC_KEY_MIN_SIZE              256
+#define DEFAULT_TELEMETRY_BATCH_MAX_BYTES         16384
 
 static const char TOPIC_DEVICE_TWIN_PREFIX[] = "$iothub/twin";
 static const char TOPIC_DEVICE_METHOD_PREFIX[] = "$iothub/methods";
@@ -103,6 +117,8 @@ static size_t REQUEST_ID_PROPERTY_LEN = sizeof(REQUEST_ID_PROPERTY) - 1;
 #define SYS_PROP_TO "to"
 #define SYS_COMPONENT_NAME "sub"
 
+#define COALESCED_TELEMETRY_CONTENT_TYPE "application/json"
+
 static const char* DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY = "creationtimeutc";
 static const char DT_MODEL_ID_TOKEN[] = "model-id";
 static const char DEFAULT_IOTHUB_PRODUCT_IDENTIFIER[] = CLIENT_DEVICE_TYPE_PREFIX "/" IOTHUB_SDK_VERSION;
@@ -198,6 +214,20 @@ typedef enum MQTT_CLIENT_STATUS_TAG
     MQTT_CLIENT_STATUS_EXECUTE_DISCONNECT
 } MQTT_CLIENT_STATUS;
 
+typedef struct TELEMETRY_INFLIGHT_PAGE_TAG
+{
+    size_t count;
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG* entries[TELEMETRY_INFLIGHT_PAGE_SIZE];
+} TELEMETRY_INFLIGHT_PAGE;
+
+typedef struct TELEMETRY_TOPIC_CACHE_ENTRY_TAG
+{
+    uint32_t key_hash;
+    size_t key_length;
+    char* key;              // Unencoded property set the topic was built from, see buildTelemetryTopicKey
+    STRING_HANDLE topic;
+} TELEMETRY_TOPIC_CACHE_ENTRY;
+
 typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 {
     // Topic control
@@ -255,6 +285,8 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     bool log_trace;
     bool raw_trace;
     TICK_COUNTER_HANDLE msgTickCounter;
+    TIMER_WHEEL_HANDLE telemetryTimeouts;   // Next resend or expiry of each message in telemetry_waitingForAck
+    TIMER_WHEEL_HANDLE twinRequestTimeouts; // Expiry of the get/report twin requests in pending_get_twin_queue and ack_waiting_queue
     OPTIONHANDLER_HANDLE saved_tls_options; // Here are the options from the xio layer if any is saved.
 
     // Internal lists for message tracking
@@ -267,7 +299,19 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     CONTROL_PACKET_TYPE currPacketState;
 
     // Telemetry specific
-    DLIST_ENTRY telemetry_waitingForAck;
+    DLIST_ENTRY telemetry_waitingForAck;    // Publish order, walked to republish on reconnect
+    TELEMETRY_INFLIGHT_PAGE* telemetry_inflight[TELEMETRY_INFLIGHT_PAGE_COUNT]; // Same messages by packet id, for PUBACKs
+    size_t telemetry_inflight_count;
+    size_t max_inflight_messages;   // 0 for no limit, see OPTION_MAX_INFLIGHT_MESSAGES
+    bool telemetry_at_most_once;    // QoS 0 telemetry, see OPTION_TELEMETRY_AT_MOST_ONCE
+    size_t telemetry_linger_ms;     // 0 when telemetry is not coalesced, see OPTION_TELEMETRY_LINGER_MS
+    size_t telemetry_batch_max_bytes;
+    bool is_lingering;              // waitingToSend holds telemetry being coalesced since linger_start_ms
+    tickcounter_ms_t linger_start_ms;
+    TELEMETRY_TOPIC_CACHE_ENTRY topic_cache[TELEMETRY_TOPIC_CACHE_SIZE];
+    size_t topic_cache_next;    // Entry replaced on the next miss
+    char* topic_key;            // Reused to build the cache key of each message
+    size_t topic_key_size;
     bool auto_url_encode_decode;
 
     // Controls frequency of reconnection logic.
@@ -280,6 +324,10 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     TRANSPORT_CALLBACKS_INFO transport_callbacks;
     void* transport_ctx;
 
+    // Metrics of the registered client (NULL when none is registered or it keeps none)
+    IOTHUB_CLIENT_METRICS_HANDLE metrics;
+    bool has_been_connected;
+
     char* http_proxy_hostname;
     int http_proxy_port;
     char* http_proxy_username;
@@ -298,6 +346,7 @@ typedef struct MQTT_DEVICE_TWIN_ITEM_TAG
     IOTHUB_DEVICE_TWIN* device_twin_data;
     DEVICE_TWIN_MSG_TYPE device_twin_msg_type;
     DLIST_ENTRY entry;
+    TIMER_WHEEL_ENTRY timeout_entry;
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK userCallback;
     void* userContext;
 } MQTT_DEVICE_TWIN_ITEM;
@@ -309,7 +358,10 @@ typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
     IOTHUB_MESSAGE_LIST* iotHubMessageEntry;
     void* context;
     uint16_t packet_id;
+    BUFFER_HANDLE encoded_packet;   // PUBLISH as first sent, resent with the DUP flag until acknowledged
+    DLIST_ENTRY coalesced;          // Messages published along with iotHubMessageEntry, see OPTION_TELEMETRY_LINGER_MS
     DLIST_ENTRY entry;
+    TIMER_WHEEL_ENTRY timeout_entry;
 } MQTT_MESSAGE_DETAILS_LIST, *PMQTT_MESSAGE_DETAILS_LIST;
 
 typedef struct DEVICE_METHOD_INFO_TAG
@@ -321,6 +373,7 @@ typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
 {
     uint16_t packet_id;
     QOS_VALUE qos_value;
+    tickcounter_ms_t receive_time;
 } MESSAGE_DISPOSITION_CONTEXT;
 
 //
@@ -410,6 +463,9 @@ static void setSavedTlsOptions(PMQTTTRANSPORT_HANDLE_DATA transport, OPTIONHANDL
 //
 static void freeTransportHandleData(MQTTTRANSPORT_HANDLE_DATA* transport_data)
 {
+    size_t page_index;
+    size_t cache_index;
+
     if (transport_data->mqttClient != NULL)
     {
         mqtt_client_deinit(transport_data->mqttClient);
@@ -423,8 +479,22 @@ static void freeTransportHandleData(MQTTTRANSPORT_HANDLE_DATA* transport_data)
 
     setSavedTlsOptions(transport_data, NULL);
 
+    timer_wheel_destroy(transport_data->telemetryTimeouts);
+    timer_wheel_destroy(transport_data->twinRequestTimeouts);
     tickcounter_destroy(transport_data->msgTickCounter);
 
+    for (page_index = 0; page_index < TELEMETRY_INFLIGHT_PAGE_COUNT; page_index++)
+    {
+        free(transport_data->telemetry_inflight[page_index]);
+    }
+
+    for (cache_index = 0; cache_index < TELEMETRY_TOPIC_CACHE_SIZE; cache_index++)
+    {
+        free(transport_data->topic_cache[cache_index].key);
+        STRING_delete(transport_data->topic_cache[cache_index].topic);
+    }
+    free(transport_data->topic_key);
+
     freeProxyData(transport_data);
 
     STRING_delete(transport_data->devicesAndModulesPath);
@@ -444,20 +514,126 @@ static void freeTransportHandleData(MQTTTRANSPORT_HANDLE_DATA* transport_data)
     free(transport_data);
 }
 
+//
+// findTelemetryWaitingForAck returns the telemetry message published with packet_id that waits for its PUBACK, if any.
+//
+static MQTT_MESSAGE_DETAILS_LIST* findTelemetryWaitingForAck(PMQTTTRANSPORT_HANDLE_DATA transport_data, uint16_t packet_id)
+{
+    TELEMETRY_INFLIGHT_PAGE* page = transport_data->telemetry_inflight[packet_id >> TELEMETRY_INFLIGHT_PAGE_BITS];
+    return (page == NULL) ? NULL : page->entries[packet_id & (TELEMETRY_INFLIGHT_PAGE_SIZE - 1)];
+}
+
 //
 // getNextPacketId gets the next Packet Id to use and increments internal counter.
+// Ids still held by telemetry waiting for a PUBACK are skipped, so that a PUBACK always names a single message.
+// Returns 0, never a valid packet id, when one full pass finds every id held.
 //
 static uint16_t getNextPacketId(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
-    if (transport_data->packetId + 1 >= USHRT_MAX)
+    uint16_t result = 0;
+    size_t attempts;
+
+    for (attempts = 0; attempts < USHRT_MAX - 1 && result == 0; attempts++)
+    {
+        if (transport_data->packetId + 1 >= USHRT_MAX)
+        {
+            transport_data->packetId = 1;
+        }
+        else
+        {
+            transport_data->packetId++;
+        }
+
+        if (findTelemetryWaitingForAck(transport_data, transport_data->packetId) == NULL)
+        {
+            result = transport_data->packetId;
+        }
+    }
+
+    if (result == 0)
+    {
+        LogError("All packet ids are held by telemetry waiting for a PUBACK");
+    }
+    return result;
+}
+
+//
+// trackTelemetryWaitingForAck indexes a telemetry message by its packet id until its PUBACK arrives.
+//
+static int trackTelemetryWaitingForAck(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry)
+{
+    int result;
+    size_t page_index = mqttMsgEntry->packet_id >> TELEMETRY_INFLIGHT_PAGE_BITS;
+    TELEMETRY_INFLIGHT_PAGE* page = transport_data->telemetry_inflight[page_index];
+
+    if (page == NULL &&
+        (page = (TELEMETRY_INFLIGHT_PAGE*)calloc(1, sizeof(TELEMETRY_INFLIGHT_PAGE))) == NULL)
     {
-        transport_data->packetId = 1;
+        LogError("Failed allocating the in flight telemetry page for packet id %u", mqttMsgEntry->packet_id);
+        result = MU_FAILURE;
     }
     else
     {
-        transport_data->packetId++;
+        transport_data->telemetry_inflight[page_index] = page;
+        page->entries[mqttMsgEntry->packet_id & (TELEMETRY_INFLIGHT_PAGE_SIZE - 1)] = mqttMsgEntry;
+        page->count++;
+        transport_data->telemetry_inflight_count++;
+        result = 0;
+    }
+
+    return result;
+}
+
+//
+// untrackTelemetryWaitingForAck drops a telemetry message from the packet id index, freeing its page once empty.
+//
+static void untrackTelemetryWaitingForAck(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry)
+{
+    size_t page_index = mqttMsgEntry->packet_id >> TELEMETRY_INFLIGHT_PAGE_BITS;
+    TELEMETRY_INFLIGHT_PAGE* page = transport_data->telemetry_inflight[page_index];
+
+    if (page != NULL && page->entries[mqttMsgEntry->packet_id & (TELEMETRY_INFLIGHT_PAGE_SIZE - 1)] == mqttMsgEntry)
+    {
+        page->entries[mqttMsgEntry->packet_id & (TELEMETRY_INFLIGHT_PAGE_SIZE - 1)] = NULL;
+        transport_data->telemetry_inflight_count--;
+        if (--page->count == 0)
+        {
+            free(page);
+            transport_data->telemetry_inflight[page_index] = NULL;
+        }
     }
-    return transport_data->packetId;
+}
+
+//
+// isInflightWindowFull tells whether OPTION_MAX_INFLIGHT_MESSAGES holds back further telemetry until PUBACKs arrive.
+//
+static bool isInflightWindowFull(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    return transport_data->max_inflight_messages != 0 && transport_data->telemetry_inflight_count >= transport_data->max_inflight_messages;
+}
+
+//
+// takeFromWaitingToSend takes a message out of the client's waitingToSend, its timeout and the WAITING_TO_SEND count.
+//
+static void takeFromWaitingToSend(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_LIST* iothubMsgList)
+{
+    (void)DList_RemoveEntryList(&iothubMsgList->entry);
+    timer_wheel_cancel(&iothubMsgList->timeout_entry);
+    iothub_client_metrics_subtract(transport_data->metrics, IOTHUB_CLIENT_METRICS_WAITING_TO_SEND, 1);
+}
+
+//
+// removeTelemetryWaitingForAck takes a telemetry message out of telemetry_waitingForAck, its index and its timeout,
+// and drops its encoded PUBLISH. The caller completes and frees it.
+//
+static void removeTelemetryWaitingForAck(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry)
+{
+    (void)DList_RemoveEntryList(&mqttMsgEntry->entry);
+    untrackTelemetryWaitingForAck(transport_data, mqttMsgEntry);
+    timer_wheel_cancel(&mqttMsgEntry->timeout_entry);
+    iothub_client_metrics_subtract(transport_data->metrics, IOTHUB_CLIENT_METRICS_WAITING_FOR_ACK, 1);
+    BUFFER_delete(mqttMsgEntry->encoded_packet);
+    mqttMsgEntry->encoded_packet = NULL;
 }
 
 #ifndef NO_LOGGING
@@ -679,6 +855,22 @@ static void notifyApplicationOfSendMessageComplete(IOTHUB_MESSAGE_LIST* iothubMs
     transport_data->transport_callbacks.send_complete_cb(&messageCompleted, confirmResult, transport_data->transport_ctx);
 }
 
+//
+// notifyApplicationOfTelemetryComplete completes a published telemetry message together with the messages coalesced into it.
+//
+static void notifyApplicationOfTelemetryComplete(MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmResult)
+{
+    DLIST_ENTRY messageCompleted;
+    PDLIST_ENTRY coalescedEntry;
+    DList_InitializeListHead(&messageCompleted);
+    DList_InsertTailList(&messageCompleted, &(mqttMsgEntry->iotHubMessageEntry->entry));
+    while ((coalescedEntry = DList_RemoveHeadList(&mqttMsgEntry->coalesced)) != &mqttMsgEntry->coalesced)
+    {
+        DList_InsertTailList(&messageCompleted, coalescedEntry);
+    }
+    transport_data->transport_callbacks.send_complete_cb(&messageCompleted, confirmResult, transport_data->transport_ctx);
+}
+
 //
 // addUserPropertiesTouMqttMessage translates application properties in iothub_message_handle (set by the application with IoTHubMessage_SetProperty e.g.)
 // into a representation in the MQTT TOPIC topic_string.
@@ -1022,13 +1214,208 @@ static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
     return result;
 }
 
+//
+// appendToTopicKey appends one field to transport_data->topic_key: a presence marker followed by the value and its terminator,
+// so that no two different property sets give the same key.
+//
+static int appendToTopicKey(PMQTTTRANSPORT_HANDLE_DATA transport_data, size_t* key_length, const char* value)
+{
+    int result;
+    size_t value_size = (value == NULL) ? 0 : strlen(value) + 1;
+    size_t needed = *key_length + 1 + value_size;
+    size_t new_size = transport_data->topic_key_size * 2;
+    char* new_key;
+
+    if (new_size < needed)
+    {
+        new_size = (needed < TELEMETRY_TOPIC_KEY_MIN_SIZE) ? TELEMETRY_TOPIC_KEY_MIN_SIZE : needed;
+    }
+
+    if (needed > transport_data->topic_key_size &&
+        (new_key = (char*)realloc(transport_data->topic_key, new_size)) == NULL)
+    {
+        LogError("Failed growing the telemetry topic key to %lu bytes", (unsigned long)new_size);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (needed > transport_data->topic_key_size)
+        {
+            transport_data->topic_key = new_key;
+            transport_data->topic_key_size = new_size;
+        }
+
+        transport_data->topic_key[*key_length] = (value == NULL) ? '0' : '1';
+        if (value != NULL)
+        {
+            (void)memcpy(transport_data->topic_key + *key_length + 1, value, value_size);
+        }
+        *key_length = needed;
+        result = 0;
+    }
+
+    return result;
+}
+
+//
+// buildTelemetryTopicKey appends to transport_data->topic_key, from *key_length on, everything addPropertiesTouMqttMessage reads
+// from the message, unencoded.  Messages carrying a per-message value (message id, creation time, diagnostics) are not worth
+// caching and fail.
+//
+static int buildTelemetryTopicKey(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE iothub_message_handle, size_t* key_length)
+{
+    int result;
+    const char* const* propertyKeys;
+    const char* const* propertyValues;
+    size_t propertyCount = 0;
+    MAP_HANDLE properties_map = IoTHubMessage_Properties(iothub_message_handle);
+
+    if (IoTHubMessage_GetMessageId(iothub_message_handle) != NULL ||
+        IoTHubMessage_GetMessageCreationTimeUtcSystemProperty(iothub_message_handle) != NULL ||
+        IoTHubMessage_GetDiagnosticPropertyData(iothub_message_handle) != NULL)
+    {
+        result = MU_FAILURE;
+    }
+    else if (properties_map != NULL && Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK)
+    {
+        LogError("Failed to get the internals of the property map.");
+        result = MU_FAILURE;
+    }
+    else if (appendToTopicKey(transport_data, key_length, transport_data->auto_url_encode_decode ? "" : NULL) != 0 ||
+        appendToTopicKey(transport_data, key_length, IoTHubMessage_IsSecurityMessage(iothub_message_handle) ? "" : NULL) != 0)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t index;
+
+        result = 0;
+        for (index = 0; index < propertyCount && result == 0; index++)
+        {
+            if (appendToTopicKey(transport_data, key_length, propertyKeys[index]) != 0 ||
+                appendToTopicKey(transport_data, key_length, propertyValues[index]) != 0)
+            {
+                result = MU_FAILURE;
+            }
+        }
+
+        if (result != 0 ||
+            appendToTopicKey(transport_data, key_length, NULL) != 0 ||
+            appendToTopicKey(transport_data, key_length, IoTHubMessage_GetCorrelationId(iothub_message_handle)) != 0 ||
+            appendToTopicKey(transport_data, key_length, IoTHubMessage_GetContentTypeSystemProperty(iothub_message_handle)) != 0 ||
+            appendToTopicKey(transport_data, key_length, IoTHubMessage_GetContentEncodingSystemProperty(iothub_message_handle)) != 0 ||
+            appendToTopicKey(transport_data, key_length, IoTHubMessage_GetOutputName(iothub_message_handle)) != 0 ||
+            appendToTopicKey(transport_data, key_length, IoTHubMessage_GetComponentName(iothub_message_handle)) != 0)
+        {
+            result = MU_FAILURE;
+        }
+    }
+
+    return result;
+}
+
+static uint32_t hashTelemetryTopicKey(const char* key, size_t key_length)
+{
+    // FNV-1a
+    uint32_t result = 2166136261u;
+    size_t index;
+
+    for (index = 0; index < key_length; index++)
+    {
+        result = (result ^ (unsigned char)key[index]) * 16777619u;
+    }
+
+    return result;
+}
+
+//
+// getTelemetryTopic returns the topic to publish iothub_message_handle on.  A topic found in (or added to) the cache stays owned by it;
+// otherwise the topic is returned in uncached_topic too, for the caller to delete.
+//
+static const char* getTelemetryTopic(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE iothub_message_handle, STRING_HANDLE* uncached_topic)
+{
+    const char* result = NULL;
+    size_t key_length = 0;
+
+    *uncached_topic = NULL;
+
+    if (buildTelemetryTopicKey(transport_data, iothub_message_handle, &key_length) != 0)
+    {
+        *uncached_topic = addPropertiesTouMqttMessage(iothub_message_handle, STRING_c_str(transport_data->topic_MqttEvent), transport_data->auto_url_encode_decode);
+    }
+    else
+    {
+        uint32_t key_hash = hashTelemetryTopicKey(transport_data->topic_key, key_length);
+        size_t index;
+
+        for (index = 0; index < TELEMETRY_TOPIC_CACHE_SIZE && result == NULL; index++)
+        {
+            TELEMETRY_TOPIC_CACHE_ENTRY* entry = &transport_data->topic_cache[index];
+            if (entry->topic != NULL && entry->key_hash == key_hash && entry->key_length == key_length &&
+                memcmp(entry->key, transport_data->topic_key, key_length) == 0)
+            {
+                result = STRING_c_str(entry->topic);
+            }
+        }
+
+        if (result == NULL)
+        {
+            STRING_HANDLE topic = addPropertiesTouMqttMessage(iothub_message_handle, STRING_c_str(transport_data->topic_MqttEvent), transport_data->auto_url_encode_decode);
+            char* key;
+
+            if (topic == NULL)
+            {
+                // Reported by the caller
+            }
+            else if ((key = (char*)malloc(key_length)) == NULL)
+            {
+                LogError("Failed allocating telemetry topic cache key; topic not cached");
+                *uncached_topic = topic;
+            }
+            else
+            {
+                TELEMETRY_TOPIC_CACHE_ENTRY* entry = &transport_data->topic_cache[transport_data->topic_cache_next];
+                transport_data->topic_cache_next = (transport_data->topic_cache_next + 1) % TELEMETRY_TOPIC_CACHE_SIZE;
+
+                free(entry->key);
+                STRING_delete(entry->topic);
+                (void)memcpy(key, transport_data->topic_key, key_length);
+                entry->key = key;
+                entry->key_length = key_length;
+                entry->key_hash = key_hash;
+                entry->topic = topic;
+                result = STRING_c_str(topic);
+            }
+        }
+    }
+
+    if (*uncached_topic != NULL)
+    {
+        result = STRING_c_str(*uncached_topic);
+    }
+
+    return result;
+}
+
+//
+// scheduleTelemetryTimeout arms the next check of a message waiting for its PUBACK: the earlier of its resend and its expiry.
+//
+static void scheduleTelemetryTimeout(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* msg_detail_entry)
+{
+    tickcounter_ms_t expiry_ms = msg_detail_entry->msgCreationTime + (tickcounter_ms_t)TELEMETRY_MSG_TIMEOUT_MIN * 1000;
+    tickcounter_ms_t resend_ms = msg_detail_entry->msgPublishTime + ((tickcounter_ms_t)RESEND_TIMEOUT_VALUE_MIN + 1) * 1000;
+    (void)timer_wheel_schedule(transport_data->telemetryTimeouts, &msg_detail_entry->timeout_entry, (resend_ms < expiry_ms) ? resend_ms : expiry_ms);
+}
+
 //
 // publishTelemetryMsg invokes the umqtt layer to send a PUBLISH message.
 //
 static int publishTelemetryMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
 {
     int result;
-    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent), transport_data->auto_url_encode_decode);
+    STRING_HANDLE uncachedTopic;
+    const char* msgTopic = getTelemetryTopic(transport_data, mqttMsgEntry->iotHubMessageEntry->messageHandle, &uncachedTopic);
     if (msgTopic == NULL)
     {
         LogError("Failed adding properties to mqtt message");
@@ -1036,7 +1423,7 @@ static int publishTelemetryMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_M
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create_in_place(mqttMsgEntry->packet_id, STRING_c_str(msgTopic), DELIVER_AT_LEAST_ONCE, payload, len);
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create_in_place(mqttMsgEntry->packet_id, msgTopic, DELIVER_AT_LEAST_ONCE, payload, len);
         if (mqttMsg == NULL)
         {
             LogError("Failed creating mqtt message");
@@ -1051,7 +1438,9 @@ static int publishTelemetryMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_M
             }
             else
             {
-                if (mqtt_client_publish(transport_data->mqttClient, mqttMsg) != 0)
+                BUFFER_delete(mqttMsgEntry->encoded_packet);
+                mqttMsgEntry->encoded_packet = NULL;
+                if (mqtt_client_publish_retained(transport_data->mqttClient, mqttMsg, &mqttMsgEntry->encoded_packet) != 0)
                 {
                     LogError("Failed attempting to publish mqtt message");
                     result = MU_FAILURE;
@@ -1063,8 +1452,48 @@ static int publishTelemetryMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_M
             }
             mqttmessage_destroy(mqttMsg);
         }
-        STRING_delete(msgTopic);
     }
+    STRING_delete(uncachedTopic);
+    return result;
+}
+
+//
+// publishTelemetryMsgAtMostOnce sends a telemetry message at QoS 0: it is complete once handed to the xio, so no PUBACK
+// tracking, packet id or retained packet is needed.
+//
+static int publishTelemetryMsgAtMostOnce(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE messageHandle, const unsigned char* payload, size_t len)
+{
+    int result;
+    STRING_HANDLE uncachedTopic;
+    const char* msgTopic = getTelemetryTopic(transport_data, messageHandle, &uncachedTopic);
+    if (msgTopic == NULL)
+    {
+        LogError("Failed adding properties to mqtt message");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create_in_place(0, msgTopic, DELIVER_AT_MOST_ONCE, payload, len);
+        if (mqttMsg == NULL)
+        {
+            LogError("Failed creating mqtt message");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            if (mqtt_client_publish(transport_data->mqttClient, mqttMsg) != 0)
+            {
+                LogError("Failed attempting to publish mqtt message");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                result = 0;
+            }
+            mqttmessage_destroy(mqttMsg);
+        }
+    }
+    STRING_delete(uncachedTopic);
     return result;
 }
 
@@ -1113,9 +1542,19 @@ static int publishDeviceMethodResponseMsg(MQTTTRANSPORT_HANDLE_DATA* transport_d
 //
 static void destroyDeviceTwinGetMsg(MQTT_DEVICE_TWIN_ITEM* msg_entry)
 {
+    timer_wheel_cancel(&msg_entry->timeout_entry);
     free(msg_entry);
 }
 
+//
+// scheduleDeviceTwinTimeout arms the expiry of a get/report twin request, counted from its msgCreationTime.
+//
+static void scheduleDeviceTwinTimeout(MQTTTRANSPORT_HANDLE_DATA* transport_data, MQTT_DEVICE_TWIN_ITEM* msg_entry)
+{
+    tickcounter_ms_t timeout_secs = (msg_entry->device_twin_msg_type == RETRIEVE_PROPERTIES) ? ON_DEMAND_GET_TWIN_REQUEST_TIMEOUT_SECS : TWIN_REPORT_UPDATE_TIMEOUT_SECS;
+    (void)timer_wheel_schedule(transport_data->twinRequestTimeouts, &msg_entry->timeout_entry, msg_entry->msgCreationTime + timeout_secs * 1000);
+}
+
 //
 // createDeviceTwinMsg allocates and fills in structure for MQTT_DEVICE_TWIN_ITEM.
 //
@@ -1141,6 +1580,8 @@ static MQTT_DEVICE_TWIN_ITEM* createDeviceTwinMsg(MQTTTRANSPORT_HANDLE_DATA* tra
         result->packet_id = getNextPacketId(transport_data);
         result->iothub_msg_id = iothub_msg_id;
         result->device_twin_msg_type = device_twin_msg_type;
+        timer_wheel_entry_init(&result->timeout_entry);
+        scheduleDeviceTwinTimeout(transport_data, result);
     }
 
     return result;
@@ -1216,44 +1657,28 @@ static void sendPendingGetTwinRequests(PMQTTTRANSPORT_HANDLE_DATA transportData)
 }
 
 //
-// removeExpiredTwinRequestsFromList removes any requests that have timed out.
+// removeExpiredTwinRequest is invoked by the twinRequestTimeouts wheel for a request that has timed out,
+// whichever of pending_get_twin_queue or ack_waiting_queue it is in.
 //
-static void removeExpiredTwinRequestsFromList(PMQTTTRANSPORT_HANDLE_DATA transport_data, tickcounter_ms_t current_ms, DLIST_ENTRY* twin_list)
+static void removeExpiredTwinRequest(void* context, TIMER_WHEEL_ENTRY* timeout_entry)
 {
-    PDLIST_ENTRY list_item = twin_list->Flink;
+    PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)context;
+    MQTT_DEVICE_TWIN_ITEM* msg_entry = containingRecord(timeout_entry, MQTT_DEVICE_TWIN_ITEM, timeout_entry);
 
-    while (list_item != twin_list)
+    if (msg_entry->device_twin_msg_type == RETRIEVE_PROPERTIES)
     {
-        DLIST_ENTRY next_list_item;
-        next_list_item.Flink = list_item->Flink;
-        MQTT_DEVICE_TWIN_ITEM* msg_entry = containingRecord(list_item, MQTT_DEVICE_TWIN_ITEM, entry);
-        bool item_timed_out = false;
-
-        if ((msg_entry->device_twin_msg_type == RETRIEVE_PROPERTIES) &&
-            (((current_ms - msg_entry->msgCreationTime) / 1000) >= ON_DEMAND_GET_TWIN_REQUEST_TIMEOUT_SECS))
-        {
-            item_timed_out = true;
-            if (msg_entry->userCallback != NULL)
-            {
-                msg_entry->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0, msg_entry->userContext);
-            }
-        }
-        else if ((msg_entry->device_twin_msg_type == REPORTED_STATE) &&
-                 (((current_ms - msg_entry->msgCreationTime) / 1000) >= TWIN_REPORT_UPDATE_TIMEOUT_SECS))
-        {
-            item_timed_out = true;
-            transport_data->transport_callbacks.twin_rpt_state_complete_cb(msg_entry->iothub_msg_id, STATUS_CODE_TIMEOUT_VALUE, transport_data->transport_ctx);
-        }
-
-        if (item_timed_out)
+        if (msg_entry->userCallback != NULL)
         {
-            (void)DList_RemoveEntryList(list_item);
-            destroyDeviceTwinGetMsg(msg_entry);
+            msg_entry->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0, msg_entry->userContext);
         }
-
-        list_item = next_list_item.Flink;
+    }
+    else
+    {
+        transport_data->transport_callbacks.twin_rpt_state_complete_cb(msg_entry->iothub_msg_id, STATUS_CODE_TIMEOUT_VALUE, transport_data->transport_ctx);
     }
 
+    (void)DList_RemoveEntryList(&msg_entry->entry);
+    destroyDeviceTwinGetMsg(msg_entry);
 }
 
 //
@@ -1265,8 +1690,7 @@ static void removeExpiredTwinRequests(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 
     if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) == 0)
     {
-        removeExpiredTwinRequestsFromList(transport_data, current_ms, &transport_data->pending_get_twin_queue);
-        removeExpiredTwinRequestsFromList(transport_data, current_ms, &transport_data->ack_waiting_queue);
+        (void)timer_wheel_advance(transport_data->twinRequestTimeouts, current_ms, removeExpiredTwinRequest, transport_data);
     }
 }
 
@@ -1625,54 +2049,41 @@ static const char* findMessagePropertyStart(PMQTTTRANSPORT_HANDLE_DATA transport
 // AddApplicationProperty adds the custom key/value property name from the incoming MQTT PUBLISH to the iotHubMessage
 // we will ultimately deliver to the application on its callback.
 //
-static int addApplicationPropertyToMessage(MAP_HANDLE propertyMap, const char* propertyNameAndValue, size_t propertyNameLength, const char* propertyValue, bool auto_url_encode_decode)
+static int addApplicationPropertyToMessage(MAP_HANDLE propertyMap, const char* propertyName, const char* propertyValue, bool auto_url_encode_decode)
 {
-    int result = 0;
-
-    char* propertyNameCopy = NULL;
+    int result;
 
-    // We need to make a copy of propertyName at this point; we don't own the buffer it's part of
-    // so we can't just sneak a temporary '\0' in there.  We don't need to make a copy of propertyValue
-    // since its part of an otherwise null terminated string.
-    if ((propertyNameCopy = (char*)malloc(propertyNameLength + 1)) == NULL)
+    if (auto_url_encode_decode)
+    {
+        STRING_HANDLE propName_decoded = URL_DecodeString(propertyName);
+        STRING_HANDLE propValue_decoded = URL_DecodeString(propertyValue);
+        if (propName_decoded == NULL || propValue_decoded == NULL)
+        {
+            LogError("Failed to URL decode property");
+            result = MU_FAILURE;
+        }
+        else if (Map_AddOrUpdate(propertyMap, STRING_c_str(propName_decoded), STRING_c_str(propValue_decoded)) != MAP_OK)
+        {
+            LogError("Map_AddOrUpdate failed.");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
+        STRING_delete(propValue_decoded);
+        STRING_delete(propName_decoded);
+    }
+    else if (Map_AddOrUpdate(propertyMap, propertyName, propertyValue) != MAP_OK)
     {
-        LogError("Failed allocating property information");
+        LogError("Map_AddOrUpdate failed.");
         result = MU_FAILURE;
     }
     else
     {
-        memcpy(propertyNameCopy, propertyNameAndValue, propertyNameLength);
-        propertyNameCopy[propertyNameLength] = '\0';
-    
-        if (auto_url_encode_decode)
-        {
-            STRING_HANDLE propName_decoded = URL_DecodeString(propertyNameCopy);
-            STRING_HANDLE propValue_decoded = URL_DecodeString(propertyValue);
-            if (propName_decoded == NULL || propValue_decoded == NULL)
-            {
-                LogError("Failed to URL decode property");
-                result = MU_FAILURE;
-            }
-            else if (Map_AddOrUpdate(propertyMap, STRING_c_str(propName_decoded), STRING_c_str(propValue_decoded)) != MAP_OK)
-            {
-                LogError("Map_AddOrUpdate failed.");
-                result = MU_FAILURE;
-            }
-            else
-            {
-                result = 0;
-            }
-            STRING_delete(propValue_decoded);
-            STRING_delete(propName_decoded);
-        }
-        else if (Map_AddOrUpdate(propertyMap, propertyNameCopy, propertyValue) != MAP_OK)
-        {
-            LogError("Map_AddOrUpdate failed.");
-            result = MU_FAILURE;
-        }
+        result = 0;
     }
 
-    free(propertyNameCopy);
     return result;
 }
 
@@ -1716,76 +2127,60 @@ static int addSystemPropertyToMessageWithDecodeIfNeeded(IOTHUB_MESSAGE_HANDLE io
 }
 
 //
-// extractMqttProperties parses the MQTT topic PUBLISH'd to this device/module, retrieves properties and fills out the 
-// IOTHUB_MESSAGE_HANDLE which will ultimately be delivered to the application callback.
+// MQTT_MESSAGE_PROPERTIES is the properties part of a C2D or input queue topic, kept with the IOTHUB_MESSAGE_HANDLE
+// so that decodeMqttProperties only runs if the application accesses the properties.
 //
-static int extractMqttProperties(PMQTTTRANSPORT_HANDLE_DATA transportData, IOTHUB_MESSAGE_HANDLE iotHubMessage, const char* topic_name, IOTHUB_IDENTITY_TYPE type)
+typedef struct MQTT_MESSAGE_PROPERTIES_TAG
 {
-    int result;
+    bool auto_url_encode_decode;
+    char* properties;
+} MQTT_MESSAGE_PROPERTIES;
 
-    const char* propertiesStart;
-    STRING_TOKENIZER_HANDLE tokenizer = NULL;
-    STRING_HANDLE propertyToken = NULL;
+static void destroyMqttProperties(MESSAGE_PROPERTIES_SOURCE_HANDLE propertiesSource)
+{
+    free(propertiesSource);
+}
+
+//
+// decodeMqttProperties fills out the properties of iotHubMessage from the retained topic properties.  It splits the
+// "propertyKey1=propertyValue1&propertyKey2=propertyValue2" string in place, as it is destroyed right after.
+//
+static int decodeMqttProperties(MESSAGE_PROPERTIES_SOURCE_HANDLE propertiesSource, IOTHUB_MESSAGE_HANDLE iotHubMessage)
+{
+    int result;
+    MQTT_MESSAGE_PROPERTIES* mqttProperties = (MQTT_MESSAGE_PROPERTIES*)propertiesSource;
     MAP_HANDLE propertyMap;
 
-    if ((propertiesStart = findMessagePropertyStart(transportData, topic_name, type)) == NULL)
-    {
-        LogError("Cannot find start of properties");
-        result = MU_FAILURE;
-    }
-    else if ((type == IOTHUB_TYPE_EVENT_QUEUE) && ((propertiesStart = addInputNamePropertyToMsg(iotHubMessage, propertiesStart)) == NULL))
-    {
-        LogError("failure adding input name to property.");
-        result = MU_FAILURE;
-    }
-    else if (*propertiesStart == '\0')
-    {
-        // No properties were specified.  This is not an error.  We'll return success to caller but skip further processing.
-        result = 0;
-    }    
-    else if ((tokenizer = STRING_TOKENIZER_create_from_char(propertiesStart)) == NULL)
-    {
-        LogError("failure allocating tokenizer");
-        result = MU_FAILURE;
-    }
-    else if ((propertyToken = STRING_new()) == NULL)
-    {
-        LogError("Failure to allocate STRING_new.");
-        result = MU_FAILURE;
-    }
-    else if ((propertyMap = IoTHubMessage_Properties(iotHubMessage)) == NULL)
+    if ((propertyMap = IoTHubMessage_Properties(iotHubMessage)) == NULL)
     {
         LogError("Failure to retrieve IoTHubMessage_properties.");
         result = MU_FAILURE;
     }
     else
     {
+        char* propertyName = mqttProperties->properties;
         result = 0;
 
-        // Iterate through each "propertyKey1=propertyValue1" set, tokenizing off the '&' separating key/value pairs.
-        while ((STRING_TOKENIZER_get_next_token(tokenizer, propertyToken, PROPERTY_SEPARATOR) == 0) && result == 0)
+        // Iterate through each "propertyKey1=propertyValue1" set, terminating it at the '&' separating key/value pairs.
+        while ((propertyName != NULL) && (result == 0))
         {
-            const char* propertyNameAndValue = STRING_c_str(propertyToken);
-            const char* propertyValue;
-                
-            if (propertyNameAndValue == NULL || (*propertyNameAndValue == 0))
+            char* nextProperty = strchr(propertyName, *PROPERTY_SEPARATOR);
+            char* propertyValue;
+
+            if (nextProperty != NULL)
             {
-                ;
+                *nextProperty++ = '\0';
             }
-            else if (((propertyValue = strchr(propertyNameAndValue, PROPERTY_EQUALS)) == NULL) ||
-                      (*(propertyValue + 1) == 0))
+
+            if (((propertyValue = strchr(propertyName, PROPERTY_EQUALS)) == NULL) ||
+                (*(propertyValue + 1) == 0))
             {
                 ;
             }
             else
             {
-                size_t propertyNameLength = propertyValue - propertyNameAndValue;
-                propertyValue++;
-
-                // After this point, propertyValue is a \0 terminated string (because the STRING_Tokenizer call above made it so)
-                // but propertyNameAndValue is NOT \0 terminated and requires its length passed with it.
-
-                IOTHUB_SYSTEM_PROPERTY_TYPE propertyType = GetMqttPropertyType(propertyNameAndValue, propertyNameLength);
+                IOTHUB_SYSTEM_PROPERTY_TYPE propertyType = GetMqttPropertyType(propertyName, propertyValue - propertyName);
+                *propertyValue++ = '\0';
 
                 if (propertyType == IOTHUB_SYSTEM_PROPERTY_TYPE_SILENTLY_IGNORE)
                 {
@@ -1796,18 +2191,73 @@ static int extractMqttProperties(PMQTTTRANSPORT_HANDLE_DATA transportData, IOTHU
                 }
                 else if (propertyType == IOTHUB_SYSTEM_PROPERTY_TYPE_APPLICATION_CUSTOM)
                 {
-                    result = addApplicationPropertyToMessage(propertyMap, propertyNameAndValue, propertyNameLength, propertyValue, transportData->auto_url_encode_decode);
+                    result = addApplicationPropertyToMessage(propertyMap, propertyName, propertyValue, mqttProperties->auto_url_encode_decode);
                 }
                 else
                 {
-                    result = addSystemPropertyToMessageWithDecodeIfNeeded(iotHubMessage, propertyType, propertyValue, transportData->auto_url_encode_decode);
+                    result = addSystemPropertyToMessageWithDecodeIfNeeded(iotHubMessage, propertyType, propertyValue, mqttProperties->auto_url_encode_decode);
                 }
             }
+
+            propertyName = nextProperty;
+        }
+    }
+
+    return result;
+}
+
+//
+// extractMqttProperties parses the MQTT topic PUBLISH'd to this device/module, sets the input name of the
+// IOTHUB_MESSAGE_HANDLE which will ultimately be delivered to the application callback, and leaves a copy of the
+// properties with it, decoded by decodeMqttProperties when first accessed.
+//
+static int extractMqttProperties(PMQTTTRANSPORT_HANDLE_DATA transportData, IOTHUB_MESSAGE_HANDLE iotHubMessage, const char* topic_name, IOTHUB_IDENTITY_TYPE type)
+{
+    int result;
+
+    const char* propertiesStart;
+    size_t propertiesLength;
+    MQTT_MESSAGE_PROPERTIES* mqttProperties;
+
+    if ((propertiesStart = findMessagePropertyStart(transportData, topic_name, type)) == NULL)
+    {
+        LogError("Cannot find start of properties");
+        result = MU_FAILURE;
+    }
+    else if ((type == IOTHUB_TYPE_EVENT_QUEUE) && ((propertiesStart = addInputNamePropertyToMsg(iotHubMessage, propertiesStart)) == NULL))
+    {
+        LogError("failure adding input name to property.");
+        result = MU_FAILURE;
+    }
+    else if (*propertiesStart == '\0')
+    {
+        // No properties were specified.  This is not an error.  We'll return success to caller but skip further processing.
+        result = 0;
+    }
+    else if ((mqttProperties = (MQTT_MESSAGE_PROPERTIES*)malloc(sizeof(MQTT_MESSAGE_PROPERTIES) + (propertiesLength = strlen(propertiesStart)) + 1)) == NULL)
+    {
+        LogError("Failure allocating the message properties");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        // Both in one allocation, the properties right after the struct
+        mqttProperties->auto_url_encode_decode = transportData->auto_url_encode_decode;
+        mqttProperties->properties = (char*)(mqttProperties + 1);
+        (void)memcpy(mqttProperties->properties, propertiesStart, propertiesLength + 1);
+
+        if (IoTHubMessage_SetPropertiesSource(iotHubMessage, (MESSAGE_PROPERTIES_SOURCE_HANDLE)mqttProperties, decodeMqttProperties, destroyMqttProperties) != IOTHUB_MESSAGE_OK)
+        {
+            LogError("Failed setting the properties source of the message");
+            destroyMqttProperties((MESSAGE_PROPERTIES_SOURCE_HANDLE)mqttProperties);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
         }
     }
 
-    STRING_delete(propertyToken);
-    STRING_TOKENIZER_destroy(tokenizer);
     return result;
 }
 
@@ -1931,7 +2381,7 @@ static void destroyMessageDispositionContext(MESSAGE_DISPOSITION_CONTEXT* dispos
     free(dispositionContext);
 }
 
-static MESSAGE_DISPOSITION_CONTEXT* createMessageDispositionContext(MQTT_MESSAGE_HANDLE msgHandle)
+static MESSAGE_DISPOSITION_CONTEXT* createMessageDispositionContext(PMQTTTRANSPORT_HANDLE_DATA transportData, MQTT_MESSAGE_HANDLE msgHandle)
 {
     MESSAGE_DISPOSITION_CONTEXT* result = malloc(sizeof(MESSAGE_DISPOSITION_CONTEXT));
 
@@ -1943,6 +2393,10 @@ static MESSAGE_DISPOSITION_CONTEXT* createMessageDispositionContext(MQTT_MESSAGE
     {
         result->packet_id = mqttmessage_getPacketId(msgHandle);
         result->qos_value = mqttmessage_getQosType(msgHandle);
+        if (tickcounter_get_current_ms(transportData->msgTickCounter, &result->receive_time) != 0)
+        {
+            result->receive_time = 0;
+        }
     }
 
     return result;
@@ -1971,7 +2425,7 @@ static void processIncomingMessageNotification(PMQTTTRANSPORT_HANDLE_DATA transp
     }
     else
     {
-        MESSAGE_DISPOSITION_CONTEXT* dispositionContext = createMessageDispositionContext(msgHandle);
+        MESSAGE_DISPOSITION_CONTEXT* dispositionContext = createMessageDispositionContext(transportData, msgHandle);
 
         if (dispositionContext == NULL)
         {
@@ -2069,20 +2523,17 @@ static void mqttOperationCompleteCallback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT
                 const PUBLISH_ACK* puback = (const PUBLISH_ACK*)msgInfo;
                 if (puback != NULL)
                 {
-                    PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                    while (currentListEntry != &transport_data->telemetry_waitingForAck)
+                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = findTelemetryWaitingForAck(transport_data, puback->packetId);
+                    if (mqttMsgEntry != NULL)
                     {
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                        DLIST_ENTRY saveListEntry;
-                        saveListEntry.Flink = currentListEntry->Flink;
-
-                        if (puback->packetId == mqttMsgEntry->packet_id)
+                        tickcounter_ms_t current_ms;
+                        removeTelemetryWaitingForAck(transport_data, mqttMsgEntry); //First remove the item from Waiting for Ack List.
+                        if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) == 0)
                         {
-                            (void)DList_RemoveEntryList(currentListEntry); //First remove the item from Waiting for Ack List.
-                            notifyApplicationOfSendMessageComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
-                            free(mqttMsgEntry);
+                            iothub_client_metrics_record(transport_data->metrics, IOTHUB_CLIENT_METRICS_TELEMETRY_ACK_LATENCY, current_ms - mqttMsgEntry->msgPublishTime);
                         }
-                        currentListEntry = saveListEntry.Flink;
+                        notifyApplicationOfTelemetryComplete(mqttMsgEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
+                        free(mqttMsgEntry);
                     }
                 }
                 else
@@ -2105,6 +2556,12 @@ static void mqttOperationCompleteCallback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT
 
                         retry_control_reset(transport_data->retry_control_handle);
 
+                        if (transport_data->has_been_connected)
+                        {
+                            iothub_client_metrics_add(transport_data->metrics, IOTHUB_CLIENT_METRICS_RECONNECTS, 1);
+                        }
+                        transport_data->has_been_connected = true;
+
                         transport_data->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK, transport_data->transport_ctx);
                     }
                     else
@@ -2371,7 +2828,11 @@ static void SubscribeToMqttProtocol(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 
         if (subscribe_count != 0)
         {
-            if (mqtt_client_subscribe(transport_data->mqttClient, packet_id, subscribe, subscribe_count) != 0)
+            if (packet_id == 0)
+            {
+                LogError("Failure: no packet id available for SUBSCRIBE.");
+            }
+            else if (mqtt_client_subscribe(transport_data->mqttClient, packet_id, subscribe, subscribe_count) != 0)
             {
                 LogError("Failure: mqtt_client_subscribe returned error.");
             }
@@ -2393,6 +2854,8 @@ static void SubscribeToMqttProtocol(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 
         // On a service reconnect, reset the expired time of messages waiting for a PUBACK.
         // This will cause the messages to republish in order as required by the MQTT spec.
+        tickcounter_ms_t current_ms = 0;
+        (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
         PDLIST_ENTRY current_entry = transport_data->telemetry_waitingForAck.Flink;
         while (current_entry != &transport_data->telemetry_waitingForAck)
         {
@@ -2401,10 +2864,11 @@ static void SubscribeToMqttProtocol(PMQTTTRANSPORT_HANDLE_DATA transport_data)
             if (!isMqttMessageSfcType(msg_detail_entry->iotHubMessageEntry->messageHandle))
             {
 #endif //RUN_SFC_TESTS
-                // Setting the value to 0 as it is simpler than calculating the amount of time to
-                // expire the PUBLISH. This value of zero is equivalent to setting a time way in the 
-                // past, enough for this control logic.
-                msg_detail_entry->msgPublishTime = 0;        // force the message to resend
+                // Backdate the publish time by a full resend timeout so the message is due now. Zero is
+                // not far enough in the past during the first minute of msgTickCounter; the unsigned
+                // arithmetic wraps around consistently for the resend checks.
+                msg_detail_entry->msgPublishTime = current_ms - ((tickcounter_ms_t)RESEND_TIMEOUT_VALUE_MIN + 1) * 1000;
+                scheduleTelemetryTimeout(transport_data, msg_detail_entry);
 
 #ifdef RUN_SFC_TESTS
             }
@@ -2458,63 +2922,128 @@ static bool RetrieveMessagePayload(IOTHUB_MESSAGE_HANDLE messageHandle, const un
 }
 
 //
-// ProcessPendingTelemetryMessages examines each telemetry message the device/module has sent that hasn't yet been PUBACK'd.
-// For each message, it might:
-// * Ignore it, if its timeout has not yet been reached.
+// resendTelemetryMsg publishes again a telemetry message that hasn't been PUBACK'd: its retained PUBLISH with the DUP flag set,
+// or a newly built one if it has none.
+//
+static int resendTelemetryMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* msg_detail_entry, tickcounter_ms_t current_ms)
+{
+    int result;
+    size_t messageLength;
+    const unsigned char* messagePayload = NULL;
+
+    if (msg_detail_entry->encoded_packet != NULL)
+    {
+        msg_detail_entry->msgPublishTime = current_ms;
+        if (mqtt_client_republish(transport_data->mqttClient, msg_detail_entry->encoded_packet) != 0)
+        {
+            LogError("Failed attempting to republish mqtt message (%d)", msg_detail_entry->packet_id);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    else if (!DList_IsListEmpty(&msg_detail_entry->coalesced))
+    {
+        LogError("Coalesced telemetry (%d) cannot be published again without its PUBLISH packet", msg_detail_entry->packet_id);
+        result = MU_FAILURE;
+    }
+    else if (!RetrieveMessagePayload(msg_detail_entry->iotHubMessageEntry->messageHandle, &messagePayload, &messageLength))
+    {
+        LogError("Failure result from IoTHubMessage_GetData");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = publishTelemetryMsg(transport_data, msg_detail_entry, messagePayload, messageLength);
+    }
+
+    return result;
+}
+
+//
+// ProcessPendingTelemetryMessage is invoked by the telemetryTimeouts wheel when a telemetry message the device/module has sent
+// and that hasn't yet been PUBACK'd reaches its resend or expiry time. It might:
 // * Attempt to retry PUBLISH the message, if has remaining retries left.
 // * Stop attempting to send the message.  This will result in tearing down the underlying MQTT/TCP connection because it indicates
 //   something is wrong.
 //
-static void ProcessPendingTelemetryMessages(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+static void ProcessPendingTelemetryMessage(void* context, TIMER_WHEEL_ENTRY* timeout_entry)
 {
-    PDLIST_ENTRY current_entry = transport_data->telemetry_waitingForAck.Flink;
+    PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)context;
+    MQTT_MESSAGE_DETAILS_LIST* msg_detail_entry = containingRecord(timeout_entry, MQTT_MESSAGE_DETAILS_LIST, timeout_entry);
     tickcounter_ms_t current_ms;
     (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
-    while (current_entry != &transport_data->telemetry_waitingForAck)
-    {
-        MQTT_MESSAGE_DETAILS_LIST* msg_detail_entry = containingRecord(current_entry, MQTT_MESSAGE_DETAILS_LIST, entry);
-        DLIST_ENTRY nextListEntry;
-        nextListEntry.Flink = current_entry->Flink;
 
-        if (((current_ms - msg_detail_entry->msgCreationTime) / 1000) >= TELEMETRY_MSG_TIMEOUT_MIN)
-        {
-            notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
-            (void)DList_RemoveEntryList(current_entry);
-            LogError("Disconnecting MQTT connection because message PUBACK (%d) timeout.", msg_detail_entry->packet_id);
-            free(msg_detail_entry);
+    if (((current_ms - msg_detail_entry->msgCreationTime) / 1000) >= TELEMETRY_MSG_TIMEOUT_MIN)
+    {
+        notifyApplicationOfTelemetryComplete(msg_detail_entry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+        removeTelemetryWaitingForAck(transport_data, msg_detail_entry);
+        LogError("Disconnecting MQTT connection because message PUBACK (%d) timeout.", msg_detail_entry->packet_id);
+        free(msg_detail_entry);
 
-            DisconnectFromClient(transport_data);
-            transport_data->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_COMMUNICATION_ERROR, transport_data->transport_ctx);
-        }
-        else if (((current_ms - msg_detail_entry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
+        DisconnectFromClient(transport_data);
+        transport_data->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_COMMUNICATION_ERROR, transport_data->transport_ctx);
+    }
+    else if (((current_ms - msg_detail_entry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
+    {
+        // Ensure that the packet state is PUBLISH_TYPE and then attempt to send the message
+        // again
+        if (transport_data->currPacketState == PUBLISH_TYPE)
         {
-            // Ensure that the packet state is PUBLISH_TYPE and then attempt to send the message
-            // again
-            if (transport_data->currPacketState == PUBLISH_TYPE)
+            if (resendTelemetryMsg(transport_data, msg_detail_entry, current_ms) != 0)
             {
-                size_t messageLength;
-                const unsigned char* messagePayload = NULL;
-                if (!RetrieveMessagePayload(msg_detail_entry->iotHubMessageEntry->messageHandle, &messagePayload, &messageLength))
-                {
-                    (void)DList_RemoveEntryList(current_entry);
-                    notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                }
-                else
-                {
-                    if (publishTelemetryMsg(transport_data, msg_detail_entry, messagePayload, messageLength) != 0)
-                    {
-                        (void)DList_RemoveEntryList(current_entry);
-                        notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                        free(msg_detail_entry);
-                    }
-                }
+                removeTelemetryWaitingForAck(transport_data, msg_detail_entry);
+                notifyApplicationOfTelemetryComplete(msg_detail_entry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                free(msg_detail_entry);
             }
             else
             {
-                msg_detail_entry->msgPublishTime = current_ms;
+                scheduleTelemetryTimeout(transport_data, msg_detail_entry);
             }
         }
-        current_entry = nextListEntry.Flink;
+        else
+        {
+            msg_detail_entry->msgPublishTime = current_ms;
+            scheduleTelemetryTimeout(transport_data, msg_detail_entry);
+        }
+    }
+    else
+    {
+        scheduleTelemetryTimeout(transport_data, msg_detail_entry);
+    }
+}
+
+//
+// ProcessPendingTelemetryMessages resends or expires the telemetry messages waiting for a PUBACK whose time has come,
+// without visiting the others.
+//
+static void ProcessPendingTelemetryMessages(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    tickcounter_ms_t current_ms;
+    if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) == 0)
+    {
+        (void)timer_wheel_advance(transport_data->telemetryTimeouts, current_ms, ProcessPendingTelemetryMessage, transport_data);
+    }
+}
+
+//
+// setByteCounter points the byte counter of the xioTransport at the registered client's metrics (or removes it
+// when there are none, so that a shared transport never reports into a client that is gone).
+//
+static void setByteCounter(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    if (transport_data->xioTransport != NULL)
+    {
+        XIO_BYTE_COUNTER byte_counter;
+        byte_counter.on_bytes_transferred = iothub_client_metrics_on_bytes_transferred;
+        byte_counter.context = transport_data->metrics;
+
+        if (xio_setoption(transport_data->xioTransport, OPTION_XIO_BYTE_COUNTER, (transport_data->metrics == NULL) ? NULL : &byte_counter) != 0)
+        {
+            LogError("Failed setting the byte counter on the xio transport.");
+        }
     }
 }
 
@@ -2545,6 +3074,8 @@ static int CreateTransportProviderIfNecessary(PMQTTTRANSPORT_HANDLE_DATA transpo
         }
         else
         {
+            setByteCounter(transport_data);
+
             if (transport_data->saved_tls_options != NULL)
             {
                 if (OptionHandler_FeedOptions(transport_data->saved_tls_options, transport_data->xioTransport) != OPTIONHANDLER_OK)
@@ -2986,12 +3517,21 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
     else
     {
         memset(state, 0, sizeof(MQTTTRANSPORT_HANDLE_DATA));
+        tickcounter_ms_t current_ms = 0;
         if ((state->msgTickCounter = tickcounter_create()) == NULL)
         {
             LogError("Invalid Argument: iotHubName is empty");
             freeTransportHandleData(state);
             state = NULL;
         }
+        else if (tickcounter_get_current_ms(state->msgTickCounter, &current_ms) != 0 ||
+            (state->telemetryTimeouts = timer_wheel_create(TIMEOUT_RESOLUTION_MS, current_ms)) == NULL ||
+            (state->twinRequestTimeouts = timer_wheel_create(TIMEOUT_RESOLUTION_MS, current_ms)) == NULL)
+        {
+            LogError("Failed creating the message timeout wheels");
+            freeTransportHandleData(state);
+            state = NULL;
+        }
         else if ((state->retry_control_handle = retry_control_create(DEFAULT_RETRY_POLICY, DEFAULT_RETRY_TIMEOUT_IN_SECONDS)) == NULL)
         {
             LogError("Failed creating default retry control");
@@ -3087,6 +3627,7 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                         state->log_trace = state->raw_trace = false;
                         state->isConnectUsernameSet = false;
                         state->auto_url_encode_decode = false;
+                        state->telemetry_batch_max_bytes = DEFAULT_TELEMETRY_BATCH_MAX_BYTES;
                         state->conn_attempted = false;
                     }
                 }
@@ -3127,13 +3668,165 @@ static void ProcessSubackDoWork(PMQTTTRANSPORT_HANDLE_DATA transport_data)
     transport_data->currPacketState = PUBLISH_TYPE;
 }
 
+//
+// isCoalescingTelemetry tells whether OPTION_TELEMETRY_LINGER_MS applies to the telemetry published next.
+//
+static bool isCoalescingTelemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    return transport_data->telemetry_linger_ms != 0 && !transport_data->telemetry_at_most_once;
+}
+
+//
+// isTelemetryLingering tells whether the telemetry in waitingToSend should wait for more messages to coalesce with:
+// until the oldest has waited OPTION_TELEMETRY_LINGER_MS or OPTION_TELEMETRY_BATCH_MAX_BYTES of payload are queued.
+//
+static bool isTelemetryLingering(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    bool result;
+    tickcounter_ms_t current_ms;
+
+    if (!isCoalescingTelemetry(transport_data) || DList_IsListEmpty(transport_data->waitingToSend))
+    {
+        transport_data->is_lingering = false;
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) != 0)
+    {
+        LogError("Failed retrieving tickcounter info; telemetry published without lingering");
+        result = false;
+    }
+    else
+    {
+        if (!transport_data->is_lingering)
+        {
+            transport_data->is_lingering = true;
+            transport_data->linger_start_ms = current_ms;
+        }
+
+        if (current_ms - transport_data->linger_start_ms >= transport_data->telemetry_linger_ms)
+        {
+            result = false;
+        }
+        else
+        {
+            size_t queued_bytes = 0;
+            PDLIST_ENTRY currentListEntry = transport_data->waitingToSend->Flink;
+
+            while (currentListEntry != transport_data->waitingToSend && queued_bytes < transport_data->telemetry_batch_max_bytes)
+            {
+                IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
+                const unsigned char* messagePayload;
+                size_t messageLength;
+                if (RetrieveMessagePayload(iothubMsgList->messageHandle, &messagePayload, &messageLength))
+                {
+                    queued_bytes += messageLength + 1;
+                }
+                currentListEntry = currentListEntry->Flink;
+            }
+
+            result = (queued_bytes < transport_data->telemetry_batch_max_bytes);
+        }
+    }
+
+    return result;
+}
+
+//
+// coalesceTelemetry moves the messages that follow mqttMsgEntry's in waitingToSend and share its topic into mqttMsgEntry->coalesced,
+// up to OPTION_TELEMETRY_BATCH_MAX_BYTES, and returns the JSON array of all their payloads in batch_payload.  batch_payload is NULL
+// when no message joins.  On failure the messages already moved are left in mqttMsgEntry->coalesced, for the caller to fail them.
+//
+static int coalesceTelemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* head_payload, size_t head_length, BUFFER_HANDLE* batch_payload)
+{
+    int result;
+    IOTHUB_MESSAGE_HANDLE head_message = mqttMsgEntry->iotHubMessageEntry->messageHandle;
+    const char* content_type = IoTHubMessage_GetContentTypeSystemProperty(head_message);
+    size_t head_key_length = 0;
+
+    *batch_payload = NULL;
+
+    // Only payloads declared JSON can be joined into a JSON array; the messages that join share the content type through
+    // the topic key. Encoded payloads (see OPTION_PAYLOAD_CODEC) cannot be concatenated
+    if (!isCoalescingTelemetry(transport_data) ||
+        content_type == NULL || strcmp(content_type, COALESCED_TELEMETRY_CONTENT_TYPE) != 0 ||
+        IoTHubMessage_GetContentEncodingSystemProperty(head_message) != NULL ||
+        buildTelemetryTopicKey(transport_data, head_message, &head_key_length) != 0)
+    {
+        // Not coalesced
+        result = 0;
+    }
+    else
+    {
+        size_t total_length = head_length + 2;
+        PDLIST_ENTRY candidate = mqttMsgEntry->iotHubMessageEntry->entry.Flink;
+
+        while (candidate != transport_data->waitingToSend)
+        {
+            IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(candidate, IOTHUB_MESSAGE_LIST, entry);
+            PDLIST_ENTRY next = candidate->Flink;
+            const unsigned char* messagePayload;
+            size_t messageLength;
+            size_t key_length = head_key_length;
+
+            // Coalescing stops at the first message that cannot join, so that messages are still published in order
+            if (!RetrieveMessagePayload(iothubMsgList->messageHandle, &messagePayload, &messageLength) ||
+                total_length + 1 + messageLength > transport_data->telemetry_batch_max_bytes ||
+                buildTelemetryTopicKey(transport_data, iothubMsgList->messageHandle, &key_length) != 0 ||
+                key_length != 2 * head_key_length ||
+                memcmp(transport_data->topic_key, transport_data->topic_key + head_key_length, head_key_length) != 0)
+            {
+                break;
+            }
+
+            takeFromWaitingToSend(transport_data, iothubMsgList);
+            DList_InsertTailList(&mqttMsgEntry->coalesced, candidate);
+            total_length += 1 + messageLength;
+            candidate = next;
+        }
+
+        if (DList_IsListEmpty(&mqttMsgEntry->coalesced))
+        {
+            result = 0;
+        }
+        else if ((*batch_payload = BUFFER_new()) == NULL || BUFFER_pre_build(*batch_payload, total_length) != 0)
+        {
+            LogError("Failed allocating %lu bytes for coalesced telemetry", (unsigned long)total_length);
+            BUFFER_delete(*batch_payload);
+            *batch_payload = NULL;
+            result = MU_FAILURE;
+        }
+        else
+        {
+            unsigned char* iterator = BUFFER_u_char(*batch_payload);
+            PDLIST_ENTRY coalescedEntry;
+
+            *iterator++ = '[';
+            (void)memcpy(iterator, head_payload, head_length);
+            iterator += head_length;
+            for (coalescedEntry = mqttMsgEntry->coalesced.Flink; coalescedEntry != &mqttMsgEntry->coalesced; coalescedEntry = coalescedEntry->Flink)
+            {
+                const unsigned char* messagePayload;
+                size_t messageLength;
+                (void)RetrieveMessagePayload(containingRecord(coalescedEntry, IOTHUB_MESSAGE_LIST, entry)->messageHandle, &messagePayload, &messageLength);
+                *iterator++ = ',';
+                (void)memcpy(iterator, messagePayload, messageLength);
+                iterator += messageLength;
+            }
+            *iterator = ']';
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
 //
 // ProcessPublishStateDoWork traverses all messages waiting to be sent and attempts to PUBLISH them.
 //
 static void ProcessPublishStateDoWork(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
-    PDLIST_ENTRY currentListEntry = transport_data->waitingToSend->Flink;
-    while (currentListEntry != transport_data->waitingToSend)
+    PDLIST_ENTRY currentListEntry = isTelemetryLingering(transport_data) ? transport_data->waitingToSend : transport_data->waitingToSend->Flink;
+    while (currentListEntry != transport_data->waitingToSend && !isInflightWindowFull(transport_data))
     {
         IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
         DLIST_ENTRY savedFromCurrentListEntry;
@@ -3143,14 +3836,26 @@ static void ProcessPublishStateDoWork(PMQTTTRANSPORT_HANDLE_DATA transport_data)
         const unsigned char* messagePayload = NULL;
         if (!RetrieveMessagePayload(iothubMsgList->messageHandle, &messagePayload, &messageLength))
         {
-            (void)(DList_RemoveEntryList(currentListEntry));
+            takeFromWaitingToSend(transport_data, iothubMsgList);
             notifyApplicationOfSendMessageComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
             LogError("Failure result from IoTHubMessage_GetData");
         }
+        else if (transport_data->telemetry_at_most_once)
+        {
+            int publish_result = publishTelemetryMsgAtMostOnce(transport_data, iothubMsgList->messageHandle, messagePayload, messageLength);
+            takeFromWaitingToSend(transport_data, iothubMsgList);
+            notifyApplicationOfSendMessageComplete(iothubMsgList, transport_data, (publish_result == 0) ? IOTHUB_CLIENT_CONFIRMATION_OK : IOTHUB_CLIENT_CONFIRMATION_ERROR);
+        }
         else
         {
-            MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST));
-            if (mqttMsgEntry == NULL)
+            MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry;
+            uint16_t packet_id = getNextPacketId(transport_data);
+            if (packet_id == 0)
+            {
+                // No packet id is free: the message stays in waitingToSend and publishing resumes once a PUBACK releases one
+                break;
+            }
+            else if ((mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST))) == NULL)
             {
                 LogError("Allocation Error: Failure allocating MQTT Message Detail List.");
             }
@@ -3158,27 +3863,60 @@ static void ProcessPublishStateDoWork(PMQTTTRANSPORT_HANDLE_DATA transport_data)
             {
                 tickcounter_ms_t current_ms;
                 (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
+                timer_wheel_entry_init(&mqttMsgEntry->timeout_entry);
+                DList_InitializeListHead(&mqttMsgEntry->coalesced);
+                mqttMsgEntry->encoded_packet = NULL;
                 mqttMsgEntry->msgCreationTime = current_ms;
                 mqttMsgEntry->iotHubMessageEntry = iothubMsgList;
-                mqttMsgEntry->packet_id = getNextPacketId(transport_data);
-                if (publishTelemetryMsg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
+                mqttMsgEntry->packet_id = packet_id;
+                if (trackTelemetryWaitingForAck(transport_data, mqttMsgEntry) != 0)
                 {
-                    (void)(DList_RemoveEntryList(currentListEntry));
+                    takeFromWaitingToSend(transport_data, iothubMsgList);
                     notifyApplicationOfSendMessageComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                     free(mqttMsgEntry);
                 }
                 else
                 {
-                    // Remove the message from the waiting queue ...
-                    (void)(DList_RemoveEntryList(currentListEntry));
-                    // and add it to the ack queue
-                    DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
+                    BUFFER_HANDLE batchPayload;
+                    int publish_result = coalesceTelemetry(transport_data, mqttMsgEntry, messagePayload, messageLength, &batchPayload);
+                    // Coalescing may have taken the messages that followed out of waitingToSend
+                    savedFromCurrentListEntry.Flink = currentListEntry->Flink;
+
+                    if (publish_result == 0)
+                    {
+                        publish_result = (batchPayload == NULL) ?
+                            publishTelemetryMsg(transport_data, mqttMsgEntry, messagePayload, messageLength) :
+                            publishTelemetryMsg(transport_data, mqttMsgEntry, BUFFER_u_char(batchPayload), BUFFER_length(batchPayload));
+                        BUFFER_delete(batchPayload);
+                    }
+
+                    if (publish_result != 0)
+                    {
+                        untrackTelemetryWaitingForAck(transport_data, mqttMsgEntry);
+                        takeFromWaitingToSend(transport_data, iothubMsgList);
+                        notifyApplicationOfTelemetryComplete(mqttMsgEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                        free(mqttMsgEntry);
+                    }
+                    else
+                    {
+                        // Remove the message from the waiting queue (and from the client's message timeouts) ...
+                        takeFromWaitingToSend(transport_data, iothubMsgList);
+                        // and add it to the ack queue
+                        DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
+                        iothub_client_metrics_add(transport_data->metrics, IOTHUB_CLIENT_METRICS_WAITING_FOR_ACK, 1);
+                        scheduleTelemetryTimeout(transport_data, mqttMsgEntry);
+                    }
                 }
             }
         }
         currentListEntry = savedFromCurrentListEntry.Flink;
     }
 
+    if (DList_IsListEmpty(transport_data->waitingToSend))
+    {
+        transport_data->is_lingering = false;
+    }
+
     if (transport_data->twin_resp_sub_recv)
     {
         sendPendingGetTwinRequests(transport_data);
@@ -3269,9 +4007,9 @@ void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
         //Empty the Waiting for Ack Messages.
         while (!DList_IsListEmpty(&transport_data->telemetry_waitingForAck))
         {
-            PDLIST_ENTRY currentEntry = DList_RemoveHeadList(&transport_data->telemetry_waitingForAck);
-            MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-            notifyApplicationOfSendMessageComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+            MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(transport_data->telemetry_waitingForAck.Flink, MQTT_MESSAGE_DETAILS_LIST, entry);
+            removeTelemetryWaitingForAck(transport_data, mqttMsgEntry);
+            notifyApplicationOfTelemetryComplete(mqttMsgEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
             free(mqttMsgEntry);
         }
         while (!DList_IsListEmpty(&transport_data->ack_waiting_queue))
@@ -3393,6 +4131,7 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetTwinAsync(IOTHUB_DEVICE_HAND
         }
         else
         {
+            scheduleDeviceTwinTimeout(transport_data, mqtt_info);
             mqtt_info->userCallback = completionCallback;
             mqtt_info->userContext = callbackContext;
 
@@ -3590,7 +4329,7 @@ IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_MQTT_Common_ProcessItem(TRANSPORT_LL_
                     {
                         DList_RemoveEntryList(&mqtt_info->entry);
 
-                        free(mqtt_info);
+                        destroyDeviceTwinGetMsg(mqtt_info);
                         result = IOTHUB_PROCESS_ERROR;
                     }
                     else
@@ -3695,7 +4434,11 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetSendStatus(TRANSPORT_LL_HAND
     else
     {
         MQTTTRANSPORT_HANDLE_DATA* handleData = (MQTTTRANSPORT_HANDLE_DATA*)handle;
-        if (!DList_IsListEmpty(handleData->waitingToSend) || !DList_IsListEmpty(&(handleData->telemetry_waitingForAck)))
+        if (!DList_IsListEmpty(handleData->waitingToSend) && isInflightWindowFull(handleData))
+        {
+            *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BACKPRESSURE;
+        }
+        else if (!DList_IsListEmpty(handleData->waitingToSend) || !DList_IsListEmpty(&(handleData->telemetry_waitingForAck)))
         {
             *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
         }
@@ -3708,6 +4451,152 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetSendStatus(TRANSPORT_LL_HAND
     return result;
 }
 
+static void lowerPollTimeout(IOTHUB_CLIENT_POLL_INFO* poll_info, uint64_t timeout_ms)
+{
+    if (timeout_ms < poll_info->timeout_ms)
+    {
+        poll_info->timeout_ms = timeout_ms;
+    }
+}
+
+static void lowerPollTimeoutToDeadline(IOTHUB_CLIENT_POLL_INFO* poll_info, tickcounter_ms_t deadline_ms, tickcounter_ms_t current_ms)
+{
+    lowerPollTimeout(poll_info, (deadline_ms <= current_ms) ? 0 : (uint64_t)(deadline_ms - current_ms));
+}
+
+static void lowerPollTimeoutToWheel(IOTHUB_CLIENT_POLL_INFO* poll_info, TIMER_WHEEL_HANDLE timer_wheel, tickcounter_ms_t current_ms)
+{
+    tickcounter_ms_t deadline_ms;
+    if (timer_wheel != NULL && timer_wheel_get_next_deadline(timer_wheel, &deadline_ms) == 0)
+    {
+        lowerPollTimeoutToDeadline(poll_info, deadline_ms, current_ms);
+    }
+}
+
+//
+// IoTHubTransport_MQTT_Common_GetPollInfo tells when IoTHubTransport_MQTT_Common_DoWork next has something to do:
+// input on the socket, queued output, or the earliest of the deadlines DoWork checks (connect timeout, SAS token
+// renewal, keep alive, telemetry resend/expiry and twin request expiry).
+//
+int IoTHubTransport_MQTT_Common_GetPollInfo(TRANSPORT_LL_HANDLE handle, bool has_pending_items, IOTHUB_CLIENT_POLL_INFO* poll_info)
+{
+    int result;
+    tickcounter_ms_t current_ms;
+
+    if (handle == NULL || poll_info == NULL)
+    {
+        LogError("Invalid argument (handle=%p, poll_info=%p)", handle, poll_info);
+        result = MU_FAILURE;
+    }
+    else if (tickcounter_get_current_ms(((PMQTTTRANSPORT_HANDLE_DATA)handle)->msgTickCounter, &current_ms) != 0)
+    {
+        LogError("Failed getting the current time");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
+        XIO_POLL_INFO xio_poll_info;
+
+        poll_info->fd = -1;
+        poll_info->want_write = false;
+        poll_info->timeout_ms = IOTHUB_CLIENT_POLL_NO_TIMEOUT;
+
+        if (transport_data->xioTransport != NULL)
+        {
+            if (xio_get_poll_info(transport_data->xioTransport, &xio_poll_info) == 0)
+            {
+                poll_info->fd = xio_poll_info.fd;
+                poll_info->want_write = xio_poll_info.want_write;
+            }
+            else
+            {
+                lowerPollTimeout(poll_info, POLL_INTERVAL_WITHOUT_EVENTS_MS);
+            }
+        }
+
+        if (transport_data->isDestroyCalled)
+        {
+            // Nothing will be done
+        }
+        else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_NOT_CONNECTED)
+        {
+            if (!transport_data->isRecoverableError)
+            {
+                // Stays down until the application intervenes
+            }
+            else if (!transport_data->conn_attempted)
+            {
+                lowerPollTimeout(poll_info, 0);
+            }
+            else
+            {
+                // retry_control decides on each DoWork whether the backoff is over
+                lowerPollTimeout(poll_info, POLL_INTERVAL_WITHOUT_EVENTS_MS);
+            }
+        }
+        else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_PENDING_CLOSE ||
+            transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_EXECUTE_DISCONNECT)
+        {
+            lowerPollTimeout(poll_info, 0);
+        }
+        else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTING)
+        {
+            lowerPollTimeoutToDeadline(poll_info, transport_data->mqtt_connect_time + ((tickcounter_ms_t)transport_data->connect_timeout_in_sec + 1) * 1000, current_ms);
+        }
+        else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTED)
+        {
+            IOTHUB_CREDENTIAL_TYPE cred_type = IoTHubClient_Auth_Get_Credential_Type(transport_data->authorization_module);
+            uint64_t keep_alive_timeout_ms;
+
+            if (transport_data->currPacketState == CONNACK_TYPE ||
+                transport_data->currPacketState == SUBSCRIBE_TYPE ||
+                transport_data->currPacketState == SUBACK_TYPE)
+            {
+                lowerPollTimeout(poll_info, 0);
+            }
+            else if (transport_data->currPacketState == PUBLISH_TYPE)
+            {
+                if (has_pending_items || (transport_data->twin_resp_sub_recv && !DList_IsListEmpty(&transport_data->pending_get_twin_queue)))
+                {
+                    lowerPollTimeout(poll_info, 0);
+                }
+
+                if (!DList_IsListEmpty(transport_data->waitingToSend) && !isInflightWindowFull(transport_data))
+                {
+                    if (transport_data->is_lingering && isCoalescingTelemetry(transport_data))
+                    {
+                        lowerPollTimeoutToDeadline(poll_info, transport_data->linger_start_ms + transport_data->telemetry_linger_ms, current_ms);
+                    }
+                    else
+                    {
+                        lowerPollTimeout(poll_info, 0);
+                    }
+                }
+            }
+
+            if (cred_type != IOTHUB_CREDENTIAL_TYPE_X509 && cred_type != IOTHUB_CREDENTIAL_TYPE_X509_ECC)
+            {
+                uint64_t sas_token_expiry = IoTHubClient_Auth_Get_SasToken_Expiry(transport_data->authorization_module);
+                lowerPollTimeoutToDeadline(poll_info, transport_data->mqtt_connect_time + ((tickcounter_ms_t)(sas_token_expiry * SAS_REFRESH_MULTIPLIER) + 1) * 1000, current_ms);
+            }
+
+            if (mqtt_client_get_next_timeout(transport_data->mqttClient, &keep_alive_timeout_ms) == 0 && keep_alive_timeout_ms != MQTT_CLIENT_NO_TIMEOUT)
+            {
+                lowerPollTimeout(poll_info, keep_alive_timeout_ms);
+            }
+        }
+
+        // The telemetry and twin timeouts are processed on every DoWork, connected or not
+        lowerPollTimeoutToWheel(poll_info, transport_data->telemetryTimeouts, current_ms);
+        lowerPollTimeoutToWheel(poll_info, transport_data->twinRequestTimeouts, current_ms);
+
+        result = 0;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -3743,6 +4632,26 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             transport_data->auto_url_encode_decode = *((bool*)value);
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(OPTION_MAX_INFLIGHT_MESSAGES, option) == 0)
+        {
+            transport_data->max_inflight_messages = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_TELEMETRY_AT_MOST_ONCE, option) == 0)
+        {
+            transport_data->telemetry_at_most_once = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_TELEMETRY_LINGER_MS, option) == 0)
+        {
+            transport_data->telemetry_linger_ms = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_TELEMETRY_BATCH_MAX_BYTES, option) == 0)
+        {
+            transport_data->telemetry_batch_max_bytes = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
         else if (strcmp(OPTION_CONNECTION_TIMEOUT, option) == 0)
         {
             int* connection_time = (int*)value;
@@ -3937,6 +4846,8 @@ TRANSPORT_LL_HANDLE IoTHubTransport_MQTT_Common_Register(TRANSPORT_LL_HANDLE han
                 else
                 {
                     transport_data->isRegistered = true;
+                    transport_data->metrics = (transport_data->transport_callbacks.get_metrics_cb == NULL) ? NULL : transport_data->transport_callbacks.get_metrics_cb(transport_data->transport_ctx);
+                    setByteCounter(transport_data);
                     result = (TRANSPORT_LL_HANDLE)handle;
                 }
             }
@@ -3953,6 +4864,8 @@ void IoTHubTransport_MQTT_Common_Unregister(TRANSPORT_LL_HANDLE deviceHandle)
         MQTTTRANSPORT_HANDLE_DATA* transport_data = (MQTTTRANSPORT_HANDLE_DATA*)deviceHandle;
 
         transport_data->isRegistered = false;
+        transport_data->metrics = NULL;
+        setByteCounter(transport_data);
     }
 }
 
@@ -4011,6 +4924,11 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SendMessageDisposition(IOTHUB_D
                 }
                 else
                 {
+                    tickcounter_ms_t current_ms;
+                    if (msgDispCtx->receive_time != 0 && tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) == 0)
+                    {
+                        iothub_client_metrics_record(transport_data->metrics, IOTHUB_CLIENT_METRICS_DISPOSITION_LATENCY, current_ms - msgDispCtx->receive_time);
+                    }
                     result = IOTHUB_CLIENT_OK;
                 }
             }
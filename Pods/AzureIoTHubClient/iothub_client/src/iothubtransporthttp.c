@@ -28,6 +28,7 @@
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/timer_wheel.h"
 
 #define IOTHUB_APP_PREFIX "iothub-app-"
 static const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
@@ -91,6 +92,8 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     void* device_transport_ctx;
     PDLIST_ENTRY waitingToSend;
     DLIST_ENTRY eventConfirmations; /*holds items for event confirmations*/
+    TIMER_WHEEL_HANDLE messageTimeouts; /*the client's timeout wheel, remembered to re-arm messages that go back to waitingToSend*/
+    IOTHUB_CLIENT_METRICS_HANDLE metrics; /*the client's counters, IOTHUB_CLIENT_METRICS_WAITING_TO_SEND follows the messages taken from waitingToSend*/
 } HTTPTRANSPORT_PERDEVICE_DATA;
 
 typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
@@ -281,6 +284,23 @@ static int set_system_properties(IOTHUB_MESSAGE_LIST* message, HTTP_HEADERS_HAND
     return result;
 }
 
+/*takes the head of waitingToSend into eventConfirmations. The client's timeout stops while the transport owns the message
+and is re-armed by putEventConfirmationsBackIn if the send fails and the message goes back to waitingToSend*/
+static void moveHeadToEventConfirmations(HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend);
+    IOTHUB_MESSAGE_LIST* message = containingRecord(head, IOTHUB_MESSAGE_LIST, entry);
+    TIMER_WHEEL_HANDLE messageTimeouts = timer_wheel_entry_get_timer_wheel(&message->timeout_entry);
+
+    if (messageTimeouts != NULL)
+    {
+        deviceData->messageTimeouts = messageTimeouts;
+        timer_wheel_cancel(&message->timeout_entry);
+    }
+    iothub_client_metrics_subtract(deviceData->metrics, IOTHUB_CLIENT_METRICS_WAITING_TO_SEND, 1);
+    DList_InsertTailList(&(deviceData->eventConfirmations), head);
+}
+
 static bool set_message_properties(IOTHUB_MESSAGE_LIST* message, size_t* msg_size, HTTP_HEADERS_HANDLE headers, HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
 {
     bool result = true;
@@ -311,8 +331,7 @@ static bool set_message_properties(IOTHUB_MESSAGE_LIST* message, size_t* msg_siz
             *msg_size += (strlen(values[index]) + strlen(keys[index]) + MAXIMUM_PROPERTY_OVERHEAD);
             if (*msg_size > MAXIMUM_MESSAGE_SIZE)
             {
-                PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                moveHeadToEventConfirmations(deviceData);
                 handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR, deviceData->device_transport_ctx); // takes care of emptying the list too
                 result = false;
                 break;
@@ -783,6 +802,8 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 result->isFirstPoll = true;
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
+                result->messageTimeouts = NULL;
+                result->metrics = (handleData->transport_callbacks.get_metrics_cb == NULL) ? NULL : handleData->transport_callbacks.get_metrics_cb(handleData->transport_ctx);
                 result->transportHandle = (HTTPTRANSPORT_HANDLE_DATA *)handle;
             }
             else
@@ -1411,8 +1432,7 @@ static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData,
                 {
                     if (messageSize > MAXIMUM_MESSAGE_SIZE)
                     {
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                        moveHeadToEventConfirmations(deviceData);
                         result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
                         STRING_delete(*payload);
                         *payload = NULL;
@@ -1430,8 +1450,7 @@ static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData,
                         else
                         {
                             /*first item was put nicely in the payload*/
-                            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                            DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                            moveHeadToEventConfirmations(deviceData);
                             allMessagesSize += messageSize;
                         }
                     }
@@ -1464,8 +1483,7 @@ static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData,
                     else
                     {
                         /*cool, the payload made it there, let's continue... */
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                        moveHeadToEventConfirmations(deviceData);
                         allMessagesSize += messageSize;
                     }
                     STRING_delete(temp);
@@ -1494,6 +1512,23 @@ static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
     DList_InitializeListHead(source);
 }
 
+static void putEventConfirmationsBackIn(HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    PDLIST_ENTRY link;
+
+    for (link = deviceData->eventConfirmations.Flink; link != &(deviceData->eventConfirmations); link = link->Flink)
+    {
+        IOTHUB_MESSAGE_LIST* message = containingRecord(link, IOTHUB_MESSAGE_LIST, entry);
+        iothub_client_metrics_add(deviceData->metrics, IOTHUB_CLIENT_METRICS_WAITING_TO_SEND, 1);
+        if ((deviceData->messageTimeouts != NULL) && (message->ms_timesOutAfter != 0))
+        {
+            /*same deadline the client scheduled when the message was queued; if it has passed the message times out on the next DoWork*/
+            (void)timer_wheel_schedule(deviceData->messageTimeouts, &message->timeout_entry, message->ms_timesOutAfter + message->message_timeout_value + 1);
+        }
+    }
+    reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+}
+
 static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
 {
 
@@ -1519,7 +1554,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                     if (temp == NULL)
                     {
                         LogError("unable to BUFFER_new");
-                        reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                        putEventConfirmationsBackIn(deviceData);
                     }
                     else
                     {
@@ -1527,7 +1562,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                         {
                             LogError("unable to BUFFER_build");
                             //items go back to waitingToSend
-                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                            putEventConfirmationsBackIn(deviceData);
                         }
                         else
                         {
@@ -1546,7 +1581,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                             {
                                 LogError("unable to HTTPAPIEX_ExecuteRequest");
                                 //items go back to waitingToSend
-                                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                                putEventConfirmationsBackIn(deviceData);
                             }
                             else
                             {
@@ -1558,7 +1593,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                 {
                                     //items go back to waitingToSend
                                     LogError("unexpected HTTP status code (%u)", statusCode);
-                                    reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                                    putEventConfirmationsBackIn(deviceData);
                                 }
                             }
                         }
@@ -1622,8 +1657,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             {
                 if (messageSize > MAXIMUM_MESSAGE_SIZE)
                 {
-                    PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                    DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                    moveHeadToEventConfirmations(deviceData);
                     handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR, deviceData->device_transport_ctx); // takes care of emptying the list too
                 }
                 else
@@ -1687,8 +1721,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                         {
                                             if (statusCode < 300)
                                             {
-                                                PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                                                DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
+                                                moveHeadToEventConfirmations(deviceData);
                                                 handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK, deviceData->device_transport_ctx); // takes care of emptying the list too
                                             }
                                             else
@@ -1698,8 +1731,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                         }
                                         else if (r == HTTPAPIEX_RECOVERYFAILED)
                                         {
-                                            PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                                            DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
+                                            moveHeadToEventConfirmations(deviceData);
                                             handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR, deviceData->device_transport_ctx); // takes care of emptying the list too
                                         }
                                     }
@@ -2296,7 +2328,8 @@ static TRANSPORT_PROVIDER thisTransportProvider =
     IotHubTransportHttp_Unsubscribe_InputQueue,     /*pfIoTHubTransport_Unsubscribe_InputQueue IoTHubTransport_Unsubscribe_InputQueue; */
     IoTHubTransportHttp_SetCallbackContext,         /*pfIoTHubTransport_SetTransportCallbacks IoTHubTransport_SetTransportCallbacks; */
     IoTHubTransportHttp_GetTwinAsync,               /*pfIoTHubTransport_GetTwinAsync IoTHubTransport_GetTwinAsync;*/
-    IoTHubTransportHttp_GetSupportedPlatformInfo      /*pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo;*/
+    IoTHubTransportHttp_GetSupportedPlatformInfo,     /*pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo;*/
+    NULL                                              /*pfIoTHubTransport_GetPollInfo IoTHubTransport_GetPollInfo; not supported*/
 };
 
 const TRANSPORT_PROVIDER* HTTP_Protocol(void)
@@ -150,6 +150,11 @@ static int IotHubTransportMqtt_GetSupportedPlatformInfo(TRANSPORT_LL_HANDLE hand
     return IoTHubTransport_MQTT_GetSupportedPlatformInfo(handle, info);
 }
 
+static int IoTHubTransportMqtt_GetPollInfo(TRANSPORT_LL_HANDLE handle, bool has_pending_items, IOTHUB_CLIENT_POLL_INFO* poll_info)
+{
+    return IoTHubTransport_MQTT_Common_GetPollInfo(handle, has_pending_items, poll_info);
+}
+
 static TRANSPORT_PROVIDER myfunc =
 {
     IoTHubTransportMqtt_SendMessageDisposition,     /*pfIotHubTransport_SendMessageDisposition IoTHubTransport_SendMessageDisposition;*/
@@ -174,7 +179,8 @@ static TRANSPORT_PROVIDER myfunc =
     IotHubTransportMqtt_Unsubscribe_InputQueue,     /*pfIoTHubTransport_Unsubscribe_InputQueue IoTHubTransport_Unsubscribe_InputQueue; */
     IotHubTransportMqtt_SetCallbackContext,         /*pfIoTHubTransport_SetCallbackContext IoTHubTransport_SetCallbackContext; */
     IoTHubTransportMqtt_GetTwinAsync,               /*pfIoTHubTransport_GetTwinAsync IoTHubTransport_GetTwinAsync;*/
-    IotHubTransportMqtt_GetSupportedPlatformInfo      /*pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo;*/
+    IotHubTransportMqtt_GetSupportedPlatformInfo,     /*pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo;*/
+    IoTHubTransportMqtt_GetPollInfo                   /*pfIoTHubTransport_GetPollInfo IoTHubTransport_GetPollInfo;*/
 };
 
 extern const TRANSPORT_PROVIDER* MQTT_Protocol(void)
@@ -9,6 +9,7 @@
 #include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/timer_wheel.h"
 
 typedef struct MESSAGE_QUEUE_TAG MESSAGE_QUEUE;
 
@@ -33,6 +34,9 @@ struct MESSAGE_QUEUE_TAG
 
     SINGLYLINKEDLIST_HANDLE pending;
     SINGLYLINKEDLIST_HANDLE in_progress;
+
+    // Deadlines of all queued messages, in get_time() seconds.
+    TIMER_WHEEL_HANDLE timeouts;
 };
 
 typedef struct MESSAGE_QUEUE_ITEM_TAG
@@ -43,6 +47,9 @@ typedef struct MESSAGE_QUEUE_ITEM_TAG
     time_t enqueue_time;
     time_t processing_start_time;
     size_t number_of_attempts;
+    SINGLYLINKEDLIST_HANDLE list;
+    LIST_ITEM_HANDLE list_item;
+    TIMER_WHEEL_ENTRY timeout_entry;
 } MESSAGE_QUEUE_ITEM;
 
 
@@ -80,6 +87,64 @@ static void fire_message_callback(MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RES
     }
 }
 
+// Arms the earliest of the message's enqueue deadline and, while it is in progress, its processing deadline.
+static void schedule_timeout(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
+{
+    bool has_deadline = false;
+    tickcounter_ms_t deadline = 0;
+
+    if (message_queue->max_message_enqueued_time_secs > 0)
+    {
+        deadline = (tickcounter_ms_t)mq_item->enqueue_time + message_queue->max_message_enqueued_time_secs;
+        has_deadline = true;
+    }
+
+    if (message_queue->max_message_processing_time_secs > 0 && mq_item->list == message_queue->in_progress && mq_item->processing_start_time != INDEFINITE_TIME)
+    {
+        tickcounter_ms_t processing_deadline = (tickcounter_ms_t)mq_item->processing_start_time + message_queue->max_message_processing_time_secs;
+        if (!has_deadline || processing_deadline < deadline)
+        {
+            deadline = processing_deadline;
+        }
+        has_deadline = true;
+    }
+
+    if (has_deadline)
+    {
+        (void)timer_wheel_schedule(message_queue->timeouts, &mq_item->timeout_entry, deadline);
+    }
+    else
+    {
+        timer_wheel_cancel(&mq_item->timeout_entry);
+    }
+}
+
+static LIST_ITEM_HANDLE add_to_list(MESSAGE_QUEUE_HANDLE message_queue, SINGLYLINKEDLIST_HANDLE list, MESSAGE_QUEUE_ITEM* mq_item)
+{
+    LIST_ITEM_HANDLE result;
+
+    if ((result = singlylinkedlist_add(list, (const void*)mq_item)) != NULL)
+    {
+        mq_item->list = list;
+        mq_item->list_item = result;
+        schedule_timeout(message_queue, mq_item);
+    }
+
+    return result;
+}
+
+static void reschedule_item_timeout(const void* item, const void* action_context, bool* continue_processing)
+{
+    schedule_timeout((MESSAGE_QUEUE_HANDLE)action_context, (MESSAGE_QUEUE_ITEM*)item);
+    *continue_processing = true;
+}
+
+static void destroy_item(MESSAGE_QUEUE_ITEM* mq_item)
+{
+    timer_wheel_cancel(&mq_item->timeout_entry);
+    free(mq_item);
+}
+
 static bool should_retry_sending(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RESULT result)
 {
     return (result == MESSAGE_QUEUE_RETRYABLE_ERROR && mq_item->number_of_attempts <= message_queue->max_retry_count);
@@ -101,7 +166,7 @@ static int retry_sending_message(MESSAGE_QUEUE_HANDLE message_queue, LIST_ITEM_H
         LogError("Failed removing message from in-progress list");
         result = MU_FAILURE;
     }
-    else if (singlylinkedlist_add(message_queue->pending, (const void*)mq_item) == NULL)
+    else if (add_to_list(message_queue, message_queue->pending, mq_item) == NULL)
     {
         LogError("Failed moving message back to pending list");
         result = MU_FAILURE;
@@ -125,7 +190,7 @@ static void dequeue_message_and_fire_callback(SINGLYLINKEDLIST_HANDLE list, LIST
 
     fire_message_callback(mq_item, result, reason);
 
-    free(mq_item);
+    destroy_item(mq_item);
 }
 
 static void on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_QUEUE_RESULT result, USER_DEFINED_REASON reason)
@@ -154,6 +219,14 @@ static void on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_q
     }
 }
 
+static void on_message_timeout(void* context, TIMER_WHEEL_ENTRY* timeout_entry)
+{
+    MESSAGE_QUEUE_ITEM* mq_item = containingRecord(timeout_entry, MESSAGE_QUEUE_ITEM, timeout_entry);
+    (void)context;
+
+    dequeue_message_and_fire_callback(mq_item->list, mq_item->list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
+}
+
 static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
 {
     time_t current_time;
@@ -164,78 +237,8 @@ static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
     }
     else
     {
-        if (message_queue->max_message_enqueued_time_secs > 0)
-        {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(message_queue->pending);
-
-            while (list_item != NULL)
-            {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
-
-                list_item = singlylinkedlist_get_next_item(list_item);
-
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
-                {
-                    dequeue_message_and_fire_callback(message_queue->pending, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
-                }
-                else
-                {
-                    // The pending list order is already based on enqueue time, so if one message is not expired, later ones won't be either.
-                    break;
-                }
-            }
-
-            list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
-
-            while (list_item != NULL)
-            {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
-
-                list_item = singlylinkedlist_get_next_item(list_item);
-
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
-                {
-                    dequeue_message_and_fire_callback(message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
-                }
-            }
-        }
-
-        if (message_queue->max_message_processing_time_secs > 0)
-        {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
-
-            while (list_item != NULL)
-            {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
-
-                list_item = singlylinkedlist_get_next_item(list_item);
-
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->processing_start_time) >= message_queue->max_message_processing_time_secs)
-                {
-                    dequeue_message_and_fire_callback(message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
-                }
-                else
-                {
-                    // The in-progress list order is already based on start-processing time, so if one message is not expired, later ones won't be either.
-                    break;
-                }
-            }
-        }
+        // Only messages whose enqueue or processing deadline has passed are visited.
+        (void)timer_wheel_advance(message_queue->timeouts, (tickcounter_ms_t)current_time, on_message_timeout, message_queue);
     }
 }
 
@@ -274,9 +277,9 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
                 mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
             }
 
-            free(mq_item);
+            destroy_item(mq_item);
         }
-        else if (singlylinkedlist_add(message_queue->in_progress, (const void*)mq_item) == NULL)
+        else if (add_to_list(message_queue, message_queue->in_progress, mq_item) == NULL)
         {
             LogError("failed moving message to in-progress list (%p)", mq_item->message);
 
@@ -285,7 +288,7 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
                 mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
             }
 
-            free(mq_item);
+            destroy_item(mq_item);
         }
         else
         {
@@ -367,7 +370,7 @@ void message_queue_remove_all(MESSAGE_QUEUE_HANDLE message_queue)
     }
 }
 
-static int move_messages_between_lists(SINGLYLINKEDLIST_HANDLE from_list, SINGLYLINKEDLIST_HANDLE to_list)
+static int move_messages_between_lists(MESSAGE_QUEUE_HANDLE message_queue, SINGLYLINKEDLIST_HANDLE from_list, SINGLYLINKEDLIST_HANDLE to_list)
 {
     int result;
     LIST_ITEM_HANDLE list_item;
@@ -390,11 +393,11 @@ static int move_messages_between_lists(SINGLYLINKEDLIST_HANDLE from_list, SINGLY
             result = MU_FAILURE;
             break;
         }
-        else if (singlylinkedlist_add(to_list, (const void*)mq_item) == NULL)
+        else if (add_to_list(message_queue, to_list, mq_item) == NULL)
         {
             LogError("failed moving message to list");
             fire_message_callback(mq_item, MESSAGE_QUEUE_CANCELLED, NULL);
-            free(mq_item);
+            destroy_item(mq_item);
             result = MU_FAILURE;
             break;
         }
@@ -414,12 +417,12 @@ int message_queue_move_all_back_to_pending(MESSAGE_QUEUE_HANDLE message_queue)
     }
     else
     {
-        if (move_messages_between_lists(message_queue->pending, message_queue->in_progress) != 0)
+        if (move_messages_between_lists(message_queue, message_queue->pending, message_queue->in_progress) != 0)
         {
             LogError("failed moving pending messages at the end of in-progress");
             result = MU_FAILURE;
         }
-        else if (move_messages_between_lists(message_queue->in_progress, message_queue->pending) != 0)
+        else if (move_messages_between_lists(message_queue, message_queue->in_progress, message_queue->pending) != 0)
         {
             LogError("failed moving all in-progress messages back to pending");
             result = MU_FAILURE;
@@ -454,6 +457,8 @@ void message_queue_destroy(MESSAGE_QUEUE_HANDLE message_queue)
             singlylinkedlist_destroy(message_queue->in_progress);
         }
 
+        timer_wheel_destroy(message_queue->timeouts);
+
         free(message_queue);
     }
 }
@@ -479,6 +484,8 @@ MESSAGE_QUEUE_HANDLE message_queue_create(MESSAGE_QUEUE_CONFIG* config)
     }
     else
     {
+        time_t current_time;
+
         memset(result, 0, sizeof(MESSAGE_QUEUE));
 
         if ((result->pending = singlylinkedlist_create()) == NULL)
@@ -493,6 +500,13 @@ MESSAGE_QUEUE_HANDLE message_queue_create(MESSAGE_QUEUE_CONFIG* config)
             message_queue_destroy(result);
             result = NULL;
         }
+        else if ((current_time = get_time(NULL)) == INDEFINITE_TIME ||
+            (result->timeouts = timer_wheel_create(1, (tickcounter_ms_t)current_time)) == NULL)
+        {
+            LogError("failed allocating MESSAGE_QUEUE timeouts");
+            message_queue_destroy(result);
+            result = NULL;
+        }
         else
         {
 
@@ -527,6 +541,7 @@ int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE mess
         else
         {
             memset(mq_item, 0, sizeof(MESSAGE_QUEUE_ITEM));
+            timer_wheel_entry_init(&mq_item->timeout_entry);
 
             if ((mq_item->enqueue_time = get_time(NULL)) == INDEFINITE_TIME)
             {
@@ -534,7 +549,7 @@ int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE mess
                 free(mq_item);
                 result = MU_FAILURE;
             }
-            else if (singlylinkedlist_add(message_queue->pending, (const void*)mq_item) == NULL)
+            else if (add_to_list(message_queue, message_queue->pending, mq_item) == NULL)
             {
                 LogError("failed enqueuing message");
                 free(mq_item);
@@ -593,6 +608,8 @@ int message_queue_set_max_message_enqueued_time_secs(MESSAGE_QUEUE_HANDLE messag
     else
     {
         message_queue->max_message_enqueued_time_secs = seconds;
+        (void)singlylinkedlist_foreach(message_queue->pending, reschedule_item_timeout, message_queue);
+        (void)singlylinkedlist_foreach(message_queue->in_progress, reschedule_item_timeout, message_queue);
         result = RESULT_OK;
     }
 
@@ -611,6 +628,7 @@ int message_queue_set_max_message_processing_time_secs(MESSAGE_QUEUE_HANDLE mess
     else
     {
         message_queue->max_message_processing_time_secs = seconds;
+        (void)singlylinkedlist_foreach(message_queue->in_progress, reschedule_item_timeout, message_queue);
         result = RESULT_OK;
     }
 
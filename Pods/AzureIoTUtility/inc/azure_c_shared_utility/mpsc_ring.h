@@ -0,0 +1,54 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif /* __cplusplus */
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+* A bounded, lock-free ring of pointers. Any number of threads may call mpsc_ring_push concurrently;
+* only a single thread may call mpsc_ring_pop. Neither call blocks.
+*/
+typedef struct MPSC_RING_TAG* MPSC_RING_HANDLE;
+
+/**
+* @brief            Creates a ring able to hold @p capacity items.
+* @param capacity   Number of slots. Rounded up to the next power of two.
+* @returns          A valid handle or NULL if @p capacity is 0 or allocation fails.
+*/
+MOCKABLE_FUNCTION(, MPSC_RING_HANDLE, mpsc_ring_create, size_t, capacity);
+
+/**
+* @brief            Frees the ring. Items still queued are not freed.
+*/
+MOCKABLE_FUNCTION(, void, mpsc_ring_destroy, MPSC_RING_HANDLE, ring);
+
+/**
+* @brief            Appends @p item to the ring. Safe to call from several threads at once.
+* @returns          0 on success, non-zero if the ring is full or an argument is NULL.
+*/
+MOCKABLE_FUNCTION(, int, mpsc_ring_push, MPSC_RING_HANDLE, ring, void*, item);
+
+/**
+* @brief            Removes the oldest item. Must only be called by the single consumer thread.
+* @returns          The item, or NULL if the ring is empty.
+*/
+MOCKABLE_FUNCTION(, void*, mpsc_ring_pop, MPSC_RING_HANDLE, ring);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MPSC_RING_H */
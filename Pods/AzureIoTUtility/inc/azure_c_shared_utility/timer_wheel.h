@@ -0,0 +1,102 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+* A hierarchical timer wheel. Scheduling and cancelling a deadline are O(1); advancing the wheel only touches
+* entries that expire (plus an occasional cascade of one slot to a finer level). Entries are intrusive: the owner
+* embeds a TIMER_WHEEL_ENTRY in its own record and gets it back in the expiry callback (use containingRecord).
+* The wheel is not thread safe; all calls for one wheel must be serialized by the owner.
+*/
+typedef struct TIMER_WHEEL_TAG* TIMER_WHEEL_HANDLE;
+
+/* Fields are private to timer_wheel.c; the struct is only public so it can be embedded. */
+typedef struct TIMER_WHEEL_ENTRY_TAG
+{
+    DLIST_ENTRY link;
+    tickcounter_ms_t expiry_tick;
+    TIMER_WHEEL_HANDLE timer_wheel;
+    size_t level;
+} TIMER_WHEEL_ENTRY;
+
+/* Invoked for each expired entry. The entry is no longer scheduled, so it may be rescheduled or freed. */
+typedef void(*ON_TIMER_WHEEL_ENTRY_EXPIRED)(void* context, TIMER_WHEEL_ENTRY* entry);
+
+/**
+* @brief                Creates a timer wheel.
+* @param resolution_ms  Granularity of the wheel. Entries expire at most one resolution after their deadline.
+* @param start_ms       Current time, in the same time base the deadlines will use.
+* @returns              A valid handle or NULL if @p resolution_ms is 0 or allocation fails.
+*/
+MOCKABLE_FUNCTION(, TIMER_WHEEL_HANDLE, timer_wheel_create, tickcounter_ms_t, resolution_ms, tickcounter_ms_t, start_ms);
+
+/**
+* @brief                Frees the wheel. Entries still scheduled are left unscheduled and are not touched.
+*/
+MOCKABLE_FUNCTION(, void, timer_wheel_destroy, TIMER_WHEEL_HANDLE, timer_wheel);
+
+/**
+* @brief                Marks @p entry as not scheduled. Must be called once before the entry is first used.
+*/
+MOCKABLE_FUNCTION(, void, timer_wheel_entry_init, TIMER_WHEEL_ENTRY*, entry);
+
+/**
+* @brief                Schedules @p entry to expire at @p deadline_ms. An entry that is already scheduled is moved.
+*                       A deadline in a tick the wheel already processed, i.e. not after the time last passed to
+*                       timer_wheel_advance rounded down to the resolution, expires on the next call to
+*                       timer_wheel_advance whatever time that call passes.
+* @returns              0 on success, non-zero if an argument is NULL.
+*/
+MOCKABLE_FUNCTION(, int, timer_wheel_schedule, TIMER_WHEEL_HANDLE, timer_wheel, TIMER_WHEEL_ENTRY*, entry, tickcounter_ms_t, deadline_ms);
+
+/**
+* @brief                Unschedules @p entry. Does nothing if the entry is not scheduled.
+*/
+MOCKABLE_FUNCTION(, void, timer_wheel_cancel, TIMER_WHEEL_ENTRY*, entry);
+
+/**
+* @brief                Returns true if @p entry is currently scheduled on a wheel.
+*/
+MOCKABLE_FUNCTION(, bool, timer_wheel_is_scheduled, const TIMER_WHEEL_ENTRY*, entry);
+
+/**
+* @brief                Returns the wheel @p entry is scheduled on, or NULL if it is not scheduled.
+*/
+MOCKABLE_FUNCTION(, TIMER_WHEEL_HANDLE, timer_wheel_entry_get_timer_wheel, const TIMER_WHEEL_ENTRY*, entry);
+
+/**
+* @brief                Moves the wheel forward to @p now_ms and calls @p on_expired for every entry whose deadline
+*                       has passed. The callback may schedule or cancel entries but must not advance or destroy the wheel.
+* @returns              The number of expired entries.
+*/
+MOCKABLE_FUNCTION(, size_t, timer_wheel_advance, TIMER_WHEEL_HANDLE, timer_wheel, tickcounter_ms_t, now_ms, ON_TIMER_WHEEL_ENTRY_EXPIRED, on_expired, void*, context);
+
+/**
+* @brief                Gets the time by which timer_wheel_advance must next be called. For entries on the coarser levels
+*                       this is the time their slot cascades, so it can be earlier than any actual deadline, never later.
+* @returns              0 and sets @p deadline_ms if any entry is scheduled, non-zero if none is or an argument is NULL.
+*/
+MOCKABLE_FUNCTION(, int, timer_wheel_get_next_deadline, TIMER_WHEEL_HANDLE, timer_wheel, tickcounter_ms_t*, deadline_ms);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* TIMER_WHEEL_H */
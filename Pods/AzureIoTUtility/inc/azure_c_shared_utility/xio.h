@@ -8,9 +8,11 @@
 #include <cstddef>
 #else
 #include <stddef.h>
+#include <stdbool.h>
 #endif /* __cplusplus */
 
 #include "azure_c_shared_utility/optionhandler.h"
+#include "azure_c_shared_utility/const_defines.h"
 
 #include "umock_c/umock_c_prod.h"
 #include "azure_macro_utils/macro_utils.h"
@@ -42,6 +44,20 @@ typedef void(*ON_IO_OPEN_COMPLETE)(void* context, IO_OPEN_RESULT open_result);
 typedef void(*ON_IO_CLOSE_COMPLETE)(void* context);
 typedef void(*ON_IO_ERROR)(void* context);
 
+/* What an event loop has to wait for before the next xio_dowork is useful. */
+typedef struct XIO_POLL_INFO_TAG
+{
+    int fd;             /* descriptor that becomes readable when there is input, -1 when the IO has none right now */
+    bool want_write;    /* output is queued and xio_dowork pushes it once fd is writable */
+} XIO_POLL_INFO;
+
+/* One of the pieces xio_sendv sends back to back. */
+typedef struct XIO_BUFFER_TAG
+{
+    const void* buffer;
+    size_t size;
+} XIO_BUFFER;
+
 typedef OPTIONHANDLER_HANDLE (*IO_RETRIEVEOPTIONS)(CONCRETE_IO_HANDLE concrete_io);
 typedef CONCRETE_IO_HANDLE(*IO_CREATE)(void* io_create_parameters);
 typedef void(*IO_DESTROY)(CONCRETE_IO_HANDLE concrete_io);
@@ -50,6 +66,8 @@ typedef int(*IO_CLOSE)(CONCRETE_IO_HANDLE concrete_io, ON_IO_CLOSE_COMPLETE on_i
 typedef int(*IO_SEND)(CONCRETE_IO_HANDLE concrete_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context);
 typedef void(*IO_DOWORK)(CONCRETE_IO_HANDLE concrete_io);
 typedef int(*IO_SETOPTION)(CONCRETE_IO_HANDLE concrete_io, const char* optionName, const void* value);
+typedef int(*IO_GET_POLL_INFO)(CONCRETE_IO_HANDLE concrete_io, XIO_POLL_INFO* poll_info);
+typedef int(*IO_SENDV)(CONCRETE_IO_HANDLE concrete_io, const XIO_BUFFER* buffers, size_t buffer_count, ON_SEND_COMPLETE on_send_complete, void* callback_context);
 
 
 typedef struct IO_INTERFACE_DESCRIPTION_TAG
@@ -62,17 +80,38 @@ typedef struct IO_INTERFACE_DESCRIPTION_TAG
     IO_SEND concrete_io_send;
     IO_DOWORK concrete_io_dowork;
     IO_SETOPTION concrete_io_setoption;
+    IO_GET_POLL_INFO concrete_io_get_poll_info; /* optional, NULL when the IO cannot tell */
+    IO_SENDV concrete_io_sendv; /* optional, NULL when xio_sendv has to gather the buffers for concrete_io_send */
 } IO_INTERFACE_DESCRIPTION;
 
+/* Observes the bytes passed to xio_send and handed to on_bytes_received. Installed with
+   xio_setoption(xio, OPTION_XIO_BYTE_COUNTER, &counter); xio keeps a copy and does not pass the option to the concrete IO.
+   A NULL value or a NULL on_bytes_transferred removes it. It survives xio_open/xio_close but not xio_destroy. */
+typedef void(*ON_XIO_BYTES_TRANSFERRED)(void* context, size_t bytes_sent, size_t bytes_received);
+
+typedef struct XIO_BYTE_COUNTER_TAG
+{
+    ON_XIO_BYTES_TRANSFERRED on_bytes_transferred;
+    void* context;
+} XIO_BYTE_COUNTER;
+
+static STATIC_VAR_UNUSED const char* const OPTION_XIO_BYTE_COUNTER = "xio_byte_counter";
+
 MOCKABLE_FUNCTION(, XIO_HANDLE, xio_create, const IO_INTERFACE_DESCRIPTION*, io_interface_description, const void*, io_create_parameters);
 MOCKABLE_FUNCTION(, void, xio_destroy, XIO_HANDLE, xio);
 MOCKABLE_FUNCTION(, int, xio_open, XIO_HANDLE, xio, ON_IO_OPEN_COMPLETE, on_io_open_complete, void*, on_io_open_complete_context, ON_BYTES_RECEIVED, on_bytes_received, void*, on_bytes_received_context, ON_IO_ERROR, on_io_error, void*, on_io_error_context);
 MOCKABLE_FUNCTION(, int, xio_close, XIO_HANDLE, xio, ON_IO_CLOSE_COMPLETE, on_io_close_complete, void*, callback_context);
 MOCKABLE_FUNCTION(, int, xio_send, XIO_HANDLE, xio, const void*, buffer, size_t, size, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
+/* Sends the buffers as one xio_send of their concatenation would, on_send_complete being called once for all of them. The buffers
+   are only read during the call. Concrete IOs without concrete_io_sendv get a copy of the buffers gathered in one. */
+MOCKABLE_FUNCTION(, int, xio_sendv, XIO_HANDLE, xio, const XIO_BUFFER*, buffers, size_t, buffer_count, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
 MOCKABLE_FUNCTION(, void, xio_dowork, XIO_HANDLE, xio);
 MOCKABLE_FUNCTION(, int, xio_setoption, XIO_HANDLE, xio, const char*, optionName, const void*, value);
 MOCKABLE_FUNCTION(, OPTIONHANDLER_HANDLE, xio_retrieveoptions, XIO_HANDLE, xio);
 
+/* Fails when the concrete IO does not implement concrete_io_get_poll_info; the caller then has to poll xio_dowork. */
+MOCKABLE_FUNCTION(, int, xio_get_poll_info, XIO_HANDLE, xio, XIO_POLL_INFO*, poll_info);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -625,6 +625,40 @@ static void tlsio_appleios_dowork(CONCRETE_IO_HANDLE tls_io)
     }
 }
 
+static int tlsio_appleios_get_poll_info(CONCRETE_IO_HANDLE tls_io, XIO_POLL_INFO* poll_info)
+{
+    int result;
+    if (tls_io == NULL || poll_info == NULL)
+    {
+        LogError("Invalid argument (tls_io=%p, poll_info=%p)", tls_io, poll_info);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        TLS_IO_INSTANCE* tls_io_instance = (TLS_IO_INSTANCE*)tls_io;
+        CFDataRef native_handle = NULL;
+
+        poll_info->fd = -1;
+        // The opening states are polled by tlsio_appleios_dowork rather than signalled on the socket
+        poll_info->want_write = is_an_opening_state(tls_io_instance->tlsio_state) ||
+            singlylinkedlist_get_head_item(tls_io_instance->pending_transmission_list) != NULL;
+
+        if (tls_io_instance->sockRead != NULL &&
+            (native_handle = (CFDataRef)CFReadStreamCopyProperty(tls_io_instance->sockRead, kCFStreamPropertySocketNativeHandle)) != NULL)
+        {
+            CFSocketNativeHandle socket_handle;
+            if (CFDataGetLength(native_handle) == (CFIndex)sizeof(socket_handle))
+            {
+                CFDataGetBytes(native_handle, CFRangeMake(0, sizeof(socket_handle)), (UInt8*)&socket_handle);
+                poll_info->fd = socket_handle;
+            }
+            CFRelease(native_handle);
+        }
+        result = 0;
+    }
+    return result;
+}
+
 static int tlsio_appleios_setoption(CONCRETE_IO_HANDLE tls_io, const char* optionName, const void* value)
 {
     TLS_IO_INSTANCE* tls_io_instance = (TLS_IO_INSTANCE*)tls_io;
@@ -746,6 +780,98 @@ static int tlsio_appleios_send_async(CONCRETE_IO_HANDLE tls_io, const void* buff
     return result;
 }
 
+// Enqueues the buffers as a single pending transmission, so that a packet split into pieces by the
+// caller is written to the stream by the same dowork_send calls as a contiguous one.
+static int tlsio_appleios_sendv_async(CONCRETE_IO_HANDLE tls_io, const XIO_BUFFER* buffers, size_t buffer_count, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    if (tls_io == NULL || buffers == NULL || buffer_count == 0 || on_send_complete == NULL)
+    {
+        result = MU_FAILURE;
+        LogError("Invalid parameter specified: tls_io: %p, buffers: %p, buffer_count: %lu, on_send_complete: %p", tls_io, buffers, (unsigned long)buffer_count, on_send_complete);
+    }
+    else if (buffer_count == 1)
+    {
+        result = tlsio_appleios_send_async(tls_io, buffers[0].buffer, buffers[0].size, on_send_complete, callback_context);
+    }
+    else
+    {
+        TLS_IO_INSTANCE* tls_io_instance = (TLS_IO_INSTANCE*)tls_io;
+        size_t size = 0;
+        size_t i;
+
+        for (i = 0; i < buffer_count; i++)
+        {
+            if (buffers[i].buffer == NULL && buffers[i].size != 0)
+            {
+                break;
+            }
+            size += buffers[i].size;
+        }
+
+        if (i < buffer_count || size == 0)
+        {
+            result = MU_FAILURE;
+            LogError("Invalid buffer specified at index %lu", (unsigned long)i);
+        }
+        else if (tls_io_instance->tlsio_state != TLSIO_STATE_OPEN)
+        {
+            result = MU_FAILURE;
+            LogError("tlsio_appleios_sendv_async without a prior successful open");
+        }
+        else
+        {
+            PENDING_TRANSMISSION* pending_transmission = (PENDING_TRANSMISSION*)malloc(sizeof(PENDING_TRANSMISSION));
+            if (pending_transmission == NULL)
+            {
+                result = MU_FAILURE;
+                LogError("malloc failed");
+            }
+            else if ((pending_transmission->bytes = (unsigned char*)malloc(size)) == NULL)
+            {
+                LogError("malloc failed");
+                free(pending_transmission);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                size_t offset = 0;
+                for (i = 0; i < buffer_count; i++)
+                {
+                    if (buffers[i].size > 0)
+                    {
+                        (void)memcpy(pending_transmission->bytes + offset, buffers[i].buffer, buffers[i].size);
+                        offset += buffers[i].size;
+                    }
+                }
+
+                // The websocket upgrade header the no-cert hack looks for is never sent in pieces, so the
+                // first send being vectored only clears the flag
+                tls_io_instance->no_messages_yet_sent = false;
+
+                pending_transmission->size = size;
+                pending_transmission->unsent_size = size;
+                pending_transmission->on_send_complete = on_send_complete;
+                pending_transmission->callback_context = callback_context;
+
+                if (singlylinkedlist_add(tls_io_instance->pending_transmission_list, pending_transmission) == NULL)
+                {
+                    LogError("Unable to add socket to pending list.");
+                    free(pending_transmission->bytes);
+                    free(pending_transmission);
+                    result = MU_FAILURE;
+                }
+                else
+                {
+                    result = 0;
+                    dowork_send(tls_io_instance);
+                }
+            }
+        }
+    }
+    return result;
+}
+
 /* Codes_SRS_TLSIO_APPLEIOS_COMPACT_30_560: [ The  tlsio_retrieveoptions  shall do nothing and return NULL. ]*/
 static OPTIONHANDLER_HANDLE tlsio_appleios_retrieveoptions(CONCRETE_IO_HANDLE tls_io)
 {
@@ -774,7 +900,9 @@ static const IO_INTERFACE_DESCRIPTION tlsio_appleios_interface_description =
     tlsio_appleios_close_async,
     tlsio_appleios_send_async,
     tlsio_appleios_dowork,
-    tlsio_appleios_setoption
+    tlsio_appleios_setoption,
+    tlsio_appleios_get_poll_info,
+    tlsio_appleios_sendv_async
 };
 
 /* Codes_SRS_TLSIO_30_001: [ The tlsio_appleios_compact shall implement and export all the Concrete functions in the VTable IO_INTERFACE_DESCRIPTION defined in the xio.h. ]*/
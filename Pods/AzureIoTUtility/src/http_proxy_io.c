@@ -884,6 +884,41 @@ static int http_proxy_io_send(CONCRETE_IO_HANDLE http_proxy_io, const void* buff
     return result;
 }
 
+static int http_proxy_io_sendv(CONCRETE_IO_HANDLE http_proxy_io, const XIO_BUFFER* buffers, size_t buffer_count, ON_SEND_COMPLETE on_send_complete, void* on_send_complete_context)
+{
+    int result;
+
+    if ((http_proxy_io == NULL) ||
+        (buffers == NULL) ||
+        (buffer_count == 0))
+    {
+        result = __LINE__;
+        LogError("Bad arguments: http_proxy_io = %p, buffers = %p.",
+            http_proxy_io, buffers);
+    }
+    else
+    {
+        HTTP_PROXY_IO_INSTANCE* http_proxy_io_instance = (HTTP_PROXY_IO_INSTANCE*)http_proxy_io;
+
+        if (http_proxy_io_instance->http_proxy_io_state != HTTP_PROXY_IO_STATE_OPEN)
+        {
+            result = __LINE__;
+            LogError("Invalid HTTP proxy IO state. Expected state is HTTP_PROXY_IO_STATE_OPEN.");
+        }
+        else if (xio_sendv(http_proxy_io_instance->underlying_io, buffers, buffer_count, on_send_complete, on_send_complete_context) != 0)
+        {
+            result = __LINE__;
+            LogError("Underlying xio_sendv failed.");
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
 static void http_proxy_io_dowork(CONCRETE_IO_HANDLE http_proxy_io)
 {
     if (http_proxy_io == NULL)
@@ -903,6 +938,27 @@ static void http_proxy_io_dowork(CONCRETE_IO_HANDLE http_proxy_io)
     }
 }
 
+static int http_proxy_io_get_poll_info(CONCRETE_IO_HANDLE http_proxy_io, XIO_POLL_INFO* poll_info)
+{
+    int result;
+
+    if ((http_proxy_io == NULL) ||
+        (poll_info == NULL))
+    {
+        LogError("Bad arguments: http_proxy_io = %p, poll_info = %p", http_proxy_io, poll_info);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        HTTP_PROXY_IO_INSTANCE* http_proxy_io_instance = (HTTP_PROXY_IO_INSTANCE*)http_proxy_io;
+
+        /* the proxy adds no buffering of its own once the CONNECT reply is in, so the underlying IO's answer stands */
+        result = xio_get_poll_info(http_proxy_io_instance->underlying_io, poll_info);
+    }
+
+    return result;
+}
+
 static int http_proxy_io_set_option(CONCRETE_IO_HANDLE http_proxy_io, const char* option_name, const void* value)
 {
     int result;
@@ -1063,7 +1119,9 @@ static const IO_INTERFACE_DESCRIPTION http_proxy_io_interface_description =
     http_proxy_io_close,
     http_proxy_io_send,
     http_proxy_io_dowork,
-    http_proxy_io_set_option
+    http_proxy_io_set_option,
+    http_proxy_io_get_poll_info,
+    http_proxy_io_sendv
 };
 
 const IO_INTERFACE_DESCRIPTION* http_proxy_io_get_interface_description(void)
@@ -0,0 +1,166 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/mpsc_ring.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+/* Bounded queue in the style of D. Vyukov's MPMC ring: every slot carries a sequence number telling
+   producers and the consumer whose turn it is, so a push costs one CAS and a pop no atomic RMW at all. */
+typedef struct MPSC_RING_SLOT_TAG
+{
+    atomic_size_t sequence;
+    void* item;
+} MPSC_RING_SLOT;
+
+typedef struct MPSC_RING_TAG
+{
+    MPSC_RING_SLOT* slots;
+    size_t mask;
+    atomic_size_t enqueue_position;
+    size_t dequeue_position; /* only touched by the consumer */
+} MPSC_RING;
+
+MPSC_RING_HANDLE mpsc_ring_create(size_t capacity)
+{
+    MPSC_RING* result;
+
+    if (capacity == 0 || capacity > (SIZE_MAX >> 1))
+    {
+        LogError("Invalid capacity %lu", (unsigned long)capacity);
+        result = NULL;
+    }
+    else if ((result = (MPSC_RING*)malloc(sizeof(MPSC_RING))) == NULL)
+    {
+        LogError("Failed allocating ring");
+    }
+    else
+    {
+        size_t slot_count = 1;
+        while (slot_count < capacity)
+        {
+            slot_count <<= 1;
+        }
+
+        if ((result->slots = (MPSC_RING_SLOT*)malloc(slot_count * sizeof(MPSC_RING_SLOT))) == NULL)
+        {
+            LogError("Failed allocating %lu ring slots", (unsigned long)slot_count);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t index;
+            for (index = 0; index < slot_count; index++)
+            {
+                atomic_init(&result->slots[index].sequence, index);
+                result->slots[index].item = NULL;
+            }
+            result->mask = slot_count - 1;
+            atomic_init(&result->enqueue_position, 0);
+            result->dequeue_position = 0;
+        }
+    }
+
+    return result;
+}
+
+void mpsc_ring_destroy(MPSC_RING_HANDLE ring)
+{
+    if (ring != NULL)
+    {
+        free(ring->slots);
+        free(ring);
+    }
+}
+
+int mpsc_ring_push(MPSC_RING_HANDLE ring, void* item)
+{
+    int result;
+
+    if (ring == NULL || item == NULL)
+    {
+        LogError("Invalid argument (ring=%p, item=%p)", ring, item);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        MPSC_RING_SLOT* slot;
+        size_t position = atomic_load_explicit(&ring->enqueue_position, memory_order_relaxed);
+
+        while (1)
+        {
+            size_t sequence;
+            intptr_t difference;
+
+            slot = &ring->slots[position & ring->mask];
+            sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+            difference = (intptr_t)sequence - (intptr_t)position;
+
+            if (difference == 0)
+            {
+                /* slot is free for this position, claim it */
+                if (atomic_compare_exchange_weak_explicit(&ring->enqueue_position, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                {
+                    result = 0;
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                /* consumer has not freed this slot yet: full */
+                result = MU_FAILURE;
+                break;
+            }
+            else
+            {
+                /* another producer claimed it first */
+                position = atomic_load_explicit(&ring->enqueue_position, memory_order_relaxed);
+            }
+        }
+
+        if (result == 0)
+        {
+            slot->item = item;
+            atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+        }
+    }
+
+    return result;
+}
+
+void* mpsc_ring_pop(MPSC_RING_HANDLE ring)
+{
+    void* result;
+
+    if (ring == NULL)
+    {
+        LogError("Invalid argument (ring=NULL)");
+        result = NULL;
+    }
+    else
+    {
+        size_t position = ring->dequeue_position;
+        MPSC_RING_SLOT* slot = &ring->slots[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+        if ((intptr_t)sequence - (intptr_t)(position + 1) < 0)
+        {
+            /* empty, or the producer owning this slot has not published yet */
+            result = NULL;
+        }
+        else
+        {
+            result = slot->item;
+            slot->item = NULL;
+            atomic_store_explicit(&slot->sequence, position + ring->mask + 1, memory_order_release);
+            ring->dequeue_position = position + 1;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,379 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/timer_wheel.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+/* Level 0 has one slot per tick; every further level has slots as wide as the whole level below it.
+   With 8 + 3 * 6 bits the wheel spans 2^26 ticks; later deadlines park in the last slot and are re-placed when it cascades. */
+#define TIMER_WHEEL_LEVEL_COUNT     4
+#define TIMER_WHEEL_LEVEL0_BITS     8
+#define TIMER_WHEEL_LEVELN_BITS     6
+#define TIMER_WHEEL_LEVEL0_SIZE     ((size_t)1 << TIMER_WHEEL_LEVEL0_BITS)
+#define TIMER_WHEEL_LEVELN_SIZE     ((size_t)1 << TIMER_WHEEL_LEVELN_BITS)
+#define TIMER_WHEEL_SLOT_COUNT      (TIMER_WHEEL_LEVEL0_SIZE + (TIMER_WHEEL_LEVEL_COUNT - 1) * TIMER_WHEEL_LEVELN_SIZE)
+#define TIMER_WHEEL_LEVEL_EXPIRED   TIMER_WHEEL_LEVEL_COUNT /* entry left its slot and waits for its callback */
+#define TIMER_WHEEL_LEVEL_DUE       (TIMER_WHEEL_LEVEL_COUNT + 1) /* deadline before current_tick, on the due list */
+
+typedef struct TIMER_WHEEL_TAG
+{
+    tickcounter_ms_t resolution_ms;
+    tickcounter_ms_t current_tick; /* next tick to be processed */
+    size_t level_entry_count[TIMER_WHEEL_LEVEL_COUNT];
+    DLIST_ENTRY slots[TIMER_WHEEL_SLOT_COUNT];
+    DLIST_ENTRY due; /* entries scheduled for a tick already processed, expired by the next advance */
+} TIMER_WHEEL;
+
+static size_t level_shift(size_t level)
+{
+    return (level == 0) ? 0 : TIMER_WHEEL_LEVEL0_BITS + (level - 1) * TIMER_WHEEL_LEVELN_BITS;
+}
+
+static size_t level_mask(size_t level)
+{
+    return ((level == 0) ? TIMER_WHEEL_LEVEL0_SIZE : TIMER_WHEEL_LEVELN_SIZE) - 1;
+}
+
+static DLIST_ENTRY* level_slot(TIMER_WHEEL* timer_wheel, size_t level, tickcounter_ms_t tick)
+{
+    size_t offset = (level == 0) ? 0 : TIMER_WHEEL_LEVEL0_SIZE + (level - 1) * TIMER_WHEEL_LEVELN_SIZE;
+    return &timer_wheel->slots[offset + (size_t)((tick >> level_shift(level)) & level_mask(level))];
+}
+
+static void place_entry(TIMER_WHEEL* timer_wheel, TIMER_WHEEL_ENTRY* entry)
+{
+    tickcounter_ms_t expiry_tick = (entry->expiry_tick < timer_wheel->current_tick) ? timer_wheel->current_tick : entry->expiry_tick;
+    tickcounter_ms_t delta = expiry_tick - timer_wheel->current_tick;
+    size_t level = 0;
+
+    while (level < TIMER_WHEEL_LEVEL_COUNT - 1 && delta >= ((tickcounter_ms_t)1 << level_shift(level + 1)))
+    {
+        level++;
+    }
+
+    if (delta >= ((tickcounter_ms_t)1 << level_shift(TIMER_WHEEL_LEVEL_COUNT)))
+    {
+        expiry_tick = timer_wheel->current_tick + ((tickcounter_ms_t)1 << level_shift(TIMER_WHEEL_LEVEL_COUNT)) - 1;
+    }
+
+    DList_InsertTailList(level_slot(timer_wheel, level, expiry_tick), &entry->link);
+    entry->level = level;
+    timer_wheel->level_entry_count[level]++;
+}
+
+static void cascade_slot(TIMER_WHEEL* timer_wheel, size_t level)
+{
+    DLIST_ENTRY* slot = level_slot(timer_wheel, level, timer_wheel->current_tick);
+    DLIST_ENTRY moving;
+    PDLIST_ENTRY link;
+
+    DList_InitializeListHead(&moving);
+    while ((link = DList_RemoveHeadList(slot)) != slot)
+    {
+        DList_InsertTailList(&moving, link);
+    }
+
+    while ((link = DList_RemoveHeadList(&moving)) != &moving)
+    {
+        TIMER_WHEEL_ENTRY* entry = containingRecord(link, TIMER_WHEEL_ENTRY, link);
+        timer_wheel->level_entry_count[level]--;
+        place_entry(timer_wheel, entry);
+    }
+}
+
+/* processes timer_wheel->current_tick: refills level 0 from the coarser levels when it wraps, then takes its slot */
+static void expire_current_tick(TIMER_WHEEL* timer_wheel, DLIST_ENTRY* expired)
+{
+    DLIST_ENTRY* slot;
+    PDLIST_ENTRY link;
+    size_t level;
+
+    for (level = 1; level < TIMER_WHEEL_LEVEL_COUNT; level++)
+    {
+        if ((timer_wheel->current_tick & (((tickcounter_ms_t)1 << level_shift(level)) - 1)) != 0)
+        {
+            break;
+        }
+        cascade_slot(timer_wheel, level);
+    }
+
+    slot = level_slot(timer_wheel, 0, timer_wheel->current_tick);
+    while ((link = DList_RemoveHeadList(slot)) != slot)
+    {
+        TIMER_WHEEL_ENTRY* entry = containingRecord(link, TIMER_WHEEL_ENTRY, link);
+        timer_wheel->level_entry_count[0]--;
+        entry->level = TIMER_WHEEL_LEVEL_EXPIRED;
+        DList_InsertTailList(expired, link);
+    }
+
+    timer_wheel->current_tick++;
+}
+
+TIMER_WHEEL_HANDLE timer_wheel_create(tickcounter_ms_t resolution_ms, tickcounter_ms_t start_ms)
+{
+    TIMER_WHEEL* result;
+
+    if (resolution_ms == 0)
+    {
+        LogError("Invalid resolution 0");
+        result = NULL;
+    }
+    else if ((result = (TIMER_WHEEL*)malloc(sizeof(TIMER_WHEEL))) == NULL)
+    {
+        LogError("Failed allocating timer wheel");
+    }
+    else
+    {
+        size_t index;
+        for (index = 0; index < TIMER_WHEEL_SLOT_COUNT; index++)
+        {
+            DList_InitializeListHead(&result->slots[index]);
+        }
+        for (index = 0; index < TIMER_WHEEL_LEVEL_COUNT; index++)
+        {
+            result->level_entry_count[index] = 0;
+        }
+        DList_InitializeListHead(&result->due);
+        result->resolution_ms = resolution_ms;
+        result->current_tick = start_ms / resolution_ms;
+    }
+
+    return result;
+}
+
+void timer_wheel_destroy(TIMER_WHEEL_HANDLE timer_wheel)
+{
+    if (timer_wheel != NULL)
+    {
+        PDLIST_ENTRY link;
+        size_t index;
+        for (index = 0; index < TIMER_WHEEL_SLOT_COUNT; index++)
+        {
+            while ((link = DList_RemoveHeadList(&timer_wheel->slots[index])) != &timer_wheel->slots[index])
+            {
+                TIMER_WHEEL_ENTRY* entry = containingRecord(link, TIMER_WHEEL_ENTRY, link);
+                DList_InitializeListHead(link);
+                entry->timer_wheel = NULL;
+            }
+        }
+        while ((link = DList_RemoveHeadList(&timer_wheel->due)) != &timer_wheel->due)
+        {
+            TIMER_WHEEL_ENTRY* entry = containingRecord(link, TIMER_WHEEL_ENTRY, link);
+            DList_InitializeListHead(link);
+            entry->timer_wheel = NULL;
+        }
+        free(timer_wheel);
+    }
+}
+
+void timer_wheel_entry_init(TIMER_WHEEL_ENTRY* entry)
+{
+    if (entry != NULL)
+    {
+        DList_InitializeListHead(&entry->link);
+        entry->expiry_tick = 0;
+        entry->timer_wheel = NULL;
+        entry->level = TIMER_WHEEL_LEVEL_EXPIRED;
+    }
+}
+
+int timer_wheel_schedule(TIMER_WHEEL_HANDLE timer_wheel, TIMER_WHEEL_ENTRY* entry, tickcounter_ms_t deadline_ms)
+{
+    int result;
+
+    if (timer_wheel == NULL || entry == NULL)
+    {
+        LogError("Invalid argument (timer_wheel=%p, entry=%p)", timer_wheel, entry);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        timer_wheel_cancel(entry);
+
+        /* round up so that an entry never expires before its deadline */
+        entry->expiry_tick = (deadline_ms / timer_wheel->resolution_ms) + (((deadline_ms % timer_wheel->resolution_ms) != 0) ? 1 : 0);
+        entry->timer_wheel = timer_wheel;
+        if (entry->expiry_tick < timer_wheel->current_tick)
+        {
+            /* the tick was already processed, so its slot would only come round again a whole turn later */
+            DList_InsertTailList(&timer_wheel->due, &entry->link);
+            entry->level = TIMER_WHEEL_LEVEL_DUE;
+        }
+        else
+        {
+            place_entry(timer_wheel, entry);
+        }
+        result = 0;
+    }
+
+    return result;
+}
+
+void timer_wheel_cancel(TIMER_WHEEL_ENTRY* entry)
+{
+    if (entry != NULL && entry->timer_wheel != NULL)
+    {
+        TIMER_WHEEL* timer_wheel = entry->timer_wheel;
+
+        (void)DList_RemoveEntryList(&entry->link);
+        DList_InitializeListHead(&entry->link);
+        if (entry->level < TIMER_WHEEL_LEVEL_COUNT)
+        {
+            timer_wheel->level_entry_count[entry->level]--;
+        }
+        entry->timer_wheel = NULL;
+        entry->level = TIMER_WHEEL_LEVEL_EXPIRED;
+    }
+}
+
+bool timer_wheel_is_scheduled(const TIMER_WHEEL_ENTRY* entry)
+{
+    return (entry != NULL && entry->timer_wheel != NULL);
+}
+
+TIMER_WHEEL_HANDLE timer_wheel_entry_get_timer_wheel(const TIMER_WHEEL_ENTRY* entry)
+{
+    return (entry == NULL) ? NULL : entry->timer_wheel;
+}
+
+size_t timer_wheel_advance(TIMER_WHEEL_HANDLE timer_wheel, tickcounter_ms_t now_ms, ON_TIMER_WHEEL_ENTRY_EXPIRED on_expired, void* context)
+{
+    size_t result = 0;
+
+    if (timer_wheel == NULL || on_expired == NULL)
+    {
+        LogError("Invalid argument (timer_wheel=%p, on_expired=%p)", timer_wheel, on_expired);
+    }
+    else
+    {
+        tickcounter_ms_t now_tick = now_ms / timer_wheel->resolution_ms;
+        DLIST_ENTRY due;
+        PDLIST_ENTRY link;
+
+        /* take the whole due list first: entries the callbacks reschedule into the past wait for the next advance */
+        DList_InitializeListHead(&due);
+        while ((link = DList_RemoveHeadList(&timer_wheel->due)) != &timer_wheel->due)
+        {
+            DList_InsertTailList(&due, link);
+            containingRecord(link, TIMER_WHEEL_ENTRY, link)->level = TIMER_WHEEL_LEVEL_EXPIRED;
+        }
+
+        while ((link = DList_RemoveHeadList(&due)) != &due)
+        {
+            TIMER_WHEEL_ENTRY* entry = containingRecord(link, TIMER_WHEEL_ENTRY, link);
+            DList_InitializeListHead(link);
+            entry->timer_wheel = NULL;
+            result++;
+
+            on_expired(context, entry);
+        }
+
+        while (timer_wheel->current_tick <= now_tick)
+        {
+            size_t level = 0;
+
+            while (level < TIMER_WHEEL_LEVEL_COUNT && timer_wheel->level_entry_count[level] == 0)
+            {
+                level++;
+            }
+
+            if (level == TIMER_WHEEL_LEVEL_COUNT)
+            {
+                /* nothing scheduled, nothing to cascade */
+                timer_wheel->current_tick = now_tick + 1;
+            }
+            else if (level > 0 && (timer_wheel->current_tick & (((tickcounter_ms_t)1 << level_shift(level)) - 1)) != 0)
+            {
+                /* the finer levels are empty: skip straight to the tick where the first occupied level cascades */
+                tickcounter_ms_t next_tick = (timer_wheel->current_tick | (((tickcounter_ms_t)1 << level_shift(level)) - 1)) + 1;
+                timer_wheel->current_tick = (next_tick > now_tick) ? now_tick + 1 : next_tick;
+            }
+            else
+            {
+                DLIST_ENTRY expired;
+
+                DList_InitializeListHead(&expired);
+                expire_current_tick(timer_wheel, &expired);
+
+                while ((link = DList_RemoveHeadList(&expired)) != &expired)
+                {
+                    TIMER_WHEEL_ENTRY* entry = containingRecord(link, TIMER_WHEEL_ENTRY, link);
+                    DList_InitializeListHead(link);
+                    entry->timer_wheel = NULL;
+                    result++;
+
+                    on_expired(context, entry);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+int timer_wheel_get_next_deadline(TIMER_WHEEL_HANDLE timer_wheel, tickcounter_ms_t* deadline_ms)
+{
+    int result;
+
+    if (timer_wheel == NULL || deadline_ms == NULL)
+    {
+        LogError("Invalid argument (timer_wheel=%p, deadline_ms=%p)", timer_wheel, deadline_ms);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        tickcounter_ms_t next_tick = 0;
+        bool found = false;
+        size_t level;
+
+        if (!DList_IsListEmpty(&timer_wheel->due))
+        {
+            /* already due: any tick before current_tick makes the caller advance at once */
+            next_tick = containingRecord(timer_wheel->due.Flink, TIMER_WHEEL_ENTRY, link)->expiry_tick;
+            found = true;
+        }
+
+        for (level = 0; level < TIMER_WHEEL_LEVEL_COUNT; level++)
+        {
+            if (timer_wheel->level_entry_count[level] != 0)
+            {
+                /* level 0 entries lie within one turn of current_tick. The slot of a coarser level that holds current_tick has
+                   already cascaded unless current_tick is aligned to that level, in which case it cascades on the next advance */
+                tickcounter_ms_t first = (level == 0 || (timer_wheel->current_tick & (((tickcounter_ms_t)1 << level_shift(level)) - 1)) == 0) ? 0 : 1;
+                tickcounter_ms_t last = (tickcounter_ms_t)level_mask(level) + first;
+                tickcounter_ms_t base = timer_wheel->current_tick >> level_shift(level);
+                tickcounter_ms_t offset;
+
+                for (offset = first; offset <= last; offset++)
+                {
+                    if (!DList_IsListEmpty(level_slot(timer_wheel, level, (base + offset) << level_shift(level))))
+                    {
+                        tickcounter_ms_t tick = (level == 0) ? timer_wheel->current_tick + offset : (base + offset) << level_shift(level);
+                        if (!found || tick < next_tick)
+                        {
+                            next_tick = tick;
+                            found = true;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (!found)
+        {
+            result = MU_FAILURE;
+        }
+        else
+        {
+            *deadline_ms = next_tick * timer_wheel->resolution_ms;
+            result = 0;
+        }
+    }
+
+    return result;
+}
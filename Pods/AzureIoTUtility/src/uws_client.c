@@ -2079,6 +2079,25 @@ void uws_client_dowork(UWS_CLIENT_HANDLE uws_client)
     }
 }
 
+int uws_client_get_poll_info(UWS_CLIENT_HANDLE uws_client, XIO_POLL_INFO* poll_info)
+{
+    int result;
+
+    if ((uws_client == NULL) ||
+        (poll_info == NULL))
+    {
+        LogError("Invalid arguments: uws_client=%p, poll_info=%p", uws_client, poll_info);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        /* frames are decoded as bytes arrive, so nothing is held back above the underlying IO */
+        result = xio_get_poll_info(uws_client->underlying_io, poll_info);
+    }
+
+    return result;
+}
+
 int uws_client_set_option(UWS_CLIENT_HANDLE uws_client, const char* option_name, const void* value)
 {
     int result;
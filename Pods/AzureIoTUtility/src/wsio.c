@@ -812,6 +812,25 @@ OPTIONHANDLER_HANDLE wsio_retrieveoptions(CONCRETE_IO_HANDLE handle)
     return result;
 }
 
+static int wsio_get_poll_info(CONCRETE_IO_HANDLE ws_io, XIO_POLL_INFO* poll_info)
+{
+    int result;
+
+    if ((ws_io == NULL) ||
+        (poll_info == NULL))
+    {
+        LogError("Bad arguments: ws_io = %p, poll_info = %p", ws_io, poll_info);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        WSIO_INSTANCE* wsio_instance = (WSIO_INSTANCE*)ws_io;
+        result = uws_client_get_poll_info(wsio_instance->uws, poll_info);
+    }
+
+    return result;
+}
+
 static const IO_INTERFACE_DESCRIPTION ws_io_interface_description =
 {
     wsio_retrieveoptions,
@@ -821,7 +840,9 @@ static const IO_INTERFACE_DESCRIPTION ws_io_interface_description =
     wsio_close,
     wsio_send,
     wsio_dowork,
-    wsio_setoption
+    wsio_setoption,
+    wsio_get_poll_info,
+    NULL
 };
 
 const IO_INTERFACE_DESCRIPTION* wsio_get_interface_description(void)
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/xio.h"
@@ -13,8 +14,23 @@ typedef struct XIO_INSTANCE_TAG
 {
     const IO_INTERFACE_DESCRIPTION* io_interface_description;
     CONCRETE_IO_HANDLE concrete_xio_handle;
+    XIO_BYTE_COUNTER byte_counter;
+    ON_BYTES_RECEIVED on_bytes_received;
+    void* on_bytes_received_context;
 } XIO_INSTANCE;
 
+static void on_underlying_io_bytes_received(void* context, const unsigned char* buffer, size_t size)
+{
+    XIO_INSTANCE* xio_instance = (XIO_INSTANCE*)context;
+
+    if (xio_instance->byte_counter.on_bytes_transferred != NULL)
+    {
+        xio_instance->byte_counter.on_bytes_transferred(xio_instance->byte_counter.context, 0, size);
+    }
+
+    xio_instance->on_bytes_received(xio_instance->on_bytes_received_context, buffer, size);
+}
+
 XIO_HANDLE xio_create(const IO_INTERFACE_DESCRIPTION* io_interface_description, const void* xio_create_parameters)
 {
     XIO_INSTANCE* xio_instance;
@@ -41,6 +57,10 @@ XIO_HANDLE xio_create(const IO_INTERFACE_DESCRIPTION* io_interface_description,
         {
             /* Codes_SRS_XIO_01_001: [xio_create shall return on success a non-NULL handle to a new IO interface.] */
             xio_instance->io_interface_description = io_interface_description;
+            xio_instance->byte_counter.on_bytes_transferred = NULL;
+            xio_instance->byte_counter.context = NULL;
+            xio_instance->on_bytes_received = NULL;
+            xio_instance->on_bytes_received_context = NULL;
 
             /* Codes_SRS_XIO_01_002: [In order to instantiate the concrete IO implementation the function concrete_io_create from the io_interface_description shall be called, passing the xio_create_parameters argument.] */
             xio_instance->concrete_xio_handle = xio_instance->io_interface_description->concrete_io_create((void*)xio_create_parameters);
@@ -84,8 +104,13 @@ int xio_open(XIO_HANDLE xio, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_i
     {
         XIO_INSTANCE* xio_instance = (XIO_INSTANCE*)xio;
 
+        /* received bytes go through this instance so that a byte counter installed later still sees them */
+        xio_instance->on_bytes_received = on_bytes_received;
+        xio_instance->on_bytes_received_context = on_bytes_received_context;
+
         /* Codes_SRS_XIO_01_019: [xio_open shall call the specific concrete_xio_open function specified in xio_create, passing callback function and context arguments for three events: open completed, bytes received, and IO error.] */
-        if (xio_instance->io_interface_description->concrete_io_open(xio_instance->concrete_xio_handle, on_io_open_complete, on_io_open_complete_context, on_bytes_received, on_bytes_received_context, on_io_error, on_io_error_context) != 0)
+        if (xio_instance->io_interface_description->concrete_io_open(xio_instance->concrete_xio_handle, on_io_open_complete, on_io_open_complete_context,
+            (on_bytes_received == NULL) ? NULL : on_underlying_io_bytes_received, (on_bytes_received == NULL) ? on_bytes_received_context : xio_instance, on_io_error, on_io_error_context) != 0)
         {
             /* Codes_SRS_XIO_01_022: [If the underlying concrete_io_open fails, xio_open shall return a non-zero value.] */
             result = MU_FAILURE;
@@ -148,6 +173,70 @@ int xio_send(XIO_HANDLE xio, const void* buffer, size_t size, ON_SEND_COMPLETE o
         /* Codes_SRS_XIO_01_015: [If the underlying concrete_io_send fails, xio_send shall return a non-zero value.] */
         /* Codes_SRS_XIO_01_027: [xio_send shall pass to the concrete_io_send function the on_send_complete and callback_context arguments.] */
         result = xio_instance->io_interface_description->concrete_io_send(xio_instance->concrete_xio_handle, buffer, size, on_send_complete, callback_context);
+
+        if (result == 0 && xio_instance->byte_counter.on_bytes_transferred != NULL)
+        {
+            xio_instance->byte_counter.on_bytes_transferred(xio_instance->byte_counter.context, size, 0);
+        }
+    }
+
+    return result;
+}
+
+int xio_sendv(XIO_HANDLE xio, const XIO_BUFFER* buffers, size_t buffer_count, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+
+    if (xio == NULL || buffers == NULL || buffer_count == 0)
+    {
+        LogError("Invalid arguments: xio = %p, buffers = %p, buffer_count = %lu", xio, buffers, (unsigned long)buffer_count);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        XIO_INSTANCE* xio_instance = (XIO_INSTANCE*)xio;
+        size_t size = 0;
+        size_t i;
+
+        for (i = 0; i < buffer_count; i++)
+        {
+            size += buffers[i].size;
+        }
+
+        if (xio_instance->io_interface_description->concrete_io_sendv != NULL)
+        {
+            result = xio_instance->io_interface_description->concrete_io_sendv(xio_instance->concrete_xio_handle, buffers, buffer_count, on_send_complete, callback_context);
+        }
+        else if (buffer_count == 1)
+        {
+            result = xio_instance->io_interface_description->concrete_io_send(xio_instance->concrete_xio_handle, buffers[0].buffer, buffers[0].size, on_send_complete, callback_context);
+        }
+        else
+        {
+            unsigned char* gathered = (unsigned char*)malloc(size);
+            if (gathered == NULL)
+            {
+                LogError("Failed allocating %lu bytes to gather the buffers", (unsigned long)size);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                size_t position = 0;
+                for (i = 0; i < buffer_count; i++)
+                {
+                    (void)memcpy(gathered + position, buffers[i].buffer, buffers[i].size);
+                    position += buffers[i].size;
+                }
+
+                result = xio_instance->io_interface_description->concrete_io_send(xio_instance->concrete_xio_handle, gathered, size, on_send_complete, callback_context);
+                free(gathered);
+            }
+        }
+
+        if (result == 0 && xio_instance->byte_counter.on_bytes_transferred != NULL)
+        {
+            xio_instance->byte_counter.on_bytes_transferred(xio_instance->byte_counter.context, size, 0);
+        }
     }
 
     return result;
@@ -191,6 +280,20 @@ int xio_setoption(XIO_HANDLE xio, const char* optionName, const void* value)
                 result = 0;
             }
         }
+        else if (strcmp(OPTION_XIO_BYTE_COUNTER, optionName) == 0)
+        {
+            /*handled here, the concrete IO never sees it*/
+            if (value == NULL)
+            {
+                xio_instance->byte_counter.on_bytes_transferred = NULL;
+                xio_instance->byte_counter.context = NULL;
+            }
+            else
+            {
+                xio_instance->byte_counter = *(const XIO_BYTE_COUNTER*)value;
+            }
+            result = 0;
+        }
         else /*passthrough*/
         {
             /* Codes_SRS_XIO_003_028: [xio_setoption shall pass the optionName and value to the concrete IO implementation specified in xio_create by invoking the concrete_xio_setoption function.] */
@@ -302,3 +405,28 @@ OPTIONHANDLER_HANDLE xio_retrieveoptions(XIO_HANDLE xio)
     return result;
 }
 
+int xio_get_poll_info(XIO_HANDLE xio, XIO_POLL_INFO* poll_info)
+{
+    int result;
+
+    if (xio == NULL || poll_info == NULL)
+    {
+        LogError("Invalid argument (xio=%p, poll_info=%p)", xio, poll_info);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        XIO_INSTANCE* xio_instance = (XIO_INSTANCE*)xio;
+
+        if (xio_instance->io_interface_description->concrete_io_get_poll_info == NULL)
+        {
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = xio_instance->io_interface_description->concrete_io_get_poll_info(xio_instance->concrete_xio_handle, poll_info);
+        }
+    }
+
+    return result;
+}
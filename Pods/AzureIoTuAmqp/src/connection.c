@@ -626,10 +626,14 @@ static ENDPOINT_INSTANCE* find_session_endpoint_by_incoming_channel(CONNECTION_H
     return result;
 }
 
-static int connection_byte_received(CONNECTION_HANDLE connection, unsigned char b)
+/* Consumes the bytes the current state handles: one header byte at a time until the protocol header has been received,
+   then everything left, in a single call to the frame codec. */
+static int connection_bytes_received(CONNECTION_HANDLE connection, const unsigned char* buffer, size_t size, size_t* bytes_consumed)
 {
     int result;
 
+    *bytes_consumed = 0;
+
     switch (connection->connection_state)
     {
     default:
@@ -642,7 +646,7 @@ static int connection_byte_received(CONNECTION_HANDLE connection, unsigned char
 
     /* Codes_S_R_S_CONNECTION_01_041: [HDR SENT In this state the connection header has been sent to the peer but no connection header has been received.] */
     case CONNECTION_STATE_HDR_SENT:
-        if (b != amqp_header[connection->header_bytes_received])
+        if (buffer[0] != amqp_header[connection->header_bytes_received])
         {
             /* Codes_S_R_S_CONNECTION_01_089: [If the incoming and outgoing protocol headers do not match, both peers MUST close their outgoing stream] */
             if (xio_close(connection->io, NULL, NULL) != 0)
@@ -655,6 +659,7 @@ static int connection_byte_received(CONNECTION_HANDLE connection, unsigned char
         }
         else
         {
+            *bytes_consumed = 1;
             connection->header_bytes_received++;
             if (connection->header_bytes_received == sizeof(amqp_header))
             {
@@ -692,16 +697,17 @@ static int connection_byte_received(CONNECTION_HANDLE connection, unsigned char
     /* Codes_S_R_S_CONNECTION_01_048: [OPENED In this state the connection header and the open frame have been both sent and received.] */
     case CONNECTION_STATE_OPENED:
         /* Codes_S_R_S_CONNECTION_01_212: [After the initial handshake has been done all bytes received from the io instance shall be passed to the frame_codec for decoding by calling frame_codec_receive_bytes.] */
-        if (frame_codec_receive_bytes(connection->frame_codec, &b, 1) != 0)
+        if (frame_codec_receive_bytes(connection->frame_codec, buffer, size) != 0)
         {
             LogError("Cannot process received bytes");
             /* Codes_S_R_S_CONNECTION_01_218: [The error amqp:internal-error shall be set in the error.condition field of the CLOSE frame.] */
             /* Codes_S_R_S_CONNECTION_01_219: [The error description shall be set to an implementation defined string.] */
-            close_connection_with_error(connection, "amqp:internal-error", "connection_byte_received::frame_codec_receive_bytes failed", NULL);
+            close_connection_with_error(connection, "amqp:internal-error", "connection_bytes_received::frame_codec_receive_bytes failed", NULL);
             result = MU_FAILURE;
         }
         else
         {
+            *bytes_consumed = size;
             result = 0;
         }
 
@@ -713,15 +719,18 @@ static int connection_byte_received(CONNECTION_HANDLE connection, unsigned char
 
 static void connection_on_bytes_received(void* context, const unsigned char* buffer, size_t size)
 {
-    size_t i;
+    size_t bytes_consumed;
 
-    for (i = 0; i < size; i++)
+    while (size > 0)
     {
-        if (connection_byte_received((CONNECTION_HANDLE)context, buffer[i]) != 0)
+        if (connection_bytes_received((CONNECTION_HANDLE)context, buffer, size, &bytes_consumed) != 0)
         {
             LogError("Cannot process received bytes");
             break;
         }
+
+        buffer += bytes_consumed;
+        size -= bytes_consumed;
     }
 }
 
@@ -808,6 +808,41 @@ static int header_detect_io_send_async(CONCRETE_IO_HANDLE header_detect_io, cons
     return result;
 }
 
+static int header_detect_io_sendv_async(CONCRETE_IO_HANDLE header_detect_io, const XIO_BUFFER* buffers, size_t buffer_count, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+
+    if ((header_detect_io == NULL) ||
+        (buffers == NULL) ||
+        (buffer_count == 0))
+    {
+        LogError("Bad arguments: header_detect_io = %p, buffers = %p, buffer_count = %u",
+            header_detect_io, buffers, (unsigned int)buffer_count);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        HEADER_DETECT_IO_INSTANCE* header_detect_io_instance = (HEADER_DETECT_IO_INSTANCE*)header_detect_io;
+
+        if (header_detect_io_instance->io_state != IO_STATE_OPEN)
+        {
+            LogError("header_detect_io not OPEN");
+            result = MU_FAILURE;
+        }
+        else if (xio_sendv(*header_detect_io_instance->last_io, buffers, buffer_count, on_send_complete, callback_context) != 0)
+        {
+            LogError("xio_sendv failed");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
 static void header_detect_io_dowork(CONCRETE_IO_HANDLE header_detect_io)
 {
     if (header_detect_io == NULL)
@@ -928,7 +963,9 @@ static const IO_INTERFACE_DESCRIPTION header_detect_io_interface_description =
     header_detect_io_close_async,
     header_detect_io_send_async,
     header_detect_io_dowork,
-    header_detect_io_set_option
+    header_detect_io_set_option,
+    NULL,
+    header_detect_io_sendv_async
 };
 
 const IO_INTERFACE_DESCRIPTION* header_detect_io_get_interface_description(void)
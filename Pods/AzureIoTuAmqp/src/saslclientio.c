@@ -1201,6 +1201,41 @@ int saslclientio_send_async(CONCRETE_IO_HANDLE sasl_client_io, const void* buffe
     return result;
 }
 
+static int saslclientio_sendv_async(CONCRETE_IO_HANDLE sasl_client_io, const XIO_BUFFER* buffers, size_t buffer_count, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+
+    if ((sasl_client_io == NULL) ||
+        (buffers == NULL) ||
+        (buffer_count == 0))
+    {
+        LogError("Bad arguments: sasl_client_io = %p, buffers = %p, buffer_count = %u",
+            sasl_client_io, buffers, (unsigned int)buffer_count);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        SASL_CLIENT_IO_INSTANCE* sasl_client_io_instance = (SASL_CLIENT_IO_INSTANCE*)sasl_client_io;
+
+        if (sasl_client_io_instance->io_state != IO_STATE_OPEN)
+        {
+            LogError("send called while not open");
+            result = MU_FAILURE;
+        }
+        else if (xio_sendv(sasl_client_io_instance->underlying_io, buffers, buffer_count, on_send_complete, callback_context) != 0)
+        {
+            LogError("xio_sendv failed");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
 void saslclientio_dowork(CONCRETE_IO_HANDLE sasl_client_io)
 {
     /* Codes_SRS_SASLCLIENTIO_01_026: [If the `sasl_client_io` argument is NULL, `saslclientio_dowork` shall do nothing.]*/
@@ -1337,7 +1372,9 @@ static const IO_INTERFACE_DESCRIPTION sasl_client_io_interface_description =
     saslclientio_close_async,
     saslclientio_send_async,
     saslclientio_dowork,
-    saslclientio_setoption
+    saslclientio_setoption,
+    NULL,
+    saslclientio_sendv_async
 };
 
 /* Codes_SRS_SASLCLIENTIO_01_087: [`saslclientio_get_interface_description` shall return a pointer to an `IO_INTERFACE_DESCRIPTION` structure that contains pointers to the functions: `saslclientio_create`, `saslclientio_destroy`, `saslclientio_open_async`, `saslclientio_close_async`, `saslclientio_send_async`, `saslclientio_setoption`, `saslclientio_retrieveoptions` and `saslclientio_dowork`.]*/
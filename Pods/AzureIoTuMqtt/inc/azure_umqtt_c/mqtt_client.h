@@ -5,6 +5,7 @@
 #define MQTT_CLIENT_H
 
 #include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/buffer_.h"
 #include "azure_macro_utils/macro_utils.h"
 #include "azure_umqtt_c/mqttconst.h"
 #include "azure_umqtt_c/mqtt_message.h"
@@ -69,8 +70,20 @@ MOCKABLE_FUNCTION(, int, mqtt_client_send_message_response, MQTT_CLIENT_HANDLE,
 
 MOCKABLE_FUNCTION(, int, mqtt_client_publish, MQTT_CLIENT_HANDLE, handle, MQTT_MESSAGE_HANDLE, msgHandle);
 
+// Same as mqtt_client_publish, but on success the encoded PUBLISH is handed to the caller in encoded_packet instead of
+// being freed, so that it can be resent with mqtt_client_republish until acknowledged. The caller BUFFER_deletes it.
+MOCKABLE_FUNCTION(, int, mqtt_client_publish_retained, MQTT_CLIENT_HANDLE, handle, MQTT_MESSAGE_HANDLE, msgHandle, BUFFER_HANDLE*, encoded_packet);
+// Resends a PUBLISH kept by mqtt_client_publish_retained, setting its DUP flag in place.
+MOCKABLE_FUNCTION(, int, mqtt_client_republish, MQTT_CLIENT_HANDLE, handle, BUFFER_HANDLE, encoded_packet);
+
 MOCKABLE_FUNCTION(, void, mqtt_client_dowork, MQTT_CLIENT_HANDLE, handle);
 
+#define MQTT_CLIENT_NO_TIMEOUT UINT64_MAX
+
+// Time left until mqtt_client_dowork has timed work (a keep alive PINGREQ or the PINGRESP deadline),
+// MQTT_CLIENT_NO_TIMEOUT when none is pending. Input is reported by the xio, not by this function.
+MOCKABLE_FUNCTION(, int, mqtt_client_get_next_timeout, MQTT_CLIENT_HANDLE, handle, uint64_t*, timeout_ms);
+
 MOCKABLE_FUNCTION(, void, mqtt_client_set_trace, MQTT_CLIENT_HANDLE, handle, bool, traceOn, bool, rawBytesOn);
 
 #ifdef __cplusplus
@@ -23,14 +23,25 @@ extern "C" {
 typedef struct MQTTCODEC_INSTANCE_TAG* MQTTCODEC_HANDLE;
 
 typedef void(*ON_PACKET_COMPLETE_CALLBACK)(void* context, CONTROL_PACKET_TYPE packet, int flags, BUFFER_HANDLE headerData);
+// packetData is only valid during the call. It points into the bytes given to mqtt_codec_bytesReceived when they hold
+// the whole packet, otherwise into a buffer the codec reuses for the next packets.
+typedef void(*ON_PACKET_DATA_COMPLETE_CALLBACK)(void* context, CONTROL_PACKET_TYPE packet, int flags, const uint8_t* packetData, size_t packetLength);
 
 MOCKABLE_FUNCTION(, MQTTCODEC_HANDLE, mqtt_codec_create, ON_PACKET_COMPLETE_CALLBACK, packetComplete, void*, callbackCtx);
+MOCKABLE_FUNCTION(, MQTTCODEC_HANDLE, mqtt_codec_create_with_packet_data, ON_PACKET_DATA_COMPLETE_CALLBACK, packetDataComplete, void*, callbackCtx);
 MOCKABLE_FUNCTION(, void, mqtt_codec_destroy, MQTTCODEC_HANDLE, handle);
 
 MOCKABLE_FUNCTION(, void, mqtt_codec_reset, MQTTCODEC_HANDLE, handle);
 MOCKABLE_FUNCTION(, BUFFER_HANDLE, mqtt_codec_connect, const MQTT_CLIENT_OPTIONS*, mqttOptions, STRING_HANDLE, trace_log);
 MOCKABLE_FUNCTION(, BUFFER_HANDLE, mqtt_codec_disconnect);
 MOCKABLE_FUNCTION(, BUFFER_HANDLE, mqtt_codec_publish, QOS_VALUE, qosValue, bool, duplicateMsg, bool, serverRetain, uint16_t, packetId, const char*, topicName, const uint8_t*, msgBuffer, size_t, buffLen, STRING_HANDLE, trace_log);
+// Size of the PUBLISH mqtt_codec_publish encodes, 0 for invalid parameters; mqtt_codec_publishInto encodes it into a packet buffer
+// of at least that size supplied by the caller, e.g. pooled, and otherwise does the same.
+MOCKABLE_FUNCTION(, size_t, mqtt_codec_publishSize, QOS_VALUE, qosValue, const char*, topicName, size_t, buffLen);
+MOCKABLE_FUNCTION(, int, mqtt_codec_publishInto, QOS_VALUE, qosValue, bool, duplicateMsg, bool, serverRetain, uint16_t, packetId, const char*, topicName, const uint8_t*, msgBuffer, size_t, buffLen, uint8_t*, packet, size_t, packetSize, STRING_HANDLE, trace_log);
+// Same for the PUBLISH without its buffLen bytes payload, for callers sending the payload from where it is with xio_sendv.
+MOCKABLE_FUNCTION(, size_t, mqtt_codec_publishHeaderSize, QOS_VALUE, qosValue, const char*, topicName, size_t, buffLen);
+MOCKABLE_FUNCTION(, int, mqtt_codec_publishHeaderInto, QOS_VALUE, qosValue, bool, duplicateMsg, bool, serverRetain, uint16_t, packetId, const char*, topicName, size_t, buffLen, uint8_t*, header, size_t, headerSize, STRING_HANDLE, trace_log);
 MOCKABLE_FUNCTION(, BUFFER_HANDLE, mqtt_codec_publishAck, uint16_t, packetId);
 MOCKABLE_FUNCTION(, BUFFER_HANDLE, mqtt_codec_publishReceived, uint16_t, packetId);
 MOCKABLE_FUNCTION(, BUFFER_HANDLE, mqtt_codec_publishRelease, uint16_t, packetId);
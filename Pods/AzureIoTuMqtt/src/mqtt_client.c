@@ -403,6 +403,35 @@ static int sendPacketItem(MQTT_CLIENT* mqtt_client, const unsigned char* data, s
     return result;
 }
 
+static int sendPacketItems(MQTT_CLIENT* mqtt_client, const XIO_BUFFER* buffers, size_t buffer_count)
+{
+    int result = xio_sendv(mqtt_client->xioHandle, buffers, buffer_count, sendComplete, mqtt_client);
+
+    if (result != 0)
+    {
+        LogError("Failure sending control packet data");
+        result = MU_FAILURE;
+    }
+    else
+    {
+#ifdef ENABLE_RAW_TRACE
+        size_t index;
+        for (index = 0; index < buffer_count; index++)
+        {
+            logOutgoingRawTrace(mqtt_client, (const uint8_t*)buffers[index].buffer, buffers[index].size);
+        }
+#endif
+
+        if (tickcounter_get_current_ms(mqtt_client->packetTickCntr, &mqtt_client->packetSendTimeMs) != 0)
+        {
+            LogError("Failure getting current ms tickcounter");
+            result = MU_FAILURE;
+        }
+    }
+
+    return result;
+}
+
 static void onOpenComplete(void* context, IO_OPEN_RESULT open_result)
 {
     MQTT_CLIENT* mqtt_client = (MQTT_CLIENT*)context;
@@ -768,18 +797,13 @@ static void ProcessPublishMessage(MQTT_CLIENT* mqtt_client, uint8_t* initialPos,
     }
 }
 
-static void recvCompleteCallback(void* context, CONTROL_PACKET_TYPE packet, int flags, BUFFER_HANDLE headerData)
+static void recvCompleteCallback(void* context, CONTROL_PACKET_TYPE packet, int flags, const uint8_t* packetData, size_t packetLength)
 {
     MQTT_CLIENT* mqtt_client = (MQTT_CLIENT*)context;
     if (mqtt_client != NULL)
     {
-        size_t packetLength = 0;
-        uint8_t* iterator = NULL;
-        if (headerData != NULL)
-        {
-            packetLength = BUFFER_length(headerData);
-            iterator = BUFFER_u_char(headerData);
-        }
+        // The byteutil readers only advance the pointer, the packet data is not modified
+        uint8_t* iterator = (uint8_t*)packetData;
 
 #ifdef ENABLE_RAW_TRACE
         logIncomingRawTrace(mqtt_client, packet, (uint8_t)flags, iterator, packetLength);
@@ -1058,7 +1082,7 @@ MQTT_CLIENT_HANDLE mqtt_client_init(ON_MQTT_MESSAGE_RECV_CALLBACK msgRecv, ON_MQ
             }
             else
             {
-                result->codec_handle = mqtt_codec_create(recvCompleteCallback, result);
+                result->codec_handle = mqtt_codec_create_with_packet_data(recvCompleteCallback, result);
                 if (result->codec_handle == NULL)
                 {
                     /*Codes_SRS_MQTT_CLIENT_07_002: [If any failure is encountered then mqttclient_init shall return NULL.]*/
@@ -1128,66 +1152,191 @@ int mqtt_client_connect(MQTT_CLIENT_HANDLE handle, XIO_HANDLE xioHandle, MQTT_CL
     return result;
 }
 
-int mqtt_client_publish(MQTT_CLIENT_HANDLE handle, MQTT_MESSAGE_HANDLE msgHandle)
+// Sends the PUBLISH header followed by the payload straight from the message, without the copy of
+// the payload a contiguous packet would take. Used when the packet is not retained for resending.
+static int publishMessageVectored(MQTT_CLIENT* mqtt_client, MQTT_MESSAGE_HANDLE msgHandle, const APP_PAYLOAD* payload, STRING_HANDLE trace_log)
 {
     int result;
-    MQTT_CLIENT* mqtt_client = (MQTT_CLIENT*)handle;
-    if (mqtt_client == NULL || msgHandle == NULL)
+    QOS_VALUE qos = mqttmessage_getQosType(msgHandle);
+    const char* topicName = mqttmessage_getTopicName(msgHandle);
+    size_t headerSize = mqtt_codec_publishHeaderSize(qos, topicName, payload->length);
+    uint8_t* header;
+
+    if (headerSize == 0 || (payload->length > 0 && payload->message == NULL))
     {
-        /*Codes_SRS_MQTT_CLIENT_07_019: [If one of the parameters handle or msgHandle is NULL then mqtt_client_publish shall return a non-zero value.]*/
-        LogError("Invalid parameter specified mqtt_client: %p, msgHandle: %p", mqtt_client, msgHandle);
+        LogError("Error: invalid PUBLISH parameters");
+        result = MU_FAILURE;
+    }
+    else if ((header = (uint8_t*)malloc(headerSize)) == NULL)
+    {
+        LogError("Error: failure allocating PUBLISH header");
         result = MU_FAILURE;
     }
     else
     {
-        /*Codes_SRS_MQTT_CLIENT_07_021: [mqtt_client_publish shall get the message information from the MQTT_MESSAGE_HANDLE.]*/
-        const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
-        if (payload == NULL)
+        if (mqtt_codec_publishHeaderInto(qos, mqttmessage_getIsDuplicateMsg(msgHandle), mqttmessage_getIsRetained(msgHandle),
+            mqttmessage_getPacketId(msgHandle), topicName, payload->length, header, headerSize, trace_log) != 0)
+        {
+            LogError("Error: mqtt_codec_publishHeaderInto failed");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            XIO_BUFFER buffers[2];
+            buffers[0].buffer = header;
+            buffers[0].size = headerSize;
+            buffers[1].buffer = payload->message;
+            buffers[1].size = payload->length;
+
+            mqtt_client->packetState = PUBLISH_TYPE;
+
+            /*Codes_SRS_MQTT_CLIENT_07_022: [On success mqtt_client_publish shall send the MQTT SUBCRIBE packet to the endpoint.]*/
+            if (sendPacketItems(mqtt_client, buffers, (payload->length > 0) ? 2 : 1) != 0)
+            {
+                /*Codes_SRS_MQTT_CLIENT_07_020: [If any failure is encountered then mqtt_client_unsubscribe shall return a non-zero value.]*/
+                LogError("Error: mqtt_client_publish send failed");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                log_outgoing_trace(mqtt_client, trace_log);
+                result = 0;
+            }
+        }
+        free(header);
+    }
+    return result;
+}
+
+static int publishMessage(MQTT_CLIENT* mqtt_client, MQTT_MESSAGE_HANDLE msgHandle, BUFFER_HANDLE* encoded_packet)
+{
+    int result;
+    /*Codes_SRS_MQTT_CLIENT_07_021: [mqtt_client_publish shall get the message information from the MQTT_MESSAGE_HANDLE.]*/
+    const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
+    if (payload == NULL)
+    {
+        /*Codes_SRS_MQTT_CLIENT_07_020: [If any failure is encountered then mqtt_client_unsubscribe shall return a non-zero value.]*/
+        LogError("Error: mqttmessage_getApplicationMsg failed");
+        result = MU_FAILURE;
+    }
+    else if (encoded_packet == NULL)
+    {
+        STRING_HANDLE trace_log = construct_trace_log_handle(mqtt_client);
+        result = publishMessageVectored(mqtt_client, msgHandle, payload, trace_log);
+        if (trace_log != NULL)
+        {
+            STRING_delete(trace_log);
+        }
+    }
+    else
+    {
+        STRING_HANDLE trace_log = construct_trace_log_handle(mqtt_client);
+
+        QOS_VALUE qos = mqttmessage_getQosType(msgHandle);
+        bool isDuplicate = mqttmessage_getIsDuplicateMsg(msgHandle);
+        bool isRetained = mqttmessage_getIsRetained(msgHandle);
+        uint16_t packetId = mqttmessage_getPacketId(msgHandle);
+        const char* topicName = mqttmessage_getTopicName(msgHandle);
+        BUFFER_HANDLE publishPacket = mqtt_codec_publish(qos, isDuplicate, isRetained, packetId, topicName, payload->message, payload->length, trace_log);
+        if (publishPacket == NULL)
         {
             /*Codes_SRS_MQTT_CLIENT_07_020: [If any failure is encountered then mqtt_client_unsubscribe shall return a non-zero value.]*/
-            LogError("Error: mqttmessage_getApplicationMsg failed");
+            LogError("Error: mqtt_codec_publish failed");
             result = MU_FAILURE;
         }
         else
         {
-            STRING_HANDLE trace_log = construct_trace_log_handle(mqtt_client);
+            mqtt_client->packetState = PUBLISH_TYPE;
 
-            QOS_VALUE qos = mqttmessage_getQosType(msgHandle);
-            bool isDuplicate = mqttmessage_getIsDuplicateMsg(msgHandle);
-            bool isRetained = mqttmessage_getIsRetained(msgHandle);
-            uint16_t packetId = mqttmessage_getPacketId(msgHandle);
-            const char* topicName = mqttmessage_getTopicName(msgHandle);
-            BUFFER_HANDLE publishPacket = mqtt_codec_publish(qos, isDuplicate, isRetained, packetId, topicName, payload->message, payload->length, trace_log);
-            if (publishPacket == NULL)
+            /*Codes_SRS_MQTT_CLIENT_07_022: [On success mqtt_client_publish shall send the MQTT SUBCRIBE packet to the endpoint.]*/
+            size_t size = BUFFER_length(publishPacket);
+            if (sendPacketItem(mqtt_client, BUFFER_u_char(publishPacket), size) != 0)
             {
                 /*Codes_SRS_MQTT_CLIENT_07_020: [If any failure is encountered then mqtt_client_unsubscribe shall return a non-zero value.]*/
-                LogError("Error: mqtt_codec_publish failed");
+                LogError("Error: mqtt_client_publish send failed");
                 result = MU_FAILURE;
             }
             else
             {
-                mqtt_client->packetState = PUBLISH_TYPE;
+                log_outgoing_trace(mqtt_client, trace_log);
+                result = 0;
+            }
 
-                /*Codes_SRS_MQTT_CLIENT_07_022: [On success mqtt_client_publish shall send the MQTT SUBCRIBE packet to the endpoint.]*/
-                size_t size = BUFFER_length(publishPacket);
-                if (sendPacketItem(mqtt_client, BUFFER_u_char(publishPacket), size) != 0)
-                {
-                    /*Codes_SRS_MQTT_CLIENT_07_020: [If any failure is encountered then mqtt_client_unsubscribe shall return a non-zero value.]*/
-                    LogError("Error: mqtt_client_publish send failed");
-                    result = MU_FAILURE;
-                }
-                else
-                {
-                    log_outgoing_trace(mqtt_client, trace_log);
-                    result = 0;
-                }
-                BUFFER_delete(publishPacket);
+            if (result == 0 && encoded_packet != NULL)
+            {
+                *encoded_packet = publishPacket;
             }
-            if (trace_log != NULL)
+            else
             {
-                STRING_delete(trace_log);
+                BUFFER_delete(publishPacket);
             }
         }
+        if (trace_log != NULL)
+        {
+            STRING_delete(trace_log);
+        }
+    }
+    return result;
+}
+
+int mqtt_client_publish(MQTT_CLIENT_HANDLE handle, MQTT_MESSAGE_HANDLE msgHandle)
+{
+    int result;
+    MQTT_CLIENT* mqtt_client = (MQTT_CLIENT*)handle;
+    if (mqtt_client == NULL || msgHandle == NULL)
+    {
+        /*Codes_SRS_MQTT_CLIENT_07_019: [If one of the parameters handle or msgHandle is NULL then mqtt_client_publish shall return a non-zero value.]*/
+        LogError("Invalid parameter specified mqtt_client: %p, msgHandle: %p", mqtt_client, msgHandle);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = publishMessage(mqtt_client, msgHandle, NULL);
+    }
+    return result;
+}
+
+int mqtt_client_publish_retained(MQTT_CLIENT_HANDLE handle, MQTT_MESSAGE_HANDLE msgHandle, BUFFER_HANDLE* encoded_packet)
+{
+    int result;
+    MQTT_CLIENT* mqtt_client = (MQTT_CLIENT*)handle;
+    if (mqtt_client == NULL || msgHandle == NULL || encoded_packet == NULL)
+    {
+        LogError("Invalid parameter specified mqtt_client: %p, msgHandle: %p, encoded_packet: %p", mqtt_client, msgHandle, encoded_packet);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = publishMessage(mqtt_client, msgHandle, encoded_packet);
+    }
+    return result;
+}
+
+int mqtt_client_republish(MQTT_CLIENT_HANDLE handle, BUFFER_HANDLE encoded_packet)
+{
+    int result;
+    MQTT_CLIENT* mqtt_client = (MQTT_CLIENT*)handle;
+    unsigned char* packet;
+    if (mqtt_client == NULL || encoded_packet == NULL || (packet = BUFFER_u_char(encoded_packet)) == NULL ||
+        (packet[0] & CONNECT_PACKET_MASK) != PUBLISH_TYPE)
+    {
+        LogError("Invalid parameter specified mqtt_client: %p, encoded_packet: %p", mqtt_client, encoded_packet);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        // The fixed header is all that changes between a PUBLISH and its retransmission
+        packet[0] |= DUPLICATE_FLAG_MASK;
+        mqtt_client->packetState = PUBLISH_TYPE;
+        if (sendPacketItem(mqtt_client, packet, BUFFER_length(encoded_packet)) != 0)
+        {
+            LogError("Error: mqtt_client_republish send failed");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
     }
     return result;
 }
@@ -1435,6 +1584,60 @@ void mqtt_client_dowork(MQTT_CLIENT_HANDLE handle)
     }
 }
 
+int mqtt_client_get_next_timeout(MQTT_CLIENT_HANDLE handle, uint64_t* timeout_ms)
+{
+    int result;
+    MQTT_CLIENT* mqtt_client = (MQTT_CLIENT*)handle;
+    if (mqtt_client == NULL || timeout_ms == NULL)
+    {
+        LogError("Invalid parameter specified mqtt_client: %p, timeout_ms: %p", mqtt_client, timeout_ms);
+        result = MU_FAILURE;
+    }
+    else if (mqtt_client->xioHandle == NULL)
+    {
+        *timeout_ms = MQTT_CLIENT_NO_TIMEOUT;
+        result = 0;
+    }
+    else if (mqtt_client->mqtt_status & MQTT_STATUS_PENDING_CLOSE)
+    {
+        *timeout_ms = 0;
+        result = 0;
+    }
+    else if (mqtt_client->mqtt_status & MQTT_STATUS_SOCKET_CONNECTED &&
+        mqtt_client->mqtt_status & MQTT_STATUS_CLIENT_CONNECTED &&
+        mqtt_client->keepAliveInterval > 0)
+    {
+        tickcounter_ms_t current_ms;
+        if (tickcounter_get_current_ms(mqtt_client->packetTickCntr, &current_ms) != 0)
+        {
+            LogError("Error: tickcounter_get_current_ms failed");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            // Mirrors the checks in mqtt_client_dowork: a PINGREQ is due keepAliveInterval seconds after the last
+            // packet sent, and a missing PINGRESP is an error once more than maxPingRespTime seconds have passed
+            tickcounter_ms_t deadline_ms = mqtt_client->packetSendTimeMs + (tickcounter_ms_t)mqtt_client->keepAliveInterval * 1000;
+            if (mqtt_client->timeSincePing > 0)
+            {
+                tickcounter_ms_t ping_deadline_ms = mqtt_client->timeSincePing + ((tickcounter_ms_t)mqtt_client->maxPingRespTime + 1) * 1000;
+                if (ping_deadline_ms < deadline_ms)
+                {
+                    deadline_ms = ping_deadline_ms;
+                }
+            }
+            *timeout_ms = (deadline_ms <= current_ms) ? 0 : (uint64_t)(deadline_ms - current_ms);
+            result = 0;
+        }
+    }
+    else
+    {
+        *timeout_ms = MQTT_CLIENT_NO_TIMEOUT;
+        result = 0;
+    }
+    return result;
+}
+
 void mqtt_client_set_trace(MQTT_CLIENT_HANDLE handle, bool traceOn, bool rawBytesOn)
 {
     AZURE_UNREFERENCED_PARAMETER(handle);
@@ -38,11 +38,16 @@
 #define UNSUBSCRIBE_FIXED_HEADER_FLAG       0x2
 
 #define MAX_SEND_SIZE                       0xFFFFFF7F // 268435455
+#define MAX_REMAINING_LENGTH                268435455  // Largest value 4 Remaining Length bytes encode
 
 // This captures the maximum packet size for 3 digits.
 // If it's above this value then we bail out of the loop
 #define MAX_3_DIGIT_PACKET_SIZE             2097152
 
+// Packets split across mqtt_codec_bytesReceived calls are assembled in a buffer kept from one packet
+// to the next, unless it grew beyond this size
+#define MAX_RECYCLED_PACKET_BUFFER_SIZE     16384
+
 #define CODEC_STATE_VALUES      \
     CODEC_STATE_FIXED_HEADER,   \
     CODEC_STATE_VAR_HEADER,     \
@@ -59,21 +64,16 @@ typedef struct MQTTCODEC_INSTANCE_TAG
     CODEC_STATE_RESULT codecState;
     size_t bufferOffset;
     int headerFlags;
-    BUFFER_HANDLE headerData;
+    size_t packetLength;
+    uint8_t* packetBuffer;
+    size_t packetBufferSize;
     ON_PACKET_COMPLETE_CALLBACK packetComplete;
+    ON_PACKET_DATA_COMPLETE_CALLBACK packetDataComplete;
     void* callContext;
     uint8_t storeRemainLen[4];
     size_t remainLenIndex;
 } MQTTCODEC_INSTANCE;
 
-typedef struct PUBLISH_HEADER_INFO_TAG
-{
-    const char* topicName;
-    uint16_t packetId;
-    const char* msgBuffer;
-    QOS_VALUE qualityOfServiceValue;
-} PUBLISH_HEADER_INFO;
-
 static const char* retrieve_qos_value(QOS_VALUE value)
 {
     switch (value)
@@ -223,62 +223,6 @@ static int constructConnectVariableHeader(BUFFER_HANDLE ctrlPacket, const MQTT_C
     return result;
 }
 
-static int constructPublishVariableHeader(BUFFER_HANDLE ctrlPacket, const PUBLISH_HEADER_INFO* publishHeader, STRING_HANDLE trace_log)
-{
-    int result = 0;
-    size_t topicLen = 0;
-    size_t spaceLen = 0;
-    size_t idLen = 0;
-
-    size_t currLen = BUFFER_length(ctrlPacket);
-
-    topicLen = strlen(publishHeader->topicName);
-    spaceLen += 2;
-
-    if (publishHeader->qualityOfServiceValue != DELIVER_AT_MOST_ONCE)
-    {
-        // Packet Id is only set if the QOS is not 0
-        idLen = 2;
-    }
-
-    if (topicLen > USHRT_MAX)
-    {
-        result = MU_FAILURE;
-    }
-    else if (BUFFER_enlarge(ctrlPacket, topicLen + idLen + spaceLen) != 0)
-    {
-        result = MU_FAILURE;
-    }
-    else
-    {
-        uint8_t* iterator = BUFFER_u_char(ctrlPacket);
-        if (iterator == NULL)
-        {
-            result = MU_FAILURE;
-        }
-        else
-        {
-            iterator += currLen;
-            /* The Topic Name MUST be present as the first field in the PUBLISH Packet Variable header.It MUST be 792 a UTF-8 encoded string [MQTT-3.3.2-1] as defined in section 1.5.3.*/
-            byteutil_writeUTF(&iterator, publishHeader->topicName, (uint16_t)topicLen);
-            if (trace_log != NULL)
-            {
-                STRING_sprintf(trace_log, " | TOPIC_NAME: %s", publishHeader->topicName);
-            }
-            if (idLen > 0)
-            {
-                if (trace_log != NULL)
-                {
-                    STRING_sprintf(trace_log, " | PACKET_ID: %"PRIu16, publishHeader->packetId);
-                }
-                byteutil_writeInt(&iterator, publishHeader->packetId);
-            }
-            result = 0;
-        }
-    }
-    return result;
-}
-
 static int constructSubscibeTypeVariableHeader(BUFFER_HANDLE ctrlPacket, uint16_t packetId)
 {
     int result = 0;
@@ -549,27 +493,8 @@ static int prepareheaderDataInfo(MQTTCODEC_INSTANCE* codecData, uint8_t remainLe
             codecData->remainLenIndex = 0;
             memset(codecData->storeRemainLen, 0, 4 * sizeof(uint8_t));
 
-            if (totalLen > 0)
-            {
-                codecData->bufferOffset = 0;
-                codecData->headerData = BUFFER_new();
-                if (codecData->headerData == NULL)
-                {
-                    /* Codes_SRS_MQTT_CODEC_07_035: [ If any error is encountered then the packet state will be marked as error and mqtt_codec_bytesReceived shall return a non-zero value. ] */
-                    LogError("Failed BUFFER_new");
-                    result = MU_FAILURE;
-                }
-                else
-                {
-                    if (BUFFER_pre_build(codecData->headerData, totalLen) != 0)
-                    {
-                        /* Codes_SRS_MQTT_CODEC_07_035: [ If any error is encountered then the packet state will be marked as error and mqtt_codec_bytesReceived shall return a non-zero value. ] */
-                        LogError("Failed BUFFER_pre_build");
-                        result = MU_FAILURE;
-                    }
-
-                }
-            }
+            codecData->bufferOffset = 0;
+            codecData->packetLength = (size_t)totalLen;
         }
     }
     else if (codecData->remainLenIndex == (sizeof(codecData->storeRemainLen) / sizeof(codecData->storeRemainLen[0])))
@@ -585,19 +510,86 @@ static int prepareheaderDataInfo(MQTTCODEC_INSTANCE* codecData, uint8_t remainLe
     return result;
 }
 
-static void completePacketData(MQTTCODEC_INSTANCE* codecData)
+static int completePacketData(MQTTCODEC_INSTANCE* codecData, const uint8_t* packetData, size_t packetLength)
 {
-    if (codecData->packetComplete != NULL)
+    int result;
+
+    if (codecData->packetDataComplete != NULL)
+    {
+        codecData->packetDataComplete(codecData->callContext, codecData->currPacket, codecData->headerFlags, (packetLength > 0) ? packetData : NULL, packetLength);
+        result = 0;
+    }
+    else if (codecData->packetComplete != NULL)
+    {
+        BUFFER_HANDLE headerData = NULL;
+        if (packetLength > 0 && (headerData = BUFFER_create(packetData, packetLength)) == NULL)
+        {
+            /* Codes_SRS_MQTT_CODEC_07_035: [ If any error is encountered then the packet state will be marked as error and mqtt_codec_bytesReceived shall return a non-zero value. ] */
+            LogError("Failed BUFFER_create");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            codecData->packetComplete(codecData->callContext, codecData->currPacket, codecData->headerFlags, headerData);
+            BUFFER_delete(headerData);
+            result = 0;
+        }
+    }
+    else
     {
-        codecData->packetComplete(codecData->callContext, codecData->currPacket, codecData->headerFlags, codecData->headerData);
+        result = 0;
     }
 
     // Clean up data
     codecData->currPacket = UNKNOWN_TYPE;
     codecData->codecState = CODEC_STATE_FIXED_HEADER;
     codecData->headerFlags = 0;
-    BUFFER_delete(codecData->headerData);
-    codecData->headerData = NULL;
+    codecData->bufferOffset = 0;
+    codecData->packetLength = 0;
+    if (codecData->packetBufferSize > MAX_RECYCLED_PACKET_BUFFER_SIZE)
+    {
+        free(codecData->packetBuffer);
+        codecData->packetBuffer = NULL;
+        codecData->packetBufferSize = 0;
+    }
+    return result;
+}
+
+// Copies the bytes of the current packet found in buffer into the recycled packet buffer, growing it on
+// the first bytes of a packet larger than the previous ones, and sets consumed to the number of bytes copied.
+static int assemblePacketData(MQTTCODEC_INSTANCE* codecData, const unsigned char* buffer, size_t size, size_t* consumed)
+{
+    int result;
+
+    if (codecData->bufferOffset == 0 && codecData->packetBufferSize < codecData->packetLength)
+    {
+        free(codecData->packetBuffer);
+        codecData->packetBufferSize = 0;
+        if ((codecData->packetBuffer = (uint8_t*)malloc(codecData->packetLength)) != NULL)
+        {
+            codecData->packetBufferSize = codecData->packetLength;
+        }
+    }
+
+    if (codecData->packetBuffer == NULL)
+    {
+        /* Codes_SRS_MQTT_CODEC_07_035: [ If any error is encountered then the packet state will be marked as error and mqtt_codec_bytesReceived shall return a non-zero value. ] */
+        LogError("Failed allocating %lu bytes packet buffer", (unsigned long)codecData->packetLength);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t toCopy = codecData->packetLength - codecData->bufferOffset;
+        if (toCopy > size)
+        {
+            toCopy = size;
+        }
+        (void)memcpy(codecData->packetBuffer + codecData->bufferOffset, buffer, toCopy);
+        codecData->bufferOffset += toCopy;
+        *consumed = toCopy;
+        result = 0;
+    }
+    return result;
 }
 
 static void clear_codec_data(MQTTCODEC_INSTANCE* codec_data)
@@ -607,7 +599,7 @@ static void clear_codec_data(MQTTCODEC_INSTANCE* codec_data)
     codec_data->codecState = CODEC_STATE_FIXED_HEADER;
     codec_data->headerFlags = 0;
     codec_data->bufferOffset = 0;
-    codec_data->headerData = NULL;
+    codec_data->packetLength = 0;
     memset(codec_data->storeRemainLen, 0, 4 * sizeof(uint8_t));
     codec_data->remainLenIndex = 0;
 }
@@ -629,12 +621,25 @@ MQTTCODEC_HANDLE mqtt_codec_create(ON_PACKET_COMPLETE_CALLBACK packetComplete, v
     {
         /* Codes_SRS_MQTT_CODEC_07_002: [On success mqtt_codec_create shall return a MQTTCODEC_HANDLE value.] */
         clear_codec_data(result);
+        result->packetBuffer = NULL;
+        result->packetBufferSize = 0;
         result->packetComplete = packetComplete;
+        result->packetDataComplete = NULL;
         result->callContext = callbackCtx;
     }
     return result;
 }
 
+MQTTCODEC_HANDLE mqtt_codec_create_with_packet_data(ON_PACKET_DATA_COMPLETE_CALLBACK packetDataComplete, void* callbackCtx)
+{
+    MQTTCODEC_HANDLE result = mqtt_codec_create(NULL, callbackCtx);
+    if (result != NULL)
+    {
+        result->packetDataComplete = packetDataComplete;
+    }
+    return result;
+}
+
 void mqtt_codec_destroy(MQTTCODEC_HANDLE handle)
 {
     /* Codes_SRS_MQTT_CODEC_07_003: [If the handle parameter is NULL then mqtt_codec_destroy shall do nothing.] */
@@ -642,7 +647,7 @@ void mqtt_codec_destroy(MQTTCODEC_HANDLE handle)
     {
         MQTTCODEC_INSTANCE* codecData = (MQTTCODEC_INSTANCE*)handle;
         /* Codes_SRS_MQTT_CODEC_07_004: [mqtt_codec_destroy shall deallocate all memory that has been allocated by this object.] */
-        BUFFER_delete(codecData->headerData);
+        free(codecData->packetBuffer);
         free(codecData);
     }
 }
@@ -742,26 +747,71 @@ BUFFER_HANDLE mqtt_codec_disconnect()
     return result;
 }
 
-BUFFER_HANDLE mqtt_codec_publish(QOS_VALUE qosValue, bool duplicateMsg, bool serverRetain, uint16_t packetId, const char* topicName, const uint8_t* msgBuffer, size_t buffLen, STRING_HANDLE trace_log)
+static size_t getPublishRemainingLength(QOS_VALUE qosValue, size_t topicLen, size_t buffLen)
 {
-    BUFFER_HANDLE result;
-    /* Codes_SRS_MQTT_CODEC_07_005: [If the parameters topicName is NULL then mqtt_codec_publish shall return NULL.] */
+    // Topic Name, Packet Identifier (only set if the QOS is not 0) and payload
+    return 2 + topicLen + ((qosValue != DELIVER_AT_MOST_ONCE) ? 2 : 0) + buffLen;
+}
+
+static size_t getRemainingLengthSize(size_t remainingLength)
+{
+    size_t result = 0;
+    do
+    {
+        remainingLength /= 128;
+        result++;
+    } while (remainingLength > 0);
+    return result;
+}
+
+size_t mqtt_codec_publishSize(QOS_VALUE qosValue, const char* topicName, size_t buffLen)
+{
+    size_t result;
+    size_t topicLen;
     if (topicName == NULL)
     {
-        result = NULL;
+        result = 0;
     }
     /* Codes_SRS_MQTT_CODEC_07_036: [mqtt_codec_publish shall return NULL if the buffLen variable is greater than the MAX_SEND_SIZE (0xFFFFFF7F).] */
-    else if (buffLen > MAX_SEND_SIZE)
+    else if (buffLen > MAX_SEND_SIZE || (topicLen = strlen(topicName)) > USHRT_MAX ||
+        getPublishRemainingLength(qosValue, topicLen, buffLen) > MAX_REMAINING_LENGTH)
     {
-        /* Codes_SRS_MQTT_CODEC_07_006: [If any error is encountered then mqtt_codec_publish shall return NULL.] */
-        result = NULL;
+        result = 0;
     }
     else
     {
-        PUBLISH_HEADER_INFO publishInfo ={ 0 };
-        publishInfo.topicName = topicName;
-        publishInfo.packetId = packetId;
-        publishInfo.qualityOfServiceValue = qosValue;
+        size_t remainingLength = getPublishRemainingLength(qosValue, topicLen, buffLen);
+        result = 1 + getRemainingLengthSize(remainingLength) + remainingLength;
+    }
+    return result;
+}
+
+size_t mqtt_codec_publishHeaderSize(QOS_VALUE qosValue, const char* topicName, size_t buffLen)
+{
+    size_t packetSize = mqtt_codec_publishSize(qosValue, topicName, buffLen);
+    return (packetSize == 0) ? 0 : packetSize - buffLen;
+}
+
+int mqtt_codec_publishHeaderInto(QOS_VALUE qosValue, bool duplicateMsg, bool serverRetain, uint16_t packetId, const char* topicName, size_t buffLen, uint8_t* header, size_t headerSize, STRING_HANDLE trace_log)
+{
+    int result;
+    size_t requiredSize = mqtt_codec_publishHeaderSize(qosValue, topicName, buffLen);
+
+    /* Codes_SRS_MQTT_CODEC_07_005: [If the parameters topicName is NULL then mqtt_codec_publish shall return NULL.] */
+    if (requiredSize == 0 || header == NULL)
+    {
+        result = MU_FAILURE;
+    }
+    else if (headerSize < requiredSize)
+    {
+        LogError("Header buffer of %lu bytes too small for a %lu bytes PUBLISH header", (unsigned long)headerSize, (unsigned long)requiredSize);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t topicLen = strlen(topicName);
+        size_t remainingLength = getPublishRemainingLength(qosValue, topicLen, buffLen);
+        uint8_t* iterator = header;
 
         uint8_t headerFlags = 0;
         if (duplicateMsg) headerFlags |= PUBLISH_DUP_FLAG;
@@ -778,83 +828,98 @@ BUFFER_HANDLE mqtt_codec_publish(QOS_VALUE qosValue, bool duplicateMsg, bool ser
             }
         }
 
-        /* Codes_SRS_MQTT_CODEC_07_007: [mqtt_codec_publish shall return a BUFFER_HANDLE that represents a MQTT PUBLISH message.] */
-        result = BUFFER_new();
-        if (result != NULL)
+        // Fixed header
+        byteutil_writeByte(&iterator, (uint8_t)PUBLISH_TYPE | headerFlags);
+        do
         {
-            STRING_HANDLE varible_header_log = NULL;
-            if (trace_log != NULL)
+            uint8_t encode = remainingLength % 128;
+            remainingLength /= 128;
+            // if there are more data to encode, set the top bit of this byte
+            if (remainingLength > 0)
             {
-                varible_header_log = STRING_construct_sprintf(" | IS_DUP: %s | RETAIN: %d | QOS: %s", duplicateMsg ? TRUE_CONST : FALSE_CONST,
-                    serverRetain ? 1 : 0,
-                    retrieve_qos_value(publishInfo.qualityOfServiceValue) );
+                encode |= NEXT_128_CHUNK;
             }
+            byteutil_writeByte(&iterator, encode);
+        } while (remainingLength > 0);
 
-            if (constructPublishVariableHeader(result, &publishInfo, varible_header_log) != 0)
-            {
-                /* Codes_SRS_MQTT_CODEC_07_006: [If any error is encountered then mqtt_codec_publish shall return NULL.] */
-                BUFFER_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                size_t payloadOffset = BUFFER_length(result);
-                if (buffLen > 0)
-                {
-                    if (BUFFER_enlarge(result, buffLen) != 0)
-                    {
-                        /* Codes_SRS_MQTT_CODEC_07_006: [If any error is encountered then mqtt_codec_publish shall return NULL.] */
-                        BUFFER_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        uint8_t* iterator = BUFFER_u_char(result);
-                        if (iterator == NULL)
-                        {
-                            /* Codes_SRS_MQTT_CODEC_07_006: [If any error is encountered then mqtt_codec_publish shall return NULL.] */
-                            BUFFER_delete(result);
-                            result = NULL;
-                        }
-                        else
-                        {
-                            iterator += payloadOffset;
-                            // Write Message
-                            (void)memcpy(iterator, msgBuffer, buffLen);
-                            if (trace_log)
-                            {
-                                STRING_sprintf(varible_header_log, " | PAYLOAD_LEN: %lu", (unsigned long)buffLen);
-                            }
-                        }
-                    }
-                }
+        /* The Topic Name MUST be present as the first field in the PUBLISH Packet Variable header.It MUST be 792 a UTF-8 encoded string [MQTT-3.3.2-1] as defined in section 1.5.3.*/
+        byteutil_writeUTF(&iterator, topicName, (uint16_t)topicLen);
+        if (qosValue != DELIVER_AT_MOST_ONCE)
+        {
+            // Packet Id is only set if the QOS is not 0
+            byteutil_writeInt(&iterator, packetId);
+        }
 
-                if (result != NULL)
-                {
-                    if (trace_log != NULL)
-                    {
-                        (void)STRING_copy(trace_log, "PUBLISH");
-                    }
-                    if (constructFixedHeader(result, PUBLISH_TYPE, headerFlags) != 0)
-                    {
-                        /* Codes_SRS_MQTT_CODEC_07_006: [If any error is encountered then mqtt_codec_publish shall return NULL.] */
-                        BUFFER_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        if (trace_log != NULL)
-                        {
-                            (void)STRING_concat_with_STRING(trace_log, varible_header_log);
-                        }
-                    }
-                }
+        if (trace_log != NULL)
+        {
+            (void)STRING_copy(trace_log, "PUBLISH");
+            (void)STRING_sprintf(trace_log, " | IS_DUP: %s | RETAIN: %d | QOS: %s | TOPIC_NAME: %s", duplicateMsg ? TRUE_CONST : FALSE_CONST,
+                serverRetain ? 1 : 0, retrieve_qos_value(qosValue), topicName);
+            if (qosValue != DELIVER_AT_MOST_ONCE)
+            {
+                (void)STRING_sprintf(trace_log, " | PACKET_ID: %"PRIu16, packetId);
             }
-            if (varible_header_log != NULL)
+            if (buffLen > 0)
             {
-                STRING_delete(varible_header_log);
+                (void)STRING_sprintf(trace_log, " | PAYLOAD_LEN: %lu", (unsigned long)buffLen);
             }
         }
+        result = 0;
+    }
+    return result;
+}
+
+int mqtt_codec_publishInto(QOS_VALUE qosValue, bool duplicateMsg, bool serverRetain, uint16_t packetId, const char* topicName, const uint8_t* msgBuffer, size_t buffLen, uint8_t* packet, size_t packetSize, STRING_HANDLE trace_log)
+{
+    int result;
+    size_t headerSize = mqtt_codec_publishHeaderSize(qosValue, topicName, buffLen);
+
+    if (headerSize == 0 || packet == NULL || (buffLen > 0 && msgBuffer == NULL))
+    {
+        result = MU_FAILURE;
+    }
+    else if (packetSize < headerSize || packetSize - headerSize < buffLen)
+    {
+        LogError("Packet buffer of %lu bytes too small for a %lu bytes PUBLISH", (unsigned long)packetSize, (unsigned long)(headerSize + buffLen));
+        result = MU_FAILURE;
+    }
+    else if (mqtt_codec_publishHeaderInto(qosValue, duplicateMsg, serverRetain, packetId, topicName, buffLen, packet, headerSize, trace_log) != 0)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        // Write Message
+        if (buffLen > 0)
+        {
+            (void)memcpy(packet + headerSize, msgBuffer, buffLen);
+        }
+        result = 0;
+    }
+    return result;
+}
+
+BUFFER_HANDLE mqtt_codec_publish(QOS_VALUE qosValue, bool duplicateMsg, bool serverRetain, uint16_t packetId, const char* topicName, const uint8_t* msgBuffer, size_t buffLen, STRING_HANDLE trace_log)
+{
+    BUFFER_HANDLE result;
+    size_t packetSize = mqtt_codec_publishSize(qosValue, topicName, buffLen);
+
+    if (packetSize == 0)
+    {
+        /* Codes_SRS_MQTT_CODEC_07_006: [If any error is encountered then mqtt_codec_publish shall return NULL.] */
+        result = NULL;
+    }
+    /* Codes_SRS_MQTT_CODEC_07_007: [mqtt_codec_publish shall return a BUFFER_HANDLE that represents a MQTT PUBLISH message.] */
+    else if ((result = BUFFER_create_with_size(packetSize)) == NULL)
+    {
+        /* Codes_SRS_MQTT_CODEC_07_006: [If any error is encountered then mqtt_codec_publish shall return NULL.] */
+        LogError("Failure allocating %lu bytes PUBLISH", (unsigned long)packetSize);
+    }
+    else if (mqtt_codec_publishInto(qosValue, duplicateMsg, serverRetain, packetId, topicName, msgBuffer, buffLen, BUFFER_u_char(result), packetSize, trace_log) != 0)
+    {
+        /* Codes_SRS_MQTT_CODEC_07_006: [If any error is encountered then mqtt_codec_publish shall return NULL.] */
+        BUFFER_delete(result);
+        result = NULL;
     }
     return result;
 }
@@ -1072,11 +1137,12 @@ int mqtt_codec_bytesReceived(MQTTCODEC_HANDLE handle, const unsigned char* buffe
         /* Codes_SRS_MQTT_CODEC_07_033: [mqtt_codec_bytesReceived constructs a sequence of bytes into the corresponding MQTT packets and on success returns zero.] */
         result = 0;
         size_t index = 0;
-        for (index = 0; index < size && result == 0; index++)
+        while (index < size && result == 0)
         {
-            uint8_t iterator = ((int8_t*)buffer)[index];
             if (codec_Data->codecState == CODEC_STATE_FIXED_HEADER)
             {
+                uint8_t iterator = ((int8_t*)buffer)[index++];
+
                 if (codec_Data->currPacket == UNKNOWN_TYPE)
                 {
                     codec_Data->currPacket = processControlPacketType(iterator, &codec_Data->headerFlags);
@@ -1135,12 +1201,16 @@ int mqtt_codec_bytesReceived(MQTTCODEC_HANDLE handle, const unsigned char* buffe
                     else if (codec_Data->currPacket == PINGRESP_TYPE)
                     {
                         // PINGRESP must not have a payload
-                        if (((int8_t*)buffer)[index] == 0)
+                        if (iterator != 0 || completePacketData(codec_Data, NULL, 0) != 0)
                         {
-                            /* Codes_SRS_MQTT_CODEC_07_034: [Upon a constructing a complete MQTT packet mqtt_codec_bytesReceived shall call the ON_PACKET_COMPLETE_CALLBACK function.] */
-                            completePacketData(codec_Data);
+                            codec_Data->currPacket = PACKET_TYPE_ERROR;
+                            result = MU_FAILURE;
                         }
-                        else
+                    }
+                    else if (codec_Data->codecState == CODEC_STATE_VAR_HEADER && codec_Data->packetLength == 0)
+                    {
+                        /* Codes_SRS_MQTT_CODEC_07_034: [Upon a constructing a complete MQTT packet mqtt_codec_bytesReceived shall call the ON_PACKET_COMPLETE_CALLBACK function.] */
+                        if (completePacketData(codec_Data, NULL, 0) != 0)
                         {
                             codec_Data->currPacket = PACKET_TYPE_ERROR;
                             result = MU_FAILURE;
@@ -1150,14 +1220,23 @@ int mqtt_codec_bytesReceived(MQTTCODEC_HANDLE handle, const unsigned char* buffe
             }
             else if (codec_Data->codecState == CODEC_STATE_VAR_HEADER)
             {
-                if (codec_Data->headerData == NULL)
+                if (codec_Data->bufferOffset == 0 && size - index >= codec_Data->packetLength)
                 {
-                    codec_Data->codecState = CODEC_STATE_PAYLOAD;
+                    // The whole packet is in buffer, hand it over from there
+                    size_t packetLength = codec_Data->packetLength;
+                    /* Codes_SRS_MQTT_CODEC_07_034: [Upon a constructing a complete MQTT packet mqtt_codec_bytesReceived shall call the ON_PACKET_COMPLETE_CALLBACK function.] */
+                    if (completePacketData(codec_Data, buffer + index, packetLength) != 0)
+                    {
+                        /* Codes_SRS_MQTT_CODEC_07_035: [If any error is encountered then the packet state will be marked as error and mqtt_codec_bytesReceived shall return a non-zero value.] */
+                        codec_Data->currPacket = PACKET_TYPE_ERROR;
+                        result = MU_FAILURE;
+                    }
+                    index += packetLength;
                 }
                 else
                 {
-                    uint8_t* dataBytes = BUFFER_u_char(codec_Data->headerData);
-                    if (dataBytes == NULL)
+                    size_t consumed = 0;
+                    if (assemblePacketData(codec_Data, buffer + index, size - index, &consumed) != 0)
                     {
                         /* Codes_SRS_MQTT_CODEC_07_035: [If any error is encountered then the packet state will be marked as error and mqtt_codec_bytesReceived shall return a non-zero value.] */
                         codec_Data->currPacket = PACKET_TYPE_ERROR;
@@ -1165,15 +1244,15 @@ int mqtt_codec_bytesReceived(MQTTCODEC_HANDLE handle, const unsigned char* buffe
                     }
                     else
                     {
-                        // Increment the data
-                        dataBytes += codec_Data->bufferOffset++;
-                        *dataBytes = iterator;
-
-                        size_t totalLen = BUFFER_length(codec_Data->headerData);
-                        if (codec_Data->bufferOffset >= totalLen)
+                        index += consumed;
+                        if (codec_Data->bufferOffset >= codec_Data->packetLength)
                         {
                             /* Codes_SRS_MQTT_CODEC_07_034: [Upon a constructing a complete MQTT packet mqtt_codec_bytesReceived shall call the ON_PACKET_COMPLETE_CALLBACK function.] */
-                            completePacketData(codec_Data);
+                            if (completePacketData(codec_Data, codec_Data->packetBuffer, codec_Data->packetLength) != 0)
+                            {
+                                codec_Data->currPacket = PACKET_TYPE_ERROR;
+                                result = MU_FAILURE;
+                            }
                         }
                     }
                 }